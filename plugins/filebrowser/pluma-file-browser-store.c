@@ -43,12 +43,33 @@
 #define FILE_BROWSER_NODE_DIR(node)	((FileBrowserNodeDir *)(node))
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
+#define DIRECTORY_LOAD_INCREMENTAL_ITEMS 1000
+#define DIRECTORY_MONITOR_EVENTS_DELAY 200
+#define ICON_CACHE_SIZE 256
+#define CONTENT_TYPE_CACHE_SIZE 262144
+
+/* Identify a file and its version for the content type cache */
+#define FILE_ID_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+				G_FILE_ATTRIBUTE_UNIX_INODE "," \
+				G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+				G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
 #define STANDARD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
 				 G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 			 	 G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
 				 G_FILE_ATTRIBUTE_STANDARD_NAME "," \
 				 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
-				 G_FILE_ATTRIBUTE_STANDARD_ICON
+				 G_FILE_ATTRIBUTE_STANDARD_ICON "," \
+				 FILE_ID_ATTRIBUTE_TYPES
+
+/* The content type and the icon of the files of a directory are only
+ * queried once they are shown, see _pluma_file_browser_store_iter_shown */
+#define ENUMERATE_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+				  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+				  G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+				  G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+				  G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
+				  FILE_ID_ATTRIBUTE_TYPES
 
 typedef struct _FileBrowserNode    FileBrowserNode;
 typedef struct _FileBrowserNodeDir FileBrowserNodeDir;
@@ -72,9 +93,29 @@ struct _AsyncNode
 {
 	FileBrowserNodeDir *dir;
 	GCancellable *cancellable;
-	GSList *original_children;
+	guint n_files;
 };
 
+/* A shared icon, composited with the emblem if any */
+typedef struct {
+	gchar *key;
+	GdkPixbuf *pixbuf;
+	GdkPixbuf *emblem;
+} IconCacheEntry;
+
+typedef struct {
+	/* The content type is guessed from the name too: a hard link or a
+	 * renamed file is another entry */
+	gchar *name;
+	guint32 device;
+	guint64 inode;
+	guint64 mtime;
+	guint32 mtime_usec;
+
+	gchar const *content_type;
+	GIcon *icon;
+} ContentTypeCacheEntry;
+
 typedef struct {
 	PlumaFileBrowserStore * model;
 	gchar * virtual_root;
@@ -91,9 +132,22 @@ struct _FileBrowserNode
 	GdkPixbuf *icon;
 	GdkPixbuf *emblem;
 
+	/* What the icon is loaded from, again when the icon theme changes */
+	GIcon *gicon;
+
 	FileBrowserNode *parent;
 	gint pos;
-	gboolean inserted;
+
+	/* In the rows of the parent while the node is a row of the model */
+	GSequenceIter *row;
+
+	/* Set while the content type and the icon are still to be queried */
+	gboolean needs_info;
+	GCancellable *info_cancellable;
+
+	/* Shown as text from its name, and kept shown once the content
+	 * turned out not to be */
+	gboolean keep_shown;
 };
 
 struct _FileBrowserNodeDir
@@ -101,9 +155,31 @@ struct _FileBrowserNodeDir
 	FileBrowserNode node;
 	GSList *children;
 
+	/* The children which are rows of the model, in the same order, so
+	 * that paths are computed without walking the children */
+	GSequence *rows;
+
+	/* The children by basename */
+	GHashTable *index;
+
+	/* The files of a large directory which are added to the children
+	 * in one go once the directory is read */
+	GSList *pending;
+
 	GCancellable *cancellable;
 	GFileMonitor *monitor;
 	PlumaFileBrowserStore *model;
+
+	/* The monitor events received since the last flush, by basename */
+	GHashTable *events;
+	guint events_id;
+
+	/* Set while the files of the flushed events are queried */
+	GCancellable *events_cancellable;
+
+	/* Set while the content of the files hidden as binary from their
+	 * name is looked at */
+	GCancellable *sniff_cancellable;
 };
 
 struct _PlumaFileBrowserStorePrivate
@@ -120,6 +196,14 @@ struct _PlumaFileBrowserStorePrivate
 
 	GSList *async_handles;
 	MountInfo *mount_info;
+
+	/* The icons by icon, emblem and size, the most recently used first */
+	GHashTable *icons;
+	GQueue icons_lru;
+
+	/* The content types and icons by name, device, inode and
+	 * modification time, kept across refreshes */
+	GHashTable *content_types;
 };
 
 static FileBrowserNode *model_find_node 		    (PlumaFileBrowserStore *model,
@@ -132,6 +216,8 @@ static void model_remove_node                               (PlumaFileBrowserSto
 
 static void set_virtual_root_from_node                      (PlumaFileBrowserStore * model,
 				                             FileBrowserNode * node);
+static void model_sniff_directory                           (PlumaFileBrowserStore * model,
+							     FileBrowserNode * node);
 
 static void pluma_file_browser_store_iface_init             (GtkTreeModelIface * iface);
 static GtkTreeModelFlags pluma_file_browser_store_get_flags (GtkTreeModel * tree_model);
@@ -237,15 +323,88 @@ cancel_mount_operation (PlumaFileBrowserStore *obj)
 	}
 }
 
+static void
+icon_cache_entry_free (IconCacheEntry * entry)
+{
+	g_free (entry->key);
+
+	if (entry->pixbuf)
+		g_object_unref (entry->pixbuf);
+
+	if (entry->emblem)
+		g_object_unref (entry->emblem);
+
+	g_slice_free (IconCacheEntry, entry);
+}
+
+static void
+model_clear_icons (PlumaFileBrowserStore * model)
+{
+	g_hash_table_remove_all (model->priv->icons);
+	g_queue_free_full (&model->priv->icons_lru,
+			   (GDestroyNotify) icon_cache_entry_free);
+	g_queue_init (&model->priv->icons_lru);
+}
+
+static void model_reload_icons (PlumaFileBrowserStore * model,
+				FileBrowserNode * node);
+
+static void
+on_icon_theme_changed (GtkIconTheme * theme,
+		       PlumaFileBrowserStore * model)
+{
+	model_clear_icons (model);
+
+	/* The rows shown so far too */
+	if (model->priv->root != NULL)
+		model_reload_icons (model, model->priv->root);
+}
+
+static guint
+content_type_cache_entry_hash (ContentTypeCacheEntry const * entry)
+{
+	return (guint) (entry->inode ^ (entry->inode >> 32) ^ entry->mtime) ^
+	       entry->device ^ g_str_hash (entry->name);
+}
+
+static gboolean
+content_type_cache_entry_equal (ContentTypeCacheEntry const * entry1,
+				ContentTypeCacheEntry const * entry2)
+{
+	return entry1->inode == entry2->inode &&
+	       entry1->device == entry2->device &&
+	       entry1->mtime == entry2->mtime &&
+	       entry1->mtime_usec == entry2->mtime_usec &&
+	       strcmp (entry1->name, entry2->name) == 0;
+}
+
+static void
+content_type_cache_entry_free (ContentTypeCacheEntry * entry)
+{
+	if (entry->icon)
+		g_object_unref (entry->icon);
+
+	g_free (entry->name);
+	g_slice_free (ContentTypeCacheEntry, entry);
+}
+
 static void
 pluma_file_browser_store_finalize (GObject * object)
 {
 	PlumaFileBrowserStore *obj = PLUMA_FILE_BROWSER_STORE (object);
 	GSList *item;
 
+	g_signal_handlers_disconnect_by_func (gtk_icon_theme_get_default (),
+					      on_icon_theme_changed,
+					      obj);
+
 	/* Free all the nodes */
 	file_browser_node_free (obj, obj->priv->root);
 
+	model_clear_icons (obj);
+	g_hash_table_destroy (obj->priv->icons);
+	g_hash_table_destroy (obj->priv->content_types);
+
 	/* Cancel any asynchronous operations */
 	for (item = obj->priv->async_handles; item; item = item->next)
 	{
@@ -463,6 +622,18 @@ pluma_file_browser_store_init (PlumaFileBrowserStore * obj)
 	// Default filter mode is hiding the hidden files
 	obj->priv->filter_mode = pluma_file_browser_store_filter_mode_get_default ();
 	obj->priv->sort_func = model_sort_default;
+
+	obj->priv->icons = g_hash_table_new (g_str_hash, g_str_equal);
+	obj->priv->content_types =
+	    g_hash_table_new_full ((GHashFunc) content_type_cache_entry_hash,
+				   (GEqualFunc) content_type_cache_entry_equal,
+				   (GDestroyNotify) content_type_cache_entry_free,
+				   NULL);
+
+	g_signal_connect (gtk_icon_theme_get_default (),
+			  "changed",
+			  G_CALLBACK (on_icon_theme_changed),
+			  obj);
 }
 
 static gboolean
@@ -502,11 +673,138 @@ model_node_visibility (PlumaFileBrowserStore * model,
 	return !NODE_IS_FILTERED (node);
 }
 
-static gboolean
-model_node_inserted (PlumaFileBrowserStore * model,
-		     FileBrowserNode * node)
+/* The order of the children, sort_func made total so that the rows can
+ * be searched */
+static gint
+model_compare_nodes (FileBrowserNode * node1,
+		     FileBrowserNode * node2,
+		     PlumaFileBrowserStore * model)
+{
+	gint result;
+
+	if (node1 == node2)
+		return 0;
+
+	result = model->priv->sort_func (node1, node2);
+
+	if (result == 0)
+		result = g_strcmp0 (node1->name, node2->name);
+
+	if (result == 0)
+		result = node1 < node2 ? -1 : 1;
+
+	return result;
+}
+
+static void
+model_node_add_row (PlumaFileBrowserStore * model,
+		    FileBrowserNode * node)
+{
+	GSequence *rows;
+
+	if (node->row != NULL || node->parent == NULL)
+		return;
+
+	rows = FILE_BROWSER_NODE_DIR (node->parent)->rows;
+	node->row = g_sequence_insert_sorted (rows,
+					      node,
+					      (GCompareDataFunc) model_compare_nodes,
+					      model);
+}
+
+static void
+model_node_remove_row (FileBrowserNode * node)
+{
+	if (node->row == NULL)
+		return;
+
+	g_sequence_remove (node->row);
+	node->row = NULL;
+}
+
+/* The index of the node among the rows of its parent, or the index it
+ * will have once inserted */
+static gint
+model_node_get_row_index (PlumaFileBrowserStore * model,
+			  FileBrowserNode * node)
+{
+	GSequenceIter *row;
+
+	if (node->row != NULL)
+		return g_sequence_iter_get_position (node->row);
+
+	row = g_sequence_search (FILE_BROWSER_NODE_DIR (node->parent)->rows,
+				 node,
+				 (GCompareDataFunc) model_compare_nodes,
+				 model);
+
+	return g_sequence_iter_get_position (row);
+}
+
+static FileBrowserNode *
+model_node_get_nth_row (FileBrowserNode * node, gint n)
+{
+	GSequenceIter *row;
+
+	if (node == NULL || !NODE_IS_DIR (node) || n < 0)
+		return NULL;
+
+	row = g_sequence_get_iter_at_pos (FILE_BROWSER_NODE_DIR (node)->rows, n);
+
+	if (g_sequence_iter_is_end (row))
+		return NULL;
+
+	return (FileBrowserNode *) g_sequence_get (row);
+}
+
+static void
+model_node_index_add (FileBrowserNode * node)
+{
+	if (node->file == NULL || node->parent == NULL)
+		return;
+
+	g_hash_table_replace (FILE_BROWSER_NODE_DIR (node->parent)->index,
+			      g_file_get_basename (node->file),
+			      node);
+}
+
+static void
+model_node_index_remove (FileBrowserNode * node)
+{
+	GHashTable *index;
+	gchar *name;
+
+	if (node->file == NULL || node->parent == NULL)
+		return;
+
+	index = FILE_BROWSER_NODE_DIR (node->parent)->index;
+	name = g_file_get_basename (node->file);
+
+	if (g_hash_table_lookup (index, name) == node)
+		g_hash_table_remove (index, name);
+
+	g_free (name);
+}
+
+static FileBrowserNode *
+model_node_find_child (FileBrowserNode * parent, GFile * file)
 {
-	return node == model->priv->virtual_root || (model_node_visibility (model, node) && node->inserted);
+	FileBrowserNode *child;
+	gchar *name;
+
+	if (!NODE_IS_DIR (parent))
+		return NULL;
+
+	name = g_file_get_basename (file);
+	child = g_hash_table_lookup (FILE_BROWSER_NODE_DIR (parent)->index,
+				     name);
+	g_free (name);
+
+	/* The basename matched, check that the file is in this directory */
+	if (child != NULL && !g_file_equal (child->file, file))
+		return NULL;
+
+	return child;
 }
 
 /* Interface implementation */
@@ -546,7 +844,6 @@ pluma_file_browser_store_get_iter (GtkTreeModel * tree_model,
 	gint * indices, depth, i;
 	FileBrowserNode * node;
 	PlumaFileBrowserStore * model;
-	gint num;
 
 	g_assert (PLUMA_IS_FILE_BROWSER_STORE (tree_model));
 	g_assert (path != NULL);
@@ -557,35 +854,10 @@ pluma_file_browser_store_get_iter (GtkTreeModel * tree_model,
 	node = model->priv->virtual_root;
 
 	for (i = 0; i < depth; ++i) {
-		GSList * item;
+		node = model_node_get_nth_row (node, indices[i]);
 
 		if (node == NULL)
 			return FALSE;
-
-		num = 0;
-
-		if (!NODE_IS_DIR (node))
-			return FALSE;
-
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-			FileBrowserNode * child;
-
-			child = (FileBrowserNode *) (item->data);
-
-			if (model_node_inserted (model, child)) {
-				if (num == indices[i]) {
-					node = child;
-					break;
-				}
-
-				num++;
-			}
-		}
-
-		if (item == NULL)
-			return FALSE;
-
-		node = (FileBrowserNode *) (item->data);
 	}
 
 	iter->user_data = node;
@@ -600,42 +872,26 @@ pluma_file_browser_store_get_path_real (PlumaFileBrowserStore * model,
 					FileBrowserNode * node)
 {
 	GtkTreePath *path;
-	gint num = 0;
 
 	path = gtk_tree_path_new ();
 
 	while (node != model->priv->virtual_root) {
-		GSList *item;
-
 		if (node->parent == NULL) {
 			gtk_tree_path_free (path);
 			return NULL;
 		}
 
-		num = 0;
-
-		for (item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next) {
-			FileBrowserNode *check;
-
-			check = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, check) && (check == node || check->inserted)) {
-				if (check == node) {
-					gtk_tree_path_prepend_index (path,
-								     num);
-					break;
-				}
-
-				++num;
-			} else if (check == node) {
-				if (NODE_IS_DUMMY (node))
-					g_warning ("Dummy not visible???");
+		if (node->row == NULL && !model_node_visibility (model, node)) {
+			if (NODE_IS_DUMMY (node))
+				g_warning ("Dummy not visible???");
 
-				gtk_tree_path_free (path);
-				return NULL;
-			}
+			gtk_tree_path_free (path);
+			return NULL;
 		}
 
+		gtk_tree_path_prepend_index (path,
+					     model_node_get_row_index (model, node));
+
 		node = node->parent;
 	}
 
@@ -695,32 +951,26 @@ static gboolean
 pluma_file_browser_store_iter_next (GtkTreeModel * tree_model,
 				    GtkTreeIter * iter)
 {
-	PlumaFileBrowserStore * model;
 	FileBrowserNode * node;
-	GSList * item;
-	GSList * first;
+	GSequenceIter * next;
 
 	g_return_val_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
 	g_return_val_if_fail (iter != NULL, FALSE);
 	g_return_val_if_fail (iter->user_data != NULL, FALSE);
 
-	model = PLUMA_FILE_BROWSER_STORE (tree_model);
 	node = (FileBrowserNode *) (iter->user_data);
 
-	if (node->parent == NULL)
+	if (node->row == NULL)
 		return FALSE;
 
-	first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+	next = g_sequence_iter_next (node->row);
 
-	for (item = first; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	if (g_sequence_iter_is_end (next))
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = g_sequence_get (next);
+	return TRUE;
 }
 
 static gboolean
@@ -729,8 +979,8 @@ pluma_file_browser_store_iter_children (GtkTreeModel * tree_model,
 					GtkTreeIter * parent)
 {
 	FileBrowserNode * node;
+	FileBrowserNode * child;
 	PlumaFileBrowserStore * model;
-	GSList * item;
 
 	g_return_val_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -744,33 +994,30 @@ pluma_file_browser_store_iter_children (GtkTreeModel * tree_model,
 	else
 		node = (FileBrowserNode *) (parent->user_data);
 
-	if (node == NULL)
-		return FALSE;
+	child = model_node_get_nth_row (node, 0);
 
-	if (!NODE_IS_DIR (node))
+	if (child == NULL)
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
-
-	return FALSE;
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
 filter_tree_model_iter_has_child_real (PlumaFileBrowserStore * model,
 				       FileBrowserNode * node)
 {
-	GSList *item;
+	GSequenceIter *row;
 
 	if (!NODE_IS_DIR (node))
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
+	/* All the rows are visible, but the dummy while model_check_dummy ()
+	 * looks for real children */
+	for (row = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->rows);
+	     !g_sequence_iter_is_end (row);
+	     row = g_sequence_iter_next (row)) {
+		if (model_node_visibility (model, (FileBrowserNode *) g_sequence_get (row)))
 			return TRUE;
 	}
 
@@ -805,8 +1052,6 @@ pluma_file_browser_store_iter_n_children (GtkTreeModel * tree_model,
 {
 	FileBrowserNode *node;
 	PlumaFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -823,11 +1068,7 @@ pluma_file_browser_store_iter_n_children (GtkTreeModel * tree_model,
 	if (!NODE_IS_DIR (node))
 		return 0;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-			++num;
-
-	return num;
+	return g_sequence_get_length (FILE_BROWSER_NODE_DIR (node)->rows);
 }
 
 static gboolean
@@ -836,9 +1077,8 @@ pluma_file_browser_store_iter_nth_child (GtkTreeModel * tree_model,
 					 GtkTreeIter * parent, gint n)
 {
 	FileBrowserNode *node;
+	FileBrowserNode *child;
 	PlumaFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -852,22 +1092,13 @@ pluma_file_browser_store_iter_nth_child (GtkTreeModel * tree_model,
 	else
 		node = (FileBrowserNode *) (parent->user_data);
 
-	if (!NODE_IS_DIR (node))
-		return FALSE;
-
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item;
-	     item = item->next) {
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data))) {
-			if (num == n) {
-				iter->user_data = item->data;
-				return TRUE;
-			}
+	child = model_node_get_nth_row (node, n);
 
-			++num;
-		}
-	}
+	if (child == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
@@ -902,7 +1133,7 @@ pluma_file_browser_store_row_inserted (GtkTreeModel * tree_model,
 {
 	FileBrowserNode * node = (FileBrowserNode *)(iter->user_data);
 
-	node->inserted = TRUE;
+	model_node_add_row (PLUMA_FILE_BROWSER_STORE (tree_model), node);
 }
 
 static gboolean
@@ -996,7 +1227,8 @@ model_node_update_visibility (PlumaFileBrowserStore * model,
 	    NODE_IS_HIDDEN (node))
 		node->flags |= PLUMA_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
 	else if (FILTER_BINARY (model->priv->filter_mode) &&
-		 (!NODE_IS_TEXT (node) && !NODE_IS_DIR (node)))
+		 (!NODE_IS_TEXT (node) && !NODE_IS_DIR (node)) &&
+		 !node->keep_shown)
 		node->flags |= PLUMA_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
 	else if (model->priv->filter_func) {
 		iter.user_data = node;
@@ -1073,7 +1305,7 @@ static void
 model_resort_node (PlumaFileBrowserStore * model, FileBrowserNode * node)
 {
 	FileBrowserNodeDir *dir;
-	GSList *item;
+	GSequenceIter *row;
 	FileBrowserNode *child;
 	gint pos = 0;
 	GtkTreeIter iter;
@@ -1082,45 +1314,44 @@ model_resort_node (PlumaFileBrowserStore * model, FileBrowserNode * node)
 
 	dir = FILE_BROWSER_NODE_DIR (node->parent);
 
-	if (!model_node_visibility (model, node->parent)) {
-		/* Just sort the children of the parent */
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->
-							      sort_func));
-	} else {
-		/* Store current positions */
-		for (item = dir->children; item; item = item->next) {
-			child = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, child))
-				child->pos = pos++;
-		}
+	dir->children = g_slist_sort_with_data (dir->children,
+						(GCompareDataFunc) model_compare_nodes,
+						model);
 
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->
-							      sort_func));
-		neworder = g_new (gint, pos);
-		pos = 0;
+	if (!model_node_visibility (model, node->parent) ||
+	    g_sequence_get_length (dir->rows) == 0)
+		return;
 
-		/* Store the new positions */
-		for (item = dir->children; item; item = item->next) {
-			child = (FileBrowserNode *) (item->data);
+	/* Store current positions */
+	for (row = g_sequence_get_begin_iter (dir->rows);
+	     !g_sequence_iter_is_end (row);
+	     row = g_sequence_iter_next (row)) {
+		child = (FileBrowserNode *) g_sequence_get (row);
+		child->pos = pos++;
+	}
 
-			if (model_node_visibility (model, child))
-				neworder[pos++] = child->pos;
-		}
+	g_sequence_sort (dir->rows,
+			 (GCompareDataFunc) model_compare_nodes,
+			 model);
+	neworder = g_new (gint, pos);
+	pos = 0;
+
+	/* Store the new positions */
+	for (row = g_sequence_get_begin_iter (dir->rows);
+	     !g_sequence_iter_is_end (row);
+	     row = g_sequence_iter_next (row)) {
+		child = (FileBrowserNode *) g_sequence_get (row);
+		neworder[pos++] = child->pos;
+	}
 
-		iter.user_data = node->parent;
-		path =
-		    pluma_file_browser_store_get_path_real (model,
-							    node->parent);
+	iter.user_data = node->parent;
+	path = pluma_file_browser_store_get_path_real (model, node->parent);
 
-		gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model),
-					       path, &iter, neworder);
+	gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model),
+				       path, &iter, neworder);
 
-		g_free (neworder);
-		gtk_tree_path_free (path);
-	}
+	g_free (neworder);
+	gtk_tree_path_free (path);
 }
 
 static void
@@ -1235,7 +1466,7 @@ model_refilter_node (PlumaFileBrowserStore * model,
 
 		if (old_visible != new_visible) {
 			if (old_visible) {
-				node->inserted = FALSE;
+				model_node_remove_row (node);
 				row_deleted (model, *path);
 			} else {
 				iter.user_data = node;
@@ -1304,10 +1535,56 @@ file_browser_node_dir_new (PlumaFileBrowserStore * model,
 	node->flags |= PLUMA_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 
 	FILE_BROWSER_NODE_DIR (node)->model = model;
+	FILE_BROWSER_NODE_DIR (node)->rows = g_sequence_new (NULL);
+	FILE_BROWSER_NODE_DIR (node)->index =
+	    g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	return node;
 }
 
+static void
+model_clear_monitor_events (FileBrowserNodeDir * dir)
+{
+	if (dir->events_id != 0) {
+		g_source_remove (dir->events_id);
+		dir->events_id = 0;
+	}
+
+	if (dir->events != NULL) {
+		g_hash_table_destroy (dir->events);
+		dir->events = NULL;
+	}
+
+	if (dir->events_cancellable != NULL) {
+		g_cancellable_cancel (dir->events_cancellable);
+		g_object_unref (dir->events_cancellable);
+		dir->events_cancellable = NULL;
+	}
+}
+
+static void
+model_cancel_sniff (FileBrowserNodeDir * dir)
+{
+	if (dir->sniff_cancellable != NULL) {
+		g_cancellable_cancel (dir->sniff_cancellable);
+		g_object_unref (dir->sniff_cancellable);
+		dir->sniff_cancellable = NULL;
+	}
+}
+
+static void
+file_browser_node_free_pending (PlumaFileBrowserStore * model,
+				FileBrowserNodeDir * dir)
+{
+	GSList *item;
+
+	for (item = dir->pending; item; item = item->next)
+		file_browser_node_free (model, (FileBrowserNode *) (item->data));
+
+	g_slist_free (dir->pending);
+	dir->pending = NULL;
+}
+
 static void
 file_browser_node_free_children (PlumaFileBrowserStore * model,
 				 FileBrowserNode * node)
@@ -1341,6 +1618,14 @@ file_browser_node_free (PlumaFileBrowserStore * model,
 	if (node == NULL)
 		return;
 
+	model_node_remove_row (node);
+	model_node_index_remove (node);
+
+	if (node->info_cancellable != NULL) {
+		g_cancellable_cancel (node->info_cancellable);
+		g_object_unref (node->info_cancellable);
+	}
+
 	if (NODE_IS_DIR (node))
 	{
 		FileBrowserNodeDir *dir;
@@ -1354,12 +1639,18 @@ file_browser_node_free (PlumaFileBrowserStore * model,
 			model_end_loading (model, node);
 		}
 
+		file_browser_node_free_pending (model, dir);
 		file_browser_node_free_children (model, node);
+		g_sequence_free (dir->rows);
+		g_hash_table_destroy (dir->index);
 
 		if (dir->monitor) {
 			g_file_monitor_cancel (dir->monitor);
 			g_object_unref (dir->monitor);
 		}
+
+		model_clear_monitor_events (dir);
+		model_cancel_sniff (dir);
 	}
 
 	if (node->file)
@@ -1374,6 +1665,9 @@ file_browser_node_free (PlumaFileBrowserStore * model,
 	if (node->icon)
 		g_object_unref (node->icon);
 
+	if (node->gicon)
+		g_object_unref (node->gicon);
+
 	if (node->emblem)
 		g_object_unref (node->emblem);
 
@@ -1476,7 +1770,7 @@ model_remove_node (PlumaFileBrowserStore * model,
 	   not the virtual root) */
 	if (model_node_visibility (model, node) && node != model->priv->virtual_root)
 	{
-		node->inserted = FALSE;
+		model_node_remove_row (node);
 		row_deleted (model, path);
 	}
 
@@ -1537,7 +1831,7 @@ model_clear (PlumaFileBrowserStore * model, gboolean free_nodes)
 			    && model_node_visibility (model, dummy)) {
 				path = gtk_tree_path_new_first ();
 
-				dummy->inserted = FALSE;
+				model_node_remove_row (dummy);
 				row_deleted (model, path);
 				gtk_tree_path_free (path);
 			}
@@ -1577,63 +1871,191 @@ file_browser_node_unload (PlumaFileBrowserStore * model,
 		dir->monitor = NULL;
 	}
 
+	model_clear_monitor_events (dir);
+	model_cancel_sniff (dir);
+	file_browser_node_free_pending (model, dir);
+
 	node->flags &= ~PLUMA_FILE_BROWSER_STORE_FLAG_LOADED;
 }
 
-static void
-model_recomposite_icon_real (PlumaFileBrowserStore * tree_model,
-			     FileBrowserNode * node,
-			     GFileInfo * info)
+static GdkPixbuf *
+model_load_icon (GIcon * gicon,
+		 GdkPixbuf * emblem,
+		 gint size)
 {
-	GdkPixbuf *icon;
+	GdkPixbuf *icon = NULL;
+	GdkPixbuf *composite;
+
+	if (gicon != NULL)
+		icon = pluma_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
+
+	if (emblem == NULL)
+		return icon;
+
+	if (icon == NULL) {
+		composite = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (emblem),
+					    gdk_pixbuf_get_has_alpha (emblem),
+					    gdk_pixbuf_get_bits_per_sample (emblem),
+					    size,
+					    size);
+		gdk_pixbuf_fill (composite, 0);
+	} else {
+		composite = gdk_pixbuf_copy (icon);
+		g_object_unref (icon);
+	}
 
-	g_return_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model));
-	g_return_if_fail (node != NULL);
+	gdk_pixbuf_composite (emblem, composite,
+			      size - 10, size - 10, 10,
+			      10, size - 10, size - 10,
+			      1, 1, GDK_INTERP_NEAREST, 255);
 
-	if (node->file == NULL)
-		return;
+	return composite;
+}
 
-	if (info) {
-		GIcon *gicon = g_file_info_get_icon (info);
-		if (gicon != NULL)
-			icon = pluma_file_browser_utils_pixbuf_from_icon (gicon, GTK_ICON_SIZE_MENU);
-		else
-			icon = NULL;
-	} else {
-		icon = pluma_file_browser_utils_pixbuf_from_file (node->file, GTK_ICON_SIZE_MENU);
+/* Returns a new reference to the icon shared by the nodes with the same
+ * icon and emblem */
+static GdkPixbuf *
+model_get_icon (PlumaFileBrowserStore * model,
+		GIcon * gicon,
+		GdkPixbuf * emblem)
+{
+	IconCacheEntry *entry;
+	GList *link;
+	gchar *name = NULL;
+	gchar *key;
+	gint size;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &size);
+
+	if (gicon != NULL) {
+		name = g_icon_to_string (gicon);
+
+		/* Not serializable, do not share it */
+		if (name == NULL)
+			return model_load_icon (gicon, emblem, size);
 	}
 
-	if (node->icon)
-		g_object_unref (node->icon);
+	key = g_strdup_printf ("%s %p %d", name ? name : "", (gpointer) emblem, size);
+	g_free (name);
 
-	if (node->emblem) {
-		gint icon_size;
+	link = g_hash_table_lookup (model->priv->icons, key);
 
-		gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, NULL, &icon_size);
+	if (link != NULL) {
+		g_free (key);
 
-		if (icon == NULL) {
-			node->icon =
-			    gdk_pixbuf_new (gdk_pixbuf_get_colorspace (node->emblem),
-					    gdk_pixbuf_get_has_alpha (node->emblem),
-					    gdk_pixbuf_get_bits_per_sample (node->emblem),
-					    icon_size,
-					    icon_size);
-		} else {
-			node->icon = gdk_pixbuf_copy (icon);
-			g_object_unref (icon);
-		}
+		/* Move it to the front */
+		g_queue_unlink (&model->priv->icons_lru, link);
+		g_queue_push_head_link (&model->priv->icons_lru, link);
 
-		gdk_pixbuf_composite (node->emblem, node->icon,
-				      icon_size - 10, icon_size - 10, 10,
-				      10, icon_size - 10, icon_size - 10,
-				      1, 1, GDK_INTERP_NEAREST, 255);
-	} else {
-		node->icon = icon;
+		entry = (IconCacheEntry *) (link->data);
+		return entry->pixbuf ? g_object_ref (entry->pixbuf) : NULL;
 	}
-}
 
-static void
-model_recomposite_icon (PlumaFileBrowserStore * tree_model,
+	entry = g_slice_new (IconCacheEntry);
+	entry->key = key;
+	entry->pixbuf = model_load_icon (gicon, emblem, size);
+
+	/* Keeps the emblem alive so that its address is not reused */
+	entry->emblem = emblem ? g_object_ref (emblem) : NULL;
+
+	g_queue_push_head (&model->priv->icons_lru, entry);
+	g_hash_table_insert (model->priv->icons, entry->key,
+			     model->priv->icons_lru.head);
+
+	if (g_queue_get_length (&model->priv->icons_lru) > ICON_CACHE_SIZE) {
+		IconCacheEntry *last;
+
+		last = g_queue_pop_tail (&model->priv->icons_lru);
+		g_hash_table_remove (model->priv->icons, last->key);
+		icon_cache_entry_free (last);
+	}
+
+	return entry->pixbuf ? g_object_ref (entry->pixbuf) : NULL;
+}
+
+static void
+model_recomposite_icon_real (PlumaFileBrowserStore * tree_model,
+			     FileBrowserNode * node,
+			     GFileInfo * info)
+{
+	GIcon *gicon = NULL;
+
+	g_return_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model));
+	g_return_if_fail (node != NULL);
+
+	if (node->file == NULL)
+		return;
+
+	if (info) {
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON) &&
+		    g_file_info_get_icon (info) != NULL)
+			gicon = g_object_ref (g_file_info_get_icon (info));
+	} else {
+		info = g_file_query_info (node->file,
+					  G_FILE_ATTRIBUTE_STANDARD_ICON,
+					  G_FILE_QUERY_INFO_NONE,
+					  NULL,
+					  NULL);
+
+		if (info != NULL) {
+			if (g_file_info_get_icon (info) != NULL)
+				gicon = g_object_ref (g_file_info_get_icon (info));
+
+			g_object_unref (info);
+		}
+	}
+
+	if (node->icon)
+		g_object_unref (node->icon);
+
+	node->icon = model_get_icon (tree_model, gicon, node->emblem);
+
+	if (node->gicon)
+		g_object_unref (node->gicon);
+
+	node->gicon = gicon;
+}
+
+/* Loads the icons of @node and of the nodes under it from the current
+ * icon theme, without querying the files again */
+static void
+model_reload_icons (PlumaFileBrowserStore * model,
+		    FileBrowserNode * node)
+{
+	GSList *item;
+
+	if (node->file != NULL) {
+		if (node->icon)
+			g_object_unref (node->icon);
+
+		node->icon = model_get_icon (model, node->gicon, node->emblem);
+
+		if (node->icon == NULL && node->gicon == NULL && NODE_IS_DIR (node))
+			node->icon = pluma_file_browser_utils_pixbuf_from_theme ("folder", GTK_ICON_SIZE_MENU);
+
+		if (node != model->priv->virtual_root && model_node_visibility (model, node)) {
+			GtkTreeIter iter;
+			GtkTreePath *path;
+
+			iter.user_data = node;
+			path = pluma_file_browser_store_get_path_real (model, node);
+			row_changed (model, &path, &iter);
+			gtk_tree_path_free (path);
+		}
+	}
+
+	if (!NODE_IS_DIR (node))
+		return;
+
+	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		model_reload_icons (model, (FileBrowserNode *) (item->data));
+
+	for (item = FILE_BROWSER_NODE_DIR (node)->pending; item; item = item->next)
+		model_reload_icons (model, (FileBrowserNode *) (item->data));
+}
+
+static void
+model_recomposite_icon (PlumaFileBrowserStore * tree_model,
 			GtkTreeIter * iter)
 {
 	g_return_if_fail (PLUMA_IS_FILE_BROWSER_STORE (tree_model));
@@ -1739,7 +2161,7 @@ model_check_dummy (PlumaFileBrowserStore * model, FileBrowserNode * node)
 				dummy->flags |=
 				    PLUMA_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
-				dummy->inserted = FALSE;
+				model_node_remove_row (dummy);
 				row_deleted (model, path);
 				gtk_tree_path_free (path);
 			}
@@ -1755,14 +2177,15 @@ insert_node_sorted (PlumaFileBrowserStore * model,
 	FileBrowserNodeDir *dir;
 
 	dir = FILE_BROWSER_NODE_DIR (parent);
+	model_node_index_add (child);
 
 	if (model->priv->sort_func == NULL) {
 		dir->children = g_slist_append (dir->children, child);
 	} else {
 		dir->children =
-		    g_slist_insert_sorted (dir->children, child,
-					   (GCompareFunc) (model->priv->
-							   sort_func));
+		    g_slist_insert_sorted_with_data (dir->children, child,
+						     (GCompareDataFunc) model_compare_nodes,
+						     model);
 	}
 }
 
@@ -1803,7 +2226,12 @@ model_add_nodes_batch (PlumaFileBrowserStore * model,
 
 	dir = FILE_BROWSER_NODE_DIR (parent);
 
-	sorted_children = g_slist_sort (children, (GCompareFunc) model->priv->sort_func);
+	for (l = children; l; l = l->next)
+		model_node_index_add ((FileBrowserNode *) (l->data));
+
+	sorted_children = g_slist_sort_with_data (children,
+						  (GCompareDataFunc) model_compare_nodes,
+						  model);
 
 	child = sorted_children;
 	l = dir->children;
@@ -1838,7 +2266,7 @@ model_add_nodes_batch (PlumaFileBrowserStore * model,
 			break;
 		}
 
-		if (model->priv->sort_func (l->data, node) > 0) {
+		if (model_compare_nodes (l->data, node, model) > 0) {
 			GSList *next_child;
 
 			if (prev == NULL) {
@@ -1876,6 +2304,84 @@ model_add_nodes_batch (PlumaFileBrowserStore * model,
 	}
 }
 
+/* Falls back to the content type guessed from the name when the content
+ * has not been looked at yet */
+static gchar const *
+file_info_get_content_type (GFileInfo * info)
+{
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		return g_file_info_get_content_type (info);
+
+	return g_file_info_get_attribute_string (info,
+						 G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+}
+
+static gboolean
+content_type_cache_entry_init (ContentTypeCacheEntry * entry,
+			       GFileInfo * info)
+{
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+	    !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) ||
+	    g_file_info_get_name (info) == NULL)
+		return FALSE;
+
+	/* Only copied for the entries kept */
+	entry->name = (gchar *) g_file_info_get_name (info);
+	entry->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+	entry->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	entry->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	entry->mtime_usec = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	entry->content_type = NULL;
+	entry->icon = NULL;
+
+	return TRUE;
+}
+
+/* Remembers the content type and the icon of a file, or fills them in
+ * from what was remembered when the file did not change since */
+static void
+model_cache_content_type (PlumaFileBrowserStore * model,
+			  GFileInfo * info)
+{
+	ContentTypeCacheEntry key;
+	ContentTypeCacheEntry *entry;
+	GHashTable *content_types = model->priv->content_types;
+
+	if (!content_type_cache_entry_init (&key, info))
+		return;
+
+	if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE)) {
+		entry = g_hash_table_lookup (content_types, &key);
+
+		if (entry != NULL) {
+			g_file_info_set_content_type (info, entry->content_type);
+
+			if (entry->icon != NULL)
+				g_file_info_set_icon (info, entry->icon);
+		}
+
+		return;
+	}
+
+	if (g_file_info_get_content_type (info) == NULL)
+		return;
+
+	/* Start again rather than keep track of the oldest ones */
+	if (g_hash_table_size (content_types) >= CONTENT_TYPE_CACHE_SIZE)
+		g_hash_table_remove_all (content_types);
+
+	entry = g_slice_new (ContentTypeCacheEntry);
+	*entry = key;
+	entry->name = g_strdup (key.name);
+	entry->content_type = g_intern_string (g_file_info_get_content_type (info));
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_ICON) &&
+	    g_file_info_get_icon (info) != NULL)
+		entry->icon = g_object_ref (g_file_info_get_icon (info));
+
+	g_hash_table_replace (content_types, entry, NULL);
+}
+
 static gchar const *
 backup_content_type (GFileInfo * info)
 {
@@ -1884,7 +2390,7 @@ backup_content_type (GFileInfo * info)
 	if (!g_file_info_get_is_backup (info))
 		return NULL;
 
-	content = g_file_info_get_content_type (info);
+	content = file_info_get_content_type (info);
 
 	if (!content || g_content_type_equals (content, "application/x-trash"))
 		return "text/plain";
@@ -1925,6 +2431,8 @@ file_browser_node_set_from_info (PlumaFileBrowserStore * model,
 		free_info = TRUE;
 	}
 
+	model_cache_content_type (model, info);
+
 	if (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))
 		node->flags |= PLUMA_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
@@ -1932,7 +2440,7 @@ file_browser_node_set_from_info (PlumaFileBrowserStore * model,
 		node->flags |= PLUMA_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 	else {
 		if (!(content = backup_content_type (info)))
-			content = g_file_info_get_content_type (info);
+			content = file_info_get_content_type (info);
 
 		if (!content ||
 		    g_content_type_is_unknown (content) ||
@@ -1942,6 +2450,8 @@ file_browser_node_set_from_info (PlumaFileBrowserStore * model,
 
 	model_recomposite_icon_real (model, node, info);
 
+	node->needs_info = !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+
 	if (free_info)
 		g_object_unref (info);
 
@@ -1956,24 +2466,6 @@ file_browser_node_set_from_info (PlumaFileBrowserStore * model,
 	}
 }
 
-static FileBrowserNode *
-node_list_contains_file (GSList *children, GFile * file)
-{
-	GSList *item;
-
-	for (item = children; item; item = item->next) {
-		FileBrowserNode *node;
-
-		node = (FileBrowserNode *) (item->data);
-
-		if (node->file != NULL
-		    && g_file_equal (node->file, file))
-			return node;
-	}
-
-	return NULL;
-}
-
 static FileBrowserNode *
 model_add_node_from_file (PlumaFileBrowserStore * model,
 			  FileBrowserNode * parent,
@@ -1984,7 +2476,7 @@ model_add_node_from_file (PlumaFileBrowserStore * model,
 	gboolean free_info = FALSE;
 	GError * error = NULL;
 
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL) {
+	if ((node = model_node_find_child (parent, file)) == NULL) {
 		if (info == NULL) {
 			info = g_file_query_info (file,
 						  STANDARD_ATTRIBUTE_TYPES,
@@ -2016,15 +2508,12 @@ model_add_node_from_file (PlumaFileBrowserStore * model,
 	return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
- * not have to check if a file already exists among the ones we just
- * added */
 static void
 model_add_nodes_from_files (PlumaFileBrowserStore * model,
-			    FileBrowserNode * parent,
-			    GSList * original_children,
+			    AsyncNode * async,
 			    GList * files)
 {
+	FileBrowserNode *parent = (FileBrowserNode *) async->dir;
 	GList *item;
 	GSList *nodes = NULL;
 
@@ -2054,9 +2543,9 @@ model_add_nodes_from_files (PlumaFileBrowserStore * model,
 			continue;
 		}
 
-		file = g_file_get_child (parent->file, name);
-
-		if ((node = node_list_contains_file (original_children, file)) == NULL) {
+		/* Skip the files which are already there */
+		if (g_hash_table_lookup (FILE_BROWSER_NODE_DIR (parent)->index, name) == NULL) {
+			file = g_file_get_child (parent->file, name);
 
 			if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
 				node = file_browser_node_dir_new (model, file, parent);
@@ -2067,14 +2556,22 @@ model_add_nodes_from_files (PlumaFileBrowserStore * model,
 			file_browser_node_set_from_info (model, node, info, FALSE);
 
 			nodes = g_slist_prepend (nodes, node);
+			async->n_files++;
+			g_object_unref (file);
 		}
 
-		g_object_unref (file);
 		g_object_unref (info);
 	}
 
-	if (nodes)
+	if (nodes == NULL)
+		return;
+
+	/* The first files are shown as they come in, the rest of a large
+	 * directory is sorted and added only once it has been read */
+	if (async->n_files <= DIRECTORY_LOAD_INCREMENTAL_ITEMS)
 		model_add_nodes_batch (model, nodes, parent);
+	else
+		async->dir->pending = g_slist_concat (nodes, async->dir->pending);
 }
 
 static FileBrowserNode *
@@ -2085,7 +2582,7 @@ model_add_node_from_dir (PlumaFileBrowserStore * model,
 	FileBrowserNode *node;
 
 	/* Check if it already exists */
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL) {
+	if ((node = model_node_find_child (parent, file)) == NULL) {
 		node = file_browser_node_dir_new (model, file, parent);
 		file_browser_node_set_from_info (model, node, NULL, FALSE);
 
@@ -2103,6 +2600,275 @@ model_add_node_from_dir (PlumaFileBrowserStore * model,
 	return node;
 }
 
+/* Removes the rows of the nodes and then prunes the children of the parent
+ * in one pass */
+static void
+model_remove_nodes_batch (PlumaFileBrowserStore * model,
+			  GSList * nodes,
+			  FileBrowserNode * parent)
+{
+	FileBrowserNodeDir *dir;
+	GHashTable *removed;
+	GSList *children = NULL;
+	GSList *item;
+
+	dir = FILE_BROWSER_NODE_DIR (parent);
+
+	if (g_slist_find (nodes, model->priv->virtual_root) != NULL) {
+		/* Moving the virtual root up refills the model, let
+		 * model_remove_node take care of it one node at a time */
+		for (item = nodes; item; item = item->next)
+			model_remove_node (model, (FileBrowserNode *) (item->data), NULL, TRUE);
+
+		return;
+	}
+
+	removed = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (item = nodes; item; item = item->next) {
+		model_remove_node (model, (FileBrowserNode *) (item->data), NULL, FALSE);
+		g_hash_table_add (removed, item->data);
+	}
+
+	for (item = dir->children; item; item = item->next) {
+		if (!g_hash_table_contains (removed, item->data))
+			children = g_slist_prepend (children, item->data);
+	}
+
+	g_slist_free (dir->children);
+	dir->children = g_slist_reverse (children);
+
+	for (item = nodes; item; item = item->next)
+		file_browser_node_free (model, (FileBrowserNode *) (item->data));
+
+	g_hash_table_destroy (removed);
+}
+
+/* Files of a directory queried together off the main thread: the ones
+ * created or changed in a monitor flush, or the ones to sniff */
+typedef struct
+{
+	FileBrowserNode *parent;
+	GPtrArray *names;
+	GPtrArray *files;
+	GPtrArray *infos;
+} FilesQuery;
+
+static void
+file_info_unref (GFileInfo * info)
+{
+	if (info != NULL)
+		g_object_unref (info);
+}
+
+static void
+files_query_free (FilesQuery * query)
+{
+	g_ptr_array_unref (query->names);
+	g_ptr_array_unref (query->files);
+	g_ptr_array_unref (query->infos);
+	g_slice_free (FilesQuery, query);
+}
+
+static FilesQuery *
+files_query_new (FileBrowserNode * parent)
+{
+	FilesQuery *query;
+
+	query = g_slice_new (FilesQuery);
+	query->parent = parent;
+	query->names = g_ptr_array_new_with_free_func (g_free);
+	query->files = g_ptr_array_new_with_free_func (g_object_unref);
+	query->infos = g_ptr_array_new_with_free_func ((GDestroyNotify) file_info_unref);
+
+	return query;
+}
+
+static void
+files_query_add (FilesQuery * query,
+		 gchar const * name)
+{
+	g_ptr_array_add (query->names, g_strdup (name));
+	g_ptr_array_add (query->files, g_file_get_child (query->parent->file, name));
+}
+
+static void
+files_query_thread (GTask * task,
+		    gpointer source_object,
+		    FilesQuery * query,
+		    GCancellable * cancellable)
+{
+	guint i;
+
+	for (i = 0; i < query->files->len; i++) {
+		GFileInfo *info;
+
+		/* NULL when gone again already */
+		info = g_file_query_info (g_ptr_array_index (query->files, i),
+					  STANDARD_ATTRIBUTE_TYPES,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
+
+		g_ptr_array_add (query->infos, info);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* @callback gets the query as the task data, and is not to use the
+ * directory when the task was cancelled */
+static void
+files_query_run (FilesQuery * query,
+		 GCancellable * cancellable,
+		 GAsyncReadyCallback callback)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, cancellable, callback, NULL);
+	g_task_set_task_data (task, query, (GDestroyNotify) files_query_free);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_run_in_thread (task, (GTaskThreadFunc) files_query_thread);
+	g_object_unref (task);
+}
+
+static gboolean model_flush_monitor_events (FileBrowserNode * parent);
+
+static void
+events_query_cb (GObject * source_object,
+		 GAsyncResult * result,
+		 gpointer user_data)
+{
+	FilesQuery *query = g_task_get_task_data (G_TASK (result));
+	FileBrowserNode *parent;
+	FileBrowserNodeDir *dir;
+	PlumaFileBrowserStore *model;
+	GSList *added = NULL;
+	GSList *changed = NULL;
+	GSList *item;
+	guint i;
+
+	/* The directory is unloaded or gone when cancelled */
+	if (!g_task_propagate_boolean (G_TASK (result), NULL))
+		return;
+
+	parent = query->parent;
+	dir = FILE_BROWSER_NODE_DIR (parent);
+	model = dir->model;
+
+	g_clear_object (&dir->events_cancellable);
+
+	for (i = 0; i < query->names->len; i++) {
+		gchar const *name = g_ptr_array_index (query->names, i);
+		GFile *file = g_ptr_array_index (query->files, i);
+		GFileInfo *info = g_ptr_array_index (query->infos, i);
+		FileBrowserNode *node;
+
+		if (info == NULL)
+			continue;
+
+		node = g_hash_table_lookup (dir->index, name);
+
+		if (node != NULL) {
+			file_browser_node_set_from_info (model, node, info, TRUE);
+			changed = g_slist_prepend (changed, node);
+		} else {
+			if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+				node = file_browser_node_dir_new (model, file, parent);
+			else
+				node = file_browser_node_new (file, parent);
+
+			file_browser_node_set_from_info (model, node, info, FALSE);
+			added = g_slist_prepend (added, node);
+		}
+	}
+
+	if (added != NULL)
+		model_add_nodes_batch (model, added, parent);
+
+	for (item = changed; item; item = item->next) {
+		FileBrowserNode *node = (FileBrowserNode *) (item->data);
+		GtkTreeIter iter;
+		GtkTreePath *path;
+
+		if (model_node_visibility (model, node)) {
+			iter.user_data = node;
+			path = pluma_file_browser_store_get_path_real (model, node);
+			row_changed (model, &path, &iter);
+			gtk_tree_path_free (path);
+		}
+	}
+
+	g_slist_free (changed);
+
+	/* The events received in the meantime */
+	if (dir->events != NULL && dir->events_id == 0)
+		model_flush_monitor_events (parent);
+}
+
+/* Deletions are applied right away. The files created or changed are
+ * queried in one go on a thread, and a flush waits for the query of the
+ * previous one to be done. */
+static gboolean
+model_flush_monitor_events (FileBrowserNode * parent)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	PlumaFileBrowserStore *model = dir->model;
+	GHashTable *events;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	GSList *removed = NULL;
+	FilesQuery *query;
+
+	dir->events_id = 0;
+
+	if (dir->events_cancellable != NULL)
+		return FALSE;
+
+	events = dir->events;
+	dir->events = NULL;
+
+	query = files_query_new (parent);
+
+	g_hash_table_iter_init (&iter, events);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		gchar const *name = key;
+		FileBrowserNode *node;
+
+		node = g_hash_table_lookup (dir->index, name);
+
+		if (GPOINTER_TO_INT (value) == G_FILE_MONITOR_EVENT_DELETED) {
+			if (node != NULL)
+				removed = g_slist_prepend (removed, node);
+		} else if (node != NULL ||
+			   GPOINTER_TO_INT (value) == G_FILE_MONITOR_EVENT_CREATED) {
+			/* Also when deleted and created again */
+			files_query_add (query, name);
+		}
+	}
+
+	g_hash_table_destroy (events);
+
+	if (removed != NULL) {
+		model_remove_nodes_batch (model, removed, parent);
+		g_slist_free (removed);
+	}
+
+	if (query->files->len == 0) {
+		files_query_free (query);
+		return FALSE;
+	}
+
+	dir->events_cancellable = g_cancellable_new ();
+	files_query_run (query, dir->events_cancellable, events_query_cb);
+
+	return FALSE;
+}
+
+/* The events are coalesced and applied in one go after a short delay, so
+ * that the model does not emit signals for every file of a busy directory */
 static void
 on_directory_monitor_event (GFileMonitor * monitor,
 			    GFile * file,
@@ -2110,36 +2876,79 @@ on_directory_monitor_event (GFileMonitor * monitor,
 			    GFileMonitorEvent event_type,
 			    FileBrowserNode * parent)
 {
-	FileBrowserNode *node;
 	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	gchar *name;
 
 	switch (event_type) {
 	case G_FILE_MONITOR_EVENT_DELETED:
-		node = node_list_contains_file (dir->children, file);
-
-		if (node != NULL) {
-			model_remove_node (dir->model, node, NULL, TRUE);
-		}
-		break;
 	case G_FILE_MONITOR_EVENT_CREATED:
-		if (g_file_query_exists (file, NULL)) {
-			model_add_node_from_file (dir->model, parent, file, NULL);
-		}
-
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
 		break;
 	default:
-		break;
+		return;
 	}
+
+	if (dir->events == NULL)
+		dir->events = g_hash_table_new_full (g_str_hash,
+						     g_str_equal,
+						     g_free,
+						     NULL);
+
+	name = g_file_get_basename (file);
+
+	/* A change does not override a pending creation or deletion */
+	if ((event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT ||
+	     event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) &&
+	    g_hash_table_contains (dir->events, name))
+		g_free (name);
+	else
+		g_hash_table_replace (dir->events, name, GINT_TO_POINTER (event_type));
+
+	if (dir->events_id == 0)
+		dir->events_id = g_timeout_add (DIRECTORY_MONITOR_EVENTS_DELAY,
+						(GSourceFunc) model_flush_monitor_events,
+						parent);
 }
 
 static void
 async_node_free (AsyncNode *async)
 {
 	g_object_unref (async->cancellable);
-	g_slist_free (async->original_children);
 	g_free (async);
 }
 
+/* The pending nodes are not in the index: the files added meanwhile,
+ * from the browser for instance, are not added twice */
+static void
+model_add_pending_nodes (PlumaFileBrowserStore * model,
+			 FileBrowserNode * parent)
+{
+	FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+	GSList *nodes = NULL;
+	GSList *item;
+
+	for (item = dir->pending; item; item = item->next) {
+		FileBrowserNode *node = (FileBrowserNode *) (item->data);
+		gchar *name;
+
+		name = g_file_get_basename (node->file);
+
+		if (g_hash_table_contains (dir->index, name))
+			file_browser_node_free (model, node);
+		else
+			nodes = g_slist_prepend (nodes, node);
+
+		g_free (name);
+	}
+
+	g_slist_free (dir->pending);
+	dir->pending = NULL;
+
+	if (nodes != NULL)
+		model_add_nodes_batch (model, nodes, parent);
+}
+
 static void
 model_iterate_next_files_cb (GFileEnumerator * enumerator,
 			     GAsyncResult * result,
@@ -2162,6 +2971,12 @@ model_iterate_next_files_cb (GFileEnumerator * enumerator,
 			g_object_unref (dir->cancellable);
 			dir->cancellable = NULL;
 
+			if (dir->pending != NULL) {
+				model_add_pending_nodes (dir->model, parent);
+			}
+
+			model_sniff_directory (dir->model, parent);
+
 /*
  * FIXME: This is temporarly, it is a bug in gio:
  * http://bugzilla.gnome.org/show_bug.cgi?id=565924
@@ -2202,7 +3017,7 @@ model_iterate_next_files_cb (GFileEnumerator * enumerator,
 		g_file_enumerator_close (enumerator, NULL, NULL);
 		async_node_free (async);
 	} else {
-		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		model_add_nodes_from_files (dir->model, async, files);
 
 		g_list_free (files);
 		next_files_async (enumerator, async);
@@ -2280,11 +3095,11 @@ model_load_directory (PlumaFileBrowserStore * model,
 	async = g_new (AsyncNode, 1);
 	async->dir = dir;
 	async->cancellable = g_object_ref (dir->cancellable);
-	async->original_children = g_slist_copy (dir->children);
+	async->n_files = 0;
 
 	/* Start loading async */
 	g_file_enumerate_children_async (node->file,
-					 STANDARD_ATTRIBUTE_TYPES,
+					 ENUMERATE_ATTRIBUTE_TYPES,
 					 G_FILE_QUERY_INFO_NONE,
 					 G_PRIORITY_DEFAULT,
 					 async->cancellable,
@@ -2492,26 +3307,32 @@ model_find_node_children (PlumaFileBrowserStore * model,
 			  FileBrowserNode * parent,
 			  GFile * file)
 {
-	FileBrowserNodeDir *dir;
 	FileBrowserNode *child;
-	FileBrowserNode *result;
-	GSList *children;
+	gchar *relative;
+	gchar *separator;
 
 	if (!NODE_IS_DIR (parent))
 		return NULL;
 
-	dir = FILE_BROWSER_NODE_DIR (parent);
+	relative = g_file_get_relative_path (parent->file, file);
+
+	if (relative == NULL)
+		return NULL;
 
-	for (children = dir->children; children; children = children->next) {
-		child = (FileBrowserNode *)(children->data);
+	/* Only the child on the way to the file needs to be looked at */
+	separator = strchr (relative, G_DIR_SEPARATOR);
 
-		result = model_find_node (model, child, file);
+	if (separator != NULL)
+		*separator = '\0';
 
-		if (result)
-			return result;
-	}
+	child = g_hash_table_lookup (FILE_BROWSER_NODE_DIR (parent)->index,
+				     relative);
+	g_free (relative);
 
-	return NULL;
+	if (child == NULL)
+		return NULL;
+
+	return model_find_node (model, child, file);
 }
 
 static FileBrowserNode *
@@ -3033,6 +3854,198 @@ _pluma_file_browser_store_iter_expanded (PlumaFileBrowserStore * model,
 	}
 }
 
+/* Replaces the guess from the name with the info of the content. With
+ * the binary filter, a file shown as text from its name stays shown if
+ * its content turns out not to be text, rather than the row vanishing
+ * under the pointer. */
+static void
+model_node_set_content_info (PlumaFileBrowserStore * model,
+			     FileBrowserNode * node,
+			     GFileInfo * info)
+{
+	GtkTreeIter iter;
+	GtkTreePath *path;
+
+	node->needs_info = FALSE;
+
+	if (!NODE_IS_DIR (node)) {
+		if (FILTER_BINARY (model->priv->filter_mode) &&
+		    model_node_visibility (model, node))
+			node->keep_shown = TRUE;
+
+		node->flags &= ~PLUMA_FILE_BROWSER_STORE_FLAG_IS_TEXT;
+	}
+
+	file_browser_node_set_from_info (model, node, info, TRUE);
+
+	if (model_node_visibility (model, node)) {
+		iter.user_data = node;
+		path = pluma_file_browser_store_get_path_real (model, node);
+		row_changed (model, &path, &iter);
+		gtk_tree_path_free (path);
+	}
+}
+
+static void
+model_query_info_cb (GFile * file,
+		     GAsyncResult * result,
+		     FileBrowserNode * node)
+{
+	GFileInfo *info;
+	GError *error = NULL;
+
+	info = g_file_query_info_finish (file, result, &error);
+
+	/* The node is gone when cancelled */
+	if (info == NULL &&
+	    error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED) {
+		g_error_free (error);
+		return;
+	}
+
+	g_clear_object (&node->info_cancellable);
+
+	if (info == NULL) {
+		node->needs_info = FALSE;
+		g_error_free (error);
+		return;
+	}
+
+	model_node_set_content_info (FILE_BROWSER_NODE_DIR (node->parent)->model,
+				     node,
+				     info);
+	g_object_unref (info);
+}
+
+static void
+sniff_query_cb (GObject * source_object,
+		GAsyncResult * result,
+		gpointer user_data)
+{
+	FilesQuery *query = g_task_get_task_data (G_TASK (result));
+	FileBrowserNodeDir *dir;
+	guint i;
+
+	/* The directory is unloaded or gone when cancelled */
+	if (!g_task_propagate_boolean (G_TASK (result), NULL))
+		return;
+
+	dir = FILE_BROWSER_NODE_DIR (query->parent);
+	g_clear_object (&dir->sniff_cancellable);
+
+	for (i = 0; i < query->names->len; i++) {
+		GFileInfo *info = g_ptr_array_index (query->infos, i);
+		FileBrowserNode *node;
+
+		node = g_hash_table_lookup (dir->index,
+					    g_ptr_array_index (query->names, i));
+
+		if (info == NULL || node == NULL || !node->needs_info)
+			continue;
+
+		if (node->info_cancellable != NULL) {
+			g_cancellable_cancel (node->info_cancellable);
+			g_clear_object (&node->info_cancellable);
+		}
+
+		model_node_set_content_info (dir->model, node, info);
+	}
+}
+
+/* With the binary filter, the files which are not text from their name
+ * are hidden until their content is known: it is looked at on a thread,
+ * for the text ones to show up */
+static void
+model_sniff_directory (PlumaFileBrowserStore * model,
+		       FileBrowserNode * node)
+{
+	FileBrowserNodeDir *dir;
+	FilesQuery *query;
+	GSList *item;
+
+	if (!FILTER_BINARY (model->priv->filter_mode) ||
+	    !NODE_IS_DIR (node) || !NODE_LOADED (node))
+		return;
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	/* Still loading, or already sniffing */
+	if (dir->cancellable != NULL || dir->sniff_cancellable != NULL)
+		return;
+
+	query = files_query_new (node);
+
+	for (item = dir->children; item; item = item->next) {
+		FileBrowserNode *child = (FileBrowserNode *) (item->data);
+		gchar *name;
+
+		if (child->file == NULL || !child->needs_info ||
+		    NODE_IS_DIR (child) || NODE_IS_TEXT (child))
+			continue;
+
+		name = g_file_get_basename (child->file);
+		files_query_add (query, name);
+		g_free (name);
+	}
+
+	if (query->files->len == 0) {
+		files_query_free (query);
+		return;
+	}
+
+	dir->sniff_cancellable = g_cancellable_new ();
+	files_query_run (query, dir->sniff_cancellable, sniff_query_cb);
+}
+
+/* For a change of the filter mode */
+static void
+model_sniff_loaded_directories (PlumaFileBrowserStore * model,
+				FileBrowserNode * node)
+{
+	GSList *item;
+
+	if (!NODE_IS_DIR (node) || !NODE_LOADED (node))
+		return;
+
+	node->keep_shown = FALSE;
+	model_sniff_directory (model, node);
+
+	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next) {
+		FileBrowserNode *child = (FileBrowserNode *) (item->data);
+
+		child->keep_shown = FALSE;
+		model_sniff_loaded_directories (model, child);
+	}
+}
+
+/* Called by the view for the rows it shows */
+void
+_pluma_file_browser_store_iter_shown (PlumaFileBrowserStore * model,
+				      GtkTreeIter * iter)
+{
+	FileBrowserNode *node;
+
+	g_return_if_fail (PLUMA_IS_FILE_BROWSER_STORE (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->user_data != NULL);
+
+	node = (FileBrowserNode *) (iter->user_data);
+
+	if (!node->needs_info || node->info_cancellable != NULL ||
+	    node->file == NULL || node->parent == NULL)
+		return;
+
+	node->info_cancellable = g_cancellable_new ();
+
+	g_file_query_info_async (node->file,
+				 STANDARD_ATTRIBUTE_TYPES,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_LOW,
+				 node->info_cancellable,
+				 (GAsyncReadyCallback) model_query_info_cb,
+				 node);
+}
+
 void
 _pluma_file_browser_store_iter_collapsed (PlumaFileBrowserStore * model,
 					  GtkTreeIter * iter)
@@ -3079,6 +4092,10 @@ pluma_file_browser_store_set_filter_mode (PlumaFileBrowserStore * model,
 		return;
 
 	model->priv->filter_mode = mode;
+
+	if (model->priv->root != NULL)
+		model_sniff_loaded_directories (model, model->priv->root);
+
 	model_refilter (model);
 
 	g_object_notify (G_OBJECT (model), "filter-mode");
@@ -3186,9 +4203,13 @@ pluma_file_browser_store_rename (PlumaFileBrowserStore * model,
 	}
 
 	if (g_file_move (node->file, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err)) {
+		model_node_index_remove (node);
+
 		previous = node->file;
 		node->file = file;
 
+		model_node_index_add (node);
+
 		/* This makes sure the actual info for the node is requeried */
 		file_browser_node_set_name (node);
 		file_browser_node_set_from_info (model, node, NULL, TRUE);
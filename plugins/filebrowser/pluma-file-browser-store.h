@@ -160,6 +160,8 @@ void _pluma_file_browser_store_iter_expanded          (PlumaFileBrowserStore * m
                                                        GtkTreeIter * iter);
 void _pluma_file_browser_store_iter_collapsed         (PlumaFileBrowserStore * model,
                                                        GtkTreeIter * iter);
+void _pluma_file_browser_store_iter_shown             (PlumaFileBrowserStore * model,
+                                                       GtkTreeIter * iter);
 
 PlumaFileBrowserStoreFilterMode
 pluma_file_browser_store_get_filter_mode              (PlumaFileBrowserStore * model);
@@ -619,6 +619,54 @@ button_press_event (GtkWidget      *widget,
 	return TRUE;
 }
 
+/* Lets the store query the content type and the icon of the rows about to
+ * be drawn, the rows out of sight are left alone */
+static void
+show_visible_rows (PlumaFileBrowserView * view)
+{
+	GtkTreeView *tree_view = GTK_TREE_VIEW (view);
+	GtkTreePath *start;
+	GtkTreePath *end;
+	GtkTreeIter iter;
+
+	if (!gtk_tree_view_get_visible_range (tree_view, &start, &end))
+		return;
+
+	while (gtk_tree_path_compare (start, end) <= 0) {
+		if (gtk_tree_model_get_iter (view->priv->model, &iter, start)) {
+			_pluma_file_browser_store_iter_shown (PLUMA_FILE_BROWSER_STORE (view->priv->model),
+							      &iter);
+
+			if (gtk_tree_view_row_expanded (tree_view, start))
+				gtk_tree_path_down (start);
+			else
+				gtk_tree_path_next (start);
+		} else {
+			/* Past the last child, go on after the parent */
+			if (!gtk_tree_path_up (start) ||
+			    gtk_tree_path_get_depth (start) == 0)
+				break;
+
+			gtk_tree_path_next (start);
+		}
+	}
+
+	gtk_tree_path_free (start);
+	gtk_tree_path_free (end);
+}
+
+static gboolean
+draw (GtkWidget *widget,
+      cairo_t   *cr)
+{
+	PlumaFileBrowserView *view = PLUMA_FILE_BROWSER_VIEW (widget);
+
+	if (PLUMA_IS_FILE_BROWSER_STORE (view->priv->model))
+		show_visible_rows (view);
+
+	return GTK_WIDGET_CLASS (pluma_file_browser_view_parent_class)->draw (widget, cr);
+}
+
 static gboolean
 key_press_event (GtkWidget   *widget,
 		 GdkEventKey *event)
@@ -849,6 +897,7 @@ pluma_file_browser_view_class_init (PlumaFileBrowserViewClass * klass)
 	widget_class->button_release_event = button_release_event;
 	widget_class->drag_begin = drag_begin;
 	widget_class->key_press_event = key_press_event;
+	widget_class->draw = draw;
 
 	/* Tree view handlers */
 	tree_view_class->row_expanded = row_expanded;
@@ -99,6 +99,16 @@ typedef struct
 	GDestroyNotify destroy_notify;
 } FilterFunc;
 
+/* The patterns of the filter, each list of patterns compiled into one
+ * regular expression */
+typedef struct
+{
+	GRegex *include_files;
+	GRegex *include_dirs;
+	GRegex *exclude_files;
+	GRegex *exclude_dirs;
+} GlobFilter;
+
 typedef struct
 {
 	GFile *root;
@@ -139,7 +149,7 @@ struct _PlumaFileBrowserWidgetPrivate
 	GSList *filter_funcs;
 	gulong filter_id;
 	gulong glob_filter_id;
-	GPatternSpec *filter_pattern;
+	GlobFilter *filter_pattern;
 	gchar *filter_pattern_str;
 
 	GList *locations;
@@ -158,6 +168,7 @@ struct _PlumaFileBrowserWidgetPrivate
 
 static void set_enable_delete		       (PlumaFileBrowserWidget *obj,
 						gboolean enable);
+static void glob_filter_free                   (GlobFilter * filter);
 static void on_model_set                       (GObject * gobject,
 						GParamSpec * arg1,
 						PlumaFileBrowserWidget * obj);
@@ -345,6 +356,9 @@ pluma_file_browser_widget_finalize (GObject * object)
 
 	g_slist_free_full (obj->priv->filter_funcs, g_free);
 
+	glob_filter_free (obj->priv->filter_pattern);
+	g_free (obj->priv->filter_pattern_str);
+
 	for (loc = obj->priv->locations; loc; loc = loc->next)
 		location_free ((Location *) (loc->data));
 
@@ -1233,6 +1247,10 @@ create_filter (PlumaFileBrowserWidget * obj)
 	obj->priv->filter_expander = expander;
 
 	entry = gtk_entry_new ();
+	gtk_widget_set_tooltip_text (entry,
+				     _("Patterns separated by semicolons, such as \"*.c;*.h\". "
+				       "Prefix a pattern with ! to hide the matching files, "
+				       "end it with / to match folders."));
 	gtk_widget_show (entry);
 
 	obj->priv->filter_entry = entry;
@@ -1371,28 +1389,179 @@ popup_menu (PlumaFileBrowserWidget * obj, GdkEventButton * event, GtkTreeModel *
 	return TRUE;
 }
 
+/* Appends the glob as an alternative of the regular expression, * and ?
+ * match any characters as with GPatternSpec */
+static void
+append_glob_regex (GString * regex, gchar const * glob)
+{
+	if (regex->len > 0)
+		g_string_append_c (regex, '|');
+
+	for (; *glob != '\0'; glob++) {
+		switch (*glob) {
+		case '*':
+			g_string_append (regex, ".*");
+			break;
+		case '?':
+			g_string_append_c (regex, '.');
+			break;
+		default:
+			if (strchr ("\\^$.|+()[]{}", *glob) != NULL)
+				g_string_append_c (regex, '\\');
+
+			g_string_append_c (regex, *glob);
+			break;
+		}
+	}
+}
+
+static GRegex *
+compile_glob_regex (GString * regex)
+{
+	GRegex *result = NULL;
+	gchar *pattern;
+
+	if (regex->len > 0) {
+		pattern = g_strdup_printf ("^(?:%s)$", regex->str);
+		result = g_regex_new (pattern,
+				      G_REGEX_OPTIMIZE | G_REGEX_DOTALL,
+				      0,
+				      NULL);
+		g_free (pattern);
+	}
+
+	g_string_free (regex, TRUE);
+
+	return result;
+}
+
+/* The patterns are separated by semicolons. The ones starting with ! hide
+ * the matching files and folders, the others show only the matching files.
+ * A pattern ending with a slash only applies to folders, so that "src/"
+ * shows only the folders named src and "!build/" hides the build folders */
+static GlobFilter *
+glob_filter_new (gchar const * pattern)
+{
+	GlobFilter *filter;
+	GString *include_files;
+	GString *include_dirs;
+	GString *exclude_files;
+	GString *exclude_dirs;
+	gchar **globs;
+	gint i;
+
+	include_files = g_string_new (NULL);
+	include_dirs = g_string_new (NULL);
+	exclude_files = g_string_new (NULL);
+	exclude_dirs = g_string_new (NULL);
+
+	globs = g_strsplit (pattern, ";", -1);
+
+	for (i = 0; globs[i] != NULL; i++) {
+		gchar *glob = g_strstrip (globs[i]);
+		gboolean exclude = FALSE;
+		gboolean dirs_only = FALSE;
+		gsize len;
+
+		if (*glob == '!') {
+			exclude = TRUE;
+			glob++;
+		}
+
+		len = strlen (glob);
+
+		if (len > 0 && glob[len - 1] == '/') {
+			dirs_only = TRUE;
+			glob[--len] = '\0';
+		}
+
+		if (len == 0)
+			continue;
+
+		if (exclude) {
+			append_glob_regex (exclude_dirs, glob);
+
+			if (!dirs_only)
+				append_glob_regex (exclude_files, glob);
+		} else if (dirs_only) {
+			append_glob_regex (include_dirs, glob);
+		} else {
+			append_glob_regex (include_files, glob);
+		}
+	}
+
+	g_strfreev (globs);
+
+	filter = g_slice_new (GlobFilter);
+	filter->include_files = compile_glob_regex (include_files);
+	filter->include_dirs = compile_glob_regex (include_dirs);
+	filter->exclude_files = compile_glob_regex (exclude_files);
+	filter->exclude_dirs = compile_glob_regex (exclude_dirs);
+
+	return filter;
+}
+
+static void
+glob_filter_free (GlobFilter * filter)
+{
+	if (filter == NULL)
+		return;
+
+	if (filter->include_files)
+		g_regex_unref (filter->include_files);
+
+	if (filter->include_dirs)
+		g_regex_unref (filter->include_dirs);
+
+	if (filter->exclude_files)
+		g_regex_unref (filter->exclude_files);
+
+	if (filter->exclude_dirs)
+		g_regex_unref (filter->exclude_dirs);
+
+	g_slice_free (GlobFilter, filter);
+}
+
 static gboolean
 filter_glob (PlumaFileBrowserWidget * obj, PlumaFileBrowserStore * store,
 	     GtkTreeIter * iter, gpointer user_data)
 {
+	GlobFilter *filter = obj->priv->filter_pattern;
+	GRegex *include;
+	GRegex *exclude;
 	gchar *name;
-	gboolean result;
+	gboolean result = TRUE;
 	guint flags;
 
-	if (obj->priv->filter_pattern == NULL)
+	if (filter == NULL)
 		return TRUE;
 
 	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
-			    PLUMA_FILE_BROWSER_STORE_COLUMN_NAME, &name,
 			    PLUMA_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
 			    -1);
 
-	if (FILE_IS_DIR (flags) || FILE_IS_DUMMY (flags))
-		result = TRUE;
-	else
-		result =
-		    g_pattern_match_string (obj->priv->filter_pattern,
-					    name);
+	if (FILE_IS_DUMMY (flags))
+		return TRUE;
+
+	if (FILE_IS_DIR (flags)) {
+		include = filter->include_dirs;
+		exclude = filter->exclude_dirs;
+	} else {
+		include = filter->include_files;
+		exclude = filter->exclude_files;
+	}
+
+	if (include == NULL && exclude == NULL)
+		return TRUE;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (store), iter,
+			    PLUMA_FILE_BROWSER_STORE_COLUMN_NAME, &name,
+			    -1);
+
+	if (include != NULL && !g_regex_match (include, name, 0, NULL))
+		result = FALSE;
+	else if (exclude != NULL && g_regex_match (exclude, name, 0, NULL))
+		result = FALSE;
 
 	g_free (name);
 
@@ -1756,10 +1925,8 @@ set_filter_pattern_real (PlumaFileBrowserWidget * obj,
 	g_free (obj->priv->filter_pattern_str);
 	obj->priv->filter_pattern_str = g_strdup (pattern);
 
-	if (obj->priv->filter_pattern) {
-		g_pattern_spec_free (obj->priv->filter_pattern);
-		obj->priv->filter_pattern = NULL;
-	}
+	glob_filter_free (obj->priv->filter_pattern);
+	obj->priv->filter_pattern = NULL;
 
 	if (pattern == NULL) {
 		if (obj->priv->glob_filter_id != 0) {
@@ -1770,7 +1937,7 @@ set_filter_pattern_real (PlumaFileBrowserWidget * obj,
 			obj->priv->glob_filter_id = 0;
 		}
 	} else {
-		obj->priv->filter_pattern = g_pattern_spec_new (pattern);
+		obj->priv->filter_pattern = glob_filter_new (pattern);
 
 		if (obj->priv->glob_filter_id == 0)
 			obj->priv->glob_filter_id =
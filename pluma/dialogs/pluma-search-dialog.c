@@ -69,6 +69,10 @@ struct _PlumaSearchDialogPrivate
 	GtkWidget *backwards_checkbutton;
 	GtkWidget *wrap_around_checkbutton;
 	GtkWidget *parse_escapes_checkbutton;
+	GtkWidget *all_documents_checkbutton;
+	GtkWidget *folder_box;
+	GtkWidget *in_folder_checkbutton;
+	GtkWidget *folder_chooser;
 	GtkWidget *find_button;
 	GtkWidget *replace_button;
 	GtkWidget *replace_all_button;
@@ -227,7 +231,8 @@ search_text_entry_changed (GtkEditable       *editable,
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
 			PLUMA_SEARCH_DIALOG_FIND_RESPONSE, TRUE);
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
-			PLUMA_SEARCH_DIALOG_REPLACE_ALL_RESPONSE, TRUE);
+			PLUMA_SEARCH_DIALOG_REPLACE_ALL_RESPONSE,
+			!pluma_search_dialog_get_in_folder (dialog));
 	}
 	else
 	{
@@ -240,6 +245,27 @@ search_text_entry_changed (GtkEditable       *editable,
 	}
 }
 
+/* The files of a folder can be searched but not replaced in */
+static void
+in_folder_checkbutton_toggled (GtkToggleButton   *button,
+			       PlumaSearchDialog *dialog)
+{
+	gboolean in_folder;
+	const gchar *search_string;
+
+	in_folder = gtk_toggle_button_get_active (button);
+	search_string = gtk_entry_get_text (GTK_ENTRY (dialog->priv->search_text_entry));
+
+	gtk_widget_set_sensitive (dialog->priv->folder_chooser, in_folder);
+	gtk_widget_set_sensitive (dialog->priv->all_documents_checkbutton, !in_folder);
+
+	gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+		PLUMA_SEARCH_DIALOG_REPLACE_RESPONSE, FALSE);
+	gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+		PLUMA_SEARCH_DIALOG_REPLACE_ALL_RESPONSE,
+		!in_folder && *search_string != '\0');
+}
+
 static void
 response_handler (PlumaSearchDialog *dialog,
 		  gint               response_id,
@@ -342,6 +368,9 @@ pluma_search_dialog_init (PlumaSearchDialog *dlg)
 					  "search_backwards_checkbutton", &dlg->priv->backwards_checkbutton,
 					  "wrap_around_checkbutton", &dlg->priv->wrap_around_checkbutton,
 					  "parse_escapes_checkbutton", &dlg->priv->parse_escapes_checkbutton,
+					  "all_documents_checkbutton", &dlg->priv->all_documents_checkbutton,
+					  "folder_box", &dlg->priv->folder_box,
+					  "in_folder_checkbutton", &dlg->priv->in_folder_checkbutton,
 					  NULL);
 
 	if (!ret)
@@ -394,6 +423,17 @@ pluma_search_dialog_init (PlumaSearchDialog *dlg)
 				 dlg->priv->replace_label,
 				 GTK_POS_RIGHT, 1, 1);
 
+	dlg->priv->folder_chooser = gtk_file_chooser_button_new (_("Select a Folder"),
+								 GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+	gtk_file_chooser_set_local_only (GTK_FILE_CHOOSER (dlg->priv->folder_chooser),
+					 TRUE);
+	gtk_widget_set_sensitive (dlg->priv->folder_chooser, FALSE);
+	gtk_widget_set_hexpand (dlg->priv->folder_chooser, TRUE);
+	gtk_widget_show (dlg->priv->folder_chooser);
+	gtk_box_pack_start (GTK_BOX (dlg->priv->folder_box),
+			    dlg->priv->folder_chooser,
+			    TRUE, TRUE, 0);
+
 	gtk_label_set_mnemonic_widget (GTK_LABEL (dlg->priv->search_label),
 				       dlg->priv->search_entry);
 	gtk_label_set_mnemonic_widget (GTK_LABEL (dlg->priv->replace_label),
@@ -450,6 +490,10 @@ pluma_search_dialog_init (PlumaSearchDialog *dlg)
 			  "changed",
 			  G_CALLBACK (search_text_entry_changed),
 			  dlg);
+	g_signal_connect (dlg->priv->in_folder_checkbutton,
+			  "toggled",
+			  G_CALLBACK (in_folder_checkbutton_toggled),
+			  dlg);
 
 	g_signal_connect (dlg,
 			  "response",
@@ -658,3 +702,59 @@ pluma_search_dialog_get_parse_escapes (PlumaSearchDialog *dialog)
 
 	return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->priv->parse_escapes_checkbutton));
 }
+
+void
+pluma_search_dialog_set_all_documents (PlumaSearchDialog *dialog,
+				       gboolean           all_documents)
+{
+	g_return_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog));
+
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (dialog->priv->all_documents_checkbutton),
+				      all_documents);
+}
+
+gboolean
+pluma_search_dialog_get_all_documents (PlumaSearchDialog *dialog)
+{
+	g_return_val_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog), FALSE);
+
+	return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->priv->all_documents_checkbutton));
+}
+
+void
+pluma_search_dialog_set_in_folder (PlumaSearchDialog *dialog,
+				   gboolean           in_folder)
+{
+	g_return_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog));
+
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (dialog->priv->in_folder_checkbutton),
+				      in_folder);
+}
+
+gboolean
+pluma_search_dialog_get_in_folder (PlumaSearchDialog *dialog)
+{
+	g_return_val_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog), FALSE);
+
+	return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->priv->in_folder_checkbutton));
+}
+
+void
+pluma_search_dialog_set_folder_uri (PlumaSearchDialog *dialog,
+				    const gchar       *uri)
+{
+	g_return_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog));
+	g_return_if_fail (uri != NULL);
+
+	gtk_file_chooser_set_current_folder_uri (GTK_FILE_CHOOSER (dialog->priv->folder_chooser),
+						 uri);
+}
+
+/* Free the returned string with g_free() */
+gchar *
+pluma_search_dialog_get_folder_uri (PlumaSearchDialog *dialog)
+{
+	g_return_val_if_fail (PLUMA_IS_SEARCH_DIALOG (dialog), NULL);
+
+	return gtk_file_chooser_get_uri (GTK_FILE_CHOOSER (dialog->priv->folder_chooser));
+}
@@ -133,6 +133,18 @@ void		pluma_search_dialog_set_parse_escapes (PlumaSearchDialog *dialog,
                                     		       gboolean           parse_escapes);
 gboolean	pluma_search_dialog_get_parse_escapes (PlumaSearchDialog *dialog);
 
+void		pluma_search_dialog_set_all_documents (PlumaSearchDialog *dialog,
+						       gboolean           all_documents);
+gboolean	pluma_search_dialog_get_all_documents (PlumaSearchDialog *dialog);
+
+void		pluma_search_dialog_set_in_folder	(PlumaSearchDialog *dialog,
+							 gboolean           in_folder);
+gboolean	pluma_search_dialog_get_in_folder	(PlumaSearchDialog *dialog);
+
+void		pluma_search_dialog_set_folder_uri	(PlumaSearchDialog *dialog,
+							 const gchar       *uri);
+gchar		*pluma_search_dialog_get_folder_uri	(PlumaSearchDialog *dialog);
+
 G_END_DECLS
 
 #endif  /* __PLUMA_SEARCH_DIALOG_H__  */
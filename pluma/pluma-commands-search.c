@@ -42,13 +42,16 @@
 
 #include "pluma-commands.h"
 #include "pluma-debug.h"
+#include "pluma-message-bus.h"
 #include "pluma-statusbar.h"
 #include "pluma-window.h"
 #include "pluma-window-private.h"
 #include "pluma-utils.h"
+#include "pluma-search-results-panel.h"
 #include "dialogs/pluma-search-dialog.h"
 
 #define PLUMA_SEARCH_DIALOG_KEY		"pluma-search-dialog-key"
+#define PLUMA_SEARCH_RESULTS_PANEL_KEY	"pluma-search-results-panel-key"
 #define PLUMA_LAST_SEARCH_DATA_KEY	"pluma-last-search-data-key"
 
 typedef struct _LastSearchData LastSearchData;
@@ -219,6 +222,109 @@ run_search (PlumaView   *view,
 	return found;
 }
 
+static void
+search_results_panel_destroyed (PlumaWindow *window,
+				GtkWidget   *panel)
+{
+	g_object_set_data (G_OBJECT (window),
+			   PLUMA_SEARCH_RESULTS_PANEL_KEY,
+			   NULL);
+}
+
+static PlumaSearchResultsPanel *
+get_search_results_panel (PlumaWindow *window)
+{
+	GtkWidget *panel;
+
+	panel = g_object_get_data (G_OBJECT (window), PLUMA_SEARCH_RESULTS_PANEL_KEY);
+
+	if (panel == NULL)
+	{
+		panel = pluma_search_results_panel_new (window);
+		gtk_widget_show (panel);
+
+		pluma_panel_add_item_with_icon (pluma_window_get_bottom_panel (window),
+						panel,
+						_("Search Results"),
+						"edit-find");
+
+		g_object_set_data (G_OBJECT (window),
+				   PLUMA_SEARCH_RESULTS_PANEL_KEY,
+				   panel);
+
+		g_object_weak_ref (G_OBJECT (panel),
+				   (GWeakNotify) search_results_panel_destroyed,
+				   window);
+	}
+
+	return PLUMA_SEARCH_RESULTS_PANEL (panel);
+}
+
+/* The documents are searched in the background, the matches are listed
+ * in the bottom panel */
+static void
+do_find_in_all_documents (PlumaSearchDialog *dialog,
+			  PlumaWindow       *window,
+			  const gchar       *entry_text,
+			  guint              flags)
+{
+	PlumaSearchResultsPanel *panel;
+	PlumaPanel *bottom_panel;
+
+	panel = get_search_results_panel (window);
+
+	if (!pluma_search_results_panel_search (panel, entry_text, flags))
+	{
+		text_not_found (window, pluma_search_dialog_get_search_text (dialog));
+		return;
+	}
+
+	bottom_panel = pluma_window_get_bottom_panel (window);
+	gtk_widget_show (GTK_WIDGET (bottom_panel));
+	pluma_panel_activate_item (bottom_panel, GTK_WIDGET (panel));
+
+	gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+					   PLUMA_SEARCH_DIALOG_REPLACE_RESPONSE,
+					   FALSE);
+}
+
+/* The files of the folder are searched in the background, the matches
+ * are listed in the bottom panel */
+static void
+do_find_in_folder (PlumaSearchDialog *dialog,
+		   PlumaWindow       *window,
+		   const gchar       *entry_text,
+		   guint              flags)
+{
+	PlumaSearchResultsPanel *panel;
+	PlumaPanel *bottom_panel;
+	gchar *folder_uri;
+	gboolean started;
+
+	folder_uri = pluma_search_dialog_get_folder_uri (dialog);
+
+	if (folder_uri == NULL)
+		return;
+
+	panel = get_search_results_panel (window);
+
+	started = pluma_search_results_panel_search_files (panel,
+							   folder_uri,
+							   entry_text,
+							   flags);
+	g_free (folder_uri);
+
+	if (!started)
+	{
+		text_not_found (window, pluma_search_dialog_get_search_text (dialog));
+		return;
+	}
+
+	bottom_panel = pluma_window_get_bottom_panel (window);
+	gtk_widget_show (GTK_WIDGET (bottom_panel));
+	pluma_panel_activate_item (bottom_panel, GTK_WIDGET (panel));
+}
+
 static void
 do_find (PlumaSearchDialog *dialog,
 	 PlumaWindow       *window)
@@ -262,6 +368,18 @@ do_find (PlumaSearchDialog *dialog,
 	PLUMA_SEARCH_SET_ENTIRE_WORD (flags, entire_word);
         PLUMA_SEARCH_SET_MATCH_REGEX (flags, match_regex);
 
+	if (pluma_search_dialog_get_in_folder (dialog))
+	{
+		do_find_in_folder (dialog, window, entry_text, flags);
+		return;
+	}
+
+	if (pluma_search_dialog_get_all_documents (dialog))
+	{
+		do_find_in_all_documents (dialog, window, entry_text, flags);
+		return;
+	}
+
 	search_text = pluma_document_get_search_text (doc, &old_flags);
 
 	if ((search_text == NULL) ||
@@ -477,10 +595,24 @@ do_replace_all (PlumaSearchDialog *dialog,
 	PLUMA_SEARCH_SET_MATCH_REGEX (flags, match_regex);
 	PLUMA_SEARCH_SET_ENTIRE_WORD (flags, entire_word);
 
-	count = pluma_document_replace_all (doc,
-					    search_entry_text,
-					    replace_entry_text,
-					    flags);
+	if (pluma_search_dialog_get_all_documents (dialog))
+	{
+		GList *docs;
+
+		docs = pluma_window_get_documents (window);
+		count = _pluma_search_replace_all_in_documents (docs,
+								search_entry_text,
+								replace_entry_text,
+								flags);
+		g_list_free (docs);
+	}
+	else
+	{
+		count = pluma_document_replace_all (doc,
+						    search_entry_text,
+						    replace_entry_text,
+						    flags);
+	}
 
 	if (count > 0)
 	{
@@ -549,13 +681,75 @@ search_dialog_destroyed (PlumaWindow       *window,
 			   NULL);
 }
 
+/* The root of the file browser if it is loaded, or else the folder of
+ * the active document */
+static gchar *
+get_default_search_folder (PlumaWindow *window)
+{
+	PlumaMessageBus *bus;
+	PlumaDocument *doc;
+	gchar *uri = NULL;
+
+	bus = pluma_window_get_message_bus (window);
+
+	if (pluma_message_bus_is_registered (bus, "/plugins/filebrowser", "get_root"))
+	{
+		PlumaMessage *message;
+
+		message = pluma_message_bus_send_sync (bus,
+						       "/plugins/filebrowser",
+						       "get_root",
+						       NULL);
+
+		pluma_message_get (message, "uri", &uri, NULL);
+		g_object_unref (message);
+
+		if (uri != NULL && pluma_utils_uri_has_file_scheme (uri))
+			return uri;
+
+		g_free (uri);
+		uri = NULL;
+	}
+
+	doc = pluma_window_get_active_document (window);
+
+	if (doc != NULL && pluma_document_is_local (doc))
+	{
+		GFile *location;
+		GFile *parent;
+
+		location = pluma_document_get_location (doc);
+		parent = g_file_get_parent (location);
+
+		if (parent != NULL)
+		{
+			uri = g_file_get_uri (parent);
+			g_object_unref (parent);
+		}
+
+		g_object_unref (location);
+	}
+
+	return uri;
+}
+
 static GtkWidget *
 create_dialog (PlumaWindow *window, gboolean show_replace)
 {
 	GtkWidget *dialog;
+	gchar *folder_uri;
 
 	dialog = pluma_search_dialog_new (GTK_WINDOW (window), show_replace);
 
+	folder_uri = get_default_search_folder (window);
+
+	if (folder_uri != NULL)
+	{
+		pluma_search_dialog_set_folder_uri (PLUMA_SEARCH_DIALOG (dialog),
+						    folder_uri);
+		g_free (folder_uri);
+	}
+
 	g_signal_connect (dialog,
 			  "response",
 			  G_CALLBACK (search_dialog_response_cb),
@@ -35,17 +35,37 @@
  * there is no I/O involved and should be accessed only by the main
  * thread */
 
+/* The text is fetched from the buffer in runs of about this many
+ * characters, spanning as many lines as fit */
+#define CHUNK_CHARS (64 * 1024)
+
+/* Enough for any char or line ending: reads asking for less go
+ * through the carry buffer */
+#define MIN_READ_SIZE 6
 
 struct _PlumaDocumentInputStreamPrivate
 {
 	GtkTextBuffer *buffer;
-	GtkTextMark   *pos;
-	gint           bytes_partial;
+
+	/* the run of text being read and the offsets in the buffer
+	 * of its start and end */
+	gchar         *chunk;
+	gsize          chunk_len;
+	gsize          chunk_pos;
+	gint           chunk_offset;
+	gint           next_offset;
+
+	/* chars of the buffer read so far */
+	gsize          position;
+
+	/* text read for a call with too little space, not returned yet */
+	gchar          carry[MIN_READ_SIZE];
+	gsize          carry_len;
+	gsize          carry_pos;
 
 	PlumaDocumentNewlineType newline_type;
 
 	guint newline_added : 1;
-	guint is_initialized : 1;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (PlumaDocumentInputStream, pluma_document_input_stream, G_TYPE_INPUT_STREAM);
@@ -114,6 +134,16 @@ pluma_document_input_stream_get_property (GObject    *object,
 	}
 }
 
+static void
+pluma_document_input_stream_finalize (GObject *object)
+{
+	PlumaDocumentInputStream *stream = PLUMA_DOCUMENT_INPUT_STREAM (object);
+
+	g_free (stream->priv->chunk);
+
+	G_OBJECT_CLASS (pluma_document_input_stream_parent_class)->finalize (object);
+}
+
 static void
 pluma_document_input_stream_class_init (PlumaDocumentInputStreamClass *klass)
 {
@@ -122,6 +152,7 @@ pluma_document_input_stream_class_init (PlumaDocumentInputStreamClass *klass)
 
 	gobject_class->get_property = pluma_document_input_stream_get_property;
 	gobject_class->set_property = pluma_document_input_stream_set_property;
+	gobject_class->finalize = pluma_document_input_stream_finalize;
 
 	stream_class->read_fn = pluma_document_input_stream_read;
 	stream_class->close_fn = pluma_document_input_stream_close;
@@ -222,22 +253,7 @@ pluma_document_input_stream_tell (PlumaDocumentInputStream *stream)
 {
 	g_return_val_if_fail (PLUMA_IS_DOCUMENT_INPUT_STREAM (stream), 0);
 
-	/* FIXME: is this potentially inefficient? If yes, we could keep
-	   track of the offset internally, assuming the mark doesn't move
-	   during the operation */
-	if (!stream->priv->is_initialized)
-	{
-		return 0;
-	}
-	else
-	{
-		GtkTextIter iter;
-
-		gtk_text_buffer_get_iter_at_mark (stream->priv->buffer,
-						  &iter,
-						  stream->priv->pos);
-		return gtk_text_iter_get_offset (&iter);
-	}
+	return stream->priv->position;
 }
 
 static const gchar *
@@ -268,187 +284,212 @@ get_new_line (PlumaDocumentInputStream *stream)
 	return ret;
 }
 
-static gsize
-read_line (PlumaDocumentInputStream *stream,
-	   gchar                    *outbuf,
-	   gsize                     space_left)
+/* Fetches the next run of text from the buffer. Returns FALSE at the
+ * end of the buffer. */
+static gboolean
+fetch_chunk (PlumaDocumentInputStream *stream)
 {
-	GtkTextIter start, next, end;
-	gchar *buf;
-	gint bytes; /* int since it's what iter_get_offset returns */
-	gsize bytes_to_write, newline_size, read;
-	const gchar *newline;
-	gboolean is_last;
-
-	gtk_text_buffer_get_iter_at_mark (stream->priv->buffer,
-					  &start,
-					  stream->priv->pos);
-
-	if (gtk_text_iter_is_end (&start))
-		return 0;
+	GtkTextIter start, end;
 
-	end = next = start;
-	newline = get_new_line (stream);
+	g_free (stream->priv->chunk);
+	stream->priv->chunk = NULL;
+	stream->priv->chunk_len = 0;
+	stream->priv->chunk_pos = 0;
 
-	/* Check needed for empty lines */
-	if (!gtk_text_iter_ends_line (&end))
-		gtk_text_iter_forward_to_line_end (&end);
+	gtk_text_buffer_get_iter_at_offset (stream->priv->buffer,
+					    &start,
+					    stream->priv->next_offset);
 
-	gtk_text_iter_forward_line (&next);
+	if (gtk_text_iter_is_end (&start))
+		return FALSE;
 
-	buf = gtk_text_iter_get_slice (&start, &end);
+	end = start;
+	gtk_text_iter_forward_chars (&end, CHUNK_CHARS);
 
-	/* the bytes of a line includes also the newline, so with the
-	   offsets we remove the newline and we add the new newline size */
-	bytes = gtk_text_iter_get_bytes_in_line (&start) - stream->priv->bytes_partial;
+	/* do not split a \r\n line ending between two runs */
+	if (gtk_text_iter_get_char (&end) == '\n')
+	{
+		GtkTextIter prev = end;
 
-	/* bytes_in_line includes the newlines, so we remove that assuming that
-	   they are single byte characters */
-	bytes = bytes - (gtk_text_iter_get_offset (&next) - gtk_text_iter_get_offset (&end));
-	is_last = gtk_text_iter_is_end (&end);
+		if (gtk_text_iter_backward_char (&prev) &&
+		    gtk_text_iter_get_char (&prev) == '\r')
+		{
+			gtk_text_iter_forward_char (&end);
+		}
+	}
 
-	/* bytes_to_write contains the amount of bytes we would like to write.
-	   This means its the amount of bytes in the line (without the newline
-	   in the buffer) + the amount of bytes for the newline we want to
-	   write (newline_size) */
-	bytes_to_write = bytes;
+	stream->priv->chunk = gtk_text_iter_get_slice (&start, &end);
+	stream->priv->chunk_len = strlen (stream->priv->chunk);
+	stream->priv->chunk_offset = stream->priv->next_offset;
+	stream->priv->next_offset = gtk_text_iter_get_offset (&end);
 
-	/* do not add the new newline_size for the last line */
-	newline_size = get_new_line_size (stream);
-	if (!is_last)
-		bytes_to_write += newline_size;
+	return TRUE;
+}
 
-	if (bytes_to_write > space_left)
+/* Returns the first line ending between @p and @end which is not
+ * already the one we write, or @end if there is none */
+static const gchar *
+find_line_ending (const gchar              *p,
+		  const gchar              *end,
+		  PlumaDocumentNewlineType  type,
+		  gsize                    *size)
+{
+	for (; p < end; p++)
 	{
-		gchar *ptr;
-		gint char_offset;
-		gint written;
-		gsize to_write;
-
-		/* Here the line does not fit in the buffer, we thus write
-		   the amount of bytes we can still fit, storing the position
-		   for the next read with the mark. Do not try to write the
-		   new newline in this case, it will be handled in the next
-		   iteration */
-		to_write = MIN (space_left, bytes);
-		ptr = buf;
-		written = 0;
-		char_offset = 0;
-
-		while (written < to_write)
+		switch (*p)
 		{
-			gint w;
+			case '\n':
+				if (type != PLUMA_DOCUMENT_NEWLINE_TYPE_LF)
+				{
+					*size = 1;
+					return p;
+				}
+				break;
 
-			ptr = g_utf8_next_char (ptr);
-			w = (ptr - buf);
-			if (w > to_write)
-			{
+			case '\r':
+				if (p + 1 < end && p[1] == '\n')
+				{
+					if (type != PLUMA_DOCUMENT_NEWLINE_TYPE_CR_LF)
+					{
+						*size = 2;
+						return p;
+					}
+					p++;
+				}
+				else if (type != PLUMA_DOCUMENT_NEWLINE_TYPE_CR)
+				{
+					*size = 1;
+					return p;
+				}
+				break;
+
+			/* U+2029 PARAGRAPH SEPARATOR */
+			case '\xe2':
+				if (end - p >= 3 && p[1] == '\x80' && p[2] == '\xa9')
+				{
+					*size = 3;
+					return p;
+				}
 				break;
-			}
-			else
-			{
-				written = w;
-				++char_offset;
-			}
 		}
+	}
 
-		memcpy (outbuf, buf, written);
+	return end;
+}
 
-		/* Note: offset is one past what we wrote */
-		gtk_text_iter_forward_chars (&start, char_offset);
-		stream->priv->bytes_partial += written;
-		read = written;
-	}
-	else
+/* Copies as much of the current run as fits in @outbuf. The text
+ * between two line endings to rewrite is copied at once. */
+static gsize
+read_chunk (PlumaDocumentInputStream *stream,
+	    gchar                    *outbuf,
+	    gsize                     space_left)
+{
+	const gchar *newline;
+	gsize newline_size;
+	gsize written = 0;
+
+	newline = get_new_line (stream);
+	newline_size = get_new_line_size (stream);
+
+	while (stream->priv->chunk_pos < stream->priv->chunk_len)
 	{
-		/* First just copy the bytes without the newline */
-		memcpy (outbuf, buf, bytes);
+		const gchar *p;
+		const gchar *end;
+		const gchar *line_end;
+		gsize ending_size = 0;
+		gsize n;
 
-		/* Then add the newline, but not for the last line */
-		if (!is_last)
-		{
-			memcpy (outbuf + bytes, newline, newline_size);
-		}
+		p = stream->priv->chunk + stream->priv->chunk_pos;
+		end = stream->priv->chunk + stream->priv->chunk_len;
 
-		start = next;
-		stream->priv->bytes_partial = 0;
-		read = bytes_to_write;
-	}
+		line_end = find_line_ending (p, end, stream->priv->newline_type, &ending_size);
+		n = line_end - p;
 
-	gtk_text_buffer_move_mark (stream->priv->buffer,
-				   stream->priv->pos,
-				   &start);
+		if (n > space_left - written)
+		{
+			/* Here the text does not fit in the buffer: write what
+			   we can, without cutting a character or a \r\n */
+			n = space_left - written;
 
-	g_free (buf);
-	return read;
-}
+			while (n > 0 && ((guchar) p[n] & 0xc0) == 0x80)
+				n--;
 
-static gssize
-pluma_document_input_stream_read (GInputStream  *stream,
-				  void          *buffer,
-				  gsize          count,
-				  GCancellable  *cancellable,
-				  GError       **error)
-{
-	PlumaDocumentInputStream *dstream;
-	GtkTextIter iter;
-	gssize space_left, read, n;
+			if (n > 0 && p[n - 1] == '\r' && p[n] == '\n')
+				n--;
 
-	dstream = PLUMA_DOCUMENT_INPUT_STREAM (stream);
+			memcpy (outbuf + written, p, n);
+			stream->priv->chunk_pos += n;
+			stream->priv->position += g_utf8_strlen (p, n);
 
-	if (count < 6)
-	{
-		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
-				     "Not enougth space in destination");
-		return -1;
-	}
+			return written + n;
+		}
 
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		return -1;
+		memcpy (outbuf + written, p, n);
+		stream->priv->chunk_pos += n;
+		stream->priv->position += g_utf8_strlen (p, n);
+		written += n;
 
-	/* Initialize the mark to the first char in the text buffer */
-	if (!dstream->priv->is_initialized)
-	{
-		gtk_text_buffer_get_start_iter (dstream->priv->buffer, &iter);
-		dstream->priv->pos = gtk_text_buffer_create_mark (dstream->priv->buffer,
-								 NULL,
-								 &iter,
-								 FALSE);
+		if (line_end == end)
+			break;
 
-		dstream->priv->is_initialized = TRUE;
+		/* the new newline is written in the next read */
+		if (space_left - written < newline_size)
+			break;
+
+		memcpy (outbuf + written, newline, newline_size);
+		stream->priv->chunk_pos += ending_size;
+		/* \r\n is two chars, U+2029 is one */
+		stream->priv->position += ending_size == 2 ? 2 : 1;
+		written += newline_size;
 	}
 
-	space_left = count;
+	return written;
+}
+
+/* Reads as much text as fits in @count bytes, which must be at least
+ * MIN_READ_SIZE */
+static gsize
+read_text (PlumaDocumentInputStream *dstream,
+	   gchar                    *buffer,
+	   gsize                     count)
+{
+	gsize read, n;
+
 	read = 0;
 
-	do
+	while (read < count)
 	{
-		n = read_line (dstream, (void *) ((gsize) buffer + read), space_left);
+		if (dstream->priv->chunk_pos == dstream->priv->chunk_len &&
+		    !fetch_chunk (dstream))
+			break;
+
+		n = read_chunk (dstream, buffer + read, count - read);
+
+		/* not enough space left for what comes next */
+		if (n == 0)
+			break;
+
 		read += n;
-		space_left -= n;
-	} while (space_left > 0 && n != 0 && dstream->priv->bytes_partial == 0);
+	}
 
 	/* Make sure that non-empty files are always terminated with \n (see bug #95676).
 	 * Note that we strip the trailing \n when loading the file */
-	gtk_text_buffer_get_iter_at_mark (dstream->priv->buffer,
-					  &iter,
-					  dstream->priv->pos);
-
-	if (gtk_text_iter_is_end (&iter) &&
-	    !gtk_text_iter_is_start (&iter))
+	if (dstream->priv->chunk_pos == dstream->priv->chunk_len &&
+	    dstream->priv->next_offset > 0 &&
+	    dstream->priv->next_offset == gtk_text_buffer_get_char_count (dstream->priv->buffer))
 	{
-		gssize newline_size;
+		gsize newline_size;
 
 		newline_size = get_new_line_size (dstream);
 
-		if (space_left >= newline_size &&
+		if (count - read >= newline_size &&
 		    !dstream->priv->newline_added)
 		{
 			const gchar *newline;
 
 			newline = get_new_line (dstream);
 
-			memcpy ((void *) ((gsize) buffer + read), newline, newline_size);
+			memcpy (buffer + read, newline, newline_size);
 
 			read += newline_size;
 			dstream->priv->newline_added = TRUE;
@@ -458,6 +499,50 @@ pluma_document_input_stream_read (GInputStream  *stream,
 	return read;
 }
 
+static gssize
+pluma_document_input_stream_read (GInputStream  *stream,
+				  void          *buffer,
+				  gsize          count,
+				  GCancellable  *cancellable,
+				  GError       **error)
+{
+	PlumaDocumentInputStream *dstream;
+	gsize n;
+
+	dstream = PLUMA_DOCUMENT_INPUT_STREAM (stream);
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return -1;
+
+	/* a char or a line ending may not fit in a small @buffer: it is
+	 * read in the carry buffer and returned a few bytes at a time, so
+	 * that 0 is only returned at the end of the text */
+	if (dstream->priv->carry_pos == dstream->priv->carry_len &&
+	    count < MIN_READ_SIZE)
+	{
+		dstream->priv->carry_len = read_text (dstream,
+						      dstream->priv->carry,
+						      MIN_READ_SIZE);
+		dstream->priv->carry_pos = 0;
+	}
+
+	if (dstream->priv->carry_pos < dstream->priv->carry_len)
+	{
+		n = MIN (count, dstream->priv->carry_len - dstream->priv->carry_pos);
+
+		memcpy (buffer, dstream->priv->carry + dstream->priv->carry_pos, n);
+		dstream->priv->carry_pos += n;
+
+		return n;
+	}
+
+	/* nothing left */
+	if (count < MIN_READ_SIZE)
+		return 0;
+
+	return read_text (dstream, buffer, count);
+}
+
 static gboolean
 pluma_document_input_stream_close (GInputStream  *stream,
 				   GCancellable  *cancellable,
@@ -467,10 +552,15 @@ pluma_document_input_stream_close (GInputStream  *stream,
 
 	dstream->priv->newline_added = FALSE;
 
-	if (dstream->priv->is_initialized)
-	{
-		gtk_text_buffer_delete_mark (dstream->priv->buffer, dstream->priv->pos);
-	}
+	g_free (dstream->priv->chunk);
+	dstream->priv->chunk = NULL;
+	dstream->priv->chunk_len = 0;
+	dstream->priv->chunk_pos = 0;
+	dstream->priv->chunk_offset = 0;
+	dstream->priv->next_offset = 0;
+	dstream->priv->position = 0;
+	dstream->priv->carry_len = 0;
+	dstream->priv->carry_pos = 0;
 
 	return TRUE;
 }
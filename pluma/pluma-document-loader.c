@@ -34,12 +34,15 @@
 #include <config.h>
 #endif
 
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 
 #include "pluma-document-loader.h"
 #include "pluma-document-output-stream.h"
+#include "pluma-io-chunk-policy.h"
+#include "pluma-mapping-guard.h"
 #include "pluma-smart-charset-converter.h"
 #include "pluma-debug.h"
 #include "pluma-metadata-manager.h"
@@ -80,6 +83,12 @@ enum
 };
 
 #define READ_CHUNK_SIZE 8192
+#define MAPPED_CHUNK_SIZE (1024 * 1024)
+#define MAX_QUEUED_BLOCKS 8
+#define INSERT_TIME_SLICE (10 * 1000)
+#define MAX_UNICHAR_LEN 6
+#define VIEWPORT_MIN_SIZE (8 * 1024 * 1024)
+#define VIEWPORT_WINDOW_SIZE (256 * 1024)
 #define REMOTE_QUERY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
                                 G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
                                 G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
@@ -112,7 +121,21 @@ struct _PlumaDocumentLoaderPrivate
     GOutputStream               *output;
     PlumaSmartCharsetConverter  *converter;
 
-    gchar                        buffer[READ_CHUNK_SIZE];
+    PlumaIOChunkPolicy           chunk_policy;
+    gchar                       *buffer;
+
+    /* Fast path for local files */
+    gboolean                     use_mmap;
+    GMappedFile                 *mapped_file;
+
+    /* Position to load first, see pluma_document_loader_set_viewport_hint() */
+    gint                         viewport_line;
+    gint                         viewport_offset;
+    gboolean                     viewport_loaded;
+
+    /* See pluma_document_loader_set_large_file_threshold() */
+    goffset                      large_file_threshold;
+    gboolean                     large_file;
 
     GError                      *error;
 };
@@ -184,6 +207,7 @@ pluma_document_loader_finalize (GObject *object)
     PlumaDocumentLoaderPrivate *priv = pluma_document_loader_get_instance_private (PLUMA_DOCUMENT_LOADER(object));
 
     g_free (priv->uri);
+    g_free (priv->buffer);
 
     G_OBJECT_CLASS (pluma_document_loader_parent_class)->finalize (object);
 }
@@ -224,6 +248,12 @@ pluma_document_loader_dispose (GObject *object)
         priv->gfile = NULL;
     }
 
+    if (priv->mapped_file != NULL)
+    {
+        g_mapped_file_unref (priv->mapped_file);
+        priv->mapped_file = NULL;
+    }
+
     g_clear_error (&priv->error);
 
     if (priv->info != NULL)
@@ -307,6 +337,14 @@ pluma_document_loader_init (PlumaDocumentLoader *loader)
     loader->priv->used = FALSE;
     loader->priv->auto_detected_newline_type = PLUMA_DOCUMENT_NEWLINE_TYPE_DEFAULT;
     loader->priv->converter = NULL;
+    loader->priv->buffer = NULL;
+    loader->priv->use_mmap = FALSE;
+    loader->priv->mapped_file = NULL;
+    loader->priv->viewport_line = -1;
+    loader->priv->viewport_offset = -1;
+    loader->priv->viewport_loaded = FALSE;
+    loader->priv->large_file_threshold = 0;
+    loader->priv->large_file = FALSE;
     loader->priv->error = NULL;
     loader->priv->enc_settings = g_settings_new (PLUMA_SCHEMA_ID);
 }
@@ -451,6 +489,33 @@ write_complete (AsyncData *async)
                                     async);
 }
 
+static void
+end_of_file (PlumaDocumentLoader *loader)
+{
+    g_output_stream_flush (loader->priv->output,
+                           NULL,
+                           &loader->priv->error);
+
+    loader->priv->auto_detected_encoding =
+        pluma_smart_charset_converter_get_guessed (loader->priv->converter);
+
+    loader->priv->auto_detected_newline_type =
+        pluma_document_output_stream_detect_newline_type (PLUMA_DOCUMENT_OUTPUT_STREAM (loader->priv->output));
+
+    /* Check if we needed some fallback char, if so, check if there was
+       a previous error and if not set a fallback used error */
+    /* FIXME Uncomment this when we want to manage conversion fallback */
+    /*if ((pluma_smart_charset_converter_get_num_fallbacks (loader->priv->converter) != 0) &&
+        loader->priv->error == NULL)
+    {
+        g_set_error_literal (&loader->priv->error,
+                     PLUMA_DOCUMENT_ERROR,
+                     PLUMA_DOCUMENT_ERROR_CONVERSION_FALLBACK,
+                     "There was a conversion error and it was "
+                     "needed to use a fallback char");
+    }*/
+}
+
 /* prototype, because they call each other... isn't C lovely */
 static void    read_file_chunk        (AsyncData *async);
 
@@ -531,32 +596,12 @@ async_read_cb (GInputStream *stream,
     /* Bump the size. */
     loader->priv->bytes_read += async->read;
 
+    _pluma_io_chunk_policy_done (&loader->priv->chunk_policy, async->read);
+
     /* end of the file, we are done! */
     if (async->read == 0)
     {
-        g_output_stream_flush (loader->priv->output,
-                               NULL,
-                               &loader->priv->error);
-
-        loader->priv->auto_detected_encoding =
-            pluma_smart_charset_converter_get_guessed (loader->priv->converter);
-
-        loader->priv->auto_detected_newline_type =
-            pluma_document_output_stream_detect_newline_type (PLUMA_DOCUMENT_OUTPUT_STREAM (loader->priv->output));
-
-        /* Check if we needed some fallback char, if so, check if there was
-           a previous error and if not set a fallback used error */
-        /* FIXME Uncomment this when we want to manage conversion fallback */
-        /*if ((pluma_smart_charset_converter_get_num_fallbacks (loader->priv->converter) != 0) &&
-            loader->priv->error == NULL)
-        {
-            g_set_error_literal (&loader->priv->error,
-                         PLUMA_DOCUMENT_ERROR,
-                         PLUMA_DOCUMENT_ERROR_CONVERSION_FALLBACK,
-                         "There was a conversion error and it was "
-                         "needed to use a fallback char");
-        }*/
-
+        end_of_file (loader);
         write_complete (async);
 
         return;
@@ -574,13 +619,797 @@ read_file_chunk (AsyncData *async)
 
     g_input_stream_read_async (G_INPUT_STREAM (loader->priv->stream),
                                loader->priv->buffer,
-                               READ_CHUNK_SIZE,
+                               _pluma_io_chunk_policy_begin (&loader->priv->chunk_policy),
                                G_PRIORITY_HIGH,
                                async->cancellable,
                                (GAsyncReadyCallback) async_read_cb,
                                async);
 }
 
+/* Local files are decoded in a worker thread: it converts the mapped
+ * bytes to UTF-8, validates them and queues copies of the resulting
+ * blocks, so that the main loop only has to insert them in the document
+ * and never reads the mapping, which the worker guards against the file
+ * being truncated under it. */
+
+typedef struct
+{
+    gchar       *owned;     /* NULL for the blocks without text */
+    const gchar *text;      /* NULL for the block ending the queue */
+    gsize        len;
+    goffset      offset;    /* mapped bytes decoded up to this block */
+    gboolean     prepend;   /* goes before the text inserted so far */
+    gint64       cursor;    /* if >= 0 the viewport is in, place the cursor here */
+    gint64       truncate;  /* if >= 0 the text after this offset is decoded again */
+} DecodedBlock;
+
+typedef struct
+{
+    AsyncData                  *async;
+
+    GThread                    *thread;
+    GMappedFile                *mapped_file;
+    PlumaSmartCharsetConverter *converter;
+    gint                        viewport_line;
+    gint                        viewport_offset;
+
+    /* The document text up to the checkpoint is the same in any ASCII
+     * compatible encoding: if the guessed encoding fails later on, only
+     * the bytes after it have to be decoded again with another one */
+    gsize                       checkpoint;
+    gsize                       failed_at;
+
+    GAsyncQueue                *blocks;
+    GMutex                      mutex;
+    GCond                       cond;
+    guint                       n_queued;
+    gint                        idle_pending;
+
+    /* set by the worker before queueing the last block */
+    GError                     *error;
+} DecodePipeline;
+
+static gboolean insert_decoded_blocks (DecodePipeline *pipeline);
+
+static void
+decoded_block_free (DecodedBlock *block)
+{
+    g_free (block->owned);
+    g_slice_free (DecodedBlock, block);
+}
+
+static DecodedBlock *
+decoded_block_new (gchar       *owned,
+                   const gchar *text,
+                   gsize        len,
+                   goffset      offset)
+{
+    DecodedBlock *block;
+
+    block = g_slice_new (DecodedBlock);
+    block->owned = owned;
+    block->text = text;
+    block->len = len;
+    block->offset = offset;
+    block->prepend = FALSE;
+    block->cursor = -1;
+    block->truncate = -1;
+
+    return block;
+}
+
+static void
+queue_block (DecodePipeline *pipeline,
+             DecodedBlock   *block)
+{
+    /* wait for the main loop to catch up */
+    g_mutex_lock (&pipeline->mutex);
+
+    while (pipeline->n_queued >= MAX_QUEUED_BLOCKS &&
+           !g_cancellable_is_cancelled (pipeline->async->cancellable))
+    {
+        g_cond_wait (&pipeline->cond, &pipeline->mutex);
+    }
+
+    pipeline->n_queued++;
+
+    g_mutex_unlock (&pipeline->mutex);
+
+    g_async_queue_push (pipeline->blocks, block);
+
+    if (g_atomic_int_compare_and_exchange (&pipeline->idle_pending, 0, 1))
+        g_idle_add ((GSourceFunc) insert_decoded_blocks, pipeline);
+}
+
+/* Returns how many bytes of @text can be inserted as they are: a
+ * multibyte char or a CRLF split at the end of the span is left for
+ * the next one. */
+static gssize
+validate_utf8_span (const gchar  *text,
+                    gsize         len,
+                    gboolean      at_end,
+                    GError      **error)
+{
+    const gchar *end;
+
+    end = _pluma_document_output_stream_validate_utf8 (text, len);
+
+    if (end != text + len)
+    {
+        gsize nvalid = end - text;
+        gsize remainder = len - nvalid;
+
+        if (remainder >= MAX_UNICHAR_LEN ||
+            g_utf8_get_char_validated (end, remainder) != (gunichar) -2)
+        {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("Invalid UTF-8 sequence in input"));
+            return -1;
+        }
+
+        if (at_end)
+        {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("Incomplete UTF-8 sequence in input"));
+            return -1;
+        }
+
+        len = nvalid;
+    }
+
+    if (!at_end && len > 0 && text[len - 1] == '\r')
+        len--;
+
+    return len;
+}
+
+static gboolean
+is_ascii (const gchar *text,
+          gsize        len)
+{
+    gsize i;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((guchar) text[i] >= 0x80)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Queues the mapped bytes from @start to @end as they are: both must be
+ * at the start of a line so that no char or CRLF is split */
+static gboolean
+queue_mapped_range (DecodePipeline  *pipeline,
+                    gsize            start,
+                    gsize            end,
+                    gboolean         prepend,
+                    gsize           *decoded,
+                    GError         **error)
+{
+    const gchar *contents;
+
+    contents = g_mapped_file_get_contents (pipeline->mapped_file);
+
+    while (start < end)
+    {
+        DecodedBlock *block;
+        gchar *text;
+        gsize span;
+        gssize len;
+
+        if (g_cancellable_set_error_if_cancelled (pipeline->async->cancellable, error))
+            return FALSE;
+
+        span = MIN (end - start, MAPPED_CHUNK_SIZE);
+
+        len = validate_utf8_span (contents + start, span, start + span == end, error);
+        if (len == -1)
+        {
+            const gchar *invalid;
+
+            invalid = _pluma_document_output_stream_validate_utf8 (contents + start, span);
+            pipeline->failed_at = invalid - contents;
+
+            return FALSE;
+        }
+
+        if (!prepend &&
+            pipeline->checkpoint == start &&
+            is_ascii (contents + start, len))
+        {
+            pipeline->checkpoint = start + len;
+        }
+
+        *decoded += len;
+
+        text = g_malloc (len);
+        memcpy (text, contents + start, len);
+
+        block = decoded_block_new (text, text, len, *decoded);
+        block->prepend = prepend;
+        queue_block (pipeline, block);
+
+        start += len;
+    }
+
+    return TRUE;
+}
+
+static gsize
+find_line_start (const gchar *contents,
+                 gsize        pos)
+{
+    while (pos > 0 && contents[pos - 1] != '\n')
+        pos--;
+
+    return pos;
+}
+
+static gsize
+find_next_line_start (const gchar *contents,
+                      gsize        length,
+                      gsize        pos)
+{
+    const gchar *nl;
+
+    nl = memchr (contents + pos, '\n', length - pos);
+
+    return nl != NULL ? (gsize) (nl - contents) + 1 : length;
+}
+
+/* Returns the byte offset of the line or of the char the document
+ * should be shown at */
+static gsize
+find_viewport_position (DecodePipeline *pipeline,
+                        const gchar    *contents,
+                        gsize           length)
+{
+    gsize pos = 0;
+
+    if (pipeline->viewport_line >= 0)
+    {
+        gint line;
+
+        for (line = 0; line < pipeline->viewport_line && pos < length; line++)
+        {
+            gsize next;
+
+            next = find_next_line_start (contents, length, pos);
+
+            /* past the last line: stay at its start */
+            if (next == length && contents[length - 1] != '\n')
+                break;
+
+            pos = next;
+        }
+    }
+    else
+    {
+        gint chars;
+
+        for (chars = 0; chars < pipeline->viewport_offset && pos < length; chars++)
+        {
+            /* skip to the start of the next char */
+            do
+                pos++;
+            while (pos < length && (contents[pos] & 0xc0) == 0x80);
+        }
+    }
+
+    return pos;
+}
+
+/* UTF-8 files are not converted at all. For large files the lines
+ * around the position the document will be shown at are queued first,
+ * followed by the rest of the file and then by the text before them,
+ * so that the view can be used before the whole file is in. */
+static gboolean
+decode_mapped_utf8 (DecodePipeline  *pipeline,
+                    gsize            start,
+                    GError         **error)
+{
+    const gchar *contents;
+    gsize length;
+    gsize from = start;
+    gsize to = start;
+    gsize decoded = start;
+
+    contents = g_mapped_file_get_contents (pipeline->mapped_file);
+    length = g_mapped_file_get_length (pipeline->mapped_file);
+
+    if (start == 0 &&
+        length >= VIEWPORT_MIN_SIZE &&
+        (pipeline->viewport_line >= 0 || pipeline->viewport_offset >= 0))
+    {
+        DecodedBlock *block;
+        gsize pos;
+
+        pos = find_viewport_position (pipeline, contents, length);
+
+        from = find_line_start (contents,
+                                pos > VIEWPORT_WINDOW_SIZE / 2 ? pos - VIEWPORT_WINDOW_SIZE / 2 : 0);
+        to = find_next_line_start (contents,
+                                   length,
+                                   MIN (pos + VIEWPORT_WINDOW_SIZE / 2, length));
+
+        if (!queue_mapped_range (pipeline, from, to, FALSE, &decoded, error))
+            return FALSE;
+
+        /* tells the main loop where to put the cursor */
+        block = decoded_block_new (NULL, "", 0, decoded);
+        block->cursor = (gint64) g_utf8_strlen (contents + from, pos - from);
+        queue_block (pipeline, block);
+    }
+
+    return queue_mapped_range (pipeline, to, length, FALSE, &decoded, error) &&
+           queue_mapped_range (pipeline, start, from, TRUE, &decoded, error);
+}
+
+/* Decodes the mapped bytes from *@offset on with the guessed encoding */
+static gboolean
+decode_mapped_range (DecodePipeline  *pipeline,
+                     gsize           *offset,
+                     GError         **error)
+{
+    const gchar *contents;
+    gsize length;
+    gboolean carry_cr = FALSE;
+
+    contents = g_mapped_file_get_contents (pipeline->mapped_file);
+    length = g_mapped_file_get_length (pipeline->mapped_file);
+
+    do
+    {
+        GConverterResult res;
+        gchar *out;
+        gsize span;
+        gsize n = 0;
+        gsize bytes_read = 0;
+        gsize bytes_written = 0;
+        gsize block_start;
+        gboolean at_end;
+
+        if (g_cancellable_set_error_if_cancelled (pipeline->async->cancellable, error))
+            return FALSE;
+
+        pipeline->failed_at = *offset;
+
+        span = MIN (length - *offset, MAPPED_CHUNK_SIZE);
+        at_end = (*offset + span == length);
+
+        out = g_malloc (MAPPED_CHUNK_SIZE + 1);
+
+        /* where the text of this block starts in the file */
+        block_start = *offset;
+
+        if (carry_cr)
+        {
+            out[n++] = '\r';
+            carry_cr = FALSE;
+            block_start--;
+        }
+
+        res = g_converter_convert (G_CONVERTER (pipeline->converter),
+                                   contents + *offset,
+                                   span,
+                                   out + n,
+                                   MAPPED_CHUNK_SIZE,
+                                   at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                   &bytes_read,
+                                   &bytes_written,
+                                   error);
+
+        if (res == G_CONVERTER_ERROR)
+        {
+            g_free (out);
+            return FALSE;
+        }
+
+        /* the first span is used to guess the encoding, if it is
+         * UTF-8 there is nothing to convert */
+        if (pluma_smart_charset_converter_get_guessed (pipeline->converter) == pluma_encoding_get_utf8 ())
+        {
+            g_free (out);
+
+            if (!decode_mapped_utf8 (pipeline, *offset, error))
+                return FALSE;
+
+            *offset = length;
+
+            return TRUE;
+        }
+
+        if (bytes_read == 0 && *offset < length)
+        {
+            g_free (out);
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                 "Conversion did not progress");
+            return FALSE;
+        }
+
+        *offset += bytes_read;
+        n += bytes_written;
+
+        /* Avoid keeping a CRLF across two blocks */
+        if (n > 0 && out[n - 1] == '\r' && *offset < length)
+        {
+            carry_cr = TRUE;
+            n--;
+        }
+
+        if (_pluma_document_output_stream_validate_utf8 (out, n) != out + n)
+        {
+            g_free (out);
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("Invalid UTF-8 sequence in input"));
+            return FALSE;
+        }
+
+        /* the block reads as the bytes it comes from */
+        if (pipeline->checkpoint == block_start &&
+            n == *offset - (carry_cr ? 1 : 0) - block_start &&
+            memcmp (out, contents + block_start, n) == 0 &&
+            is_ascii (out, n))
+        {
+            pipeline->checkpoint = block_start + n;
+        }
+
+        if (n > 0)
+            queue_block (pipeline, decoded_block_new (out, out, n, *offset));
+        else
+            g_free (out);
+    } while (*offset < length);
+
+    return TRUE;
+}
+
+/* When the guessed encoding fails on some text past the first block
+ * another candidate is guessed from that text, and the document is
+ * decoded again from the checkpoint instead of failing the load. */
+static gboolean
+retry_from_checkpoint (DecodePipeline  *pipeline,
+                       GError         **error)
+{
+    const gchar *contents;
+    gsize length;
+    gsize sample_start;
+    gsize sample_end;
+    DecodedBlock *block;
+
+    if (!g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA) &&
+        !g_error_matches (*error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT))
+        return FALSE;
+
+    contents = g_mapped_file_get_contents (pipeline->mapped_file);
+    length = g_mapped_file_get_length (pipeline->mapped_file);
+
+    /* guess from the line it failed on */
+    sample_start = pipeline->failed_at;
+    sample_end = MIN (pipeline->failed_at + MAPPED_CHUNK_SIZE, length);
+
+    while (sample_start > pipeline->checkpoint &&
+           pipeline->failed_at - sample_start < MAPPED_CHUNK_SIZE &&
+           contents[sample_start - 1] != '\n')
+    {
+        sample_start--;
+    }
+
+    if (sample_start == sample_end)
+        sample_start = pipeline->checkpoint;
+
+    if (sample_start == sample_end ||
+        !pluma_smart_charset_converter_guess_again (pipeline->converter,
+                                                    contents + sample_start,
+                                                    sample_end - sample_start,
+                                                    pipeline->checkpoint > 0))
+        return FALSE;
+
+    pluma_debug_message (DEBUG_LOADER,
+                         "%s, decoding again from %" G_GSIZE_FORMAT " as %s",
+                         (*error)->message,
+                         pipeline->checkpoint,
+                         pluma_encoding_get_charset (pluma_smart_charset_converter_get_guessed (pipeline->converter)));
+
+    g_clear_error (error);
+
+    /* the text before the checkpoint is ASCII: offsets are the same in
+     * bytes and in chars */
+    block = decoded_block_new (NULL, "", 0, pipeline->checkpoint);
+    block->truncate = (gint64) pipeline->checkpoint;
+    queue_block (pipeline, block);
+
+    return TRUE;
+}
+
+/* Returns the number of bytes decoded, sets pipeline->error on failure */
+static gsize
+decode_mapped_contents (DecodePipeline *pipeline)
+{
+    gsize offset = 0;
+    GError *error = NULL;
+
+    while (!decode_mapped_range (pipeline, &offset, &error) &&
+           retry_from_checkpoint (pipeline, &error))
+    {
+        offset = pipeline->checkpoint;
+    }
+
+    pipeline->error = error;
+
+    return offset;
+}
+
+static gpointer
+decode_mapped_file (DecodePipeline *pipeline)
+{
+    PlumaMappingGuard guard;
+    gsize offset;
+
+    _pluma_mapping_guard_push (&guard,
+                               g_mapped_file_get_contents (pipeline->mapped_file),
+                               g_mapped_file_get_length (pipeline->mapped_file));
+
+    if (sigsetjmp (guard.env, 1) == 0)
+    {
+        offset = decode_mapped_contents (pipeline);
+        _pluma_mapping_guard_pop (&guard);
+    }
+    else
+    {
+        /* the file got shorter than its mapping */
+        offset = 0;
+        g_clear_error (&pipeline->error);
+        g_set_error (&pipeline->error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     _("The file was truncated while it was being loaded"));
+    }
+
+    /* the last block tells the main loop we are done */
+    queue_block (pipeline, decoded_block_new (NULL, NULL, 0, offset));
+
+    return NULL;
+}
+
+static void
+decode_pipeline_free (DecodePipeline *pipeline)
+{
+    DecodedBlock *block;
+
+    if (pipeline->thread != NULL)
+    {
+        /* wake up the worker if it is waiting for room in the queue */
+        g_mutex_lock (&pipeline->mutex);
+        g_cond_broadcast (&pipeline->cond);
+        g_mutex_unlock (&pipeline->mutex);
+
+        g_thread_join (pipeline->thread);
+    }
+
+    while ((block = g_async_queue_try_pop (pipeline->blocks)) != NULL)
+        decoded_block_free (block);
+
+    g_async_queue_unref (pipeline->blocks);
+    g_mutex_clear (&pipeline->mutex);
+    g_cond_clear (&pipeline->cond);
+
+    g_mapped_file_unref (pipeline->mapped_file);
+    g_object_unref (pipeline->converter);
+    g_clear_error (&pipeline->error);
+
+    g_slice_free (DecodePipeline, pipeline);
+}
+
+static void
+decode_pipeline_finish (DecodePipeline *pipeline)
+{
+    AsyncData *async;
+    PlumaDocumentLoader *loader;
+    GError *error;
+
+    async = pipeline->async;
+    loader = async->loader;
+
+    g_thread_join (pipeline->thread);
+    pipeline->thread = NULL;
+
+    error = pipeline->error;
+    pipeline->error = NULL;
+
+    decode_pipeline_free (pipeline);
+
+    if (error != NULL)
+    {
+        async_failed (async, error);
+        return;
+    }
+
+    end_of_file (loader);
+
+    if (!g_output_stream_close (loader->priv->output, async->cancellable, &error))
+    {
+        async_failed (async, error);
+        return;
+    }
+
+    remote_load_completed_or_failed (loader, async);
+}
+
+/* The region around the position to show is in the document: the rest
+ * is going to be inserted before and after it */
+static void
+show_viewport (PlumaDocumentLoader *loader,
+               gint64               cursor)
+{
+    GtkTextIter iter;
+
+    pluma_debug_message (DEBUG_LOADER, "viewport loaded, cursor at %" G_GINT64_FORMAT, cursor);
+
+    _pluma_utils_get_iter_at_offset64 (GTK_TEXT_BUFFER (loader->priv->document),
+                                       &iter,
+                                       cursor);
+    gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (loader->priv->document), &iter);
+
+    loader->priv->viewport_loaded = TRUE;
+}
+
+static gboolean
+insert_decoded_blocks (DecodePipeline *pipeline)
+{
+    AsyncData *async;
+    PlumaDocumentLoader *loader;
+    DecodedBlock *block;
+    goffset start;
+    gint64 deadline;
+
+    pluma_debug (DEBUG_LOADER);
+
+    async = pipeline->async;
+
+    /* manually check cancelled state */
+    if (g_cancellable_is_cancelled (async->cancellable))
+    {
+        decode_pipeline_free (pipeline);
+        async_data_free (async);
+        return FALSE;
+    }
+
+    loader = async->loader;
+    start = loader->priv->bytes_read;
+    deadline = g_get_monotonic_time () + INSERT_TIME_SLICE;
+
+    _pluma_io_chunk_policy_begin (&loader->priv->chunk_policy);
+
+    while ((block = g_async_queue_try_pop (pipeline->blocks)) != NULL)
+    {
+        g_mutex_lock (&pipeline->mutex);
+        pipeline->n_queued--;
+        g_cond_signal (&pipeline->cond);
+        g_mutex_unlock (&pipeline->mutex);
+
+        if (block->text == NULL)
+        {
+            decoded_block_free (block);
+            decode_pipeline_finish (pipeline);
+            return FALSE;
+        }
+
+        if (block->truncate >= 0)
+            pluma_document_output_stream_truncate (PLUMA_DOCUMENT_OUTPUT_STREAM (loader->priv->output),
+                                                   block->truncate);
+
+        if (block->prepend)
+            pluma_document_output_stream_prepend_validated (PLUMA_DOCUMENT_OUTPUT_STREAM (loader->priv->output),
+                                                            block->text,
+                                                            block->len);
+        else if (block->len > 0)
+            pluma_document_output_stream_write_validated (PLUMA_DOCUMENT_OUTPUT_STREAM (loader->priv->output),
+                                                          block->text,
+                                                          block->len);
+
+        loader->priv->bytes_read = block->offset;
+
+        if (block->cursor >= 0)
+        {
+            show_viewport (loader, block->cursor);
+            decoded_block_free (block);
+
+            /* let the view show it right away */
+            break;
+        }
+
+        decoded_block_free (block);
+
+        if (g_get_monotonic_time () > deadline)
+            break;
+    }
+
+    _pluma_io_chunk_policy_done (&loader->priv->chunk_policy,
+                                 loader->priv->bytes_read - start);
+
+    pluma_document_loader_loading (loader, FALSE, NULL);
+
+    if (g_async_queue_length (pipeline->blocks) > 0)
+        return TRUE;
+
+    g_atomic_int_set (&pipeline->idle_pending, 0);
+
+    /* the worker may have queued a block in the meantime */
+    if (g_async_queue_length (pipeline->blocks) > 0 &&
+        g_atomic_int_compare_and_exchange (&pipeline->idle_pending, 0, 1))
+        return TRUE;
+
+    return FALSE;
+}
+
+static void
+start_decode_pipeline (AsyncData *async)
+{
+    PlumaDocumentLoader *loader;
+    DecodePipeline *pipeline;
+
+    loader = async->loader;
+
+    pipeline = g_slice_new (DecodePipeline);
+    pipeline->async = async;
+    pipeline->mapped_file = loader->priv->mapped_file;
+    pipeline->converter = g_object_ref (loader->priv->converter);
+    pipeline->viewport_line = loader->priv->viewport_line;
+    pipeline->viewport_offset = loader->priv->viewport_offset;
+    pipeline->checkpoint = 0;
+    pipeline->failed_at = 0;
+    pipeline->blocks = g_async_queue_new ();
+    g_mutex_init (&pipeline->mutex);
+    g_cond_init (&pipeline->cond);
+    pipeline->n_queued = 0;
+    pipeline->idle_pending = 0;
+    pipeline->error = NULL;
+
+    /* the pipeline owns the mapping from now on */
+    loader->priv->mapped_file = NULL;
+
+    pipeline->thread = g_thread_new ("pluma-loader",
+                                     (GThreadFunc) decode_mapped_file,
+                                     pipeline);
+}
+
+/* Maps a local file in memory so that it can be decoded in large spans
+ * off the main thread instead of going through the async stream
+ * machinery.
+ * Returns FALSE if the file cannot be mapped, in which case the caller
+ * should fall back to reading it as a stream. */
+static gboolean
+open_mapped_file (PlumaDocumentLoader *loader)
+{
+    GFileInfo *info;
+    gchar *path;
+    GError *error = NULL;
+
+    info = loader->priv->info;
+
+    /* files like the ones in /proc report a size of 0 but still have
+     * contents, so only map what we know the size of */
+    if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) ||
+        g_file_info_get_size (info) <= 0)
+        return FALSE;
+
+    path = g_file_get_path (loader->priv->gfile);
+    if (path == NULL)
+        return FALSE;
+
+    loader->priv->mapped_file = g_mapped_file_new (path, FALSE, &error);
+    g_free (path);
+
+    if (loader->priv->mapped_file == NULL)
+    {
+        pluma_debug_message (DEBUG_LOADER, "Cannot map file: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 static GSList *
 get_candidate_encodings (PlumaDocumentLoader *loader)
 {
@@ -628,6 +1457,30 @@ finish_query_info (AsyncData *async)
         return;
     }
 
+    /* too large for the document, leave it to the large file viewer */
+    if (loader->priv->use_mmap &&
+        loader->priv->large_file_threshold > 0 &&
+        g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) &&
+        g_file_info_get_size (info) >= loader->priv->large_file_threshold)
+    {
+        loader->priv->large_file = TRUE;
+
+        remote_load_completed_or_failed (loader, async);
+
+        return;
+    }
+
+    if (loader->priv->use_mmap && !open_mapped_file (loader))
+    {
+        /* fall back to reading the file as a stream */
+        loader->priv->use_mmap = FALSE;
+        g_clear_object (&loader->priv->info);
+
+        open_async_read (async);
+
+        return;
+    }
+
     /* Get the candidate encodings */
     if (loader->priv->encoding == NULL)
     {
@@ -641,6 +1494,20 @@ finish_query_info (AsyncData *async)
     loader->priv->converter = pluma_smart_charset_converter_new (candidate_encodings);
     g_slist_free (candidate_encodings);
 
+    if (loader->priv->use_mmap)
+    {
+        /* blocks are queued by the decoder, the policy just keeps the stats */
+        _pluma_io_chunk_policy_init (&loader->priv->chunk_policy,
+                                     PLUMA_IO_CHUNK_POLICY_FIXED,
+                                     MAPPED_CHUNK_SIZE);
+
+        loader->priv->output = pluma_document_output_stream_new (loader->priv->document);
+
+        start_decode_pipeline (async);
+
+        return;
+    }
+
     conv_stream = g_converter_input_stream_new (loader->priv->stream,
                                                 G_CONVERTER (loader->priv->converter));
 
@@ -651,6 +1518,13 @@ finish_query_info (AsyncData *async)
     /* Output stream */
     loader->priv->output = pluma_document_output_stream_new (loader->priv->document);
 
+    _pluma_io_chunk_policy_init (&loader->priv->chunk_policy,
+                                 g_settings_get_enum (loader->priv->enc_settings,
+                                                      PLUMA_SETTINGS_IO_CHUNK_POLICY),
+                                 READ_CHUNK_SIZE);
+
+    loader->priv->buffer = g_malloc (_pluma_io_chunk_policy_get_max_size (&loader->priv->chunk_policy));
+
     /* start reading */
     read_file_chunk (async);
 }
@@ -860,7 +1734,24 @@ pluma_document_loader_load (PlumaDocumentLoader *loader)
     loader->priv->cancellable = g_cancellable_new ();
     async = async_data_new (loader);
 
-    open_async_read (async);
+    /* local files are mapped in memory instead of being streamed, we
+     * still need the info first to know what we are dealing with */
+    loader->priv->use_mmap = g_file_is_native (loader->priv->gfile);
+
+    if (loader->priv->use_mmap)
+    {
+        g_file_query_info_async (loader->priv->gfile,
+                                 REMOTE_QUERY_ATTRIBUTES,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 G_PRIORITY_HIGH,
+                                 async->cancellable,
+                                 (GAsyncReadyCallback) query_info_cb,
+                                 async);
+    }
+    else
+    {
+        open_async_read (async);
+    }
 }
 
 gboolean
@@ -902,6 +1793,54 @@ pluma_document_loader_get_uri (PlumaDocumentLoader *loader)
     return loader->priv->uri;
 }
 
+/* Asks to insert and show the lines around @line (counting from 0) or,
+ * if @line is negative, around the char at @offset before the rest of
+ * the file. This is only done for large local files. */
+void
+pluma_document_loader_set_viewport_hint (PlumaDocumentLoader *loader,
+                                         gint                 line,
+                                         gint                 offset)
+{
+    g_return_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader));
+    g_return_if_fail (!loader->priv->used);
+
+    loader->priv->viewport_line = line;
+    loader->priv->viewport_offset = line < 0 ? MAX (offset, 0) : -1;
+}
+
+/* Returns TRUE once the region asked with
+ * pluma_document_loader_set_viewport_hint() has been loaded while the
+ * rest of the file is still loading */
+gboolean
+pluma_document_loader_get_viewport_loaded (PlumaDocumentLoader *loader)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader), FALSE);
+
+    return loader->priv->viewport_loaded;
+}
+
+/* Local files of @threshold bytes or more are not loaded: the load
+ * completes right after the file info has been queried and
+ * pluma_document_loader_get_large_file() returns TRUE. Zero disables
+ * the check. */
+void
+pluma_document_loader_set_large_file_threshold (PlumaDocumentLoader *loader,
+                                                goffset              threshold)
+{
+    g_return_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader));
+    g_return_if_fail (!loader->priv->used);
+
+    loader->priv->large_file_threshold = MAX (threshold, 0);
+}
+
+gboolean
+pluma_document_loader_get_large_file (PlumaDocumentLoader *loader)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader), FALSE);
+
+    return loader->priv->large_file;
+}
+
 goffset
 pluma_document_loader_get_bytes_read (PlumaDocumentLoader *loader)
 {
@@ -910,6 +1849,24 @@ pluma_document_loader_get_bytes_read (PlumaDocumentLoader *loader)
     return loader->priv->bytes_read;
 }
 
+/* Returns the size of the chunks currently being read */
+gsize
+pluma_document_loader_get_chunk_size (PlumaDocumentLoader *loader)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader), 0);
+
+    return loader->priv->chunk_policy.size;
+}
+
+/* Returns the average read throughput in bytes per second, 0 if unknown */
+guint64
+pluma_document_loader_get_throughput (PlumaDocumentLoader *loader)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_LOADER (loader), 0);
+
+    return _pluma_io_chunk_policy_get_throughput (&loader->priv->chunk_policy);
+}
+
 const PlumaEncoding *
 pluma_document_loader_get_encoding (PlumaDocumentLoader *loader)
 {
@@ -106,8 +106,23 @@ const PlumaEncoding         *pluma_document_loader_get_encoding (PlumaDocumentLo
 
 PlumaDocumentNewlineType     pluma_document_loader_get_newline_type (PlumaDocumentLoader *loader);
 
+void                         pluma_document_loader_set_viewport_hint (PlumaDocumentLoader *loader,
+                                                                      gint                 line,
+                                                                      gint                 offset);
+
+gboolean                     pluma_document_loader_get_viewport_loaded (PlumaDocumentLoader *loader);
+
+void                         pluma_document_loader_set_large_file_threshold (PlumaDocumentLoader *loader,
+                                                                             goffset              threshold);
+
+gboolean                     pluma_document_loader_get_large_file (PlumaDocumentLoader *loader);
+
 goffset                      pluma_document_loader_get_bytes_read (PlumaDocumentLoader *loader);
 
+gsize                        pluma_document_loader_get_chunk_size (PlumaDocumentLoader *loader);
+
+guint64                      pluma_document_loader_get_throughput (PlumaDocumentLoader *loader);
+
 /* You can get from the info: content_type, time_modified, standard_size, access_can_write
    and also the metadata*/
 GFileInfo                   *pluma_document_loader_get_info (PlumaDocumentLoader *loader);
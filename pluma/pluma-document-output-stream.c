@@ -28,6 +28,7 @@
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 #include "pluma-document-output-stream.h"
+#include "pluma-utils.h"
 
 /* NOTE: never use async methods on this stream, the stream is just
  * a wrapper around GtkTextBuffer api so that we can use GIO Stream
@@ -42,8 +43,13 @@ struct _PlumaDocumentOutputStreamPrivate
 	PlumaDocument *doc;
 	GtkTextIter    pos;
 
-	gchar *buffer;
-	gsize buflen;
+	/* where text inserted before the appended one goes */
+	GtkTextMark   *prepend_mark;
+
+	/* a trailing \r or incomplete character left by the previous
+	 * write, to be completed by the next one */
+	gchar carry[MAX_UNICHAR_LEN];
+	gsize carry_len;
 
 	guint is_initialized : 1;
 	guint is_closed : 1;
@@ -116,7 +122,14 @@ pluma_document_output_stream_finalize (GObject *object)
 {
 	PlumaDocumentOutputStream *stream = PLUMA_DOCUMENT_OUTPUT_STREAM (object);
 
-	g_free (stream->priv->buffer);
+	if (stream->priv->prepend_mark != NULL)
+	{
+		if (!gtk_text_mark_get_deleted (stream->priv->prepend_mark))
+			gtk_text_buffer_delete_mark (gtk_text_mark_get_buffer (stream->priv->prepend_mark),
+						     stream->priv->prepend_mark);
+
+		g_object_unref (stream->priv->prepend_mark);
+	}
 
 	G_OBJECT_CLASS (pluma_document_output_stream_parent_class)->finalize (object);
 }
@@ -173,8 +186,7 @@ pluma_document_output_stream_init (PlumaDocumentOutputStream *stream)
 {
 	stream->priv = pluma_document_output_stream_get_instance_private (stream);
 
-	stream->priv->buffer = NULL;
-	stream->priv->buflen = 0;
+	stream->priv->carry_len = 0;
 
 	stream->priv->is_initialized = FALSE;
 	stream->priv->is_closed = FALSE;
@@ -278,6 +290,135 @@ end_append_text_to_document (PlumaDocumentOutputStream *stream)
 	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (stream->priv->doc));
 }
 
+static void
+ensure_initialized (PlumaDocumentOutputStream *stream)
+{
+	if (!stream->priv->is_initialized)
+	{
+		/* Init the undoable action */
+		gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (stream->priv->doc));
+
+		gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (stream->priv->doc),
+						&stream->priv->pos);
+		stream->priv->is_initialized = TRUE;
+	}
+}
+
+/* bytes with the high bit set, or zero */
+#define HAS_NON_ASCII(w) (((w) & G_GUINT64_CONSTANT (0x8080808080808080)) | \
+			  (((w) - G_GUINT64_CONSTANT (0x0101010101010101)) & ~(w) & \
+			   G_GUINT64_CONSTANT (0x8080808080808080)))
+
+/* Returns the end of the valid UTF-8 at the start of @text. Like
+ * g_utf8_validate() nul bytes are not valid. ASCII text is checked
+ * eight bytes at a time. */
+const gchar *
+_pluma_document_output_stream_validate_utf8 (const gchar *text,
+					     gsize        len)
+{
+	const gchar *p = text;
+	const gchar *end = text + len;
+
+	while (p < end)
+	{
+		gunichar ch;
+
+		if (end - p >= 8)
+		{
+			guint64 word;
+
+			memcpy (&word, p, sizeof (word));
+
+			if (!HAS_NON_ASCII (word))
+			{
+				p += 8;
+				continue;
+			}
+		}
+
+		if (*p == '\0')
+			break;
+
+		if ((guchar) *p < 0x80)
+		{
+			p++;
+			continue;
+		}
+
+		ch = g_utf8_get_char_validated (p, end - p);
+		if (ch == (gunichar)-1 || ch == (gunichar)-2)
+			break;
+
+		p = g_utf8_next_char (p);
+	}
+
+	return p;
+}
+
+static void
+insert_text (PlumaDocumentOutputStream *stream,
+	     const gchar               *text,
+	     gsize                      len)
+{
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (stream->priv->doc),
+				&stream->priv->pos, text, len);
+}
+
+/* Completes the character left over by the previous write with the
+ * first bytes of @buffer. Returns the number of bytes taken from
+ * @buffer or -1 if the character is invalid. */
+static gssize
+complete_carry (PlumaDocumentOutputStream  *stream,
+		const gchar                *buffer,
+		gsize                       count,
+		GError                    **error)
+{
+	gsize needed;
+	gsize n;
+	gunichar ch;
+
+	if (stream->priv->carry[0] == '\r')
+	{
+		n = 0;
+
+		/* Avoid splitting a CRLF across two inserts. */
+		if (count > 0 && buffer[0] == '\n')
+		{
+			stream->priv->carry[1] = '\n';
+			stream->priv->carry_len = 2;
+			n = 1;
+		}
+
+		insert_text (stream, stream->priv->carry, stream->priv->carry_len);
+		stream->priv->carry_len = 0;
+
+		return n;
+	}
+
+	needed = g_utf8_skip[(guchar) stream->priv->carry[0]];
+	n = MIN (needed - stream->priv->carry_len, count);
+
+	memcpy (stream->priv->carry + stream->priv->carry_len, buffer, n);
+	stream->priv->carry_len += n;
+
+	/* still incomplete */
+	if (stream->priv->carry_len < needed)
+		return n;
+
+	ch = g_utf8_get_char_validated (stream->priv->carry, stream->priv->carry_len);
+	if (ch == (gunichar)-1 || ch == (gunichar)-2)
+	{
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     _("Invalid UTF-8 sequence in input"));
+		return -1;
+	}
+
+	insert_text (stream, stream->priv->carry, stream->priv->carry_len);
+	stream->priv->carry_len = 0;
+
+	return n;
+}
+
 static gssize
 pluma_document_output_stream_write (GOutputStream            *stream,
 				    const void               *buffer,
@@ -286,9 +427,8 @@ pluma_document_output_stream_write (GOutputStream            *stream,
 				    GError                  **error)
 {
 	PlumaDocumentOutputStream *ostream;
-	gchar *text;
+	const gchar *text;
 	gsize len;
-	gboolean freetext = FALSE;
 	const gchar *end;
 	gboolean valid;
 
@@ -297,39 +437,33 @@ pluma_document_output_stream_write (GOutputStream            *stream,
 
 	ostream = PLUMA_DOCUMENT_OUTPUT_STREAM (stream);
 
-	if (!ostream->priv->is_initialized)
-	{
-		/* Init the undoable action */
-		gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (ostream->priv->doc));
+	ensure_initialized (ostream);
 
-		gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (ostream->priv->doc),
-						&ostream->priv->pos);
-		ostream->priv->is_initialized = TRUE;
-	}
+	text = buffer;
+	len = count;
 
-	if (ostream->priv->buflen > 0)
+	if (ostream->priv->carry_len > 0)
 	{
-		len = ostream->priv->buflen + count;
-		text = g_new (gchar , len + 1);
-		memcpy (text, ostream->priv->buffer, ostream->priv->buflen);
-		memcpy (text + ostream->priv->buflen, buffer, count);
-		text[len] = '\0';
-		g_free (ostream->priv->buffer);
-		ostream->priv->buffer = NULL;
-		ostream->priv->buflen = 0;
-		freetext = TRUE;
-	}
-	else
-	{
-		text = (gchar *) buffer;
-		len = count;
+		gssize n;
+
+		n = complete_carry (ostream, text, len, error);
+		if (n == -1)
+			return -1;
+
+		text += n;
+		len -= n;
+
+		if (ostream->priv->carry_len > 0)
+			return count;
 	}
 
-	/* validate */
-	valid = g_utf8_validate (text, len, &end);
+	/* validate only the new bytes, the text is then inserted straight
+	   from the caller's buffer */
+	end = _pluma_document_output_stream_validate_utf8 (text, len);
+	valid = (end == text + len);
 
 	/* Avoid keeping a CRLF across two buffers. */
-	if (valid && len > 1 && end[-1] == '\r')
+	if (valid && len > 0 && end[-1] == '\r')
 	{
 		valid = FALSE;
 		end--;
@@ -342,12 +476,12 @@ pluma_document_output_stream_write (GOutputStream            *stream,
 		gunichar ch;
 
 		if ((remainder < MAX_UNICHAR_LEN) &&
-		    ((ch = g_utf8_get_char_validated (text + nvalid, remainder)) == (gunichar)-2 ||
+		    ((ch = g_utf8_get_char_validated (end, remainder)) == (gunichar)-2 ||
 		     ch == (gunichar)'\r'))
 		{
-			ostream->priv->buffer = g_strndup (end, remainder);
-			ostream->priv->buflen = remainder;
-			len -= remainder;
+			memcpy (ostream->priv->carry, end, remainder);
+			ostream->priv->carry_len = remainder;
+			len = nvalid;
 		}
 		else
 		{
@@ -357,22 +491,125 @@ pluma_document_output_stream_write (GOutputStream            *stream,
 			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
 				     _("Invalid UTF-8 sequence in input"));
 
-			if (freetext)
-				g_free (text);
-
 			return -1;
 		}
 	}
 
-	gtk_text_buffer_insert (GTK_TEXT_BUFFER (ostream->priv->doc),
-				&ostream->priv->pos, text, len);
-
-	if (freetext)
-		g_free (text);
+	if (len > 0)
+		insert_text (ostream, text, len);
 
 	return count;
 }
 
+/**
+ * pluma_document_output_stream_write_validated:
+ * @stream: a #PlumaDocumentOutputStream
+ * @text: valid UTF-8 text
+ * @len: length of @text in bytes
+ *
+ * Appends @text to the document without going through the validation
+ * done by g_output_stream_write(). The caller must make sure that @text
+ * is valid UTF-8 and that it does not end in the middle of a CRLF.
+ */
+void
+pluma_document_output_stream_write_validated (PlumaDocumentOutputStream *stream,
+					      const gchar               *text,
+					      gsize                      len)
+{
+	g_return_if_fail (PLUMA_IS_DOCUMENT_OUTPUT_STREAM (stream));
+	g_return_if_fail (stream->priv->carry_len == 0);
+	g_return_if_fail (stream->priv->prepend_mark == NULL);
+
+	ensure_initialized (stream);
+
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (stream->priv->doc),
+				&stream->priv->pos, text, len);
+}
+
+/**
+ * pluma_document_output_stream_prepend_validated:
+ * @stream: a #PlumaDocumentOutputStream
+ * @text: valid UTF-8 text
+ * @len: length of @text in bytes
+ *
+ * Inserts @text before the text appended so far, right after the text
+ * given to the previous calls to this function. This lets the loader
+ * fill the document starting from the middle of the file. Once some
+ * text has been prepended nothing can be appended anymore.
+ */
+void
+pluma_document_output_stream_prepend_validated (PlumaDocumentOutputStream *stream,
+						const gchar               *text,
+						gsize                      len)
+{
+	GtkTextIter iter;
+
+	g_return_if_fail (PLUMA_IS_DOCUMENT_OUTPUT_STREAM (stream));
+	g_return_if_fail (stream->priv->carry_len == 0);
+
+	ensure_initialized (stream);
+
+	if (stream->priv->prepend_mark == NULL)
+	{
+		gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (stream->priv->doc),
+						&iter);
+
+		/* right gravity: the mark moves after the text inserted at it */
+		stream->priv->prepend_mark =
+			gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (stream->priv->doc),
+						     NULL, &iter, FALSE);
+		g_object_ref (stream->priv->prepend_mark);
+	}
+
+	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (stream->priv->doc),
+					  &iter,
+					  stream->priv->prepend_mark);
+
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (stream->priv->doc),
+				&iter, text, len);
+}
+
+/**
+ * pluma_document_output_stream_truncate:
+ * @stream: a #PlumaDocumentOutputStream
+ * @offset: a char offset in the document
+ *
+ * Removes the text after @offset, so that the document can be filled
+ * again from there once the text turned out to be in another encoding.
+ * The following writes append to what is left, even if some text was
+ * prepended before.
+ */
+void
+pluma_document_output_stream_truncate (PlumaDocumentOutputStream *stream,
+				       gint64                     offset)
+{
+	GtkTextIter end;
+
+	g_return_if_fail (PLUMA_IS_DOCUMENT_OUTPUT_STREAM (stream));
+
+	ensure_initialized (stream);
+
+	stream->priv->carry_len = 0;
+
+	_pluma_utils_get_iter_at_offset64 (GTK_TEXT_BUFFER (stream->priv->doc),
+					   &stream->priv->pos,
+					   offset);
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (stream->priv->doc), &end);
+
+	/* pos is revalidated to where the text was */
+	gtk_text_buffer_delete (GTK_TEXT_BUFFER (stream->priv->doc),
+				&stream->priv->pos,
+				&end);
+
+	if (stream->priv->prepend_mark != NULL)
+	{
+		gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (stream->priv->doc),
+					     stream->priv->prepend_mark);
+		g_object_unref (stream->priv->prepend_mark);
+		stream->priv->prepend_mark = NULL;
+	}
+}
+
 static gboolean
 pluma_document_output_stream_flush (GOutputStream *stream,
                                     GCancellable  *cancellable,
@@ -382,7 +619,7 @@ pluma_document_output_stream_flush (GOutputStream *stream,
 
 	/* Flush deferred data if some. */
 	if (!ostream->priv->is_closed && ostream->priv->is_initialized &&
-	    ostream->priv->buflen > 0 &&
+	    ostream->priv->carry_len > 0 &&
 	    pluma_document_output_stream_write (stream, "", 0, cancellable,
 						error) == -1)
 		return FALSE;
@@ -403,7 +640,7 @@ pluma_document_output_stream_close (GOutputStream     *stream,
 		ostream->priv->is_closed = TRUE;
 	}
 
-	if (ostream->priv->buflen > 0)
+	if (ostream->priv->carry_len > 0)
 	{
 		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
 			     _("Incomplete UTF-8 sequence in input"));
@@ -60,6 +60,20 @@ GOutputStream		*pluma_document_output_stream_new		(PlumaDocument *doc);
 
 PlumaDocumentNewlineType pluma_document_output_stream_detect_newline_type (PlumaDocumentOutputStream *stream);
 
+void			 pluma_document_output_stream_write_validated	(PlumaDocumentOutputStream *stream,
+									 const gchar               *text,
+									 gsize                      len);
+
+void			 pluma_document_output_stream_prepend_validated	(PlumaDocumentOutputStream *stream,
+									 const gchar               *text,
+									 gsize                      len);
+
+void			 pluma_document_output_stream_truncate		(PlumaDocumentOutputStream *stream,
+									 gint64                     offset);
+
+const gchar		*_pluma_document_output_stream_validate_utf8	(const gchar               *text,
+									 gsize                      len);
+
 G_END_DECLS
 
 #endif /* __PLUMA_DOCUMENT_OUTPUT_STREAM_H__ */
@@ -32,13 +32,24 @@
 #include <config.h>
 #endif
 
+/* for copy_file_range () */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <glib/gi18n.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "pluma-document-saver.h"
 #include "pluma-document-input-stream.h"
+#include "pluma-io-chunk-policy.h"
 #include "pluma-debug.h"
 #include "pluma-utils.h"
 #include "pluma-enum-types.h"
@@ -46,6 +57,9 @@
 
 #define WRITE_CHUNK_SIZE 8192
 
+/* Bytes copied at once when making backups */
+#define COPY_CHUNK_SIZE (1024 * 1024)
+
 /* Signals */
 
 enum {
@@ -69,7 +83,7 @@ enum {
 typedef struct
 {
     PlumaDocumentSaver    *saver;
-    gchar                  buffer[WRITE_CHUNK_SIZE];
+    gchar                 *buffer;
     GCancellable          *cancellable;
     gboolean               tried_mount;
     gssize                 written;
@@ -104,6 +118,8 @@ struct _PlumaDocumentSaverPrivate
     goffset                   size;
     goffset                   bytes_written;
 
+    PlumaIOChunkPolicy        chunk_policy;
+
     GFile                    *gfile;
     GCancellable             *cancellable;
     GOutputStream            *stream;
@@ -235,6 +251,7 @@ async_data_new (PlumaDocumentSaver *gvsaver)
     async->saver = gvsaver;
     async->cancellable = g_object_ref (gvsaver->priv->cancellable);
 
+    async->buffer = NULL;
     async->tried_mount = FALSE;
     async->written = 0;
     async->read = 0;
@@ -248,6 +265,7 @@ static void
 async_data_free (AsyncData *async)
 {
     g_object_unref (async->cancellable);
+    g_free (async->buffer);
 
     if (async->error)
     {
@@ -605,6 +623,8 @@ async_write_cb (GOutputStream *stream,
         return;
     }
 
+    _pluma_io_chunk_policy_done (&saver->priv->chunk_policy, async->read);
+
     /* note that this signal blocks the write... check if it isn't
      * a performance problem
      */
@@ -647,7 +667,7 @@ read_file_chunk (AsyncData *async)
        would be racy and we can endup with invalidated iters */
     async->read = g_input_stream_read (saver->priv->input,
                                        async->buffer,
-                                       WRITE_CHUNK_SIZE,
+                                       _pluma_io_chunk_policy_begin (&saver->priv->chunk_policy),
                                        async->cancellable,
                                        &error);
 
@@ -726,11 +746,732 @@ async_replace_ready_callback (GFile        *source,
 
     saver->priv->size = pluma_document_input_stream_get_total_size (PLUMA_DOCUMENT_INPUT_STREAM (saver->priv->input));
 
+    _pluma_io_chunk_policy_init (&saver->priv->chunk_policy,
+                                 g_settings_get_enum (saver->priv->editor_settings,
+                                                      PLUMA_SETTINGS_IO_CHUNK_POLICY),
+                                 WRITE_CHUNK_SIZE);
+
+    async->buffer = g_malloc (_pluma_io_chunk_policy_get_max_size (&saver->priv->chunk_policy));
+
     read_file_chunk (async);
 }
 
+/* Local files are serialized on the main thread, since the buffer can only
+ * be read from there, and handed over chunk by chunk to a worker thread
+ * that encodes them, writes them to a temporary file next to the
+ * destination, syncs it and renames it over the destination: the original
+ * file is left untouched until the new contents are safely on disk. */
+typedef struct
+{
+    AsyncData    *async;
+    GCancellable *cancellable;
+
+    gchar        *path;
+    gchar        *charset;
+    gboolean      backup;
+
+    /* GBytes read from the document, an empty one ends the contents */
+    GAsyncQueue  *chunks;
+    GError       *read_error;
+
+    /* set by the worker when no more chunks are needed */
+    gint          stop;
+    /* set when the reader waits for the worker to catch up */
+    gint          throttled;
+    gboolean      end_seen;
+
+    GCharsetConverter *converter;
+    /* input the converter could not take yet */
+    GByteArray   *pending;
+
+    /* the file cannot be replaced by renaming, write it in place */
+    gboolean      fallback;
+    GError       *error;
+} FastSaveJob;
+
+/* Chunks serialized ahead of the writer at most */
+#define MAX_QUEUED_CHUNKS 8
+
+/* Bytes encoded at once */
+#define ENCODE_BUFFER_SIZE (64 * 1024)
+
 static void
-begin_write (AsyncData *async)
+fast_save_job_free (FastSaveJob *job)
+{
+    g_object_unref (job->cancellable);
+    g_free (job->path);
+    g_free (job->charset);
+
+    g_async_queue_unref (job->chunks);
+    g_clear_error (&job->read_error);
+
+    g_clear_object (&job->converter);
+
+    if (job->pending != NULL)
+        g_byte_array_unref (job->pending);
+
+    g_clear_error (&job->error);
+
+    g_slice_free (FastSaveJob, job);
+}
+
+static void
+set_error_from_errno (GError **error,
+                      gint     errsv)
+{
+    g_set_error_literal (error,
+                         G_IO_ERROR,
+                         g_io_error_from_errno (errsv),
+                         g_strerror (errsv));
+}
+
+static gboolean
+write_all (gint          fd,
+           const gchar  *buf,
+           gsize         len,
+           GError      **error)
+{
+    while (len > 0)
+    {
+        gssize res;
+
+        res = write (fd, buf, len);
+
+        if (res == -1)
+        {
+            gint errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+
+            set_error_from_errno (error, errsv);
+            return FALSE;
+        }
+
+        buf += res;
+        len -= res;
+    }
+
+    return TRUE;
+}
+
+/* Encodes and writes the given bytes. Characters cut at the end of a chunk
+ * are kept until the next one, @at_end flushes the converter. */
+static gboolean
+write_encoded (FastSaveJob  *job,
+               gint          fd,
+               const gchar  *buf,
+               gsize         len,
+               gboolean      at_end,
+               GError      **error)
+{
+    gchar *out;
+    const gchar *in;
+    gsize in_left;
+    gboolean ret = TRUE;
+
+    if (job->converter == NULL)
+        return write_all (fd, buf, len, error);
+
+    g_byte_array_append (job->pending, (const guint8 *) buf, len);
+
+    in = (const gchar *) job->pending->data;
+    in_left = job->pending->len;
+    out = g_malloc (ENCODE_BUFFER_SIZE);
+
+    while (in_left > 0 || at_end)
+    {
+        GConverterResult res;
+        gsize bytes_read;
+        gsize bytes_written;
+        GError *err = NULL;
+
+        res = g_converter_convert (G_CONVERTER (job->converter),
+                                   in, in_left,
+                                   out, ENCODE_BUFFER_SIZE,
+                                   at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                   &bytes_read,
+                                   &bytes_written,
+                                   &err);
+
+        if (res == G_CONVERTER_ERROR)
+        {
+            if (!at_end && g_error_matches (err, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT))
+            {
+                g_error_free (err);
+                break;
+            }
+
+            g_propagate_error (error, err);
+            ret = FALSE;
+            break;
+        }
+
+        in += bytes_read;
+        in_left -= bytes_read;
+
+        if (!write_all (fd, out, bytes_written, error))
+        {
+            ret = FALSE;
+            break;
+        }
+
+        if (res == G_CONVERTER_FINISHED)
+            break;
+    }
+
+    g_free (out);
+    g_byte_array_remove_range (job->pending, 0, job->pending->len - in_left);
+
+    return ret;
+}
+
+static gboolean
+copy_file_contents (gint     src,
+                    gint     dest,
+                    GError **error)
+{
+    gchar *buffer;
+    gssize res;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    goffset copied = 0;
+
+    /* let the kernel (or the file system) do the copy */
+    while ((res = copy_file_range (src, NULL, dest, NULL, COPY_CHUNK_SIZE, 0)) != 0)
+    {
+        if (res == -1)
+        {
+            gint errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+
+            if (copied == 0 &&
+                (errsv == ENOSYS || errsv == EXDEV || errsv == EINVAL || errsv == EOPNOTSUPP))
+                break;
+
+            set_error_from_errno (error, errsv);
+            return FALSE;
+        }
+
+        copied += res;
+    }
+
+    if (res == 0)
+        return TRUE;
+#endif
+
+    buffer = g_malloc (COPY_CHUNK_SIZE);
+
+    while ((res = read (src, buffer, COPY_CHUNK_SIZE)) != 0)
+    {
+        if (res == -1)
+        {
+            gint errsv = errno;
+
+            if (errsv == EINTR)
+                continue;
+
+            set_error_from_errno (error, errsv);
+            g_free (buffer);
+            return FALSE;
+        }
+
+        if (!write_all (dest, buffer, res, error))
+        {
+            g_free (buffer);
+            return FALSE;
+        }
+    }
+
+    g_free (buffer);
+
+    return TRUE;
+}
+
+/* The old contents are kept by linking the backup to the original file,
+ * which is about to be replaced by a new inode anyway: they are only
+ * copied when the file system does not support hard links. */
+static gboolean
+make_backup (const gchar     *path,
+             const gchar     *backup_path,
+             const GStatBuf  *st,
+             GError         **error)
+{
+    GError *err = NULL;
+    gint src;
+    gint dest;
+
+    if (link (path, backup_path) == 0)
+        return TRUE;
+
+    src = g_open (path, O_RDONLY, 0);
+
+    if (src == -1)
+    {
+        set_error_from_errno (&err, errno);
+    }
+    else
+    {
+        dest = g_open (backup_path, O_WRONLY | O_CREAT | O_EXCL, st->st_mode & 0777);
+
+        if (dest == -1)
+        {
+            set_error_from_errno (&err, errno);
+        }
+        else
+        {
+            if (!copy_file_contents (src, dest, &err) || fsync (dest) == -1)
+            {
+                if (err == NULL)
+                    set_error_from_errno (&err, errno);
+
+                g_unlink (backup_path);
+            }
+
+            close (dest);
+        }
+
+        close (src);
+    }
+
+    if (err != NULL)
+    {
+        pluma_debug_message (DEBUG_SAVER, "Backup failed: %s", err->message);
+
+        g_error_free (err);
+        g_set_error_literal (error,
+                             G_IO_ERROR,
+                             G_IO_ERROR_CANT_CREATE_BACKUP,
+                             "Backup file creation failed");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+sync_directory (const gchar *path)
+{
+    gchar *dirname;
+    gint fd;
+
+    dirname = g_path_get_dirname (path);
+    fd = g_open (dirname, O_RDONLY, 0);
+
+    if (fd != -1)
+    {
+        fsync (fd);
+        close (fd);
+    }
+
+    g_free (dirname);
+}
+
+static void serialize_document (FastSaveJob *job);
+
+/* Takes the next chunk off the queue, and lets the reader go on when it
+ * waits for room in it */
+static GBytes *
+pop_chunk (FastSaveJob *job)
+{
+    GBytes *chunk;
+
+    chunk = g_async_queue_pop (job->chunks);
+
+    if (g_bytes_get_size (chunk) == 0)
+        job->end_seen = TRUE;
+
+    if (g_async_queue_length (job->chunks) < MAX_QUEUED_CHUNKS &&
+        g_atomic_int_compare_and_exchange (&job->throttled, TRUE, FALSE))
+        serialize_document (job);
+
+    return chunk;
+}
+
+static gboolean
+write_chunks (FastSaveJob  *job,
+              gint          fd,
+              GError      **error)
+{
+    while (TRUE)
+    {
+        GBytes *chunk;
+        gconstpointer data;
+        gsize size;
+        gboolean ok;
+
+        chunk = pop_chunk (job);
+        data = g_bytes_get_data (chunk, &size);
+
+        if (size == 0)
+        {
+            g_bytes_unref (chunk);
+            break;
+        }
+
+        ok = !g_cancellable_set_error_if_cancelled (job->cancellable, error) &&
+             write_encoded (job, fd, data, size, FALSE, error);
+
+        g_bytes_unref (chunk);
+
+        if (!ok)
+            return FALSE;
+    }
+
+    if (job->read_error != NULL)
+    {
+        g_propagate_error (error, job->read_error);
+        job->read_error = NULL;
+        return FALSE;
+    }
+
+    return write_encoded (job, fd, NULL, 0, TRUE, error);
+}
+
+static void
+fast_save_write (FastSaveJob *job)
+{
+    gchar *backup_path = NULL;
+    gchar *dirname;
+    gchar *basename;
+    gchar *tmp_path;
+    GStatBuf st;
+    gboolean exists;
+    gint fd;
+
+    if (g_lstat (job->path, &st) == 0)
+    {
+        exists = TRUE;
+
+        /* renaming would break symlinks and hard links */
+        job->fallback = !S_ISREG (st.st_mode) || st.st_nlink > 1;
+    }
+    else
+    {
+        exists = FALSE;
+        job->fallback = (errno != ENOENT);
+    }
+
+    if (job->fallback)
+        return;
+
+    if (job->charset != NULL)
+    {
+        job->converter = g_charset_converter_new (job->charset, "UTF-8", &job->error);
+
+        if (job->converter == NULL)
+            return;
+
+        job->pending = g_byte_array_new ();
+    }
+
+    dirname = g_path_get_dirname (job->path);
+    basename = g_path_get_basename (job->path);
+    tmp_path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S ".%s.XXXXXX", dirname, basename);
+    g_free (dirname);
+    g_free (basename);
+
+    /* the mode is filtered by the umask like for a new file */
+    fd = g_mkstemp_full (tmp_path, O_WRONLY, 0666);
+
+    if (fd == -1)
+    {
+        pluma_debug_message (DEBUG_SAVER, "Cannot create temporary file: %s", g_strerror (errno));
+
+        job->fallback = TRUE;
+        goto out;
+    }
+
+    if (exists)
+    {
+        GStatBuf tmp_st;
+
+        if (fchmod (fd, st.st_mode & 07777) == -1 ||
+            fstat (fd, &tmp_st) == -1 ||
+            ((tmp_st.st_uid != st.st_uid || tmp_st.st_gid != st.st_gid) &&
+             fchown (fd, st.st_uid, st.st_gid) == -1))
+        {
+            pluma_debug_message (DEBUG_SAVER, "Cannot preserve the file mode or owner");
+
+            job->fallback = TRUE;
+            goto fail;
+        }
+    }
+
+    if (!write_chunks (job, fd, &job->error))
+        goto fail;
+
+    if (fsync (fd) == -1)
+    {
+        set_error_from_errno (&job->error, errno);
+        goto fail;
+    }
+
+    if (close (fd) == -1)
+    {
+        fd = -1;
+        set_error_from_errno (&job->error, errno);
+        goto fail;
+    }
+
+    fd = -1;
+
+    /* the old backup stays in place until the file is saved */
+    if (exists && job->backup)
+    {
+        backup_path = g_strconcat (tmp_path, "~", NULL);
+
+        if (!make_backup (job->path, backup_path, &st, &job->error))
+        {
+            g_clear_pointer (&backup_path, g_free);
+            goto fail;
+        }
+    }
+
+    if (g_cancellable_set_error_if_cancelled (job->cancellable, &job->error))
+        goto fail;
+
+    if (g_rename (tmp_path, job->path) == -1)
+    {
+        set_error_from_errno (&job->error, errno);
+        goto fail;
+    }
+
+    if (backup_path != NULL)
+    {
+        gchar *final_backup_path;
+
+        final_backup_path = g_strconcat (job->path, "~", NULL);
+
+        if (g_rename (backup_path, final_backup_path) == -1)
+        {
+            pluma_debug_message (DEBUG_SAVER, "Cannot replace the backup: %s", g_strerror (errno));
+            g_unlink (backup_path);
+        }
+
+        g_free (final_backup_path);
+    }
+
+    sync_directory (job->path);
+
+    goto out;
+
+fail:
+    if (fd != -1)
+        close (fd);
+
+    if (backup_path != NULL)
+        g_unlink (backup_path);
+
+    g_unlink (tmp_path);
+
+out:
+    g_free (tmp_path);
+    g_free (backup_path);
+}
+
+static void begin_stream_write (AsyncData *async);
+
+static gboolean
+fast_save_done (FastSaveJob *job)
+{
+    AsyncData *async = job->async;
+    PlumaDocumentSaver *saver;
+
+    pluma_debug (DEBUG_SAVER);
+
+    /* check cancelled state manually */
+    if (g_cancellable_is_cancelled (job->cancellable))
+    {
+        async_data_free (async);
+        fast_save_job_free (job);
+        return FALSE;
+    }
+
+    saver = async->saver;
+    g_input_stream_close (saver->priv->input, NULL, NULL);
+
+    if (job->fallback)
+    {
+        pluma_debug_message (DEBUG_SAVER, "Cannot save atomically, write in place");
+
+        fast_save_job_free (job);
+
+        g_clear_object (&saver->priv->input);
+        begin_stream_write (async);
+        return FALSE;
+    }
+
+    if (job->error != NULL)
+    {
+        GError *error = job->error;
+
+        pluma_debug_message (DEBUG_SAVER, "Fast save error: %s", error->message);
+
+        job->error = NULL;
+        fast_save_job_free (job);
+
+        async_failed (async, error);
+        return FALSE;
+    }
+
+    fast_save_job_free (job);
+
+    pluma_debug_message (DEBUG_SAVER, "Query info on file");
+    g_file_query_info_async (saver->priv->gfile,
+                             REMOTE_QUERY_ATTRIBUTES,
+                             G_FILE_QUERY_INFO_NONE,
+                             G_PRIORITY_HIGH,
+                             async->cancellable,
+                             (GAsyncReadyCallback) remote_get_info_cb,
+                             async);
+
+    return FALSE;
+}
+
+static gpointer
+fast_save_thread (FastSaveJob *job)
+{
+    fast_save_write (job);
+
+    /* the reader stops at the next chunk, wait for it to be done with
+     * the job */
+    g_atomic_int_set (&job->stop, TRUE);
+
+    while (!job->end_seen)
+        g_bytes_unref (pop_chunk (job));
+
+    g_idle_add_full (G_PRIORITY_HIGH,
+                     (GSourceFunc) fast_save_done,
+                     job,
+                     NULL);
+
+    return NULL;
+}
+
+static void
+end_serialize (FastSaveJob *job)
+{
+    g_async_queue_push (job->chunks, g_bytes_new (NULL, 0));
+}
+
+/* The document is read in chunks from an idle, so that the progress keeps
+ * being reported and the window redrawn while serializing big files. The
+ * reading pauses while the writer is MAX_QUEUED_CHUNKS behind. */
+static gboolean
+serialize_document_chunk (FastSaveJob *job)
+{
+    PlumaDocumentSaver *saver;
+    gchar *buffer;
+    gsize size;
+    gssize read;
+    GError *error = NULL;
+
+    /* the writer thread reports the cancellation */
+    if (g_atomic_int_get (&job->stop) ||
+        g_cancellable_is_cancelled (job->cancellable))
+    {
+        end_serialize (job);
+        return FALSE;
+    }
+
+    if (g_async_queue_length (job->chunks) >= MAX_QUEUED_CHUNKS)
+    {
+        g_atomic_int_set (&job->throttled, TRUE);
+
+        /* unless the writer caught up meanwhile, it resumes the reading */
+        if (g_async_queue_length (job->chunks) >= MAX_QUEUED_CHUNKS ||
+            !g_atomic_int_compare_and_exchange (&job->throttled, TRUE, FALSE))
+            return FALSE;
+    }
+
+    saver = job->async->saver;
+
+    size = _pluma_io_chunk_policy_begin (&saver->priv->chunk_policy);
+    buffer = g_malloc (size);
+
+    read = g_input_stream_read (saver->priv->input,
+                                buffer,
+                                size,
+                                job->cancellable,
+                                &error);
+
+    if (read <= 0)
+    {
+        g_free (buffer);
+
+        if (error != NULL)
+            job->read_error = error;
+
+        pluma_debug_message (DEBUG_SAVER, "Serialized the document");
+
+        end_serialize (job);
+        return FALSE;
+    }
+
+    g_async_queue_push (job->chunks, g_bytes_new_take (buffer, read));
+
+    _pluma_io_chunk_policy_done (&saver->priv->chunk_policy, read);
+
+    saver->priv->bytes_written = pluma_document_input_stream_tell (PLUMA_DOCUMENT_INPUT_STREAM (saver->priv->input));
+    pluma_document_saver_saving (saver, FALSE, NULL);
+
+    return TRUE;
+}
+
+static void
+serialize_document (FastSaveJob *job)
+{
+    g_idle_add ((GSourceFunc) serialize_document_chunk, job);
+}
+
+static gboolean
+can_fast_save (PlumaDocumentSaver *saver)
+{
+    return g_settings_get_boolean (saver->priv->editor_settings,
+                                   PLUMA_SETTINGS_ATOMIC_SAVE) &&
+           g_file_is_native (saver->priv->gfile);
+}
+
+static void
+begin_fast_save (AsyncData *async)
+{
+    PlumaDocumentSaver *saver;
+    FastSaveJob *job;
+
+    saver = async->saver;
+
+    job = g_slice_new0 (FastSaveJob);
+    job->async = async;
+    job->cancellable = g_object_ref (async->cancellable);
+    job->path = g_file_get_path (saver->priv->gfile);
+    job->backup = saver->priv->keep_backup;
+    job->chunks = g_async_queue_new_full ((GDestroyNotify) g_bytes_unref);
+
+    if (saver->priv->encoding != pluma_encoding_get_utf8 ())
+        job->charset = g_strdup (pluma_encoding_get_charset (saver->priv->encoding));
+
+    saver->priv->input = pluma_document_input_stream_new (GTK_TEXT_BUFFER (saver->priv->document),
+                                                          saver->priv->newline_type);
+
+    saver->priv->size = pluma_document_input_stream_get_total_size (PLUMA_DOCUMENT_INPUT_STREAM (saver->priv->input));
+
+    _pluma_io_chunk_policy_init (&saver->priv->chunk_policy,
+                                 g_settings_get_enum (saver->priv->editor_settings,
+                                                      PLUMA_SETTINGS_IO_CHUNK_POLICY),
+                                 WRITE_CHUNK_SIZE);
+
+    g_thread_unref (g_thread_new ("pluma-saver",
+                                  (GThreadFunc) fast_save_thread,
+                                  job));
+
+    serialize_document (job);
+}
+
+static void
+begin_stream_write (AsyncData *async)
 {
     PlumaDocumentSaver *saver;
     gboolean backup;
@@ -759,6 +1500,20 @@ begin_write (AsyncData *async)
                           async);
 }
 
+static void
+begin_write (AsyncData *async)
+{
+    if (can_fast_save (async->saver))
+    {
+        pluma_debug_message (DEBUG_SAVER, "Start saving atomically");
+
+        begin_fast_save (async);
+        return;
+    }
+
+    begin_stream_write (async);
+}
+
 static void
 mount_ready_callback (GFile        *file,
                       GAsyncResult *res,
@@ -1020,6 +1775,24 @@ pluma_document_saver_get_bytes_written (PlumaDocumentSaver *saver)
     return saver->priv->bytes_written;
 }
 
+/* Returns the size of the chunks currently being written */
+gsize
+pluma_document_saver_get_chunk_size (PlumaDocumentSaver *saver)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_SAVER (saver), 0);
+
+    return saver->priv->chunk_policy.size;
+}
+
+/* Returns the average write throughput in bytes per second, 0 if unknown */
+guint64
+pluma_document_saver_get_throughput (PlumaDocumentSaver *saver)
+{
+    g_return_val_if_fail (PLUMA_IS_DOCUMENT_SAVER (saver), 0);
+
+    return _pluma_io_chunk_policy_get_throughput (&saver->priv->chunk_policy);
+}
+
 GFileInfo *
 pluma_document_saver_get_info (PlumaDocumentSaver *saver)
 {
@@ -112,6 +112,10 @@ goffset                 pluma_document_saver_get_file_size        (PlumaDocument
 
 goffset                 pluma_document_saver_get_bytes_written    (PlumaDocumentSaver  *saver);
 
+gsize                   pluma_document_saver_get_chunk_size       (PlumaDocumentSaver  *saver);
+
+guint64                 pluma_document_saver_get_throughput       (PlumaDocumentSaver  *saver);
+
 GFileInfo              *pluma_document_saver_get_info             (PlumaDocumentSaver  *saver);
 
 G_END_DECLS
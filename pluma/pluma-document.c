@@ -49,6 +49,9 @@
 #include "pluma-style-scheme-manager.h"
 #include "pluma-document-loader.h"
 #include "pluma-document-saver.h"
+#include "pluma-large-file.h"
+#include "pluma-search-snapshot.h"
+#include "pluma-match-index.h"
 #include "pluma-enum-types.h"
 #include "plumatextregion.h"
 
@@ -58,6 +61,25 @@
 #define METADATA_QUERY "metadata::*"
 #endif
 
+/* Lines and bytes of a large file paged in the document at once */
+#define LARGE_FILE_PAGE_LINES 2000
+#define LARGE_FILE_PAGE_SIZE (4 * 1024 * 1024)
+#define LARGE_FILE_INDEX_SLICE (16 * 1024 * 1024)
+
+/* Search highlighting is done in chunks of lines from an idle which
+ * gives the main loop back after SEARCH_HIGHLIGHT_BUDGET microseconds.
+ * Only the lines shown in a view are highlighted, along with
+ * SEARCH_HIGHLIGHT_MARGIN_LINES lines around them for scrolling. */
+#define SEARCH_HIGHLIGHT_CHUNK_LINES 200
+#define SEARCH_HIGHLIGHT_BUDGET (8 * 1000)
+#define SEARCH_HIGHLIGHT_MARGIN_LINES 100
+
+/* Lines searched at once when indexing the matches, in the same budget */
+#define MATCH_INDEX_CHUNK_LINES 2000
+
+/* Seconds the copy of the text is kept after the last search */
+#define SEARCH_SNAPSHOT_TIMEOUT 30
+
 #undef ENABLE_PROFILE
 
 #ifdef ENABLE_PROFILE
@@ -96,6 +118,8 @@ static void	pluma_document_save_real	(PlumaDocument          *doc,
 static void	to_search_region_range 		(PlumaDocument *doc,
 						 GtkTextIter   *start,
 						 GtkTextIter   *end);
+static void	reset_match_index 		(PlumaDocument *doc);
+static void	clear_search_snapshot 		(PlumaDocument *doc);
 static void 	insert_text_cb		 	(PlumaDocument *doc,
 						 GtkTextIter   *pos,
 						 const gchar   *text,
@@ -104,6 +128,15 @@ static void 	insert_text_cb		 	(PlumaDocument *doc,
 static void	delete_range_cb 		(PlumaDocument *doc,
 						 GtkTextIter   *start,
 						 GtkTextIter   *end);
+static void	delete_range_before_cb 		(PlumaDocument *doc,
+						 GtkTextIter   *start,
+						 GtkTextIter   *end);
+static void	large_file_show_offset		(PlumaDocument *doc,
+						 gsize          offset);
+static void	large_file_show_line		(PlumaDocument *doc,
+						 gint64         line);
+static void	large_file_loaded		(PlumaDocumentLoader *loader,
+						 PlumaDocument       *doc);
 
 struct _PlumaDocumentPrivate
 {
@@ -139,10 +172,38 @@ struct _PlumaDocumentPrivate
 	/* Saving stuff */
 	PlumaDocumentSaver *saver;
 
+	/* Files too large to be loaded are paged in, see pluma-large-file.h */
+	PlumaLargeFile      *large_file;
+	gint64               large_file_first_line;
+	gsize                large_file_start;
+	gsize                large_file_end;
+	guint                large_file_idle;
+
 	/* Search highlighting support variables */
 	PlumaTextRegion *to_search_region;
 	GtkTextTag      *found_tag;
 
+	/* parts of to_search_region shown in a view, the rest of it is
+	 * only highlighted once it is shown too */
+	PlumaTextRegion *visible_search_region;
+	guint            search_idle;
+
+	/* Flat copy of the text for searches, dropped on changes, when not
+	 * searched for a while or when memory is low */
+	PlumaSearchSnapshot *search_snapshot;
+	gint64               search_snapshot_used;
+	guint                search_snapshot_timeout;
+#if GLIB_CHECK_VERSION(2,64,0)
+	GMemoryMonitor      *memory_monitor;
+#endif
+
+	/* Matches of the search text, indexed from an idle as long as
+	 * someone wants to count them */
+	PlumaMatchIndex *match_index;
+	PlumaTextRegion *to_index_region;
+	guint            match_index_idle;
+	gint             match_index_users;
+
 	/* Mount operation factory */
 	PlumaMountOperationFactory  mount_operation_factory;
 	gpointer		    mount_operation_userdata;
@@ -152,6 +213,7 @@ struct _PlumaDocumentPrivate
 	gint language_set_by_user : 1;
 	gint stop_cursor_moved_emission : 1;
 	gint dispose_has_run : 1;
+	gint large_file_searching : 1;
 };
 
 enum {
@@ -177,6 +239,7 @@ enum {
 	SAVING,
 	SAVED,
 	SEARCH_HIGHLIGHT_UPDATED,
+	MATCH_INDEX_UPDATED,
 	LAST_SIGNAL
 };
 
@@ -241,7 +304,9 @@ pluma_document_dispose (GObject *object)
 	 * because the language is gone by the time finalize runs.
 	 * beside if some plugin prevents proper finalization by
 	 * holding a ref to the doc, we still save the metadata */
-	if ((!doc->priv->dispose_has_run) && (doc->priv->uri != NULL))
+	/* the cursor of a large file is relative to the current page */
+	if ((!doc->priv->dispose_has_run) && (doc->priv->uri != NULL) &&
+	    (doc->priv->large_file == NULL))
 	{
 		GtkTextIter iter;
 		gchar *position;
@@ -283,6 +348,37 @@ pluma_document_dispose (GObject *object)
 		doc->priv->loader = NULL;
 	}
 
+	if (doc->priv->large_file_idle != 0)
+	{
+		g_source_remove (doc->priv->large_file_idle);
+		doc->priv->large_file_idle = 0;
+	}
+
+	_pluma_large_file_free (doc->priv->large_file);
+	doc->priv->large_file = NULL;
+
+	if (doc->priv->search_idle != 0)
+	{
+		g_source_remove (doc->priv->search_idle);
+		doc->priv->search_idle = 0;
+	}
+
+	if (doc->priv->match_index_idle != 0)
+	{
+		g_source_remove (doc->priv->match_index_idle);
+		doc->priv->match_index_idle = 0;
+	}
+
+	clear_search_snapshot (doc);
+
+#if GLIB_CHECK_VERSION(2,64,0)
+	if (doc->priv->memory_monitor != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (doc->priv->memory_monitor, doc);
+		g_clear_object (&doc->priv->memory_monitor);
+	}
+#endif
+
 	if (doc->priv->metadata_info != NULL)
 	{
 		g_object_unref (doc->priv->metadata_info);
@@ -318,8 +414,14 @@ pluma_document_finalize (GObject *object)
 	{
 		/* we can't delete marks if we're finalizing the buffer */
 		pluma_text_region_destroy (doc->priv->to_search_region, FALSE);
+		pluma_text_region_destroy (doc->priv->visible_search_region, FALSE);
 	}
 
+	if (doc->priv->to_index_region != NULL)
+		pluma_text_region_destroy (doc->priv->to_index_region, FALSE);
+
+	_pluma_match_index_free (doc->priv->match_index);
+
 	G_OBJECT_CLASS (pluma_document_parent_class)->finalize (object);
 }
 
@@ -430,11 +532,53 @@ pluma_document_mark_set (GtkTextBuffer     *buffer,
 static void
 pluma_document_changed (GtkTextBuffer *buffer)
 {
+	/* pixbufs and child anchors change the text too */
+	clear_search_snapshot (PLUMA_DOCUMENT (buffer));
+
 	emit_cursor_moved (PLUMA_DOCUMENT (buffer));
 
 	GTK_TEXT_BUFFER_CLASS (pluma_document_parent_class)->changed (buffer);
 }
 
+static gboolean
+tag_is_invisible (GtkTextTag *tag)
+{
+	gboolean invisible;
+
+	g_object_get (tag, "invisible", &invisible, NULL);
+
+	return invisible;
+}
+
+/* The copy of the text leaves the hidden text out */
+static void
+pluma_document_apply_tag (GtkTextBuffer     *buffer,
+			  GtkTextTag        *tag,
+			  const GtkTextIter *start,
+			  const GtkTextIter *end)
+{
+	PlumaDocument *doc = PLUMA_DOCUMENT (buffer);
+
+	if (doc->priv->search_snapshot != NULL && tag_is_invisible (tag))
+		clear_search_snapshot (doc);
+
+	GTK_TEXT_BUFFER_CLASS (pluma_document_parent_class)->apply_tag (buffer, tag, start, end);
+}
+
+static void
+pluma_document_remove_tag (GtkTextBuffer     *buffer,
+			   GtkTextTag        *tag,
+			   const GtkTextIter *start,
+			   const GtkTextIter *end)
+{
+	PlumaDocument *doc = PLUMA_DOCUMENT (buffer);
+
+	if (doc->priv->search_snapshot != NULL && tag_is_invisible (tag))
+		clear_search_snapshot (doc);
+
+	GTK_TEXT_BUFFER_CLASS (pluma_document_parent_class)->remove_tag (buffer, tag, start, end);
+}
+
 static void
 pluma_document_class_init (PlumaDocumentClass *klass)
 {
@@ -448,6 +592,8 @@ pluma_document_class_init (PlumaDocumentClass *klass)
 
 	buf_class->mark_set = pluma_document_mark_set;
 	buf_class->changed = pluma_document_changed;
+	buf_class->apply_tag = pluma_document_apply_tag;
+	buf_class->remove_tag = pluma_document_remove_tag;
 
 	klass->load = pluma_document_load_real;
 	klass->save = pluma_document_save_real;
@@ -648,6 +794,17 @@ pluma_document_class_init (PlumaDocumentClass *klass)
 			      2,
 			      GTK_TYPE_TEXT_ITER | G_SIGNAL_TYPE_STATIC_SCOPE,
 			      GTK_TYPE_TEXT_ITER | G_SIGNAL_TYPE_STATIC_SCOPE);
+
+	/* emitted while the matches are indexed, see
+	 * _pluma_document_set_index_matches () */
+	document_signals[MATCH_INDEX_UPDATED] =
+	    	g_signal_new ("match-index-updated",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL, NULL,
+			      G_TYPE_NONE,
+			      0);
 }
 
 #if !GTK_SOURCE_CHECK_VERSION(4, 3, 1)
@@ -1013,6 +1170,11 @@ pluma_document_init (PlumaDocument *doc)
 			  	G_CALLBACK (delete_range_cb),
 			  	NULL);
 
+	g_signal_connect (doc,
+			  "delete-range",
+			  G_CALLBACK (delete_range_before_cb),
+			  NULL);
+
 	g_signal_connect (doc,
 			  "notify::content-type",
 			  G_CALLBACK (on_content_type_changed),
@@ -1022,6 +1184,21 @@ pluma_document_init (PlumaDocument *doc)
 			  "notify::uri",
 			  G_CALLBACK (on_uri_changed),
 			  NULL);
+
+	/* a tag may start or stop hiding text */
+	g_signal_connect_object (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (doc)),
+				 "tag-changed",
+				 G_CALLBACK (clear_search_snapshot),
+				 doc,
+				 G_CONNECT_SWAPPED);
+
+#if GLIB_CHECK_VERSION(2,64,0)
+	doc->priv->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect_swapped (doc->priv->memory_monitor,
+				  "low-memory-warning",
+				  G_CALLBACK (clear_search_snapshot),
+				  doc);
+#endif
 }
 
 PlumaDocument *
@@ -1296,6 +1473,91 @@ pluma_document_get_readonly (PlumaDocument *doc)
 	return doc->priv->readonly;
 }
 
+gboolean
+_pluma_document_is_large_file (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+
+	return doc->priv->large_file != NULL;
+}
+
+/* Returns the line of the file shown on the first line of the document,
+ * which is only different from 0 for large files */
+gint64
+_pluma_document_get_first_line (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), 0);
+
+	return doc->priv->large_file != NULL ? doc->priv->large_file_first_line : 0;
+}
+
+/* Returns whether the page of the large file reaches its end */
+gboolean
+_pluma_document_large_file_at_end (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), TRUE);
+
+	return doc->priv->large_file == NULL ||
+	       doc->priv->large_file_end == _pluma_large_file_get_length (doc->priv->large_file);
+}
+
+/* Returns whether the page of the large file starts at its start */
+gboolean
+_pluma_document_large_file_at_start (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), TRUE);
+
+	return doc->priv->large_file == NULL ||
+	       doc->priv->large_file_start == 0;
+}
+
+/* Pages in the part of the large file around @iter, which is in the
+ * current page, and moves the cursor to it */
+void
+_pluma_document_large_file_show_iter (PlumaDocument     *doc,
+				      const GtkTextIter *iter)
+{
+	GtkTextIter line_start;
+	gint64 line;
+	gsize offset;
+	gchar *slice;
+
+	g_return_if_fail (PLUMA_IS_DOCUMENT (doc));
+	g_return_if_fail (doc->priv->large_file != NULL);
+	g_return_if_fail (iter != NULL);
+
+	/* the first line of the page may start in the middle of its line */
+	if (gtk_text_iter_get_line (iter) == 0)
+	{
+		offset = doc->priv->large_file_start;
+	}
+	else
+	{
+		line = doc->priv->large_file_first_line + gtk_text_iter_get_line (iter);
+		offset = _pluma_large_file_get_line_offset (doc->priv->large_file, &line);
+	}
+
+	line_start = *iter;
+	gtk_text_iter_set_line_offset (&line_start, 0);
+
+	slice = gtk_text_iter_get_slice (&line_start, iter);
+	offset += strlen (slice);
+	g_free (slice);
+
+	large_file_show_offset (doc, offset);
+}
+
+/* Returns TRUE if the region around the cursor is loaded while the rest
+ * of the document is still loading */
+gboolean
+_pluma_document_get_viewport_loaded (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+
+	return doc->priv->loader != NULL &&
+	       pluma_document_loader_get_viewport_loaded (doc->priv->loader);
+}
+
 gboolean
 _pluma_document_check_externally_modified (PlumaDocument *doc)
 {
@@ -1496,7 +1758,12 @@ document_loader_loading (PlumaDocumentLoader *loader,
 			 const GError        *error,
 			 PlumaDocument       *doc)
 {
-	if (completed)
+	if (completed && error == NULL &&
+	    pluma_document_loader_get_large_file (loader))
+	{
+		large_file_loaded (loader, doc);
+	}
+	else if (completed)
 	{
 		document_loader_loaded (loader, error, doc);
 	}
@@ -1522,169 +1789,555 @@ document_loader_loading (PlumaDocumentLoader *loader,
 	}
 }
 
+/* Large local files are shown at the cursor position before the rest
+ * of the file is loaded */
 static void
-pluma_document_load_real (PlumaDocument       *doc,
-			  const gchar         *uri,
-			  const PlumaEncoding *encoding,
-			  gint                 line_pos,
-			  gboolean             create)
+set_loader_viewport_hint (PlumaDocument *doc,
+			  gint           line_pos)
 {
-	g_return_if_fail (doc->priv->loader == NULL);
+	gint offset = 0;
 
-	pluma_debug_message (DEBUG_DOCUMENT, "load_real: uri = %s", uri);
+	if (!g_settings_get_boolean (doc->priv->editor_settings,
+				     PLUMA_SETTINGS_PROGRESSIVE_LOADING))
+		return;
 
-	/* create a loader. It will be destroyed when loading is completed */
-	doc->priv->loader = pluma_document_loader_new (doc, uri, encoding);
+	if (line_pos > 0)
+	{
+		pluma_document_loader_set_viewport_hint (doc->priv->loader,
+							 line_pos - 1,
+							 -1);
+		return;
+	}
 
-	g_signal_connect (doc->priv->loader,
-			  "loading",
-			  G_CALLBACK (document_loader_loading),
-			  doc);
+	if (g_settings_get_boolean (doc->priv->editor_settings,
+				    PLUMA_SETTINGS_RESTORE_CURSOR_POSITION))
+	{
+		gchar *pos;
 
-	doc->priv->create = create;
-	doc->priv->requested_encoding = encoding;
-	doc->priv->requested_line_pos = line_pos;
+		pos = pluma_document_get_metadata (doc, PLUMA_METADATA_ATTRIBUTE_POSITION);
 
-	set_uri (doc, uri);
-	set_content_type (doc, NULL);
+		offset = pos ? atoi (pos) : 0;
+		g_free (pos);
+	}
 
-	pluma_document_loader_load (doc->priv->loader);
+	pluma_document_loader_set_viewport_hint (doc->priv->loader, -1, offset);
 }
 
-/**
- * pluma_document_load:
- * @doc: the #PlumaDocument.
- * @uri: the uri where to load the document from.
- * @encoding: the #PlumaEncoding to encode the document.
- * @line_pos: the line to show.
- * @create: whether the document should be created if it doesn't exist.
- *
- * Load a document. This results in the "load" signal to be emitted.
- */
-void
-pluma_document_load (PlumaDocument       *doc,
-		     const gchar         *uri,
-		     const PlumaEncoding *encoding,
-		     gint                 line_pos,
-		     gboolean             create)
+/* Files too large for the buffer are opened in the read-only viewer,
+ * the loader tells them apart from the info it queries anyway */
+static void
+set_loader_large_file_threshold (PlumaDocument *doc,
+				 gboolean       create)
 {
-	g_return_if_fail (PLUMA_IS_DOCUMENT (doc));
-	g_return_if_fail (uri != NULL);
-	g_return_if_fail (pluma_utils_is_valid_uri (uri));
+	guint threshold;
 
-	g_signal_emit (doc, document_signals[LOAD], 0, uri, encoding, line_pos, create);
+	if (create ||
+	    !g_settings_get_boolean (doc->priv->editor_settings,
+				     PLUMA_SETTINGS_LARGE_FILE_VIEWER))
+		return;
+
+	threshold = g_settings_get_uint (doc->priv->editor_settings,
+					 PLUMA_SETTINGS_LARGE_FILE_VIEWER_THRESHOLD);
+
+	pluma_document_loader_set_large_file_threshold (doc->priv->loader,
+							(goffset) threshold * 1024 * 1024);
 }
 
-/**
- * pluma_document_load_cancel:
- * @doc: the #PlumaDocument.
- *
- * Cancel load of a document.
- */
-gboolean
-pluma_document_load_cancel (PlumaDocument *doc)
+/* Sets @iter at the char of the page of the large file at @offset */
+static void
+large_file_get_iter_at_offset (PlumaDocument *doc,
+			       gsize          offset,
+			       GtkTextIter   *iter)
 {
-	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+	PlumaLargeFile *file = doc->priv->large_file;
+	const gchar *contents;
+	gint64 line;
+	gsize line_start;
+	glong chars;
 
-	if (doc->priv->loader == NULL)
-		return FALSE;
+	contents = _pluma_large_file_get_contents (file);
+	offset = CLAMP (offset, doc->priv->large_file_start, doc->priv->large_file_end);
 
-	return pluma_document_loader_cancel (doc->priv->loader);
+	line = _pluma_large_file_get_line_at_offset (file, offset);
+	line_start = _pluma_large_file_get_line_offset (file, &line);
+
+	/* count from the start of the page if the line starts before it */
+	line_start = MAX (line_start, doc->priv->large_file_start);
+	chars = g_utf8_strlen (contents + line_start, offset - line_start);
+
+	gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (doc),
+					  iter,
+					  line - doc->priv->large_file_first_line);
+
+	if (chars < gtk_text_iter_get_chars_in_line (iter))
+		gtk_text_iter_set_line_offset (iter, chars);
+	else if (!gtk_text_iter_ends_line (iter))
+		gtk_text_iter_forward_to_line_end (iter);
 }
 
-static void
-document_saver_saving (PlumaDocumentSaver *saver,
-		       gboolean            completed,
-		       const GError       *error,
-		       PlumaDocument      *doc)
+/* Returns the start of the char at or before @pos, not going back
+ * past @min */
+static gsize
+large_file_char_start (const gchar *contents,
+		       gsize        pos,
+		       gsize        min)
 {
-	pluma_debug (DEBUG_DOCUMENT);
+	while (pos > min && (contents[pos] & 0xc0) == 0x80)
+		pos--;
 
-	if (completed)
-	{
-		/* save was successful */
-		if (error == NULL)
-		{
-			const gchar *uri;
-			const gchar *content_type = NULL;
-			guint64 mtime = 0;
-			GFileInfo *info;
+	return pos;
+}
 
-			uri = pluma_document_saver_get_uri (saver);
-			set_uri (doc, uri);
+/* Replaces the text of the document with the page of the large file
+ * around @offset and moves the cursor there. A page holds at most
+ * LARGE_FILE_PAGE_LINES lines and LARGE_FILE_PAGE_SIZE bytes, half of
+ * them before the line of @offset: a line longer than that is cut at a
+ * char boundary, so the first and the last line of the document can be
+ * parts of lines of the file. */
+static void
+large_file_show_offset (PlumaDocument *doc,
+			gsize          offset)
+{
+	PlumaLargeFile *file = doc->priv->large_file;
+	const gchar *contents;
+	gsize length;
+	gint64 line;
+	gint64 first;
+	gint64 last;
+	gsize line_start;
+	gsize start;
+	gsize end;
+	gchar *text = NULL;
+	GtkTextIter iter;
 
-			info = pluma_document_saver_get_info (saver);
+	contents = _pluma_large_file_get_contents (file);
+	length = _pluma_large_file_get_length (file);
 
-			if (info != NULL)
-			{
-				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
-					content_type = g_file_info_get_attribute_string (info,
-											 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+	line = _pluma_large_file_get_line_at_offset (file, offset);
+	line_start = _pluma_large_file_get_line_offset (file, &line);
 
-				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
-					mtime = g_file_info_get_attribute_uint64 (info,
-					                                          G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+	offset = MIN (offset, length);
+	if (offset < length)
+		offset = large_file_char_start (contents, offset, line_start);
 
-				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC))
-				{
-					guint32 usec;
+	first = MAX (line - LARGE_FILE_PAGE_LINES / 2, 0);
+	start = _pluma_large_file_get_line_offset (file, &first);
 
-					usec = g_file_info_get_attribute_uint32 (info,
-					                                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
-					mtime += (guint64) usec;
-				}
-			}
+	/* leave the other half of the page to the text after @offset */
+	while (offset - start > LARGE_FILE_PAGE_SIZE / 2 && first < line)
+	{
+		const gchar *nl;
 
-			set_content_type (doc, content_type);
-			doc->priv->mtime = (gint64) mtime;
+		nl = memchr (contents + start, '\n', line_start - start);
+		if (nl == NULL)
+			break;
 
-			doc->priv->time_of_last_save_or_load = g_get_real_time ();
+		start = nl - contents + 1;
+		first++;
+	}
 
-			_pluma_document_set_readonly (doc, FALSE);
+	if (offset - start > LARGE_FILE_PAGE_SIZE / 2)
+		start = large_file_char_start (contents,
+					       offset - LARGE_FILE_PAGE_SIZE / 2,
+					       line_start);
 
-			gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (doc),
-						      FALSE);
+	last = first + LARGE_FILE_PAGE_LINES;
+	end = _pluma_large_file_get_line_offset (file, &last);
 
-			set_encoding (doc,
-				      doc->priv->requested_encoding,
-				      TRUE);
-		}
+	/* the last page goes up to the end of the file */
+	if (last < first + LARGE_FILE_PAGE_LINES)
+		end = length;
 
-		g_signal_emit (doc,
-			       document_signals[SAVED],
-			       0,
-			       error);
+	/* end the page on the last line break that fits, or in the middle
+	 * of the line of @offset if it does not end before */
+	if (end - start > LARGE_FILE_PAGE_SIZE)
+	{
+		gsize limit = start + LARGE_FILE_PAGE_SIZE;
 
-		/* the saver has been used, throw it away */
-		g_object_unref (doc->priv->saver);
-		doc->priv->saver = NULL;
+		for (end = limit; end > offset && contents[end - 1] != '\n'; end--)
+			;
+
+		if (end == offset)
+			end = large_file_char_start (contents, limit, offset);
 	}
-	else
-	{
-		goffset size = 0;
-		goffset written = 0;
 
-		size = pluma_document_saver_get_file_size (saver);
-		written = pluma_document_saver_get_bytes_written (saver);
+	doc->priv->large_file_first_line = first;
+	doc->priv->large_file_start = start;
+	doc->priv->large_file_end = end;
 
-		pluma_debug_message (DEBUG_DOCUMENT, "save progress: %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT, written, size);
+	/* do not show the line break ending the page as an empty line */
+	if (end > start && contents[end - 1] == '\n')
+		end--;
+	if (end > start && contents[end - 1] == '\r')
+		end--;
 
-		g_signal_emit (doc,
-			       document_signals[SAVING],
-			       0,
-			       written,
-			       size);
+	if (!g_utf8_validate (contents + start, end - start, NULL))
+	{
+		gchar *str;
+
+		str = g_strndup (contents + start, end - start);
+		text = pluma_utils_make_valid_utf8 (str);
+		g_free (str);
 	}
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	/* the page size keeps the length within a gint */
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc),
+				  text != NULL ? text : contents + start,
+				  text != NULL ? -1 : (gint) (end - start));
+
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+
+	gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (doc), FALSE);
+
+	g_free (text);
+
+	large_file_get_iter_at_offset (doc, offset, &iter);
+	gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &iter);
 }
 
+/* Pages in the lines around @line of the large file and moves the
+ * cursor at its start */
 static void
-pluma_document_save_real (PlumaDocument          *doc,
-			  const gchar            *uri,
-			  const PlumaEncoding    *encoding,
+large_file_show_line (PlumaDocument *doc,
+		      gint64         line)
+{
+	/* clamps @line to the last one */
+	large_file_show_offset (doc,
+				_pluma_large_file_get_line_offset (doc->priv->large_file, &line));
+}
+
+/* Moves the cursor to the char @line_offset of @line of the large file,
+ * paging it in if needed */
+static gboolean
+large_file_goto_line_offset (PlumaDocument *doc,
+			     gint64         line,
+			     gint           line_offset)
+{
+	PlumaLargeFile *file = doc->priv->large_file;
+	const gchar *contents;
+	const gchar *p;
+	const gchar *line_end;
+	gsize length;
+	gsize offset;
+	gint i;
+	GtkTextIter iter;
+
+	contents = _pluma_large_file_get_contents (file);
+	length = _pluma_large_file_get_length (file);
+
+	offset = _pluma_large_file_get_line_offset (file, &line);
+
+	line_end = memchr (contents + offset, '\n', length - offset);
+	if (line_end == NULL)
+		line_end = contents + length;
+
+	p = contents + offset;
+
+	for (i = 0; i < line_offset && p < line_end; i++)
+		p = g_utf8_next_char (p);
+
+	offset = MIN (p, line_end) - contents;
+
+	if (offset < doc->priv->large_file_start || offset > doc->priv->large_file_end)
+	{
+		large_file_show_offset (doc, offset);
+	}
+	else
+	{
+		large_file_get_iter_at_offset (doc, offset, &iter);
+		gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &iter);
+	}
+
+	return i >= line_offset;
+}
+
+static gboolean
+index_large_file (PlumaDocument *doc)
+{
+	if (_pluma_large_file_build_index (doc->priv->large_file,
+					   LARGE_FILE_INDEX_SLICE))
+		return TRUE;
+
+	doc->priv->large_file_idle = 0;
+
+	return FALSE;
+}
+
+/* The loader stopped after querying the info of a file too large for
+ * the buffer: map it and page in only the lines being looked at */
+static void
+large_file_loaded (PlumaDocumentLoader *loader,
+		   PlumaDocument       *doc)
+{
+	GFile *location;
+	GFileInfo *info;
+	gchar *path;
+	GError *error = NULL;
+
+	pluma_debug (DEBUG_DOCUMENT);
+
+	location = pluma_document_get_location (doc);
+	path = g_file_get_path (location);
+	g_object_unref (location);
+
+	if (path != NULL)
+	{
+		doc->priv->large_file = _pluma_large_file_new (path, &error);
+		g_free (path);
+	}
+	else
+	{
+		g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Not a local file");
+	}
+
+	if (error != NULL)
+	{
+		g_signal_emit (doc,
+			       document_signals[LOADED],
+			       0,
+			       error);
+
+		g_error_free (error);
+		reset_temp_loading_data (doc);
+
+		return;
+	}
+
+	info = pluma_document_loader_get_info (loader);
+
+	if (info != NULL)
+	{
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+			doc->priv->mtime = (gint64) g_file_info_get_attribute_uint64 (info,
+										      G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC))
+			doc->priv->mtime += g_file_info_get_attribute_uint32 (info,
+									      G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+			set_content_type (doc, g_file_info_get_attribute_string (info,
+										 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE));
+	}
+
+	/* pages cannot be saved back */
+	_pluma_document_set_readonly (doc, TRUE);
+
+	doc->priv->time_of_last_save_or_load = g_get_real_time ();
+
+	set_encoding (doc, pluma_encoding_get_utf8 (), FALSE);
+
+	large_file_show_line (doc, MAX (doc->priv->requested_line_pos - 1, 0));
+
+	g_signal_emit (doc,
+		       document_signals[LOADED],
+		       0,
+		       NULL);
+
+	reset_temp_loading_data (doc);
+
+	/* count the lines in the background */
+	doc->priv->large_file_idle = g_idle_add ((GSourceFunc) index_large_file,
+						 doc);
+}
+
+static void
+pluma_document_load_real (PlumaDocument       *doc,
+			  const gchar         *uri,
+			  const PlumaEncoding *encoding,
+			  gint                 line_pos,
+			  gboolean             create)
+{
+	g_return_if_fail (doc->priv->loader == NULL);
+
+	pluma_debug_message (DEBUG_DOCUMENT, "load_real: uri = %s", uri);
+
+	/* the file may not be that large anymore when reverting */
+	if (doc->priv->large_file_idle != 0)
+	{
+		g_source_remove (doc->priv->large_file_idle);
+		doc->priv->large_file_idle = 0;
+	}
+
+	_pluma_large_file_free (doc->priv->large_file);
+	doc->priv->large_file = NULL;
+
+	/* create a loader. It will be destroyed when loading is completed */
+	doc->priv->loader = pluma_document_loader_new (doc, uri, encoding);
+
+	g_signal_connect (doc->priv->loader,
+			  "loading",
+			  G_CALLBACK (document_loader_loading),
+			  doc);
+
+	doc->priv->create = create;
+	doc->priv->requested_encoding = encoding;
+	doc->priv->requested_line_pos = line_pos;
+
+	set_uri (doc, uri);
+	set_content_type (doc, NULL);
+
+	set_loader_viewport_hint (doc, line_pos);
+	set_loader_large_file_threshold (doc, create);
+
+	pluma_document_loader_load (doc->priv->loader);
+}
+
+/**
+ * pluma_document_load:
+ * @doc: the #PlumaDocument.
+ * @uri: the uri where to load the document from.
+ * @encoding: the #PlumaEncoding to encode the document.
+ * @line_pos: the line to show.
+ * @create: whether the document should be created if it doesn't exist.
+ *
+ * Load a document. This results in the "load" signal to be emitted.
+ */
+void
+pluma_document_load (PlumaDocument       *doc,
+		     const gchar         *uri,
+		     const PlumaEncoding *encoding,
+		     gint                 line_pos,
+		     gboolean             create)
+{
+	g_return_if_fail (PLUMA_IS_DOCUMENT (doc));
+	g_return_if_fail (uri != NULL);
+	g_return_if_fail (pluma_utils_is_valid_uri (uri));
+
+	g_signal_emit (doc, document_signals[LOAD], 0, uri, encoding, line_pos, create);
+}
+
+/**
+ * pluma_document_load_cancel:
+ * @doc: the #PlumaDocument.
+ *
+ * Cancel load of a document.
+ */
+gboolean
+pluma_document_load_cancel (PlumaDocument *doc)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+
+	if (doc->priv->loader == NULL)
+		return FALSE;
+
+	return pluma_document_loader_cancel (doc->priv->loader);
+}
+
+static void
+document_saver_saving (PlumaDocumentSaver *saver,
+		       gboolean            completed,
+		       const GError       *error,
+		       PlumaDocument      *doc)
+{
+	pluma_debug (DEBUG_DOCUMENT);
+
+	if (completed)
+	{
+		/* save was successful */
+		if (error == NULL)
+		{
+			const gchar *uri;
+			const gchar *content_type = NULL;
+			guint64 mtime = 0;
+			GFileInfo *info;
+
+			uri = pluma_document_saver_get_uri (saver);
+			set_uri (doc, uri);
+
+			info = pluma_document_saver_get_info (saver);
+
+			if (info != NULL)
+			{
+				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+					content_type = g_file_info_get_attribute_string (info,
+											 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+
+				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+					mtime = g_file_info_get_attribute_uint64 (info,
+					                                          G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+
+				if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC))
+				{
+					guint32 usec;
+
+					usec = g_file_info_get_attribute_uint32 (info,
+					                                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+					mtime += (guint64) usec;
+				}
+			}
+
+			set_content_type (doc, content_type);
+			doc->priv->mtime = (gint64) mtime;
+
+			doc->priv->time_of_last_save_or_load = g_get_real_time ();
+
+			_pluma_document_set_readonly (doc, FALSE);
+
+			gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (doc),
+						      FALSE);
+
+			set_encoding (doc,
+				      doc->priv->requested_encoding,
+				      TRUE);
+		}
+
+		g_signal_emit (doc,
+			       document_signals[SAVED],
+			       0,
+			       error);
+
+		/* the saver has been used, throw it away */
+		g_object_unref (doc->priv->saver);
+		doc->priv->saver = NULL;
+	}
+	else
+	{
+		goffset size = 0;
+		goffset written = 0;
+
+		size = pluma_document_saver_get_file_size (saver);
+		written = pluma_document_saver_get_bytes_written (saver);
+
+		pluma_debug_message (DEBUG_DOCUMENT, "save progress: %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT, written, size);
+
+		g_signal_emit (doc,
+			       document_signals[SAVING],
+			       0,
+			       written,
+			       size);
+	}
+}
+
+static void
+pluma_document_save_real (PlumaDocument          *doc,
+			  const gchar            *uri,
+			  const PlumaEncoding    *encoding,
 			  PlumaDocumentSaveFlags  flags)
 {
 	g_return_if_fail (doc->priv->saver == NULL);
 
+	/* only a page of the file is in the document */
+	if (doc->priv->large_file != NULL)
+	{
+		GError *error = NULL;
+
+		g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     _("Files opened in the large file viewer cannot be saved"));
+
+		g_signal_emit (doc,
+			       document_signals[SAVED],
+			       0,
+			       error);
+
+		g_error_free (error);
+
+		return;
+	}
+
 	/* create a saver, it will be destroyed once saving is complete */
 	doc->priv->saver = pluma_document_saver_new (doc, uri, encoding,
 						     doc->priv->newline_type,
@@ -1827,6 +2480,25 @@ pluma_document_goto_line (PlumaDocument *doc,
 
 	line_count = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
 
+	if (doc->priv->large_file != NULL && line >= 0)
+	{
+		gint64 last = line;
+		gsize line_start;
+
+		line_start = _pluma_large_file_get_line_offset (doc->priv->large_file, &last);
+
+		/* page in the start of the line unless it is already there */
+		if (line_start < doc->priv->large_file_start ||
+		    line >= doc->priv->large_file_first_line + line_count)
+		{
+			large_file_show_line (doc, line);
+
+			return last == line;
+		}
+
+		line -= doc->priv->large_file_first_line;
+	}
+
 	if (line >= line_count)
 	{
 		ret = FALSE;
@@ -1858,6 +2530,9 @@ pluma_document_goto_line_offset (PlumaDocument *doc,
 	g_return_val_if_fail (line >= -1, FALSE);
 	g_return_val_if_fail (line_offset >= -1, FALSE);
 
+	if (doc->priv->large_file != NULL)
+		return large_file_goto_line_offset (doc, line, line_offset);
+
 	gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (doc),
 					  &iter,
 					  line);
@@ -1938,8 +2613,17 @@ pluma_document_set_search_text (PlumaDocument *doc,
 		{
 			converted_text = g_strdup("");
 			notify = pluma_document_get_can_search_again (doc);
+
+			/* the search is over */
+			clear_search_snapshot (doc);
 		}
 
+		/* the old pattern is not going to be searched again */
+		if (doc->priv->search_text != NULL &&
+		    PLUMA_SEARCH_IS_MATCH_REGEX (doc->priv->search_flags) &&
+		    strcmp (doc->priv->search_text, converted_text) != 0)
+			_pluma_utils_regex_cache_remove (doc->priv->search_text);
+
 		g_free (doc->priv->search_text);
 
 		doc->priv->search_text = converted_text;
@@ -1968,6 +2652,8 @@ pluma_document_set_search_text (PlumaDocument *doc,
 		to_search_region_range (doc,
 					&begin,
 					&end);
+
+		reset_match_index (doc);
 	}
 
 	if (notify)
@@ -2029,6 +2715,244 @@ pluma_document_get_can_search_again (PlumaDocument *doc)
 	        (*doc->priv->search_text != '\0'));
 }
 
+/* Pages in the part of the large file with the match of the search
+ * text starting at @match, and sets @iter at its start */
+static void
+large_file_show_match (PlumaDocument *doc,
+		       gsize          match,
+		       GtkTextIter   *iter)
+{
+	large_file_show_offset (doc, match);
+	large_file_get_iter_at_offset (doc, match, iter);
+}
+
+/* Continues a search that reached the end (or the start if @forward is
+ * FALSE) of the page of the large file in the rest of the file, looking
+ * in the mapped bytes */
+static gboolean
+large_file_search (PlumaDocument     *doc,
+		   const GtkTextIter *start,
+		   const GtkTextIter *end,
+		   gboolean           forward,
+		   GtkTextIter       *match_start,
+		   GtkTextIter       *match_end)
+{
+	const gchar *contents;
+	const gchar *text;
+	GRegex *regex = NULL;
+	gsize overlap;
+	gsize from;
+	gsize to;
+	gsize match;
+	gsize match_stop;
+	gboolean case_sensitive;
+	gboolean found = FALSE;
+
+	if (doc->priv->large_file_searching || *doc->priv->search_text == '\0')
+		return FALSE;
+
+	contents = _pluma_large_file_get_contents (doc->priv->large_file);
+	text = doc->priv->search_text;
+	case_sensitive = PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags);
+
+	if (PLUMA_SEARCH_IS_MATCH_REGEX (doc->priv->search_flags))
+	{
+		regex = _pluma_utils_regex_cache_get (text,
+						      G_REGEX_OPTIMIZE |
+						      G_REGEX_MULTILINE |
+						      (case_sensitive ? 0 : G_REGEX_CASELESS));
+
+		if (regex == NULL)
+			return FALSE;
+
+		/* the length of the matches is not known */
+		overlap = 0;
+	}
+	else
+	{
+		overlap = strlen (text) - 1;
+	}
+
+	/* keep matches overlapping the page */
+	if ((forward && end == NULL) || (!forward && start != NULL && end == NULL))
+	{
+		/* after the page */
+		from = doc->priv->large_file_end - MIN (overlap, doc->priv->large_file_end - doc->priv->large_file_start);
+		to = _pluma_large_file_get_length (doc->priv->large_file);
+	}
+	else if (start == NULL)
+	{
+		/* before the page */
+		from = 0;
+		to = doc->priv->large_file_start + overlap;
+	}
+	else
+	{
+		if (regex != NULL)
+			g_regex_unref (regex);
+
+		return FALSE;
+	}
+
+	while (regex != NULL ?
+	       _pluma_large_file_find_regex (doc->priv->large_file,
+					     regex,
+					     from,
+					     to,
+					     !forward,
+					     &match,
+					     &match_stop) :
+	       _pluma_large_file_find (doc->priv->large_file,
+				       text,
+				       from,
+				       to,
+				       case_sensitive,
+				       !forward,
+				       &match,
+				       &match_stop))
+	{
+		GtkTextIter iter;
+
+		large_file_show_match (doc, match, &iter);
+
+		doc->priv->large_file_searching = TRUE;
+
+		if (forward)
+		{
+			found = pluma_document_search_forward (doc, &iter, NULL,
+							       match_start, match_end);
+		}
+		else
+		{
+			gtk_text_iter_forward_chars (&iter,
+						     g_utf8_strlen (contents + match, match_stop - match));
+			found = pluma_document_search_backward (doc, NULL, &iter,
+								match_start, match_end);
+		}
+
+		doc->priv->large_file_searching = FALSE;
+
+		if (found)
+			break;
+
+		/* e.g. not a whole word: look further */
+		if (forward)
+			from = match + 1;
+		else if (match_stop > match)
+			to = match_stop - 1;
+		else if (match > from)
+			to = match - 1;
+		else
+			break;
+	}
+
+	if (regex != NULL)
+		g_regex_unref (regex);
+
+	return found;
+}
+
+static void
+clear_search_snapshot (PlumaDocument *doc)
+{
+	if (doc->priv->search_snapshot_timeout != 0)
+	{
+		g_source_remove (doc->priv->search_snapshot_timeout);
+		doc->priv->search_snapshot_timeout = 0;
+	}
+
+	if (doc->priv->search_snapshot != NULL)
+	{
+		_pluma_search_snapshot_free (doc->priv->search_snapshot);
+		doc->priv->search_snapshot = NULL;
+	}
+}
+
+static gboolean
+search_snapshot_timeout (PlumaDocument *doc)
+{
+	gint64 unused;
+
+	unused = g_get_monotonic_time () - doc->priv->search_snapshot_used;
+
+	if (unused < SEARCH_SNAPSHOT_TIMEOUT * G_USEC_PER_SEC)
+		return TRUE;
+
+	pluma_debug_message (DEBUG_DOCUMENT, "Dropping the unused search snapshot");
+
+	doc->priv->search_snapshot_timeout = 0;
+	clear_search_snapshot (doc);
+
+	return FALSE;
+}
+
+/* The copy is kept as long as the searches go on, so that they do not copy
+ * the whole text again each time */
+static PlumaSearchSnapshot *
+get_search_snapshot (PlumaDocument *doc)
+{
+	if (doc->priv->search_snapshot == NULL)
+	{
+		doc->priv->search_snapshot = _pluma_search_snapshot_new (GTK_TEXT_BUFFER (doc));
+		doc->priv->search_snapshot_timeout =
+			g_timeout_add_seconds (SEARCH_SNAPSHOT_TIMEOUT,
+					       (GSourceFunc) search_snapshot_timeout,
+					       doc);
+	}
+
+	doc->priv->search_snapshot_used = g_get_monotonic_time ();
+
+	return doc->priv->search_snapshot;
+}
+
+/* Taking the copy over keeps it from being dropped, the caller frees it */
+static PlumaSearchSnapshot *
+steal_search_snapshot (PlumaDocument *doc)
+{
+	PlumaSearchSnapshot *snapshot;
+
+	snapshot = doc->priv->search_snapshot;
+	doc->priv->search_snapshot = NULL;
+	clear_search_snapshot (doc);
+
+	if (snapshot == NULL)
+		snapshot = _pluma_search_snapshot_new (GTK_TEXT_BUFFER (doc));
+
+	return snapshot;
+}
+
+/* Literal searches run on the copy of the text kept for the regex ones,
+ * instead of comparing the text through iters one character at a time */
+static gboolean
+literal_search (PlumaDocument      *doc,
+		const GtkTextIter  *iter,
+		const GtkTextIter  *limit,
+		gboolean            forward,
+		GtkTextSearchFlags  search_flags,
+		GtkTextIter        *match_start,
+		GtkTextIter        *match_end)
+{
+	if (*doc->priv->search_text == '\0')
+	{
+		if (forward)
+			return gtk_text_iter_forward_search (iter, "", search_flags,
+							     match_start, match_end, limit);
+		else
+			return gtk_text_iter_backward_search (iter, "", search_flags,
+							      match_start, match_end, limit);
+	}
+
+	return _pluma_search_snapshot_find (get_search_snapshot (doc),
+					    GTK_TEXT_BUFFER (doc),
+					    doc->priv->search_text,
+					    PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags),
+					    iter,
+					    limit,
+					    forward,
+					    match_start,
+					    match_end);
+}
+
 /**
  * pluma_document_search_forward:
  * @doc:
@@ -2080,12 +3004,13 @@ pluma_document_search_forward (PlumaDocument     *doc,
 	{
 		if(!PLUMA_SEARCH_IS_MATCH_REGEX(doc->priv->search_flags))
 		{
-			found = gtk_text_iter_forward_search (&iter,
-							      doc->priv->search_text,
-							      search_flags,
-							      &m_start,
-							      &m_end,
-							      end);
+			found = literal_search (doc,
+						&iter,
+						end,
+						TRUE,
+						search_flags,
+						&m_start,
+						&m_end);
 		} else {
 			found = pluma_gtk_text_iter_regex_search (&iter,
 								  doc->priv->search_text,
@@ -2109,6 +3034,9 @@ pluma_document_search_forward (PlumaDocument     *doc,
 			break;
 	}
 
+	if (!found && doc->priv->large_file != NULL)
+		return large_file_search (doc, start, end, TRUE, match_start, match_end);
+
 	if (found && (match_start != NULL))
 		*match_start = m_start;
 
@@ -2169,12 +3097,13 @@ pluma_document_search_backward (PlumaDocument     *doc,
 	{
 		if(!PLUMA_SEARCH_IS_MATCH_REGEX(doc->priv->search_flags))
 		{
-			found = gtk_text_iter_backward_search (&iter,
-							       doc->priv->search_text,
-							       search_flags,
-							       &m_start,
-							       &m_end,
-							       start);
+			found = literal_search (doc,
+						&iter,
+						start,
+						FALSE,
+						search_flags,
+						&m_start,
+						&m_end);
 		}
 		else
 		{
@@ -2200,6 +3129,9 @@ pluma_document_search_backward (PlumaDocument     *doc,
 			break;
 	}
 
+	if (!found && doc->priv->large_file != NULL)
+		return large_file_search (doc, start, end, FALSE, match_start, match_end);
+
 	if (found && (match_start != NULL))
 		*match_start = m_start;
 
@@ -2209,6 +3141,129 @@ pluma_document_search_backward (PlumaDocument     *doc,
 	return found;
 }
 
+typedef struct
+{
+	gint   start;
+	gint   end;
+	gchar *text;
+} ReplaceEdit;
+
+static gboolean
+snapshot_range_is_word (PlumaDocument       *doc,
+			PlumaSearchSnapshot *snapshot,
+			gint                 start,
+			gint                 end)
+{
+	GtkTextIter m_start;
+	GtkTextIter m_end;
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc),
+					    &m_start,
+					    _pluma_search_snapshot_get_buffer_offset (snapshot, start, FALSE));
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc),
+					    &m_end,
+					    _pluma_search_snapshot_get_buffer_offset (snapshot, end, end > start));
+
+	return gtk_text_iter_starts_word (&m_start) &&
+	       gtk_text_iter_ends_word (&m_end);
+}
+
+static void
+push_replace_edit (PlumaDocument       *doc,
+		   PlumaSearchSnapshot *snapshot,
+		   GArray              *edits,
+		   gint                 start,
+		   gint                 end,
+		   GString             *text)
+{
+	ReplaceEdit edit;
+
+	/* buffer offsets, the snapshot does not survive the first edit */
+	edit.start = _pluma_search_snapshot_get_buffer_offset (snapshot, start, FALSE);
+	edit.end = _pluma_search_snapshot_get_buffer_offset (snapshot, end, end > start);
+	edit.text = g_string_free (text, FALSE);
+
+	g_array_append_val (edits, edit);
+}
+
+/* Finds all the matches of @regex in the snapshot and returns the edits
+ * replacing them. Only the matches touching each other are merged in one
+ * edit, so that the text between the others keeps its marks and tags. */
+static GArray *
+get_replace_edits (PlumaDocument       *doc,
+		   PlumaSearchSnapshot *snapshot,
+		   GRegex              *regex,
+		   const gchar         *replace,
+		   gboolean             expand_references,
+		   gboolean             entire_word,
+		   gint                *n_replaced)
+{
+	const gchar *text;
+	GMatchInfo *match_info;
+	GArray *edits;
+	GString *edit_text = NULL;
+	gint edit_start = 0;
+	gint edit_end = 0;
+
+	text = _pluma_search_snapshot_get_text (snapshot);
+	edits = g_array_new (FALSE, FALSE, sizeof (ReplaceEdit));
+	*n_replaced = 0;
+
+	g_regex_match_full (regex,
+			    text,
+			    _pluma_search_snapshot_get_length (snapshot),
+			    0,
+			    0,
+			    &match_info,
+			    NULL);
+
+	for (; g_match_info_matches (match_info); g_match_info_next (match_info, NULL))
+	{
+		gint start;
+		gint end;
+
+		g_match_info_fetch_pos (match_info, 0, &start, &end);
+
+		if (entire_word && !snapshot_range_is_word (doc, snapshot, start, end))
+			continue;
+
+		/* not across hidden text either */
+		if (edit_text == NULL || start != edit_end ||
+		    _pluma_search_snapshot_get_buffer_offset (snapshot, start, FALSE) !=
+		    _pluma_search_snapshot_get_buffer_offset (snapshot, edit_end, TRUE))
+		{
+			if (edit_text != NULL)
+				push_replace_edit (doc, snapshot, edits, edit_start, edit_end, edit_text);
+
+			edit_text = g_string_new (NULL);
+			edit_start = start;
+		}
+
+		if (expand_references)
+		{
+			gchar *expanded;
+
+			expanded = g_match_info_expand_references (match_info, replace, NULL);
+			g_string_append (edit_text, expanded);
+			g_free (expanded);
+		}
+		else
+		{
+			g_string_append (edit_text, replace);
+		}
+
+		edit_end = end;
+		++(*n_replaced);
+	}
+
+	if (edit_text != NULL)
+		push_replace_edit (doc, snapshot, edits, edit_start, edit_end, edit_text);
+
+	g_match_info_free (match_info);
+
+	return edits;
+}
+
 /* FIXME this is an issue for introspection regardning @find */
 gint
 pluma_document_replace_all (PlumaDocument       *doc,
@@ -2216,45 +3271,92 @@ pluma_document_replace_all (PlumaDocument       *doc,
 			    const gchar         *replace,
 			    guint                flags)
 {
-	GtkTextIter iter;
-	GtkTextIter m_start;
-	GtkTextIter m_end;
-	GtkTextSearchFlags search_flags = 0;
-	gboolean found = TRUE;
+	GRegex *regex;
+	GRegexCompileFlags compile_flags;
+	PlumaSearchSnapshot *snapshot;
+	GArray *edits;
 	gint cont = 0;
 	gchar *search_text;
-	gchar *replace_text = NULL;
-	gint replace_text_len = 0;
+	gchar *replace_text;
 	GtkTextBuffer *buffer;
 	gboolean brackets_highlighting;
 	gboolean search_highliting;
+	gint64 started;
+	guint i;
 
 	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), 0);
 	g_return_val_if_fail (replace != NULL, 0);
 	g_return_val_if_fail ((find != NULL) || (doc->priv->search_text != NULL), 0);
 
 	buffer = GTK_TEXT_BUFFER (doc);
+	started = g_get_monotonic_time ();
 
 	if (find == NULL)
 		search_text = g_strdup (doc->priv->search_text);
 	else
 		search_text = pluma_utils_unescape_search_text (find);
 
-	if(!PLUMA_SEARCH_IS_MATCH_REGEX(flags))
+	/* plain text is searched as an escaped regex, so that all the matches
+	 * can be found in one pass over the same snapshot */
+	compile_flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+
+	if (!PLUMA_SEARCH_IS_CASE_SENSITIVE (flags))
+		compile_flags |= G_REGEX_CASELESS;
+
+	if (PLUMA_SEARCH_IS_MATCH_REGEX (flags))
 	{
-		replace_text = pluma_utils_unescape_search_text (replace);
-		replace_text_len = strlen (replace_text);
+		regex = _pluma_utils_regex_cache_get (search_text, compile_flags);
+		replace_text = g_strdup (replace);
+
+		if (regex != NULL && !g_regex_check_replacement (replace_text, NULL, NULL))
+		{
+			g_regex_unref (regex);
+			regex = NULL;
+		}
 	}
+	else
+	{
+		gchar *pattern;
 
-	gtk_text_buffer_get_start_iter (buffer, &iter);
+		pattern = g_regex_escape_string (search_text, -1);
+		regex = _pluma_utils_regex_cache_get (pattern, compile_flags);
+		replace_text = pluma_utils_unescape_search_text (replace);
 
-	search_flags = GTK_TEXT_SEARCH_VISIBLE_ONLY | GTK_TEXT_SEARCH_TEXT_ONLY;
+		g_free (pattern);
+	}
 
-	if (!PLUMA_SEARCH_IS_CASE_SENSITIVE (flags))
+	if (regex == NULL || *search_text == '\0')
 	{
-		search_flags = search_flags | GTK_TEXT_SEARCH_CASE_INSENSITIVE;
+		if (regex != NULL)
+			g_regex_unref (regex);
+
+		g_free (search_text);
+		g_free (replace_text);
+		return 0;
 	}
 
+	g_free (search_text);
+
+	/* the edits would drop the snapshot */
+	snapshot = steal_search_snapshot (doc);
+
+	edits = get_replace_edits (doc,
+				   snapshot,
+				   regex,
+				   replace_text,
+				   PLUMA_SEARCH_IS_MATCH_REGEX (flags),
+				   PLUMA_SEARCH_IS_ENTIRE_WORD (flags),
+				   &cont);
+
+	_pluma_search_snapshot_free (snapshot);
+	g_regex_unref (regex);
+	g_free (replace_text);
+
+	if (edits->len == 0)
+	{
+		g_array_free (edits, TRUE);
+		return 0;
+	}
 
 	/* disable cursor_moved emission until the end of the
 	 * replace_all so that we don't spend all the time
@@ -2272,62 +3374,31 @@ pluma_document_replace_all (PlumaDocument       *doc,
 
 	gtk_text_buffer_begin_user_action (buffer);
 
-	do
+	/* from the end, so that the offsets of the edits left stay valid */
+	for (i = edits->len; i > 0; i--)
 	{
-		if(!PLUMA_SEARCH_IS_MATCH_REGEX(flags))
-		{
-			found = gtk_text_iter_forward_search (&iter,
-							      search_text,
-							      search_flags,
-							      &m_start,
-							      &m_end,
-							      NULL);
-		} else {
-			g_free (replace_text);
-			replace_text = g_strdup (replace);
-			found = pluma_gtk_text_iter_regex_search (&iter,
-							          search_text,
-							          search_flags,
-							          &m_start,
-							          &m_end,
-							          NULL,
-							          TRUE,
-							          &replace_text);
-			replace_text_len = strlen (replace_text);
-		}
-
-		if (found && PLUMA_SEARCH_IS_ENTIRE_WORD (flags))
-		{
-			gboolean word;
-
-			word = gtk_text_iter_starts_word (&m_start) &&
-			       gtk_text_iter_ends_word (&m_end);
+		ReplaceEdit *edit = &g_array_index (edits, ReplaceEdit, i - 1);
+		GtkTextIter m_start;
+		GtkTextIter m_end;
 
-			if (!word)
-			{
-				iter = m_end;
-				continue;
-			}
-		}
+		gtk_text_buffer_get_iter_at_offset (buffer, &m_start, edit->start);
+		gtk_text_buffer_get_iter_at_offset (buffer, &m_end, edit->end);
 
-		if (found)
-		{
-			++cont;
+		gtk_text_buffer_delete (buffer, &m_start, &m_end);
+		gtk_text_buffer_insert (buffer, &m_start, edit->text, -1);
 
-			gtk_text_buffer_delete (buffer,
-						&m_start,
-						&m_end);
-			gtk_text_buffer_insert (buffer,
-						&m_start,
-						replace_text,
-						replace_text_len);
+		g_free (edit->text);
+	}
 
-			iter = m_start;
-        }
+	gtk_text_buffer_end_user_action (buffer);
 
-	} while (found);
+	pluma_debug_message (DEBUG_SEARCH,
+			     "replaced %d matches with %u edits in %" G_GINT64_FORMAT " ms",
+			     cont,
+			     edits->len,
+			     (g_get_monotonic_time () - started) / 1000);
 
-	gtk_text_buffer_end_user_action (buffer);
+	g_array_free (edits, TRUE);
 
 	/* re-enable cursor_moved emission and notify
 	 * the current position
@@ -2339,9 +3410,6 @@ pluma_document_replace_all (PlumaDocument       *doc,
 							   brackets_highlighting);
 	pluma_document_set_enable_search_highlighting (doc, search_highliting);
 
-	g_free (search_text);
-	g_free (replace_text);
-
 	return cont;
 }
 
@@ -2500,8 +3568,8 @@ search_region (PlumaDocument *doc,
 	GtkTextIter iter;
 	GtkTextIter m_start;
 	GtkTextIter m_end;
-	GtkTextSearchFlags search_flags = 0;
-	gboolean found = TRUE;
+	PlumaSearchSnapshot *snapshot;
+	gboolean case_sensitive;
 
 	GtkTextBuffer *buffer;
 
@@ -2558,30 +3626,29 @@ search_region (PlumaDocument *doc,
 	if (*doc->priv->search_text == '\0')
 		return;
 
-	iter = *start;
+	/* use the copy of the whole text if there is one, otherwise copying
+	 * the region is enough */
+	snapshot = doc->priv->search_snapshot;
 
-	search_flags = GTK_TEXT_SEARCH_VISIBLE_ONLY | GTK_TEXT_SEARCH_TEXT_ONLY;
+	if (snapshot == NULL)
+		snapshot = _pluma_search_snapshot_new_for_range (buffer, start, end);
 
-	if (!PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags))
-	{
-		search_flags = search_flags | GTK_TEXT_SEARCH_CASE_INSENSITIVE;
-	}
+	case_sensitive = PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags);
+	iter = *start;
 
-	do
+	while (_pluma_search_snapshot_find (snapshot,
+					    buffer,
+					    doc->priv->search_text,
+					    case_sensitive,
+					    &iter,
+					    end,
+					    TRUE,
+					    &m_start,
+					    &m_end))
 	{
-		if ((end != NULL) && gtk_text_iter_is_end (end))
-			end = NULL;
-
-		found = gtk_text_iter_forward_search (&iter,
-							doc->priv->search_text,
-							search_flags,
-                        	                	&m_start,
-                        	                	&m_end,
-                                	               	end);
-
 		iter = m_end;
 
-		if (found && PLUMA_SEARCH_IS_ENTIRE_WORD (doc->priv->search_flags))
+		if (PLUMA_SEARCH_IS_ENTIRE_WORD (doc->priv->search_flags))
 		{
 			gboolean word;
 
@@ -2592,15 +3659,14 @@ search_region (PlumaDocument *doc,
 				continue;
 		}
 
-		if (found)
-		{
-			gtk_text_buffer_apply_tag (buffer,
-						   doc->priv->found_tag,
-						   &m_start,
-						   &m_end);
-		}
+		gtk_text_buffer_apply_tag (buffer,
+					   doc->priv->found_tag,
+					   &m_start,
+					   &m_end);
+	}
 
-	} while (found);
+	if (snapshot != doc->priv->search_snapshot)
+		_pluma_search_snapshot_free (snapshot);
 }
 
 static void
@@ -2631,6 +3697,113 @@ to_search_region_range (PlumaDocument *doc,
 	g_signal_emit (doc, document_signals [SEARCH_HIGHLIGHT_UPDATED], 0, start, end);
 }
 
+/* Highlights the next chunk of the parts shown in a view left to search.
+ * Returns FALSE if there is nothing left to highlight there. */
+static gboolean
+search_next_chunk (PlumaDocument *doc)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	GtkTextIter chunk_end;
+	GtkTextIter start_search;
+	GtkTextIter end_search;
+	gboolean found = FALSE;
+	gint n;
+	gint i;
+
+	n = pluma_text_region_subregions (doc->priv->visible_search_region);
+
+	for (i = 0; i < n && !found; i++)
+	{
+		PlumaTextRegion *region;
+
+		pluma_text_region_nth_subregion (doc->priv->visible_search_region,
+						 i,
+						 &start,
+						 &end);
+
+		region = pluma_text_region_intersect (doc->priv->to_search_region,
+						      &start,
+						      &end);
+
+		if (region != NULL)
+		{
+			found = pluma_text_region_nth_subregion (region, 0, &start, &end);
+			pluma_text_region_destroy (region, TRUE);
+		}
+	}
+
+	if (!found)
+	{
+		/* what is shown is already highlighted */
+		if (n > 0)
+		{
+			pluma_text_region_destroy (doc->priv->visible_search_region, TRUE);
+			doc->priv->visible_search_region = pluma_text_region_new (GTK_TEXT_BUFFER (doc));
+		}
+
+		return FALSE;
+	}
+
+	chunk_end = start;
+	gtk_text_iter_forward_lines (&chunk_end, SEARCH_HIGHLIGHT_CHUNK_LINES);
+
+	if (gtk_text_iter_compare (&chunk_end, &end) > 0)
+		chunk_end = end;
+
+	start_search = start;
+	end_search = chunk_end;
+
+	search_region (doc, &start_search, &end_search);
+
+	/* remove the just highlighted region */
+	pluma_text_region_subtract (doc->priv->to_search_region,
+				    &start,
+				    &chunk_end);
+	pluma_text_region_subtract (doc->priv->visible_search_region,
+				    &start,
+				    &chunk_end);
+
+	return TRUE;
+}
+
+static gboolean
+search_highlight_idle (PlumaDocument *doc)
+{
+	gint64 deadline;
+
+	deadline = g_get_monotonic_time () + SEARCH_HIGHLIGHT_BUDGET;
+
+	do
+	{
+		if (!search_next_chunk (doc))
+		{
+			doc->priv->search_idle = 0;
+			return FALSE;
+		}
+	}
+	while (g_get_monotonic_time () < deadline);
+
+	return TRUE;
+}
+
+static void
+schedule_search_highlight (PlumaDocument *doc)
+{
+	if (doc->priv->search_idle != 0)
+		return;
+
+	/* before the next frame is drawn */
+	doc->priv->search_idle = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+						  (GSourceFunc) search_highlight_idle,
+						  doc,
+						  NULL);
+}
+
+/* Called by the views with the lines they show: the matches in there,
+ * and in a few lines around them, are highlighted from an idle so that
+ * a short search text in a big document does not stall the drawing. The
+ * rest of the document is left until it is shown. */
 void
 _pluma_document_search_region (PlumaDocument     *doc,
 			       const GtkTextIter *start,
@@ -2647,43 +3820,411 @@ _pluma_document_search_region (PlumaDocument     *doc,
 	if (doc->priv->to_search_region == NULL)
 		return;
 
-	/*
-	g_print ("U [%u (%u), %u (%u)]\n", gtk_text_iter_get_line (start), gtk_text_iter_get_offset (start),
-					   gtk_text_iter_get_line (end), gtk_text_iter_get_offset (end));
-	*/
-
 	/* get the subregions not yet highlighted */
 	region = pluma_text_region_intersect (doc->priv->to_search_region,
 					      start,
 					      end);
 	if (region)
 	{
-		gint i;
-		GtkTextIter start_search;
-		GtkTextIter end_search;
+		GtkTextIter visible_start = *start;
+		GtkTextIter visible_end = *end;
 
-		i = pluma_text_region_subregions (region);
-		pluma_text_region_nth_subregion (region,
-						 0,
-						 &start_search,
-						 NULL);
+		pluma_text_region_destroy (region, TRUE);
 
-		pluma_text_region_nth_subregion (region,
-						 i - 1,
-						 NULL,
-						 &end_search);
+		/* ready for some scrolling */
+		gtk_text_iter_backward_lines (&visible_start, SEARCH_HIGHLIGHT_MARGIN_LINES);
+		gtk_text_iter_forward_lines (&visible_end, SEARCH_HIGHLIGHT_MARGIN_LINES);
 
-		pluma_text_region_destroy (region, TRUE);
+		pluma_text_region_add (doc->priv->visible_search_region,
+				       &visible_start,
+				       &visible_end);
+
+		schedule_search_highlight (doc);
+	}
+}
+
+/* Regex searches run on the copy of the text kept by get_search_snapshot() */
+gboolean
+_pluma_document_regex_search (PlumaDocument     *doc,
+			      GRegex            *regex,
+			      const GtkTextIter *iter,
+			      const GtkTextIter *limit,
+			      gboolean           forward,
+			      GtkTextIter       *match_start,
+			      GtkTextIter       *match_end,
+			      gchar            **replace_text)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+	g_return_val_if_fail (regex != NULL, FALSE);
+
+	return _pluma_search_snapshot_regex_search (get_search_snapshot (doc),
+						    GTK_TEXT_BUFFER (doc),
+						    regex,
+						    iter,
+						    limit,
+						    forward,
+						    match_start,
+						    match_end,
+						    replace_text);
+}
+
+static gboolean
+next_match_in_snapshot (PlumaDocument       *doc,
+			PlumaSearchSnapshot *snapshot,
+			GRegex              *regex,
+			const GtkTextIter   *iter,
+			const GtkTextIter   *limit,
+			GtkTextIter         *match_start,
+			GtkTextIter         *match_end)
+{
+	if (regex != NULL)
+		return _pluma_search_snapshot_regex_search (snapshot,
+							    GTK_TEXT_BUFFER (doc),
+							    regex,
+							    iter,
+							    limit,
+							    TRUE,
+							    match_start,
+							    match_end,
+							    NULL);
+
+	return _pluma_search_snapshot_find (snapshot,
+					    GTK_TEXT_BUFFER (doc),
+					    doc->priv->search_text,
+					    PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags),
+					    iter,
+					    limit,
+					    TRUE,
+					    match_start,
+					    match_end);
+}
+
+/* Indexes the matches starting between @start and @end, which must be at
+ * the start of a line. The text after @end is searched too for the
+ * matches which go past it. */
+static void
+index_matches (PlumaDocument     *doc,
+	       const GtkTextIter *start,
+	       const GtkTextIter *end)
+{
+	PlumaSearchSnapshot *snapshot;
+	GRegex *regex = NULL;
+	GtkTextIter iter;
+	GtkTextIter limit;
+	GtkTextIter m_start;
+	GtkTextIter m_end;
+	gint start_offset;
+	gint end_offset;
+	gint last_end = -1;
+	gint prev;
+
+	start_offset = gtk_text_iter_get_offset (start);
+	end_offset = gtk_text_iter_get_offset (end);
+
+	_pluma_match_index_remove (doc->priv->match_index, start_offset, end_offset);
+
+	if (doc->priv->search_text == NULL || *doc->priv->search_text == '\0')
+		return;
+
+	if (PLUMA_SEARCH_IS_MATCH_REGEX (doc->priv->search_flags))
+	{
+		GRegexCompileFlags compile_flags;
+
+		compile_flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+
+		if (!PLUMA_SEARCH_IS_CASE_SENSITIVE (doc->priv->search_flags))
+			compile_flags |= G_REGEX_CASELESS;
+
+		regex = _pluma_utils_regex_cache_get (doc->priv->search_text, compile_flags);
+
+		if (regex == NULL)
+			return;
+	}
+
+	/* do not find again the end of a match starting before */
+	iter = *start;
+	prev = _pluma_match_index_find (doc->priv->match_index, start_offset, FALSE);
+
+	if (prev >= 0)
+	{
+		gint prev_end;
+
+		_pluma_match_index_get_nth (doc->priv->match_index, prev, NULL, &prev_end);
+
+		if (prev_end > start_offset)
+			gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, prev_end);
+	}
+
+	limit = *end;
+	gtk_text_iter_forward_lines (&limit, doc->priv->num_of_lines_search_text);
+
+	snapshot = doc->priv->search_snapshot;
+
+	if (snapshot == NULL)
+	{
+		GtkTextIter context;
+
+		/* the lines before the chunk are copied too, for lookbehinds
+		 * and anchors to see them: the search itself starts at iter */
+		context = *start;
+		gtk_text_iter_backward_lines (&context, doc->priv->num_of_lines_search_text + 1);
+
+		snapshot = _pluma_search_snapshot_new_for_range (GTK_TEXT_BUFFER (doc), &context, &limit);
+	}
+
+	while (gtk_text_iter_compare (&iter, end) < 0 &&
+	       next_match_in_snapshot (doc, snapshot, regex, &iter, &limit, &m_start, &m_end))
+	{
+		gint m_start_offset;
+		gint m_end_offset;
+
+		m_start_offset = gtk_text_iter_get_offset (&m_start);
+		m_end_offset = gtk_text_iter_get_offset (&m_end);
+
+		if (m_start_offset >= end_offset)
+			break;
+
+		iter = m_end;
+
+		/* an empty match would be found again */
+		if (m_start_offset == m_end_offset && !gtk_text_iter_forward_char (&iter))
+			iter = *end;
 
-		gtk_text_iter_order (&start_search, &end_search);
+		if (PLUMA_SEARCH_IS_ENTIRE_WORD (doc->priv->search_flags) &&
+		    !(gtk_text_iter_starts_word (&m_start) && gtk_text_iter_ends_word (&m_end)))
+			continue;
 
-		search_region (doc, &start_search, &end_search);
+		_pluma_match_index_add (doc->priv->match_index, m_start_offset, m_end_offset);
+		last_end = m_end_offset;
+	}
+
+	/* the matches after the chunk overlapping the last one are not */
+	if (last_end > end_offset)
+		_pluma_match_index_remove (doc->priv->match_index, end_offset, last_end);
+
+	if (snapshot != doc->priv->search_snapshot)
+		_pluma_search_snapshot_free (snapshot);
+
+	if (regex != NULL)
+		g_regex_unref (regex);
+}
+
+static gboolean
+match_index_idle (PlumaDocument *doc)
+{
+	gint64 deadline;
+	gboolean more = TRUE;
+
+	deadline = g_get_monotonic_time () + SEARCH_HIGHLIGHT_BUDGET;
+
+	do
+	{
+		GtkTextIter start;
+		GtkTextIter end;
+		GtkTextIter chunk_end;
+
+		if (!pluma_text_region_nth_subregion (doc->priv->to_index_region, 0, &start, &end))
+		{
+			more = FALSE;
+			break;
+		}
+
+		chunk_end = start;
+		gtk_text_iter_forward_lines (&chunk_end, MATCH_INDEX_CHUNK_LINES);
+
+		if (gtk_text_iter_compare (&chunk_end, &end) > 0)
+			chunk_end = end;
+
+		index_matches (doc, &start, &chunk_end);
+
+		pluma_text_region_subtract (doc->priv->to_index_region,
+					    &start,
+					    &chunk_end);
+	}
+	while (g_get_monotonic_time () < deadline);
+
+	if (!more)
+	{
+		/* empty subregions left behind by deletions */
+		pluma_text_region_destroy (doc->priv->to_index_region, TRUE);
+		doc->priv->to_index_region = pluma_text_region_new (GTK_TEXT_BUFFER (doc));
+
+		doc->priv->match_index_idle = 0;
+	}
+
+	g_signal_emit (doc, document_signals[MATCH_INDEX_UPDATED], 0);
+
+	return more;
+}
+
+static void
+schedule_match_index (PlumaDocument *doc)
+{
+	if (doc->priv->match_index_idle != 0)
+		return;
+
+	doc->priv->match_index_idle = g_idle_add ((GSourceFunc) match_index_idle, doc);
+}
+
+/* Marks the lines around @start and @end to be indexed again */
+static void
+to_index_region_range (PlumaDocument     *doc,
+		       const GtkTextIter *start,
+		       const GtkTextIter *end)
+{
+	GtkTextIter i_start = *start;
+	GtkTextIter i_end = *end;
+
+	/* the matches can go over a few lines */
+	gtk_text_iter_backward_lines (&i_start, MAX (doc->priv->num_of_lines_search_text - 1, 0));
+	gtk_text_iter_set_line_offset (&i_start, 0);
+
+	if (!gtk_text_iter_ends_line (&i_end))
+		gtk_text_iter_forward_to_line_end (&i_end);
+
+	gtk_text_iter_forward_line (&i_end);
+
+	pluma_text_region_add (doc->priv->to_index_region, &i_start, &i_end);
+
+	schedule_match_index (doc);
+}
+
+static void
+reset_match_index (PlumaDocument *doc)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+
+	if (doc->priv->match_index == NULL)
+		return;
+
+	_pluma_match_index_clear (doc->priv->match_index);
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	to_index_region_range (doc, &start, &end);
+
+	g_signal_emit (doc, document_signals[MATCH_INDEX_UPDATED], 0);
+}
+
+/* While at least one caller wants the matches of the search text to be
+ * indexed, they are searched from an idle and kept up to date with the
+ * changes of the text, and "match-index-updated" is emitted as the index
+ * grows. */
+void
+_pluma_document_set_index_matches (PlumaDocument *doc,
+				   gboolean       index)
+{
+	g_return_if_fail (PLUMA_IS_DOCUMENT (doc));
+
+	if (index)
+	{
+		if (doc->priv->match_index_users++ > 0)
+			return;
+
+		doc->priv->match_index = _pluma_match_index_new ();
+		doc->priv->to_index_region = pluma_text_region_new (GTK_TEXT_BUFFER (doc));
+
+		reset_match_index (doc);
+	}
+	else
+	{
+		g_return_if_fail (doc->priv->match_index_users > 0);
+
+		if (--doc->priv->match_index_users > 0)
+			return;
+
+		if (doc->priv->match_index_idle != 0)
+		{
+			g_source_remove (doc->priv->match_index_idle);
+			doc->priv->match_index_idle = 0;
+		}
+
+		pluma_text_region_destroy (doc->priv->to_index_region, TRUE);
+		doc->priv->to_index_region = NULL;
+
+		_pluma_match_index_free (doc->priv->match_index);
+		doc->priv->match_index = NULL;
+	}
+}
+
+/* Returns the number of matches indexed so far; *@complete is set to
+ * FALSE if the index is still being built */
+gint
+_pluma_document_get_n_matches (PlumaDocument *doc,
+			       gboolean      *complete)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), 0);
 
-		/* remove the just highlighted region */
-		pluma_text_region_subtract (doc->priv->to_search_region,
-					    start,
-					    end);
+	if (doc->priv->match_index == NULL)
+	{
+		if (complete != NULL)
+			*complete = FALSE;
+
+		return 0;
 	}
+
+	if (complete != NULL)
+		*complete = (doc->priv->match_index_idle == 0);
+
+	return _pluma_match_index_get_n_matches (doc->priv->match_index);
+}
+
+/* Returns the number of the match starting at @match_start, counting
+ * from 0, or -1 if there is no such match in the index */
+gint
+_pluma_document_get_match_number (PlumaDocument     *doc,
+				  const GtkTextIter *match_start)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), -1);
+	g_return_val_if_fail (match_start != NULL, -1);
+
+	if (doc->priv->match_index == NULL)
+		return -1;
+
+	return _pluma_match_index_lookup (doc->priv->match_index,
+					  gtk_text_iter_get_offset (match_start));
+}
+
+/* Returns the number of the first match starting at or after @iter, or of
+ * the last one starting before it if @forward is FALSE, or -1 */
+gint
+_pluma_document_find_match (PlumaDocument     *doc,
+			    const GtkTextIter *iter,
+			    gboolean           forward)
+{
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), -1);
+	g_return_val_if_fail (iter != NULL, -1);
+
+	if (doc->priv->match_index == NULL)
+		return -1;
+
+	return _pluma_match_index_find (doc->priv->match_index,
+					gtk_text_iter_get_offset (iter),
+					forward);
+}
+
+gboolean
+_pluma_document_get_nth_match (PlumaDocument *doc,
+			       gint           n,
+			       GtkTextIter   *match_start,
+			       GtkTextIter   *match_end)
+{
+	gint start;
+	gint end;
+
+	g_return_val_if_fail (PLUMA_IS_DOCUMENT (doc), FALSE);
+
+	if (doc->priv->match_index == NULL ||
+	    !_pluma_match_index_get_nth (doc->priv->match_index, n, &start, &end))
+		return FALSE;
+
+	if (match_start != NULL)
+		gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), match_start, start);
+
+	if (match_end != NULL)
+		gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), match_end, end);
+
+	return TRUE;
 }
 
 static void
@@ -2708,6 +4249,16 @@ insert_text_cb (PlumaDocument *doc,
 	gtk_text_iter_backward_chars (&start,
 				      g_utf8_strlen (text, length));
 
+	if (doc->priv->match_index != NULL)
+	{
+		_pluma_match_index_text_inserted (doc->priv->match_index,
+						  gtk_text_iter_get_offset (&start),
+						  gtk_text_iter_get_offset (&end) -
+						  gtk_text_iter_get_offset (&start));
+
+		to_index_region_range (doc, &start, &end);
+	}
+
 	to_search_region_range (doc, &start, &end);
 }
 
@@ -2724,9 +4275,27 @@ delete_range_cb (PlumaDocument *doc,
 	d_start = *start;
 	d_end = *end;
 
+	if (doc->priv->match_index != NULL)
+		to_index_region_range (doc, &d_start, &d_end);
+
 	to_search_region_range (doc, &d_start, &d_end);
 }
 
+/* The offsets of the deleted text are only known before the deletion */
+static void
+delete_range_before_cb (PlumaDocument *doc,
+			GtkTextIter   *start,
+			GtkTextIter   *end)
+{
+	if (doc->priv->match_index == NULL)
+		return;
+
+	_pluma_match_index_text_deleted (doc->priv->match_index,
+					 gtk_text_iter_get_offset (start),
+					 gtk_text_iter_get_offset (end) -
+					 gtk_text_iter_get_offset (start));
+}
+
 void
 pluma_document_set_enable_search_highlighting (PlumaDocument *doc,
 					       gboolean       enable)
@@ -2738,6 +4307,12 @@ pluma_document_set_enable_search_highlighting (PlumaDocument *doc,
 	if ((doc->priv->to_search_region != NULL) == enable)
 		return;
 
+	if (doc->priv->search_idle != 0)
+	{
+		g_source_remove (doc->priv->search_idle);
+		doc->priv->search_idle = 0;
+	}
+
 	if (doc->priv->to_search_region != NULL)
 	{
 		/* Disable search highlighting */
@@ -2760,10 +4335,15 @@ pluma_document_set_enable_search_highlighting (PlumaDocument *doc,
 		pluma_text_region_destroy (doc->priv->to_search_region,
 					   TRUE);
 		doc->priv->to_search_region = NULL;
+
+		pluma_text_region_destroy (doc->priv->visible_search_region,
+					   TRUE);
+		doc->priv->visible_search_region = NULL;
 	}
 	else
 	{
 		doc->priv->to_search_region = pluma_text_region_new (GTK_TEXT_BUFFER (doc));
+		doc->priv->visible_search_region = pluma_text_region_new (GTK_TEXT_BUFFER (doc));
 		if (pluma_document_get_can_search_again (doc))
 		{
 			/* If search_text is not empty, highligth all its occurrences */
@@ -301,6 +301,23 @@ void		 _pluma_document_set_readonly 	(PlumaDocument       *doc,
 glong		 _pluma_document_get_seconds_since_last_save_or_load
 						(PlumaDocument       *doc);
 
+gboolean	_pluma_document_get_viewport_loaded
+						(PlumaDocument       *doc);
+
+gboolean	_pluma_document_is_large_file	(PlumaDocument       *doc);
+
+gint64		_pluma_document_get_first_line	(PlumaDocument       *doc);
+
+gboolean	_pluma_document_large_file_at_start
+						(PlumaDocument       *doc);
+
+gboolean	_pluma_document_large_file_at_end
+						(PlumaDocument       *doc);
+
+void		_pluma_document_large_file_show_iter
+						(PlumaDocument       *doc,
+						 const GtkTextIter   *iter);
+
 /* Note: this is a sync stat: use only on local files */
 gboolean	_pluma_document_check_externally_modified
 						(PlumaDocument       *doc);
@@ -309,6 +326,35 @@ void		_pluma_document_search_region   (PlumaDocument       *doc,
 						 const GtkTextIter   *start,
 						 const GtkTextIter   *end);
 
+gboolean	_pluma_document_regex_search	(PlumaDocument       *doc,
+						 GRegex              *regex,
+						 const GtkTextIter   *iter,
+						 const GtkTextIter   *limit,
+						 gboolean             forward,
+						 GtkTextIter         *match_start,
+						 GtkTextIter         *match_end,
+						 gchar              **replace_text);
+
+void		_pluma_document_set_index_matches
+						(PlumaDocument       *doc,
+						 gboolean             index);
+
+gint		_pluma_document_get_n_matches	(PlumaDocument       *doc,
+						 gboolean            *complete);
+
+gint		_pluma_document_get_match_number
+						(PlumaDocument       *doc,
+						 const GtkTextIter   *match_start);
+
+gint		_pluma_document_find_match	(PlumaDocument       *doc,
+						 const GtkTextIter   *iter,
+						 gboolean             forward);
+
+gboolean	_pluma_document_get_nth_match	(PlumaDocument       *doc,
+						 gint                 n,
+						 GtkTextIter         *match_start,
+						 GtkTextIter         *match_end);
+
 /* Search macros */
 #define PLUMA_SEARCH_IS_DONT_SET_FLAGS(sflags) ((sflags & PLUMA_SEARCH_DONT_SET_FLAGS) != 0)
 #define PLUMA_SEARCH_SET_DONT_SET_FLAGS(sflags,state) ((state == TRUE) ? \
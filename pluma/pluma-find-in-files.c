@@ -0,0 +1,1232 @@
+/*
+ * pluma-find-in-files.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* for memmem () */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "pluma-find-in-files.h"
+#include "pluma-debug.h"
+#include "pluma-encodings.h"
+#include "pluma-settings.h"
+#include "pluma-smart-charset-converter.h"
+
+/* Characters shown before and after a match in its preview */
+#define PREVIEW_CONTEXT 40
+
+/* Matches looked at between two checks for cancellation */
+#define CANCEL_CHECK_INTERVAL 256
+
+/* Matches listed per file and in total, the ones after are only counted */
+#define MAX_MATCHES_PER_FILE 1000
+#define MAX_LISTED_MATCHES 10000
+
+/* Like git, a file with a NUL byte in its first bytes is binary */
+#define BINARY_CHECK_SIZE 8000
+
+/* How often the results found so far are handed to the main thread (ms) */
+#define FLUSH_INTERVAL 100
+
+/* Past this many folders and files queued or being searched, the
+ * thread walking a folder searches its entries itself */
+#define MAX_PENDING_ITEMS 256
+
+/* Size of the output buffer of the conversion to UTF-8 */
+#define CONVERT_BUFFER_SIZE (16 * 1024)
+
+/* A pool thread keeps the buffer it reads the files in for the next
+ * ones, unless it grew past this size for a big file */
+#define MAX_KEPT_BUFFER_SIZE (4 * 1024 * 1024)
+
+typedef struct
+{
+    GFunc    func;
+    gpointer data;
+} PoolTask;
+
+typedef struct
+{
+    gchar *data;
+    gsize  size;
+} ReadBuffer;
+
+typedef struct
+{
+    GPatternSpec *spec;
+    gboolean      negated;
+    gboolean      dir_only;
+
+    /* matched against the path from the folder of the .gitignore file
+     * rather than against the name */
+    gboolean      anchored;
+} IgnorePattern;
+
+/* The patterns of the .gitignore file of a folder, chained to the ones of
+ * the folders above it */
+typedef struct _IgnoreRules IgnoreRules;
+
+struct _IgnoreRules
+{
+    gint         ref_count;
+    IgnoreRules *parent;
+    gchar       *dir;
+    GPtrArray   *patterns;
+};
+
+struct _PlumaFindInFiles
+{
+    gint                  ref_count;
+
+    gchar                *root;
+    GRegex               *regex;
+    gchar                *literal;
+    gboolean              literal_is_ascii;
+    gboolean              entire_word;
+    GCancellable         *cancellable;
+
+    /* the encodings the files which are not UTF-8 are read with, like
+     * the document loader does */
+    GSList               *encodings;
+
+    /* folders and files queued or being searched */
+    gint                  n_pending;
+    guint                 n_searched;
+    guint                 n_skipped;
+    gint                  n_listed;
+
+    GMutex                mutex;
+    GPtrArray            *results;
+
+    /* main thread only */
+    guint                 flush_timeout;
+    PlumaFindInFilesFunc  func;
+    gpointer              user_data;
+};
+
+typedef struct
+{
+    PlumaFindInFiles *search;
+    gchar            *relative_path;
+    IgnoreRules      *rules;
+    gboolean          is_dir;
+} WorkItem;
+
+static const gchar *vcs_dirs[] = { ".git", ".hg", ".svn", ".bzr", "CVS", NULL };
+
+static GThreadPool *search_pool = NULL;
+
+static void read_buffer_free (ReadBuffer *buffer);
+
+static GPrivate read_buffer = G_PRIVATE_INIT ((GDestroyNotify) read_buffer_free);
+
+static void
+run_pool_task (PoolTask *task,
+               gpointer  user_data)
+{
+    task->func (task->data, NULL);
+
+    g_slice_free (PoolTask, task);
+}
+
+/* Runs @func on one of the search threads, shared by all the searches:
+ * one per core */
+void
+_pluma_search_pool_push (GFunc    func,
+                         gpointer data)
+{
+    static gsize initialized = 0;
+    PoolTask *task;
+
+    if (g_once_init_enter (&initialized))
+    {
+        search_pool = g_thread_pool_new ((GFunc) run_pool_task,
+                                         NULL,
+                                         g_get_num_processors (),
+                                         FALSE,
+                                         NULL);
+
+        g_once_init_leave (&initialized, 1);
+    }
+
+    task = g_slice_new (PoolTask);
+    task->func = func;
+    task->data = data;
+
+    g_thread_pool_push (search_pool, task, NULL);
+}
+
+static gboolean
+is_word_char (gunichar c)
+{
+    return g_unichar_isalnum (c) || c == '_';
+}
+
+/* Out of the main thread gtk_text_iter_starts_word() and
+ * gtk_text_iter_ends_word() cannot be used: this is close enough to
+ * them for the languages separating words with spaces and punctuation */
+static gboolean
+range_is_word (const gchar *text,
+               gsize        length,
+               gint         start,
+               gint         end)
+{
+    if (!is_word_char (g_utf8_get_char (text + start)))
+        return FALSE;
+
+    if (start > 0 &&
+        is_word_char (g_utf8_get_char (g_utf8_prev_char (text + start))))
+        return FALSE;
+
+    if (!is_word_char (g_utf8_get_char (g_utf8_prev_char (text + end))))
+        return FALSE;
+
+    if ((gsize) end < length &&
+        is_word_char (g_utf8_get_char (text + end)))
+        return FALSE;
+
+    return TRUE;
+}
+
+static void
+append_escaped (GString     *markup,
+                const gchar *start,
+                const gchar *end)
+{
+    gchar *escaped;
+
+    escaped = g_markup_escape_text (start, end - start);
+    g_string_append (markup, escaped);
+    g_free (escaped);
+}
+
+/* Finds the first line break in [@p, @limit), and sets *@next to the
+ * start of the line after it. The line breaks are the ones of
+ * GtkTextBuffer: "\n", "\r", "\r\n" and the paragraph separator. */
+static const gchar *
+find_line_break (const gchar  *p,
+                 const gchar  *limit,
+                 const gchar  *text_end,
+                 const gchar **next)
+{
+    for (; p < limit; p++)
+    {
+        switch ((guchar) *p)
+        {
+            case '\n':
+                *next = p + 1;
+                return p;
+
+            case '\r':
+                *next = (p + 1 < text_end && p[1] == '\n') ? p + 2 : p + 1;
+                return p;
+
+            /* U+2029 */
+            case 0xe2:
+                if (text_end - p >= 3 &&
+                    (guchar) p[1] == 0x80 &&
+                    (guchar) p[2] == 0xa9)
+                {
+                    *next = p + 3;
+                    return p;
+                }
+                break;
+        }
+    }
+
+    return NULL;
+}
+
+/* The line of the match, cut around it if it is long: only a bounded
+ * number of characters is looked at, for minified files not to make
+ * each match cost the whole line */
+static gchar *
+make_preview (gint         line,
+              const gchar *line_start,
+              const gchar *match_start,
+              const gchar *match_end,
+              const gchar *text_end)
+{
+    const gchar *line_end;
+    const gchar *next;
+    const gchar *before;
+    const gchar *shown_end;
+    const gchar *after;
+    GString *markup;
+    gint i;
+
+    line_end = find_line_break (match_start, text_end, text_end, &next);
+    if (line_end == NULL)
+        line_end = text_end;
+
+    match_end = MIN (match_end, line_end);
+
+    /* skip the indentation */
+    while (line_start < match_start && (*line_start == ' ' || *line_start == '\t'))
+        line_start++;
+
+    before = match_start;
+    for (i = 0; i < PREVIEW_CONTEXT && before > line_start; i++)
+        before = g_utf8_prev_char (before);
+
+    shown_end = match_start;
+    for (i = 0; i < 2 * PREVIEW_CONTEXT && shown_end < match_end; i++)
+        shown_end = g_utf8_next_char (shown_end);
+
+    after = shown_end;
+    if (shown_end == match_end)
+    {
+        for (i = 0; i < PREVIEW_CONTEXT && after < line_end; i++)
+            after = g_utf8_next_char (after);
+    }
+
+    markup = g_string_new (NULL);
+    g_string_printf (markup, "%d: ", line + 1);
+
+    if (before > line_start)
+        g_string_append (markup, "\342\200\246");
+
+    append_escaped (markup, before, match_start);
+    g_string_append (markup, "<b>");
+    append_escaped (markup, match_start, shown_end);
+    g_string_append (markup, "</b>");
+    append_escaped (markup, shown_end, after);
+
+    if (after < line_end)
+        g_string_append (markup, "\342\200\246");
+
+    return g_string_free (markup, FALSE);
+}
+
+GArray *
+_pluma_search_matches_new (void)
+{
+    return g_array_new (FALSE, FALSE, sizeof (PlumaSearchMatch));
+}
+
+void
+_pluma_search_matches_free (GArray *matches)
+{
+    guint i;
+
+    if (matches == NULL)
+        return;
+
+    for (i = 0; i < matches->len; i++)
+        g_free (g_array_index (matches, PlumaSearchMatch, i).markup);
+
+    g_array_free (matches, TRUE);
+}
+
+/* Looks for all the matches of @regex in the UTF-8 @text and appends the
+ * first @max_matches to @matches. Can be called from any thread. Returns
+ * the number of matches, listed or not. Empty matches are skipped since
+ * they cannot be selected. */
+gint
+_pluma_search_scan_text (const gchar  *text,
+                         gsize         length,
+                         GRegex       *regex,
+                         gboolean      entire_word,
+                         guint         max_matches,
+                         GCancellable *cancellable,
+                         GArray       *matches)
+{
+    GMatchInfo *match_info;
+    const gchar *scanned;
+    const gchar *line_start;
+    const gchar *column_pos;
+    gint line = 0;
+    gint column = 0;
+    gint n_matches = 0;
+    guint n_checked = 0;
+
+    g_return_val_if_fail (text != NULL, 0);
+    g_return_val_if_fail (regex != NULL, 0);
+    g_return_val_if_fail (matches != NULL, 0);
+
+    /* the lines and the columns are counted from the previous match */
+    scanned = line_start = column_pos = text;
+
+    g_regex_match_full (regex, text, length, 0, 0, &match_info, NULL);
+
+    while (g_match_info_matches (match_info))
+    {
+        gint start;
+        gint end;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+
+        if (end > start &&
+            (!entire_word || range_is_word (text, length, start, end)))
+        {
+            n_matches++;
+
+            if (matches->len < max_matches)
+            {
+                const gchar *match_start = text + start;
+                const gchar *next;
+                PlumaSearchMatch match;
+
+                while (find_line_break (scanned, match_start, text + length, &next) != NULL)
+                {
+                    line++;
+                    scanned = line_start = column_pos = next;
+                    column = 0;
+                }
+
+                /* a match starting between "\r" and "\n" */
+                if (scanned > match_start)
+                {
+                    line_start = column_pos = match_start;
+                }
+                else
+                {
+                    scanned = match_start;
+                }
+
+                column += g_utf8_pointer_to_offset (column_pos, match_start);
+                column_pos = match_start;
+
+                match.line = line;
+                match.line_offset = column;
+                match.length = g_utf8_pointer_to_offset (match_start, text + end);
+                match.markup = make_preview (line,
+                                             line_start,
+                                             match_start,
+                                             text + end,
+                                             text + length);
+
+                g_array_append_val (matches, match);
+            }
+        }
+
+        if (++n_checked % CANCEL_CHECK_INTERVAL == 0 &&
+            g_cancellable_is_cancelled (cancellable))
+            break;
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    return n_matches;
+}
+
+static gboolean
+pattern_matches (GPatternSpec *spec,
+                 const gchar  *string)
+{
+#if GLIB_CHECK_VERSION(2,70,0)
+    return g_pattern_spec_match_string (spec, string);
+#else
+    return g_pattern_match_string (spec, string);
+#endif
+}
+
+static void
+ignore_pattern_free (IgnorePattern *pattern)
+{
+    g_pattern_spec_free (pattern->spec);
+
+    g_slice_free (IgnorePattern, pattern);
+}
+
+static IgnoreRules *
+ignore_rules_ref (IgnoreRules *rules)
+{
+    if (rules != NULL)
+        g_atomic_int_inc (&rules->ref_count);
+
+    return rules;
+}
+
+static void
+ignore_rules_unref (IgnoreRules *rules)
+{
+    while (rules != NULL && g_atomic_int_dec_and_test (&rules->ref_count))
+    {
+        IgnoreRules *parent = rules->parent;
+
+        g_ptr_array_unref (rules->patterns);
+        g_free (rules->dir);
+        g_slice_free (IgnoreRules, rules);
+
+        rules = parent;
+    }
+}
+
+/* Parses the usual subset of the .gitignore syntax: comments, negation,
+ * patterns only matching folders and patterns anchored to the folder.
+ * GPatternSpec is used for the wildcards, so "*" also matches "/". */
+static IgnorePattern *
+parse_ignore_pattern (gchar *line)
+{
+    IgnorePattern *pattern;
+    gboolean negated;
+    gboolean dir_only;
+    gboolean anchored;
+    gsize len;
+
+    g_strchomp (line);
+
+    if (*line == '\0' || *line == '#')
+        return NULL;
+
+    negated = (*line == '!');
+    if (negated)
+        line++;
+
+    /* "\#" and "\!" */
+    if (*line == '\\')
+        line++;
+
+    len = strlen (line);
+    dir_only = (len > 0 && line[len - 1] == '/');
+    if (dir_only)
+        line[len - 1] = '\0';
+
+    if (g_str_has_prefix (line, "**/"))
+        line += 3;
+
+    anchored = (strchr (line, '/') != NULL);
+
+    if (*line == '/')
+        line++;
+
+    if (*line == '\0')
+        return NULL;
+
+    pattern = g_slice_new (IgnorePattern);
+    pattern->spec = g_pattern_spec_new (line);
+    pattern->negated = negated;
+    pattern->dir_only = dir_only;
+    pattern->anchored = anchored;
+
+    return pattern;
+}
+
+/* Returns the rules for the folder at @path: @parent if it has no
+ * .gitignore file */
+static IgnoreRules *
+load_ignore_rules (const gchar *path,
+                   const gchar *relative_path,
+                   IgnoreRules *parent)
+{
+    IgnoreRules *rules;
+    gchar *filename;
+    gchar *contents;
+    gchar **lines;
+    gint i;
+
+    filename = g_build_filename (path, ".gitignore", NULL);
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+        g_free (filename);
+        return ignore_rules_ref (parent);
+    }
+
+    g_free (filename);
+
+    rules = g_slice_new (IgnoreRules);
+    rules->ref_count = 1;
+    rules->parent = ignore_rules_ref (parent);
+    rules->dir = g_strdup (relative_path);
+    rules->patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) ignore_pattern_free);
+
+    lines = g_strsplit (contents, "\n", -1);
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        IgnorePattern *pattern;
+
+        pattern = parse_ignore_pattern (lines[i]);
+
+        if (pattern != NULL)
+            g_ptr_array_add (rules->patterns, pattern);
+    }
+
+    g_strfreev (lines);
+    g_free (contents);
+
+    return rules;
+}
+
+/* The last pattern matching in the closest .gitignore file decides */
+static gboolean
+is_ignored (IgnoreRules *rules,
+            const gchar *relative_path,
+            const gchar *name,
+            gboolean     is_dir)
+{
+    for (; rules != NULL; rules = rules->parent)
+    {
+        const gchar *sub_path = relative_path;
+        guint i;
+
+        if (*rules->dir != '\0')
+            sub_path += strlen (rules->dir) + 1;
+
+        for (i = rules->patterns->len; i > 0; i--)
+        {
+            IgnorePattern *pattern = g_ptr_array_index (rules->patterns, i - 1);
+
+            if (pattern->dir_only && !is_dir)
+                continue;
+
+            if (pattern_matches (pattern->spec, pattern->anchored ? sub_path : name))
+                return !pattern->negated;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+is_vcs_dir (const gchar *name)
+{
+    gint i;
+
+    for (i = 0; vcs_dirs[i] != NULL; i++)
+    {
+        if (strcmp (name, vcs_dirs[i]) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static PlumaFindInFiles *
+find_in_files_ref (PlumaFindInFiles *search)
+{
+    g_atomic_int_inc (&search->ref_count);
+
+    return search;
+}
+
+/* The last reference may be dropped on a search thread */
+static void
+find_in_files_unref (PlumaFindInFiles *search)
+{
+    if (!g_atomic_int_dec_and_test (&search->ref_count))
+        return;
+
+    g_free (search->root);
+    g_regex_unref (search->regex);
+    g_free (search->literal);
+    g_slist_free (search->encodings);
+    g_object_unref (search->cancellable);
+
+    g_mutex_clear (&search->mutex);
+    g_ptr_array_unref (search->results);
+
+    g_slice_free (PlumaFindInFiles, search);
+}
+
+static void
+result_free (PlumaFindInFilesResult *result)
+{
+    g_free (result->uri);
+    g_free (result->relative_path);
+    _pluma_search_matches_free (result->matches);
+
+    g_slice_free (PlumaFindInFilesResult, result);
+}
+
+static void run_work_item (WorkItem *item,
+                           gpointer  user_data);
+
+static void walk_folder (PlumaFindInFiles *search,
+                         const gchar      *relative_path,
+                         IgnoreRules      *parent_rules);
+
+static void search_file (PlumaFindInFiles *search,
+                         const gchar      *relative_path);
+
+static void
+push_work_item (PlumaFindInFiles *search,
+                gchar            *relative_path,
+                IgnoreRules      *rules,
+                gboolean          is_dir)
+{
+    WorkItem *item;
+
+    /* the queue is bounded: a folder with many files is searched by the
+     * thread walking it rather than queued all at once */
+    if (g_atomic_int_get (&search->n_pending) >= MAX_PENDING_ITEMS)
+    {
+        if (is_dir)
+            walk_folder (search, relative_path, rules);
+        else
+            search_file (search, relative_path);
+
+        g_free (relative_path);
+        return;
+    }
+
+    g_atomic_int_inc (&search->n_pending);
+
+    item = g_slice_new (WorkItem);
+    item->search = find_in_files_ref (search);
+    item->relative_path = relative_path;
+    item->rules = ignore_rules_ref (rules);
+    item->is_dir = is_dir;
+
+    _pluma_search_pool_push ((GFunc) run_work_item, item);
+}
+
+/* Queues the files and the folders of a folder: the folders are walked
+ * in parallel too */
+static void
+walk_folder (PlumaFindInFiles *search,
+             const gchar      *relative_path,
+             IgnoreRules      *parent_rules)
+{
+    IgnoreRules *rules;
+    GDir *dir;
+    gchar *path;
+    const gchar *name;
+
+    path = g_build_filename (search->root, relative_path, NULL);
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir == NULL)
+    {
+        g_free (path);
+        return;
+    }
+
+    rules = load_ignore_rules (path, relative_path, parent_rules);
+
+    while ((name = g_dir_read_name (dir)) != NULL &&
+           !g_cancellable_is_cancelled (search->cancellable))
+    {
+        gchar *child_path;
+        gchar *child_relative_path;
+        GStatBuf st;
+
+        child_path = g_build_filename (path, name, NULL);
+
+        if (*relative_path != '\0')
+            child_relative_path = g_build_filename (relative_path, name, NULL);
+        else
+            child_relative_path = g_strdup (name);
+
+        /* symbolic links are not followed, they could make loops */
+        if (g_lstat (child_path, &st) == 0 &&
+            (S_ISDIR (st.st_mode) || S_ISREG (st.st_mode)) &&
+            !(S_ISDIR (st.st_mode) && is_vcs_dir (name)) &&
+            !is_ignored (rules, child_relative_path, name, S_ISDIR (st.st_mode)))
+        {
+            push_work_item (search, child_relative_path, rules, S_ISDIR (st.st_mode));
+        }
+        else
+        {
+            g_free (child_relative_path);
+        }
+
+        g_free (child_path);
+    }
+
+    g_dir_close (dir);
+    ignore_rules_unref (rules);
+    g_free (path);
+}
+
+static gboolean
+contains_literal (const gchar *text,
+                  gsize        length,
+                  const gchar *literal)
+{
+    gsize len = strlen (literal);
+
+    if (length < len)
+        return FALSE;
+
+#ifdef HAVE_MEMMEM
+    /* the C library has a vectorized one */
+    return memmem (text, length, literal, len) != NULL;
+#else
+    {
+        gsize skip[256];
+        const gchar *p;
+        const gchar *last;
+        gsize i;
+
+        /* Horspool */
+        for (i = 0; i < 256; i++)
+            skip[i] = len;
+
+        for (i = 0; i + 1 < len; i++)
+            skip[(guchar) literal[i]] = len - 1 - i;
+
+        last = text + length - len;
+
+        for (p = text; p <= last; p += skip[(guchar) p[len - 1]])
+        {
+            if (p[len - 1] == literal[len - 1] && memcmp (p, literal, len - 1) == 0)
+                return TRUE;
+        }
+
+        return FALSE;
+    }
+#endif
+}
+
+/* Converts a file which is not UTF-8 with the candidate encodings, the
+ * way it would be loaded. Returns NULL if none of them reads it without
+ * fallback characters. */
+static gchar *
+convert_to_utf8 (PlumaFindInFiles *search,
+                 const gchar      *text,
+                 gsize             length,
+                 gsize            *new_length)
+{
+    PlumaSmartCharsetConverter *converter;
+    GConverterResult result;
+    GString *converted;
+    gchar *buffer;
+    gboolean ok;
+
+    if (search->encodings == NULL)
+        return NULL;
+
+    converter = pluma_smart_charset_converter_new (search->encodings);
+    converted = g_string_sized_new (length + length / 2);
+    buffer = g_malloc (CONVERT_BUFFER_SIZE);
+
+    do
+    {
+        gsize bytes_read;
+        gsize bytes_written;
+
+        result = g_converter_convert (G_CONVERTER (converter),
+                                      text,
+                                      length,
+                                      buffer,
+                                      CONVERT_BUFFER_SIZE,
+                                      G_CONVERTER_INPUT_AT_END,
+                                      &bytes_read,
+                                      &bytes_written,
+                                      NULL);
+
+        g_string_append_len (converted, buffer, bytes_written);
+
+        text += bytes_read;
+        length -= bytes_read;
+    }
+    while (result == G_CONVERTER_CONVERTED &&
+           !g_cancellable_is_cancelled (search->cancellable));
+
+    ok = (result == G_CONVERTER_FINISHED &&
+          pluma_smart_charset_converter_get_num_fallbacks (converter) == 0 &&
+          g_utf8_validate (converted->str, converted->len, NULL));
+
+    g_free (buffer);
+    g_object_unref (converter);
+
+    if (!ok)
+    {
+        g_string_free (converted, TRUE);
+        return NULL;
+    }
+
+    *new_length = converted->len;
+
+    return g_string_free (converted, FALSE);
+}
+
+static void
+read_buffer_free (ReadBuffer *buffer)
+{
+    g_free (buffer->data);
+    g_slice_free (ReadBuffer, buffer);
+}
+
+/* Reads up to @count bytes, fewer only at the end of the file */
+static gssize
+read_all (gint   fd,
+          gchar *data,
+          gsize  count)
+{
+    gsize total = 0;
+
+    while (total < count)
+    {
+        gssize res;
+
+        res = read (fd, data + total, count - total);
+
+        if (res == -1)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return -1;
+        }
+
+        if (res == 0)
+            break;
+
+        total += res;
+    }
+
+    return total;
+}
+
+/* Reads the file at @path into the buffer of the thread. A mapping would
+ * raise SIGBUS in the pool thread if the file was truncated meanwhile,
+ * here the file just ends early. Returns FALSE if the file cannot be
+ * read or if it is binary, which is known from its first bytes. */
+static gboolean
+read_file (const gchar *path,
+           ReadBuffer  *buffer,
+           gsize       *length)
+{
+    GStatBuf st;
+    gsize size;
+    gsize head;
+    gssize res;
+    gint fd;
+
+    fd = g_open (path, O_RDONLY, 0);
+
+    if (fd == -1)
+        return FALSE;
+
+    /* nothing to find in an empty file */
+    if (fstat (fd, &st) == -1 || !S_ISREG (st.st_mode) || st.st_size == 0)
+    {
+        close (fd);
+        return FALSE;
+    }
+
+    size = st.st_size;
+
+    if (buffer->size < size)
+    {
+        g_free (buffer->data);
+        buffer->data = g_try_malloc (size);
+
+        if (buffer->data == NULL)
+        {
+            buffer->size = 0;
+            close (fd);
+            return FALSE;
+        }
+
+        buffer->size = size;
+    }
+
+    /* the cheap check first, without reading the rest of a binary file */
+    head = MIN (size, BINARY_CHECK_SIZE);
+    res = read_all (fd, buffer->data, head);
+
+    if (res == -1 || memchr (buffer->data, '\0', res) != NULL)
+    {
+        close (fd);
+        return FALSE;
+    }
+
+    *length = res;
+
+    if ((gsize) res == head && size > head)
+    {
+        res = read_all (fd, buffer->data + head, size - head);
+
+        if (res == -1)
+        {
+            close (fd);
+            return FALSE;
+        }
+
+        *length += res;
+    }
+
+    close (fd);
+
+    return TRUE;
+}
+
+static void
+search_text (PlumaFindInFiles *search,
+             const gchar      *path,
+             const gchar      *relative_path,
+             const gchar      *text,
+             gsize             length)
+{
+    gchar *converted = NULL;
+    GArray *matches;
+    gint listed;
+    gint n_matches;
+
+    /* most files do not match. An ASCII literal has the same bytes in
+     * the encodings the files which are not UTF-8 can be read with. */
+    if (length == 0 ||
+        (search->literal_is_ascii && !contains_literal (text, length, search->literal)))
+        return;
+
+    if (!g_utf8_validate (text, length, NULL))
+    {
+        converted = convert_to_utf8 (search, text, length, &length);
+
+        if (converted == NULL)
+        {
+            g_atomic_int_inc ((gint *) &search->n_skipped);
+            return;
+        }
+
+        text = converted;
+    }
+
+    if (search->literal != NULL && !search->literal_is_ascii &&
+        !contains_literal (text, length, search->literal))
+    {
+        g_free (converted);
+        return;
+    }
+
+    listed = g_atomic_int_get (&search->n_listed);
+
+    matches = _pluma_search_matches_new ();
+    n_matches = _pluma_search_scan_text (text,
+                                         length,
+                                         search->regex,
+                                         search->entire_word,
+                                         CLAMP (MAX_LISTED_MATCHES - listed, 0, MAX_MATCHES_PER_FILE),
+                                         search->cancellable,
+                                         matches);
+
+    g_free (converted);
+
+    if (n_matches > 0)
+    {
+        PlumaFindInFilesResult *result;
+
+        g_atomic_int_add (&search->n_listed, matches->len);
+
+        result = g_slice_new (PlumaFindInFilesResult);
+        result->uri = g_filename_to_uri (path, NULL, NULL);
+        result->relative_path = g_strdup (relative_path);
+        result->n_matches = n_matches;
+        result->matches = matches;
+
+        g_mutex_lock (&search->mutex);
+        g_ptr_array_add (search->results, result);
+        g_mutex_unlock (&search->mutex);
+    }
+    else
+    {
+        _pluma_search_matches_free (matches);
+    }
+}
+
+static void
+search_file (PlumaFindInFiles *search,
+             const gchar      *relative_path)
+{
+    ReadBuffer *buffer;
+    gchar *path;
+    gsize length;
+
+    buffer = g_private_get (&read_buffer);
+
+    if (buffer == NULL)
+    {
+        buffer = g_slice_new0 (ReadBuffer);
+        g_private_set (&read_buffer, buffer);
+    }
+
+    path = g_build_filename (search->root, relative_path, NULL);
+
+    g_atomic_int_inc ((gint *) &search->n_searched);
+
+    if (read_file (path, buffer, &length))
+        search_text (search, path, relative_path, buffer->data, length);
+
+    /* not to hold on to the size of the biggest file ever searched */
+    if (buffer->size > MAX_KEPT_BUFFER_SIZE)
+        g_private_replace (&read_buffer, NULL);
+
+    g_free (path);
+}
+
+static void
+run_work_item (WorkItem *item,
+               gpointer  user_data)
+{
+    PlumaFindInFiles *search = item->search;
+
+    if (!g_cancellable_is_cancelled (search->cancellable))
+    {
+        if (item->is_dir)
+            walk_folder (search, item->relative_path, item->rules);
+        else
+            search_file (search, item->relative_path);
+    }
+
+    /* after the items of a folder were queued, so that it only gets to
+     * zero once everything was searched */
+    g_atomic_int_add (&search->n_pending, -1);
+
+    ignore_rules_unref (item->rules);
+    g_free (item->relative_path);
+    find_in_files_unref (search);
+
+    g_slice_free (WorkItem, item);
+}
+
+static gboolean
+flush_results (PlumaFindInFiles *search)
+{
+    GPtrArray *results;
+    gboolean finished;
+
+    /* read before taking the results, not to miss the last ones */
+    finished = (g_atomic_int_get (&search->n_pending) == 0);
+
+    g_mutex_lock (&search->mutex);
+    results = search->results;
+    search->results = g_ptr_array_new_with_free_func ((GDestroyNotify) result_free);
+    g_mutex_unlock (&search->mutex);
+
+    if (finished)
+    {
+        search->flush_timeout = 0;
+
+        pluma_debug_message (DEBUG_SEARCH,
+                             "searched %u files",
+                             _pluma_find_in_files_get_n_searched (search));
+    }
+
+    /* the callback may cancel the search */
+    find_in_files_ref (search);
+
+    if (search->func != NULL)
+        search->func (search, results, finished, search->user_data);
+
+    g_ptr_array_unref (results);
+    find_in_files_unref (search);
+
+    return !finished;
+}
+
+/* Starts searching the files under the local folder @root for @regex.
+ * When @literal is not NULL, it is a string the files must contain to
+ * match, so that most of them are skipped without running the regex.
+ * @func is called on the main thread as the results come. */
+PlumaFindInFiles *
+_pluma_find_in_files_new (const gchar          *root,
+                          GRegex               *regex,
+                          const gchar          *literal,
+                          gboolean              entire_word,
+                          PlumaFindInFilesFunc  func,
+                          gpointer              user_data)
+{
+    PlumaFindInFiles *search;
+    GSettings *settings;
+    gchar **enc_strv;
+
+    g_return_val_if_fail (root != NULL, NULL);
+    g_return_val_if_fail (regex != NULL, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    search = g_slice_new0 (PlumaFindInFiles);
+    search->ref_count = 1;
+    search->root = g_strdup (root);
+    search->regex = g_regex_ref (regex);
+    search->literal = (literal != NULL && *literal != '\0') ? g_strdup (literal) : NULL;
+    search->literal_is_ascii = (search->literal != NULL && g_str_is_ascii (search->literal));
+    search->entire_word = entire_word;
+    search->cancellable = g_cancellable_new ();
+    search->results = g_ptr_array_new_with_free_func ((GDestroyNotify) result_free);
+    search->func = func;
+    search->user_data = user_data;
+
+    /* UTF-8 is validated first */
+    settings = g_settings_new (PLUMA_SCHEMA_ID);
+    enc_strv = g_settings_get_strv (settings, PLUMA_SETTINGS_ENCODING_AUTO_DETECTED);
+    search->encodings = _pluma_encoding_strv_to_list ((const gchar * const *) enc_strv);
+    search->encodings = g_slist_remove (search->encodings, pluma_encoding_get_utf8 ());
+    g_strfreev (enc_strv);
+    g_object_unref (settings);
+
+    g_mutex_init (&search->mutex);
+
+    push_work_item (search, g_strdup (""), NULL, TRUE);
+
+    search->flush_timeout = g_timeout_add (FLUSH_INTERVAL,
+                                           (GSourceFunc) flush_results,
+                                           search);
+
+    return search;
+}
+
+/* Stops the search if it is still running and releases it: @func is not
+ * called anymore. The threads let it go as they notice. */
+void
+_pluma_find_in_files_cancel (PlumaFindInFiles *search)
+{
+    g_return_if_fail (search != NULL);
+
+    g_cancellable_cancel (search->cancellable);
+
+    if (search->flush_timeout != 0)
+    {
+        g_source_remove (search->flush_timeout);
+        search->flush_timeout = 0;
+    }
+
+    search->func = NULL;
+
+    find_in_files_unref (search);
+}
+
+guint
+_pluma_find_in_files_get_n_searched (PlumaFindInFiles *search)
+{
+    g_return_val_if_fail (search != NULL, 0);
+
+    return g_atomic_int_get ((gint *) &search->n_searched);
+}
+
+/* The files which are neither binary nor UTF-8 and which none of the
+ * candidate encodings could read */
+guint
+_pluma_find_in_files_get_n_skipped (PlumaFindInFiles *search)
+{
+    g_return_val_if_fail (search != NULL, 0);
+
+    return g_atomic_int_get ((gint *) &search->n_skipped);
+}
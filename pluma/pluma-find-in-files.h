@@ -0,0 +1,92 @@
+/*
+ * pluma-find-in-files.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_FIND_IN_FILES_H__
+#define __PLUMA_FIND_IN_FILES_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A match found out of the main thread, with its line in Pango markup */
+typedef struct
+{
+    gint   line;
+    gint   line_offset;
+    gint   length;
+    gchar *markup;
+} PlumaSearchMatch;
+
+/* The matches found in one file */
+typedef struct
+{
+    gchar  *uri;
+    gchar  *relative_path;
+    gint    n_matches;
+    GArray *matches;
+} PlumaFindInFilesResult;
+
+/* Searches the files under a local folder on the search threads, walking
+ * the folders in parallel too. The files which are not UTF-8 are read
+ * with the candidate encodings of the settings. Binary files, version
+ * control folders and the paths matched by .gitignore files are skipped.
+ * The results are handed to the main thread in batches. */
+typedef struct _PlumaFindInFiles PlumaFindInFiles;
+
+/* Called on the main thread with the files found since the last call.
+ * @results is freed after the call. */
+typedef void (* PlumaFindInFilesFunc) (PlumaFindInFiles *search,
+                                       GPtrArray        *results,
+                                       gboolean          finished,
+                                       gpointer          user_data);
+
+void              _pluma_search_pool_push              (GFunc                 func,
+                                                        gpointer              data);
+
+gint              _pluma_search_scan_text              (const gchar          *text,
+                                                        gsize                 length,
+                                                        GRegex               *regex,
+                                                        gboolean              entire_word,
+                                                        guint                 max_matches,
+                                                        GCancellable         *cancellable,
+                                                        GArray               *matches);
+
+GArray           *_pluma_search_matches_new            (void);
+
+void              _pluma_search_matches_free           (GArray               *matches);
+
+PlumaFindInFiles *_pluma_find_in_files_new             (const gchar          *root,
+                                                        GRegex               *regex,
+                                                        const gchar          *literal,
+                                                        gboolean              entire_word,
+                                                        PlumaFindInFilesFunc  func,
+                                                        gpointer              user_data);
+
+void              _pluma_find_in_files_cancel          (PlumaFindInFiles     *search);
+
+guint             _pluma_find_in_files_get_n_searched  (PlumaFindInFiles     *search);
+
+guint             _pluma_find_in_files_get_n_skipped   (PlumaFindInFiles     *search);
+
+G_END_DECLS
+
+#endif /* __PLUMA_FIND_IN_FILES_H__ */
@@ -0,0 +1,145 @@
+/*
+ * pluma-io-chunk-policy.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "pluma-io-chunk-policy.h"
+#include "pluma-debug.h"
+
+/* If handling a chunk keeps the main loop busy for longer than a frame
+ * the chunk is too big for the UI to stay responsive */
+#define LATENCY_BUDGET (16 * 1000)
+
+/* Keep growing as long as a bigger chunk is not noticeably slower */
+#define RATE_TOLERANCE 0.9
+
+void
+_pluma_io_chunk_policy_init (PlumaIOChunkPolicy     *policy,
+                             PlumaIOChunkPolicyType  type,
+                             gsize                   initial_size)
+{
+    g_return_if_fail (policy != NULL);
+    g_return_if_fail (initial_size > 0);
+
+    policy->type = type;
+    policy->size = initial_size;
+
+    if (type == PLUMA_IO_CHUNK_POLICY_ADAPTIVE)
+        policy->max_size = MAX (initial_size, PLUMA_IO_CHUNK_MAX_SIZE);
+    else
+        policy->max_size = initial_size;
+
+    policy->started = 0;
+    policy->finished = 0;
+    policy->rate = 0;
+    policy->prev_rate = 0;
+    policy->last_full = FALSE;
+    policy->n_chunks = 0;
+    policy->transferred = 0;
+    policy->elapsed = 0;
+}
+
+static void
+adapt_size (PlumaIOChunkPolicy *policy,
+            gint64              now)
+{
+    gint64 busy;
+
+    /* time spent on the main loop since the previous chunk came in */
+    busy = now - policy->finished;
+
+    if (busy > LATENCY_BUDGET)
+    {
+        policy->size = MAX (policy->size / 2, PLUMA_IO_CHUNK_MIN_SIZE);
+    }
+    else if (policy->last_full &&
+             (policy->n_chunks == 1 || policy->rate >= policy->prev_rate * RATE_TOLERANCE))
+    {
+        policy->size = MIN (policy->size * 2, policy->max_size);
+    }
+
+    pluma_debug_message (DEBUG_UTILS,
+                         "busy: %" G_GINT64_FORMAT "us, chunk size: %" G_GSIZE_FORMAT,
+                         busy, policy->size);
+}
+
+/* Returns the number of bytes to ask for in the next round trip */
+gsize
+_pluma_io_chunk_policy_begin (PlumaIOChunkPolicy *policy)
+{
+    gint64 now;
+
+    g_return_val_if_fail (policy != NULL, PLUMA_IO_CHUNK_MIN_SIZE);
+
+    now = g_get_monotonic_time ();
+
+    if (policy->type == PLUMA_IO_CHUNK_POLICY_ADAPTIVE && policy->n_chunks > 0)
+        adapt_size (policy, now);
+
+    policy->started = now;
+
+    return policy->size;
+}
+
+void
+_pluma_io_chunk_policy_done (PlumaIOChunkPolicy *policy,
+                             gsize               transferred)
+{
+    gint64 io_time;
+
+    g_return_if_fail (policy != NULL);
+
+    policy->finished = g_get_monotonic_time ();
+    io_time = MAX (policy->finished - policy->started, 1);
+
+    policy->prev_rate = policy->rate;
+    policy->rate = (gdouble) transferred / io_time;
+    policy->last_full = (transferred >= policy->size);
+
+    policy->n_chunks++;
+    policy->transferred += transferred;
+    policy->elapsed += io_time;
+}
+
+/* The biggest chunk the policy can ever ask for, to size buffers */
+gsize
+_pluma_io_chunk_policy_get_max_size (const PlumaIOChunkPolicy *policy)
+{
+    g_return_val_if_fail (policy != NULL, 0);
+
+    return policy->max_size;
+}
+
+/* Returns the average throughput in bytes per second, or 0 if nothing
+ * was transferred yet */
+guint64
+_pluma_io_chunk_policy_get_throughput (const PlumaIOChunkPolicy *policy)
+{
+    g_return_val_if_fail (policy != NULL, 0);
+
+    if (policy->elapsed == 0)
+        return 0;
+
+    return (guint64) ((gdouble) policy->transferred * G_USEC_PER_SEC / policy->elapsed);
+}
@@ -0,0 +1,80 @@
+/*
+ * pluma-io-chunk-policy.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_IO_CHUNK_POLICY_H__
+#define __PLUMA_IO_CHUNK_POLICY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define PLUMA_IO_CHUNK_MIN_SIZE  4096
+#define PLUMA_IO_CHUNK_MAX_SIZE  (1024 * 1024)
+
+/* Keep in sync with org.mate.pluma.IOChunkPolicy */
+typedef enum
+{
+    PLUMA_IO_CHUNK_POLICY_FIXED = 0,
+    PLUMA_IO_CHUNK_POLICY_ADAPTIVE
+} PlumaIOChunkPolicyType;
+
+/* Decides how many bytes the loader and the saver move per round trip.
+ * The adaptive policy starts with a small chunk so that the first data
+ * shows up quickly, doubles it while the throughput keeps up and halves
+ * it when handling a chunk keeps the main loop busy for too long. */
+typedef struct _PlumaIOChunkPolicy PlumaIOChunkPolicy;
+
+struct _PlumaIOChunkPolicy
+{
+    PlumaIOChunkPolicyType type;
+
+    gsize                  size;
+    gsize                  max_size;
+
+    gint64                 started;
+    gint64                 finished;
+
+    gdouble                rate;
+    gdouble                prev_rate;
+    gboolean               last_full;
+
+    guint                  n_chunks;
+    guint64                transferred;
+    gint64                 elapsed;
+};
+
+void        _pluma_io_chunk_policy_init           (PlumaIOChunkPolicy     *policy,
+                                                   PlumaIOChunkPolicyType  type,
+                                                   gsize                   initial_size);
+
+gsize       _pluma_io_chunk_policy_begin          (PlumaIOChunkPolicy     *policy);
+
+void        _pluma_io_chunk_policy_done           (PlumaIOChunkPolicy     *policy,
+                                                   gsize                   transferred);
+
+gsize       _pluma_io_chunk_policy_get_max_size   (const PlumaIOChunkPolicy *policy);
+
+guint64     _pluma_io_chunk_policy_get_throughput (const PlumaIOChunkPolicy *policy);
+
+G_END_DECLS
+
+#endif /* __PLUMA_IO_CHUNK_POLICY_H__ */
@@ -0,0 +1,690 @@
+/*
+ * pluma-large-file.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* for memmem () */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "pluma-large-file.h"
+#include "pluma-document-output-stream.h"
+#include "pluma-mapping-guard.h"
+#include "pluma-debug.h"
+#include "pluma-utils.h"
+
+/* The offset of one line every LINE_INDEX_STEP is stored */
+#define LINE_INDEX_STEP 1024
+
+/* Bytes scanned at once when the index has to be extended right away */
+#define INDEX_CHUNK_SIZE (4 * 1024 * 1024)
+
+struct _PlumaLargeFile
+{
+    gint         fd;
+    GMappedFile *mapped_file;
+    const gchar *contents;
+    gsize        length;
+
+    /* start offsets of lines 0, LINE_INDEX_STEP, 2 * LINE_INDEX_STEP... */
+    GArray      *line_index;
+    gsize        scanned;
+    gint64       n_newlines;
+    gboolean     indexed;
+};
+
+/* The file stays mapped for as long as it is shown: if it gets
+ * truncated, e.g. by logrotate, the pages past its new end read as
+ * zeros instead of raising SIGBUS, and its length is checked again
+ * before going through its contents. */
+PlumaLargeFile *
+_pluma_large_file_new (const gchar  *path,
+                       GError      **error)
+{
+    PlumaLargeFile *file;
+    GMappedFile *mapped_file;
+    guint64 start = 0;
+    gint fd;
+
+    g_return_val_if_fail (path != NULL, NULL);
+
+    fd = g_open (path, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        int errsv = errno;
+        gchar *display_name;
+
+        display_name = g_filename_display_name (path);
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                     _("Failed to open file “%s”: %s"),
+                     display_name, g_strerror (errsv));
+        g_free (display_name);
+
+        return NULL;
+    }
+
+    mapped_file = g_mapped_file_new_from_fd (fd, FALSE, error);
+
+    if (mapped_file == NULL)
+    {
+        g_close (fd, NULL);
+        return NULL;
+    }
+
+    file = g_slice_new (PlumaLargeFile);
+    file->fd = fd;
+    file->mapped_file = mapped_file;
+    file->contents = g_mapped_file_get_contents (mapped_file);
+    file->length = g_mapped_file_get_length (mapped_file);
+
+    if (file->contents != NULL &&
+        !_pluma_mapping_guard_add_region (file->contents, file->length))
+        g_warning ("Too many large files open, truncating %s will crash", path);
+    file->line_index = g_array_new (FALSE, FALSE, sizeof (guint64));
+    file->scanned = 0;
+    file->n_newlines = 0;
+    file->indexed = (file->length == 0);
+
+    g_array_append_val (file->line_index, start);
+
+    return file;
+}
+
+void
+_pluma_large_file_free (PlumaLargeFile *file)
+{
+    if (file == NULL)
+        return;
+
+    g_array_free (file->line_index, TRUE);
+
+    if (file->contents != NULL)
+        _pluma_mapping_guard_remove_region (file->contents);
+
+    g_mapped_file_unref (file->mapped_file);
+    g_close (file->fd, NULL);
+
+    g_slice_free (PlumaLargeFile, file);
+}
+
+/* Forgets about the bytes past the end of the file if it got shorter,
+ * and about the lines indexed in them */
+static void
+update_length (PlumaLargeFile *file)
+{
+    struct stat buf;
+    guint n;
+
+    if (fstat (file->fd, &buf) == -1 || (gsize) buf.st_size >= file->length)
+        return;
+
+    pluma_debug_message (DEBUG_UTILS,
+                         "truncated from %" G_GSIZE_FORMAT " to %" G_GINT64_FORMAT " bytes",
+                         file->length, (gint64) buf.st_size);
+
+    file->length = buf.st_size;
+
+    n = file->line_index->len;
+
+    while (n > 1 && g_array_index (file->line_index, guint64, n - 1) > file->length)
+        n--;
+
+    g_array_set_size (file->line_index, n);
+
+    /* go on indexing from the last line kept */
+    if (file->scanned > file->length)
+    {
+        file->scanned = g_array_index (file->line_index, guint64, n - 1);
+        file->n_newlines = (gint64) (n - 1) * LINE_INDEX_STEP;
+    }
+
+    file->indexed = (file->scanned == file->length);
+}
+
+const gchar *
+_pluma_large_file_get_contents (PlumaLargeFile *file)
+{
+    g_return_val_if_fail (file != NULL, NULL);
+
+    return file->contents;
+}
+
+gsize
+_pluma_large_file_get_length (PlumaLargeFile *file)
+{
+    g_return_val_if_fail (file != NULL, 0);
+
+    update_length (file);
+
+    return file->length;
+}
+
+/* Indexes the lines in the next @max_bytes of the file.
+ * Returns TRUE if there is more to index. */
+gboolean
+_pluma_large_file_build_index (PlumaLargeFile *file,
+                               gsize           max_bytes)
+{
+    const gchar *p;
+    const gchar *end;
+    const gchar *nl;
+
+    g_return_val_if_fail (file != NULL, FALSE);
+
+    update_length (file);
+
+    if (file->indexed)
+        return FALSE;
+
+    p = file->contents + file->scanned;
+    end = file->contents + MIN (file->scanned + max_bytes, file->length);
+
+    while ((nl = memchr (p, '\n', end - p)) != NULL)
+    {
+        file->n_newlines++;
+
+        if (file->n_newlines % LINE_INDEX_STEP == 0)
+        {
+            guint64 offset = nl - file->contents + 1;
+
+            g_array_append_val (file->line_index, offset);
+        }
+
+        p = nl + 1;
+    }
+
+    file->scanned = end - file->contents;
+    file->indexed = (file->scanned == file->length);
+
+    if (file->indexed)
+        pluma_debug_message (DEBUG_UTILS,
+                             "indexed %" G_GINT64_FORMAT " lines",
+                             _pluma_large_file_get_n_lines (file));
+
+    return !file->indexed;
+}
+
+/* Returns the number of lines, not counting the empty one after a
+ * trailing newline like the document does, or -1 if the file is not
+ * fully indexed yet */
+gint64
+_pluma_large_file_get_n_lines (PlumaLargeFile *file)
+{
+    g_return_val_if_fail (file != NULL, -1);
+
+    if (!file->indexed)
+        return -1;
+
+    if (file->length > 0 && file->contents[file->length - 1] == '\n')
+        return file->n_newlines;
+
+    return file->n_newlines + 1;
+}
+
+/* Returns the offset of the start of *@line. If the file has less
+ * lines, *@line is set to the last one. */
+gsize
+_pluma_large_file_get_line_offset (PlumaLargeFile *file,
+                                   gint64         *line)
+{
+    gsize offset;
+    gint64 i;
+
+    g_return_val_if_fail (file != NULL, 0);
+    g_return_val_if_fail (line != NULL, 0);
+
+    update_length (file);
+
+    *line = MAX (*line, 0);
+
+    while (file->n_newlines < *line &&
+           _pluma_large_file_build_index (file, INDEX_CHUNK_SIZE))
+        ;
+
+    if (file->indexed)
+        *line = MIN (*line, _pluma_large_file_get_n_lines (file) - 1);
+
+    offset = g_array_index (file->line_index, guint64, *line / LINE_INDEX_STEP);
+
+    for (i = 0; i < *line % LINE_INDEX_STEP; i++)
+    {
+        const gchar *nl;
+
+        nl = memchr (file->contents + offset, '\n', file->length - offset);
+
+        /* truncated since it was indexed */
+        if (nl == NULL)
+        {
+            *line -= *line % LINE_INDEX_STEP - i;
+            break;
+        }
+
+        offset = nl - file->contents + 1;
+    }
+
+    return offset;
+}
+
+/* Returns the line containing the byte at @offset */
+gint64
+_pluma_large_file_get_line_at_offset (PlumaLargeFile *file,
+                                      gsize           offset)
+{
+    const gchar *p;
+    const gchar *end;
+    const gchar *nl;
+    guint lo, hi;
+    gint64 line;
+
+    g_return_val_if_fail (file != NULL, 0);
+
+    update_length (file);
+
+    offset = MIN (offset, file->length);
+
+    while (file->scanned <= offset &&
+           _pluma_large_file_build_index (file, INDEX_CHUNK_SIZE))
+        ;
+
+    /* last indexed line starting at or before offset */
+    lo = 0;
+    hi = file->line_index->len;
+
+    while (hi - lo > 1)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if (g_array_index (file->line_index, guint64, mid) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    line = (gint64) lo * LINE_INDEX_STEP;
+    p = file->contents + g_array_index (file->line_index, guint64, lo);
+    end = file->contents + offset;
+
+    while ((nl = memchr (p, '\n', end - p)) != NULL)
+    {
+        line++;
+        p = nl + 1;
+    }
+
+    return line;
+}
+
+/* Regex searches run on windows of the mapped bytes: each one starts
+ * with some context before it, for lookbehinds and anchors, and goes on
+ * a little after it for the matches that cross its end */
+#define SEARCH_WINDOW_SIZE (4 * 1024 * 1024)
+#define SEARCH_WINDOW_CONTEXT (64 * 1024)
+
+/* Looks for the first (or the last if @last is TRUE) match of @regex
+ * starting between @start and @end in the text from @context to @limit.
+ * Invalid UTF-8 sequences split the text in parts searched one by one. */
+static gboolean
+find_in_window (PlumaLargeFile *file,
+                GRegex         *regex,
+                gsize           context,
+                gsize           start,
+                gsize           end,
+                gsize           limit,
+                gboolean        last,
+                gsize          *match_start,
+                gsize          *match_end)
+{
+    gboolean found = FALSE;
+
+    while (start < end)
+    {
+        const gchar *valid_end;
+        gsize run_limit;
+
+        valid_end = _pluma_document_output_stream_validate_utf8 (file->contents + context,
+                                                                 limit - context);
+        run_limit = valid_end - file->contents;
+
+        if (run_limit > start)
+        {
+            GMatchInfo *match_info;
+            GRegexMatchFlags match_flags = 0;
+
+            if (context > 0 && file->contents[context - 1] != '\n')
+                match_flags |= G_REGEX_MATCH_NOTBOL;
+
+            if (run_limit < file->length && file->contents[run_limit] != '\n')
+                match_flags |= G_REGEX_MATCH_NOTEOL;
+
+            g_regex_match_full (regex,
+                                file->contents + context,
+                                run_limit - context,
+                                start - context,
+                                match_flags,
+                                &match_info,
+                                NULL);
+
+            while (g_match_info_matches (match_info))
+            {
+                gint s, e;
+
+                g_match_info_fetch_pos (match_info, 0, &s, &e);
+
+                if (context + s >= end)
+                    break;
+
+                *match_start = context + s;
+                *match_end = context + e;
+                found = TRUE;
+
+                if (!last)
+                    break;
+
+                g_match_info_next (match_info, NULL);
+            }
+
+            g_match_info_free (match_info);
+
+            if (found && !last)
+                return TRUE;
+        }
+
+        if (run_limit >= limit)
+            break;
+
+        /* go on after the invalid byte */
+        context = run_limit + 1;
+
+        while (context < limit && (file->contents[context] & 0xc0) == 0x80)
+            context++;
+
+        start = MAX (start, context);
+    }
+
+    return found;
+}
+
+/* Returns the start of the char at or before @pos, going back to the
+ * start of its line if that is close enough */
+static gsize
+find_window_context (PlumaLargeFile *file,
+                     gsize           pos)
+{
+    gsize min;
+    gsize context;
+
+    min = pos > SEARCH_WINDOW_CONTEXT ? pos - SEARCH_WINDOW_CONTEXT : 0;
+
+    for (context = pos; context > min; context--)
+    {
+        if (file->contents[context - 1] == '\n')
+            return context;
+    }
+
+    while (context < pos && (file->contents[context] & 0xc0) == 0x80)
+        context++;
+
+    return context;
+}
+
+/* Returns the end of the line of @pos, or @pos plus the window context
+ * if the line is longer, without going past @to */
+static gsize
+find_window_limit (PlumaLargeFile *file,
+                   gsize           pos,
+                   gsize           to)
+{
+    const gchar *nl;
+    gsize max;
+
+    if (pos >= to)
+        return to;
+
+    max = MIN (to, pos + SEARCH_WINDOW_CONTEXT);
+    nl = memchr (file->contents + pos, '\n', max - pos);
+
+    return nl != NULL ? (gsize) (nl - file->contents) + 1 : max;
+}
+
+/* Looks for a match of @regex starting between @from and @to and
+ * ending before @to, the first one or the last one if @backward is
+ * TRUE. Parts of the file which are not valid UTF-8 are skipped.
+ * A match spanning more than the window context past a window end
+ * is not found. */
+gboolean
+_pluma_large_file_find_regex (PlumaLargeFile *file,
+                              GRegex         *regex,
+                              gsize           from,
+                              gsize           to,
+                              gboolean        backward,
+                              gsize          *match_start,
+                              gsize          *match_end)
+{
+    g_return_val_if_fail (file != NULL, FALSE);
+    g_return_val_if_fail (regex != NULL, FALSE);
+
+    update_length (file);
+
+    to = MIN (to, file->length);
+
+    if (!backward)
+    {
+        gsize start = from;
+
+        while (start < to)
+        {
+            gsize end;
+
+            /* on a char boundary */
+            while (start < to && (file->contents[start] & 0xc0) == 0x80)
+                start++;
+
+            if (start == to)
+                break;
+
+            end = MIN (start + SEARCH_WINDOW_SIZE, to);
+
+            if (find_in_window (file,
+                                regex,
+                                find_window_context (file, start),
+                                start,
+                                end,
+                                find_window_limit (file, end, to),
+                                FALSE,
+                                match_start,
+                                match_end))
+                return TRUE;
+
+            start = end;
+        }
+    }
+    else
+    {
+        gsize end = to;
+
+        while (end > from)
+        {
+            gsize start;
+
+            start = end - from > SEARCH_WINDOW_SIZE ? end - SEARCH_WINDOW_SIZE : from;
+
+            /* on a char boundary */
+            while (start > from && (file->contents[start] & 0xc0) == 0x80)
+                start--;
+
+            if (find_in_window (file,
+                                regex,
+                                find_window_context (file, start),
+                                start,
+                                end,
+                                find_window_limit (file, end, to),
+                                TRUE,
+                                match_start,
+                                match_end))
+                return TRUE;
+
+            end = start;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Returns the first position of @needle in @text, or the last one if
+ * @backward is TRUE. Both are Horspool searches, the backward one
+ * mirrored: the window moves left by the distance from the start of the
+ * needle to the next occurrence of the byte under its first one. */
+static const gchar *
+find_bytes (const gchar *text,
+            gsize        text_len,
+            const gchar *needle,
+            gsize        len,
+            gboolean     backward)
+{
+    gsize skip[256];
+    const gchar *p;
+    gsize i;
+
+    if (text_len < len)
+        return NULL;
+
+    if (!backward)
+    {
+#ifdef HAVE_MEMMEM
+        /* the C library has a vectorized one */
+        return memmem (text, text_len, needle, len);
+#else
+        const gchar *last;
+
+        for (i = 0; i < 256; i++)
+            skip[i] = len;
+
+        for (i = 0; i + 1 < len; i++)
+            skip[(guchar) needle[i]] = len - 1 - i;
+
+        last = text + text_len - len;
+
+        for (p = text; p <= last; p += skip[(guchar) p[len - 1]])
+        {
+            if (p[len - 1] == needle[len - 1] && memcmp (p, needle, len - 1) == 0)
+                return p;
+        }
+
+        return NULL;
+#endif
+    }
+
+    for (i = 0; i < 256; i++)
+        skip[i] = len;
+
+    for (i = len - 1; i > 0; i--)
+        skip[(guchar) needle[i]] = i;
+
+    p = text + text_len - len;
+
+    while (TRUE)
+    {
+        if (p[0] == needle[0] && memcmp (p + 1, needle + 1, len - 1) == 0)
+            return p;
+
+        if ((gsize) (p - text) < skip[(guchar) p[0]])
+            return NULL;
+
+        p -= skip[(guchar) p[0]];
+    }
+}
+
+/* Looks for @needle between @from and @to in the mapped bytes, starting
+ * from @to if @backward is TRUE. Case insensitive searches go through
+ * a regex, see _pluma_large_file_find_regex(). */
+gboolean
+_pluma_large_file_find (PlumaLargeFile *file,
+                        const gchar    *needle,
+                        gsize           from,
+                        gsize           to,
+                        gboolean        case_sensitive,
+                        gboolean        backward,
+                        gsize          *match_start,
+                        gsize          *match_end)
+{
+    const gchar *p;
+    gsize len;
+
+    g_return_val_if_fail (file != NULL, FALSE);
+    g_return_val_if_fail (needle != NULL, FALSE);
+
+    update_length (file);
+
+    len = strlen (needle);
+    to = MIN (to, file->length);
+
+    if (len == 0 || from >= to)
+        return FALSE;
+
+    if (!case_sensitive)
+    {
+        GRegex *regex;
+        gchar *pattern;
+        gboolean found;
+
+        pattern = g_regex_escape_string (needle, -1);
+        regex = _pluma_utils_regex_cache_get (pattern,
+                                              G_REGEX_OPTIMIZE |
+                                              G_REGEX_MULTILINE |
+                                              G_REGEX_CASELESS);
+        g_free (pattern);
+
+        if (regex == NULL)
+            return FALSE;
+
+        found = _pluma_large_file_find_regex (file,
+                                              regex,
+                                              from,
+                                              to,
+                                              backward,
+                                              match_start,
+                                              match_end);
+        g_regex_unref (regex);
+
+        return found;
+    }
+
+    p = find_bytes (file->contents + from, to - from, needle, len, backward);
+
+    if (p == NULL)
+        return FALSE;
+
+    *match_start = p - file->contents;
+    *match_end = *match_start + len;
+
+    return TRUE;
+}
@@ -0,0 +1,75 @@
+/*
+ * pluma-large-file.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_LARGE_FILE_H__
+#define __PLUMA_LARGE_FILE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A file too large to be loaded in a GtkTextBuffer: it is kept mapped
+ * in memory and only the offsets of one line every few are indexed, so
+ * that any range of lines can be paged in the document on demand. */
+typedef struct _PlumaLargeFile PlumaLargeFile;
+
+PlumaLargeFile  *_pluma_large_file_new               (const gchar    *path,
+                                                      GError        **error);
+
+void             _pluma_large_file_free              (PlumaLargeFile *file);
+
+const gchar     *_pluma_large_file_get_contents      (PlumaLargeFile *file);
+
+gsize            _pluma_large_file_get_length        (PlumaLargeFile *file);
+
+gboolean         _pluma_large_file_build_index       (PlumaLargeFile *file,
+                                                      gsize           max_bytes);
+
+gint64           _pluma_large_file_get_n_lines       (PlumaLargeFile *file);
+
+gsize            _pluma_large_file_get_line_offset   (PlumaLargeFile *file,
+                                                      gint64         *line);
+
+gint64           _pluma_large_file_get_line_at_offset
+                                                     (PlumaLargeFile *file,
+                                                      gsize           offset);
+
+gboolean         _pluma_large_file_find              (PlumaLargeFile *file,
+                                                      const gchar    *needle,
+                                                      gsize           from,
+                                                      gsize           to,
+                                                      gboolean        case_sensitive,
+                                                      gboolean        backward,
+                                                      gsize          *match_start,
+                                                      gsize          *match_end);
+
+gboolean         _pluma_large_file_find_regex        (PlumaLargeFile *file,
+                                                      GRegex         *regex,
+                                                      gsize           from,
+                                                      gsize           to,
+                                                      gboolean        backward,
+                                                      gsize          *match_start,
+                                                      gsize          *match_end);
+
+G_END_DECLS
+
+#endif /* __PLUMA_LARGE_FILE_H__ */
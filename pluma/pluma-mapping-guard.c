@@ -0,0 +1,206 @@
+/*
+ * pluma-mapping-guard.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "pluma-mapping-guard.h"
+
+/* Regions are looked up by the signal handler without locking */
+#define MAX_REGIONS 64
+
+typedef struct
+{
+    const gchar * volatile start;
+    volatile gsize         length;
+} Region;
+
+/* the innermost guard set by the current thread */
+static GPrivate current_guard = G_PRIVATE_INIT (NULL);
+
+static Region regions[MAX_REGIONS];
+static GMutex regions_lock;
+
+static struct sigaction previous_action;
+static gsize page_size;
+
+/* Maps zeros over the page at @addr if it belongs to a region */
+static gboolean
+fill_with_zeros (const gchar *addr)
+{
+    gint i;
+
+    for (i = 0; i < MAX_REGIONS; i++)
+    {
+        const gchar *start = regions[i].start;
+        gsize length = regions[i].length;
+
+        if (start != NULL && addr >= start && addr < start + length)
+        {
+            gpointer page;
+
+            page = (gpointer) ((gsize) addr & ~(page_size - 1));
+
+            return mmap (page, page_size, PROT_READ,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                         -1, 0) != MAP_FAILED;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+sigbus_handler (int        signum,
+                siginfo_t *info,
+                void      *context)
+{
+    PlumaMappingGuard *guard;
+    const gchar *addr;
+
+    addr = info->si_addr;
+
+    for (guard = g_private_get (&current_guard); guard != NULL; guard = guard->previous)
+    {
+        if (addr >= guard->start && addr < guard->start + guard->length)
+        {
+            g_private_set (&current_guard, guard->previous);
+            siglongjmp (guard->env, 1);
+        }
+    }
+
+    /* the faulting access is done again on return */
+    if (fill_with_zeros (addr))
+        return;
+
+    /* not a guarded mapping: give the signal back to whoever handled it
+     * before, the faulting access raises it again on return */
+    sigaction (SIGBUS, &previous_action, NULL);
+}
+
+static void
+install_handler (void)
+{
+    static gsize installed = 0;
+
+    if (g_once_init_enter (&installed))
+    {
+        struct sigaction action;
+
+        action.sa_sigaction = sigbus_handler;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset (&action.sa_mask);
+
+        page_size = sysconf (_SC_PAGESIZE);
+        sigaction (SIGBUS, &action, &previous_action);
+
+        g_once_init_leave (&installed, 1);
+    }
+}
+
+/* Starts guarding the reads of the @length bytes mapped at @start in
+ * the current thread, see pluma-mapping-guard.h. Guards can be nested
+ * and must be popped in the reverse order. */
+void
+_pluma_mapping_guard_push (PlumaMappingGuard *guard,
+                           const gchar       *start,
+                           gsize              length)
+{
+    g_return_if_fail (guard != NULL);
+
+    install_handler ();
+
+    guard->start = start;
+    guard->length = length;
+    guard->previous = g_private_get (&current_guard);
+
+    g_private_set (&current_guard, guard);
+}
+
+void
+_pluma_mapping_guard_pop (PlumaMappingGuard *guard)
+{
+    g_return_if_fail (guard != NULL);
+    g_return_if_fail (g_private_get (&current_guard) == guard);
+
+    g_private_set (&current_guard, guard->previous);
+}
+
+/* Makes the pages of the @length bytes mapped at @start read as zeros,
+ * from any thread, once the file is truncated. Returns FALSE if there
+ * are too many regions already. */
+gboolean
+_pluma_mapping_guard_add_region (const gchar *start,
+                                 gsize        length)
+{
+    gboolean added = FALSE;
+    gint i;
+
+    g_return_val_if_fail (start != NULL, FALSE);
+
+    install_handler ();
+
+    g_mutex_lock (&regions_lock);
+
+    for (i = 0; i < MAX_REGIONS && !added; i++)
+    {
+        if (regions[i].start == NULL)
+        {
+            /* the handler skips the slot until the start is set */
+            regions[i].length = length;
+            regions[i].start = start;
+            added = TRUE;
+        }
+    }
+
+    g_mutex_unlock (&regions_lock);
+
+    return added;
+}
+
+/* Must be called before unmapping the region */
+void
+_pluma_mapping_guard_remove_region (const gchar *start)
+{
+    gint i;
+
+    g_return_if_fail (start != NULL);
+
+    g_mutex_lock (&regions_lock);
+
+    for (i = 0; i < MAX_REGIONS; i++)
+    {
+        if (regions[i].start == start)
+        {
+            regions[i].start = NULL;
+            regions[i].length = 0;
+            break;
+        }
+    }
+
+    g_mutex_unlock (&regions_lock);
+}
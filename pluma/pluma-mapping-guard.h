@@ -0,0 +1,81 @@
+/*
+ * pluma-mapping-guard.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_MAPPING_GUARD_H__
+#define __PLUMA_MAPPING_GUARD_H__
+
+#include <setjmp.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Reading the pages of a mapped file past its end raises SIGBUS, which
+ * happens as soon as the file is truncated while it is mapped, e.g. by
+ * logrotate. A guard turns that signal into a jump back to the point it
+ * was set at, in the thread that faulted:
+ *
+ *     _pluma_mapping_guard_push (&guard, contents, length);
+ *
+ *     if (sigsetjmp (guard.env, 1) == 0)
+ *     {
+ *         ... read the mapped bytes ...
+ *         _pluma_mapping_guard_pop (&guard);
+ *     }
+ *     else
+ *     {
+ *         ... the file was truncated, the guard is already popped ...
+ *     }
+ *
+ * The locals changed after sigsetjmp() cannot be used in the second
+ * branch, and the guarded code should only read the mapping: whatever
+ * it was doing when the signal came in is left half done.
+ *
+ * Mappings read from anywhere for a long time can be added as regions
+ * instead: the pages past the end of the file then read as zeros. */
+typedef struct _PlumaMappingGuard PlumaMappingGuard;
+
+struct _PlumaMappingGuard
+{
+    sigjmp_buf          env;
+
+    const gchar        *start;
+    gsize               length;
+
+    PlumaMappingGuard  *previous;
+};
+
+void        _pluma_mapping_guard_push     (PlumaMappingGuard *guard,
+                                           const gchar       *start,
+                                           gsize              length);
+
+void        _pluma_mapping_guard_pop      (PlumaMappingGuard *guard);
+
+gboolean    _pluma_mapping_guard_add_region
+                                          (const gchar       *start,
+                                           gsize              length);
+
+void        _pluma_mapping_guard_remove_region
+                                          (const gchar       *start);
+
+G_END_DECLS
+
+#endif /* __PLUMA_MAPPING_GUARD_H__ */
@@ -0,0 +1,343 @@
+/*
+ * pluma-match-index.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "pluma-match-index.h"
+
+typedef struct
+{
+    gint start;
+    gint end;
+} MatchRange;
+
+struct _PlumaMatchIndex
+{
+    /* sorted by start; since the matches do not overlap the ends are
+     * sorted too */
+    GArray *matches;
+
+    /* the matches from shift_from on are still to be moved by shift:
+     * an edit only moves the ones between it and the previous edit */
+    guint   shift_from;
+    gint    shift;
+};
+
+#define MATCH(index,i) (g_array_index ((index)->matches, MatchRange, (i)))
+
+PlumaMatchIndex *
+_pluma_match_index_new (void)
+{
+    PlumaMatchIndex *index;
+
+    index = g_slice_new (PlumaMatchIndex);
+    index->matches = g_array_new (FALSE, FALSE, sizeof (MatchRange));
+    index->shift_from = 0;
+    index->shift = 0;
+
+    return index;
+}
+
+void
+_pluma_match_index_free (PlumaMatchIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    g_array_free (index->matches, TRUE);
+
+    g_slice_free (PlumaMatchIndex, index);
+}
+
+void
+_pluma_match_index_clear (PlumaMatchIndex *index)
+{
+    g_return_if_fail (index != NULL);
+
+    g_array_set_size (index->matches, 0);
+    index->shift_from = 0;
+    index->shift = 0;
+}
+
+static gint
+get_start (PlumaMatchIndex *index,
+           guint            i)
+{
+    return MATCH (index, i).start + (i >= index->shift_from ? index->shift : 0);
+}
+
+static gint
+get_end (PlumaMatchIndex *index,
+         guint            i)
+{
+    return MATCH (index, i).end + (i >= index->shift_from ? index->shift : 0);
+}
+
+/* Returns the index of the first match starting at or after @offset */
+static guint
+first_starting_at (PlumaMatchIndex *index,
+                   gint             offset)
+{
+    guint lo, hi;
+
+    lo = 0;
+    hi = index->matches->len;
+
+    while (lo < hi)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if (get_start (index, mid) < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Returns the index of the first match ending after @offset */
+static guint
+first_ending_after (PlumaMatchIndex *index,
+                    gint             offset)
+{
+    guint lo, hi;
+
+    lo = 0;
+    hi = index->matches->len;
+
+    while (lo < hi)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if (get_end (index, mid) <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static void
+move_matches (PlumaMatchIndex *index,
+              guint            from,
+              guint            to,
+              gint             delta)
+{
+    guint i;
+
+    for (i = from; i < to; i++)
+    {
+        MATCH (index, i).start += delta;
+        MATCH (index, i).end += delta;
+    }
+}
+
+/* Moves the matches from @from on by @delta, only updating the ones
+ * between @from and the matches already waiting to be moved */
+static void
+shift_matches (PlumaMatchIndex *index,
+               guint            from,
+               gint             delta)
+{
+    if (index->shift == 0)
+    {
+        index->shift_from = from;
+    }
+    else if (from >= index->shift_from)
+    {
+        move_matches (index, index->shift_from, from, index->shift);
+        index->shift_from = from;
+    }
+    else
+    {
+        move_matches (index, from, index->shift_from, delta);
+    }
+
+    index->shift += delta;
+}
+
+static void
+remove_matches (PlumaMatchIndex *index,
+                guint            first,
+                guint            last)
+{
+    if (last <= first)
+        return;
+
+    g_array_remove_range (index->matches, first, last - first);
+
+    if (index->shift_from > first)
+        index->shift_from = MAX (first, index->shift_from - (last - first));
+}
+
+/* The caller makes sure that the match does not overlap the others */
+void
+_pluma_match_index_add (PlumaMatchIndex *index,
+                        gint             start,
+                        gint             end)
+{
+    MatchRange match;
+    guint i;
+
+    g_return_if_fail (index != NULL);
+    g_return_if_fail (start <= end);
+
+    i = first_starting_at (index, start);
+
+    if (i < index->shift_from)
+    {
+        match.start = start;
+        match.end = end;
+        index->shift_from++;
+    }
+    else
+    {
+        match.start = start - index->shift;
+        match.end = end - index->shift;
+    }
+
+    g_array_insert_val (index->matches, i, match);
+}
+
+/* Removes the matches starting between @start and @end */
+void
+_pluma_match_index_remove (PlumaMatchIndex *index,
+                           gint             start,
+                           gint             end)
+{
+    guint first;
+    guint last;
+
+    g_return_if_fail (index != NULL);
+
+    first = first_starting_at (index, start);
+    last = first_starting_at (index, end);
+
+    remove_matches (index, first, last);
+}
+
+void
+_pluma_match_index_text_inserted (PlumaMatchIndex *index,
+                                  gint             offset,
+                                  gint             length)
+{
+    guint first;
+    guint last;
+
+    g_return_if_fail (index != NULL);
+
+    /* drop the matches the text was inserted into */
+    first = first_ending_after (index, offset);
+    last = first_starting_at (index, offset);
+
+    remove_matches (index, first, last);
+
+    shift_matches (index, first, length);
+}
+
+void
+_pluma_match_index_text_deleted (PlumaMatchIndex *index,
+                                 gint             offset,
+                                 gint             length)
+{
+    guint first;
+    guint last;
+
+    g_return_if_fail (index != NULL);
+
+    /* drop the matches overlapping the deleted text */
+    first = first_ending_after (index, offset);
+    last = first_starting_at (index, offset + length);
+
+    remove_matches (index, first, last);
+
+    shift_matches (index, first, -length);
+}
+
+gint
+_pluma_match_index_get_n_matches (PlumaMatchIndex *index)
+{
+    g_return_val_if_fail (index != NULL, 0);
+
+    return index->matches->len;
+}
+
+gboolean
+_pluma_match_index_get_nth (PlumaMatchIndex *index,
+                            gint             n,
+                            gint            *start,
+                            gint            *end)
+{
+    g_return_val_if_fail (index != NULL, FALSE);
+
+    if (n < 0 || (guint) n >= index->matches->len)
+        return FALSE;
+
+    if (start != NULL)
+        *start = get_start (index, n);
+
+    if (end != NULL)
+        *end = get_end (index, n);
+
+    return TRUE;
+}
+
+/* Returns the number of the match starting at @start, or -1 */
+gint
+_pluma_match_index_lookup (PlumaMatchIndex *index,
+                           gint             start)
+{
+    guint i;
+
+    g_return_val_if_fail (index != NULL, -1);
+
+    i = first_starting_at (index, start);
+
+    if (i < index->matches->len && get_start (index, i) == start)
+        return i;
+
+    return -1;
+}
+
+/* Returns the number of the first match starting at or after @offset,
+ * or of the last one starting before it if @forward is FALSE, or -1 if
+ * there is none */
+gint
+_pluma_match_index_find (PlumaMatchIndex *index,
+                         gint             offset,
+                         gboolean         forward)
+{
+    guint i;
+
+    g_return_val_if_fail (index != NULL, -1);
+
+    i = first_starting_at (index, offset);
+
+    if (forward)
+        return i < index->matches->len ? (gint) i : -1;
+
+    return (gint) i - 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * pluma-match-index.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_MATCH_INDEX_H__
+#define __PLUMA_MATCH_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The matches of the search text in a document, as character offsets
+ * sorted by position, so that the number of a match and the n-th match
+ * are found with a binary search. The matches never overlap. The owner
+ * fills the index and tells it about the changes of the text: the
+ * matches after a change are moved, the ones the change cut through are
+ * dropped, and the owner has to search the changed lines again. */
+typedef struct _PlumaMatchIndex PlumaMatchIndex;
+
+PlumaMatchIndex *_pluma_match_index_new           (void);
+
+void             _pluma_match_index_free          (PlumaMatchIndex *index);
+
+void             _pluma_match_index_clear         (PlumaMatchIndex *index);
+
+void             _pluma_match_index_add           (PlumaMatchIndex *index,
+                                                   gint             start,
+                                                   gint             end);
+
+void             _pluma_match_index_remove        (PlumaMatchIndex *index,
+                                                   gint             start,
+                                                   gint             end);
+
+void             _pluma_match_index_text_inserted (PlumaMatchIndex *index,
+                                                   gint             offset,
+                                                   gint             length);
+
+void             _pluma_match_index_text_deleted  (PlumaMatchIndex *index,
+                                                   gint             offset,
+                                                   gint             length);
+
+gint             _pluma_match_index_get_n_matches (PlumaMatchIndex *index);
+
+gboolean         _pluma_match_index_get_nth       (PlumaMatchIndex *index,
+                                                   gint             n,
+                                                   gint            *start,
+                                                   gint            *end);
+
+gint             _pluma_match_index_lookup        (PlumaMatchIndex *index,
+                                                   gint             start);
+
+gint             _pluma_match_index_find          (PlumaMatchIndex *index,
+                                                   gint             offset,
+                                                   gboolean         forward);
+
+G_END_DECLS
+
+#endif /* __PLUMA_MATCH_INDEX_H__ */
@@ -0,0 +1,1239 @@
+/*
+ * pluma-search-results-panel.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib/gi18n.h>
+
+#include "pluma-search-results-panel.h"
+#include "pluma-debug.h"
+#include "pluma-document.h"
+#include "pluma-find-in-files.h"
+#include "pluma-tab.h"
+#include "pluma-utils.h"
+#include "pluma-view.h"
+
+/* Matches listed per document, the ones after are only counted */
+#define MAX_RESULTS_PER_DOCUMENT 1000
+
+/* An edited document is searched again once it has not changed for
+ * this long (ms) */
+#define RESEARCH_DELAY 500
+
+/* The documents are searched on a copy of their text, on threads, and
+ * only the results come back to the main thread: a GtkTextBuffer cannot
+ * be used out of it. */
+typedef struct
+{
+	PlumaSearchResultsPanel *panel;
+	PlumaDocument           *doc;
+	GCancellable            *cancellable;
+
+	gchar                   *text;
+	gsize                    length;
+	GRegex                  *regex;
+	gboolean                 entire_word;
+
+	GArray                  *results;
+	gint                     n_matches;
+} SearchJob;
+
+typedef struct
+{
+	PlumaSearchResultsPanel *panel;
+	PlumaDocument           *doc;
+
+	GtkTreeRowReference     *row;
+	gulong                   changed_id;
+	guint                    research_timeout;
+
+	/* the running job, if any */
+	GCancellable            *cancellable;
+
+	gint                     n_matches;
+} DocumentState;
+
+struct _PlumaSearchResultsPanelPrivate
+{
+	/* not a reference: the window owns the panel */
+	PlumaWindow  *window;
+
+	GtkWidget    *status_label;
+	GtkWidget    *treeview;
+	GtkTreeStore *store;
+
+	GRegex       *regex;
+	gboolean      entire_word;
+
+	/* PlumaDocument -> DocumentState */
+	GHashTable   *documents;
+	gint          n_searching;
+
+	/* when searching the files of a folder rather than the documents */
+	gchar            *root;
+	PlumaFindInFiles *files_search;
+	guint             n_searched_files;
+	guint             n_skipped_files;
+	gint              n_file_matches;
+	gint              n_files;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (PlumaSearchResultsPanel, pluma_search_results_panel, GTK_TYPE_BOX)
+
+enum
+{
+	PROP_0,
+	PROP_WINDOW
+};
+
+enum
+{
+	MARKUP_COLUMN,
+	DOCUMENT_COLUMN,
+	LINE_COLUMN,
+	LINE_OFFSET_COLUMN,
+	LENGTH_COLUMN,
+	URI_COLUMN,
+	N_COLUMNS
+};
+
+/* A match to select once its file is loaded */
+typedef struct
+{
+	PlumaWindow *window;
+	gint         line;
+	gint         line_offset;
+	gint         length;
+} PendingMatch;
+
+static gboolean search_job_done (SearchJob *job);
+
+/* Runs on a search thread */
+static void
+search_job_run (SearchJob *job,
+		gpointer   user_data)
+{
+	if (!g_cancellable_is_cancelled (job->cancellable))
+		job->n_matches = _pluma_search_scan_text (job->text,
+							  job->length,
+							  job->regex,
+							  job->entire_word,
+							  MAX_RESULTS_PER_DOCUMENT,
+							  job->cancellable,
+							  job->results);
+
+	g_idle_add ((GSourceFunc) search_job_done, job);
+}
+
+static void
+search_job_free (SearchJob *job)
+{
+	_pluma_search_matches_free (job->results);
+	g_free (job->text);
+	g_regex_unref (job->regex);
+	g_object_unref (job->cancellable);
+	g_object_unref (job->doc);
+
+	g_slice_free (SearchJob, job);
+}
+
+static gboolean
+get_document_iter (PlumaSearchResultsPanel *panel,
+		   DocumentState           *state,
+		   GtkTreeIter             *iter)
+{
+	GtkTreePath *path;
+	gboolean ret;
+
+	if (state->row == NULL || !gtk_tree_row_reference_valid (state->row))
+		return FALSE;
+
+	path = gtk_tree_row_reference_get_path (state->row);
+	ret = gtk_tree_model_get_iter (GTK_TREE_MODEL (panel->priv->store), iter, path);
+	gtk_tree_path_free (path);
+
+	return ret;
+}
+
+static void
+update_document_row (PlumaSearchResultsPanel *panel,
+		     DocumentState           *state)
+{
+	GtkTreeIter iter;
+	gchar *name;
+	gchar *escaped;
+	gchar *markup;
+
+	if (!get_document_iter (panel, state, &iter))
+		return;
+
+	name = pluma_document_get_short_name_for_display (state->doc);
+	escaped = g_markup_escape_text (name, -1);
+
+	if (state->cancellable != NULL)
+		markup = g_strdup_printf ("<b>%s</b>", escaped);
+	else if (state->n_matches > MAX_RESULTS_PER_DOCUMENT)
+		markup = g_strdup_printf (_("<b>%s</b> (%d matches, the first %d are listed)"),
+					  escaped,
+					  state->n_matches,
+					  MAX_RESULTS_PER_DOCUMENT);
+	else
+		markup = g_strdup_printf (ngettext ("<b>%s</b> (%d match)",
+						    "<b>%s</b> (%d matches)",
+						    state->n_matches),
+					  escaped,
+					  state->n_matches);
+
+	gtk_tree_store_set (panel->priv->store,
+			    &iter,
+			    MARKUP_COLUMN, markup,
+			    -1);
+
+	g_free (markup);
+	g_free (escaped);
+	g_free (name);
+}
+
+static void
+set_matches_status (PlumaSearchResultsPanel *panel,
+		    gint                     n_matches,
+		    const gchar             *where)
+{
+	gchar *matches;
+	gchar *text;
+
+	if (n_matches == 0)
+	{
+		gtk_label_set_text (GTK_LABEL (panel->priv->status_label),
+				    _("No matches found"));
+		return;
+	}
+
+	matches = g_strdup_printf (ngettext ("%d match", "%d matches", n_matches),
+				   n_matches);
+	/* Translators: the first %s is "%d match(es)", the second one
+	 * "%d document(s)" or "%d file(s)" */
+	text = g_strdup_printf (_("%s in %s"), matches, where);
+
+	gtk_label_set_text (GTK_LABEL (panel->priv->status_label), text);
+
+	g_free (text);
+	g_free (matches);
+}
+
+static void
+update_files_status (PlumaSearchResultsPanel *panel)
+{
+	gchar *text;
+
+	if (panel->priv->files_search != NULL)
+	{
+		guint n_searched;
+
+		n_searched = _pluma_find_in_files_get_n_searched (panel->priv->files_search);
+		text = g_strdup_printf (ngettext ("Searching\342\200\246 %u file searched",
+						  "Searching\342\200\246 %u files searched",
+						  n_searched),
+					n_searched);
+
+		gtk_label_set_text (GTK_LABEL (panel->priv->status_label), text);
+	}
+	else
+	{
+		text = g_strdup_printf (ngettext ("%d file", "%d files", panel->priv->n_files),
+					panel->priv->n_files);
+
+		set_matches_status (panel, panel->priv->n_file_matches, text);
+
+		/* the files in an encoding none of the candidates could read */
+		if (panel->priv->n_skipped_files > 0)
+		{
+			gchar *status;
+
+			status = g_strdup_printf (ngettext ("%s (%u file could not be read)",
+							    "%s (%u files could not be read)",
+							    panel->priv->n_skipped_files),
+						  gtk_label_get_text (GTK_LABEL (panel->priv->status_label)),
+						  panel->priv->n_skipped_files);
+
+			gtk_label_set_text (GTK_LABEL (panel->priv->status_label), status);
+			g_free (status);
+		}
+	}
+
+	g_free (text);
+}
+
+static void
+update_status (PlumaSearchResultsPanel *panel)
+{
+	GHashTableIter iter;
+	DocumentState *state;
+	gint n_matches = 0;
+	gint n_documents = 0;
+	gchar *text;
+
+	if (panel->priv->regex == NULL)
+	{
+		gtk_label_set_text (GTK_LABEL (panel->priv->status_label), "");
+		return;
+	}
+
+	if (panel->priv->root != NULL)
+	{
+		update_files_status (panel);
+		return;
+	}
+
+	if (panel->priv->n_searching > 0)
+	{
+		text = g_strdup_printf (ngettext ("Searching %d document\342\200\246",
+						  "Searching %d documents\342\200\246",
+						  panel->priv->n_searching),
+					panel->priv->n_searching);
+
+		gtk_label_set_text (GTK_LABEL (panel->priv->status_label), text);
+		g_free (text);
+
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, panel->priv->documents);
+
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &state))
+	{
+		if (state->n_matches > 0)
+		{
+			n_matches += state->n_matches;
+			n_documents++;
+		}
+	}
+
+	text = g_strdup_printf (ngettext ("%d document", "%d documents", n_documents),
+				n_documents);
+
+	set_matches_status (panel, n_matches, text);
+
+	g_free (text);
+}
+
+static void
+cancel_job (PlumaSearchResultsPanel *panel,
+	    DocumentState           *state)
+{
+	if (state->cancellable == NULL)
+		return;
+
+	/* the job frees itself once back on the main thread */
+	g_cancellable_cancel (state->cancellable);
+	g_clear_object (&state->cancellable);
+
+	panel->priv->n_searching--;
+}
+
+static void
+start_job (PlumaSearchResultsPanel *panel,
+	   DocumentState           *state)
+{
+	SearchJob *job;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	cancel_job (panel, state);
+
+	state->cancellable = g_cancellable_new ();
+	panel->priv->n_searching++;
+
+	job = g_slice_new0 (SearchJob);
+	job->panel = panel;
+	job->doc = g_object_ref (state->doc);
+	job->cancellable = g_object_ref (state->cancellable);
+	job->regex = g_regex_ref (panel->priv->regex);
+	job->entire_word = panel->priv->entire_word;
+	job->results = _pluma_search_matches_new ();
+
+	/* copying the text is all the main thread does */
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (state->doc), &start, &end);
+	job->text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (state->doc), &start, &end, TRUE);
+	job->length = strlen (job->text);
+
+	_pluma_search_pool_push ((GFunc) search_job_run, job);
+}
+
+static void
+show_results (PlumaSearchResultsPanel *panel,
+	      DocumentState           *state,
+	      SearchJob               *job)
+{
+	GtkTreeIter parent;
+	GtkTreeIter child;
+	GtkTreePath *path;
+	guint i;
+
+	state->n_matches = job->n_matches;
+
+	if (!get_document_iter (panel, state, &parent))
+	{
+		if (job->n_matches == 0)
+			return;
+
+		/* it had no matches the last time */
+		gtk_tree_store_append (panel->priv->store, &parent, NULL);
+		gtk_tree_store_set (panel->priv->store,
+				    &parent,
+				    DOCUMENT_COLUMN, state->doc,
+				    LINE_COLUMN, -1,
+				    -1);
+
+		path = gtk_tree_model_get_path (GTK_TREE_MODEL (panel->priv->store), &parent);
+		gtk_tree_row_reference_free (state->row);
+		state->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (panel->priv->store), path);
+		gtk_tree_path_free (path);
+	}
+	else if (job->n_matches == 0)
+	{
+		gtk_tree_store_remove (panel->priv->store, &parent);
+		gtk_tree_row_reference_free (state->row);
+		state->row = NULL;
+
+		return;
+	}
+
+	while (gtk_tree_model_iter_children (GTK_TREE_MODEL (panel->priv->store), &child, &parent))
+		gtk_tree_store_remove (panel->priv->store, &child);
+
+	for (i = 0; i < job->results->len; i++)
+	{
+		PlumaSearchMatch *match = &g_array_index (job->results, PlumaSearchMatch, i);
+
+		gtk_tree_store_insert_with_values (panel->priv->store,
+						   &child,
+						   &parent,
+						   -1,
+						   MARKUP_COLUMN, match->markup,
+						   DOCUMENT_COLUMN, state->doc,
+						   LINE_COLUMN, match->line,
+						   LINE_OFFSET_COLUMN, match->line_offset,
+						   LENGTH_COLUMN, match->length,
+						   -1);
+	}
+
+	update_document_row (panel, state);
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (panel->priv->store), &parent);
+	gtk_tree_view_expand_row (GTK_TREE_VIEW (panel->priv->treeview), path, FALSE);
+	gtk_tree_path_free (path);
+}
+
+static gboolean
+search_job_done (SearchJob *job)
+{
+	PlumaSearchResultsPanel *panel = job->panel;
+	DocumentState *state;
+
+	/* the panel may be gone if the job was cancelled */
+	if (g_cancellable_is_cancelled (job->cancellable))
+	{
+		search_job_free (job);
+		return FALSE;
+	}
+
+	state = g_hash_table_lookup (panel->priv->documents, job->doc);
+	g_return_val_if_fail (state != NULL && state->cancellable == job->cancellable, FALSE);
+
+	pluma_debug_message (DEBUG_SEARCH,
+			     "%d matches in %" G_GSIZE_FORMAT " bytes",
+			     job->n_matches,
+			     job->length);
+
+	g_clear_object (&state->cancellable);
+	panel->priv->n_searching--;
+
+	show_results (panel, state, job);
+	update_status (panel);
+
+	search_job_free (job);
+
+	return FALSE;
+}
+
+static gboolean
+research_timeout (DocumentState *state)
+{
+	state->research_timeout = 0;
+
+	start_job (state->panel, state);
+
+	update_document_row (state->panel, state);
+	update_status (state->panel);
+
+	return FALSE;
+}
+
+static void
+document_changed (PlumaDocument *doc,
+		  DocumentState *state)
+{
+	/* the results of a running job would be out of date already */
+	cancel_job (state->panel, state);
+
+	if (state->research_timeout != 0)
+		g_source_remove (state->research_timeout);
+
+	state->research_timeout = g_timeout_add (RESEARCH_DELAY,
+						 (GSourceFunc) research_timeout,
+						 state);
+}
+
+static void
+document_state_free (DocumentState *state)
+{
+	GtkTreeIter iter;
+
+	cancel_job (state->panel, state);
+
+	if (state->research_timeout != 0)
+		g_source_remove (state->research_timeout);
+
+	g_signal_handler_disconnect (state->doc, state->changed_id);
+
+	if (get_document_iter (state->panel, state, &iter))
+		gtk_tree_store_remove (state->panel->priv->store, &iter);
+
+	gtk_tree_row_reference_free (state->row);
+	g_object_unref (state->doc);
+
+	g_slice_free (DocumentState, state);
+}
+
+/* The documents of the tabs busy loading or saving for instance are
+ * left alone, and so are the large files: only a part of them is
+ * loaded in the document */
+static gboolean
+can_search_document (PlumaDocument *doc)
+{
+	PlumaTab *tab;
+
+	if (_pluma_document_is_large_file (doc))
+		return FALSE;
+
+	tab = pluma_tab_get_from_document (doc);
+
+	return (tab == NULL) || (pluma_tab_get_state (tab) == PLUMA_TAB_STATE_NORMAL);
+}
+
+static void
+add_document (PlumaSearchResultsPanel *panel,
+	      PlumaDocument           *doc)
+{
+	DocumentState *state;
+	GtkTreeIter iter;
+	GtkTreePath *path;
+
+	if (!can_search_document (doc))
+		return;
+
+	state = g_slice_new0 (DocumentState);
+	state->panel = panel;
+	state->doc = g_object_ref (doc);
+
+	/* the rows are added in the order of the tabs, the results fill
+	 * them in as they come */
+	gtk_tree_store_append (panel->priv->store, &iter, NULL);
+	gtk_tree_store_set (panel->priv->store,
+			    &iter,
+			    DOCUMENT_COLUMN, doc,
+			    LINE_COLUMN, -1,
+			    -1);
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (panel->priv->store), &iter);
+	state->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (panel->priv->store), path);
+	gtk_tree_path_free (path);
+
+	state->changed_id = g_signal_connect (doc,
+					      "changed",
+					      G_CALLBACK (document_changed),
+					      state);
+
+	g_hash_table_insert (panel->priv->documents, doc, state);
+
+	start_job (panel, state);
+	update_document_row (panel, state);
+}
+
+static void
+cancel_files_search (PlumaSearchResultsPanel *panel)
+{
+	if (panel->priv->files_search != NULL)
+	{
+		_pluma_find_in_files_cancel (panel->priv->files_search);
+		panel->priv->files_search = NULL;
+	}
+
+	g_free (panel->priv->root);
+	panel->priv->root = NULL;
+}
+
+static void
+clear_results (PlumaSearchResultsPanel *panel)
+{
+	cancel_files_search (panel);
+
+	g_hash_table_remove_all (panel->priv->documents);
+	gtk_tree_store_clear (panel->priv->store);
+
+	panel->priv->n_searched_files = 0;
+	panel->priv->n_skipped_files = 0;
+	panel->priv->n_file_matches = 0;
+	panel->priv->n_files = 0;
+
+	if (panel->priv->regex != NULL)
+	{
+		g_regex_unref (panel->priv->regex);
+		panel->priv->regex = NULL;
+	}
+
+	update_status (panel);
+}
+
+static void
+add_file_result (PlumaSearchResultsPanel *panel,
+		 PlumaFindInFilesResult  *result)
+{
+	GtkTreeIter parent;
+	GtkTreeIter child;
+	GtkTreePath *path;
+	gchar *escaped;
+	gchar *markup;
+	guint i;
+
+	escaped = g_markup_escape_text (result->relative_path, -1);
+
+	if ((guint) result->n_matches > result->matches->len)
+		markup = g_strdup_printf (_("<b>%s</b> (%d matches, the first %d are listed)"),
+					  escaped,
+					  result->n_matches,
+					  result->matches->len);
+	else
+		markup = g_strdup_printf (ngettext ("<b>%s</b> (%d match)",
+						    "<b>%s</b> (%d matches)",
+						    result->n_matches),
+					  escaped,
+					  result->n_matches);
+
+	gtk_tree_store_insert_with_values (panel->priv->store,
+					   &parent,
+					   NULL,
+					   -1,
+					   MARKUP_COLUMN, markup,
+					   LINE_COLUMN, -1,
+					   URI_COLUMN, result->uri,
+					   -1);
+
+	g_free (markup);
+	g_free (escaped);
+
+	for (i = 0; i < result->matches->len; i++)
+	{
+		PlumaSearchMatch *match = &g_array_index (result->matches, PlumaSearchMatch, i);
+
+		gtk_tree_store_insert_with_values (panel->priv->store,
+						   &child,
+						   &parent,
+						   -1,
+						   MARKUP_COLUMN, match->markup,
+						   LINE_COLUMN, match->line,
+						   LINE_OFFSET_COLUMN, match->line_offset,
+						   LENGTH_COLUMN, match->length,
+						   URI_COLUMN, result->uri,
+						   -1);
+	}
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (panel->priv->store), &parent);
+	gtk_tree_view_expand_row (GTK_TREE_VIEW (panel->priv->treeview), path, FALSE);
+	gtk_tree_path_free (path);
+
+	panel->priv->n_file_matches += result->n_matches;
+	panel->priv->n_files++;
+}
+
+/* Called every so often while the files are searched, with the ones
+ * which matched in the meantime */
+static void
+files_found (PlumaFindInFiles        *search,
+	     GPtrArray               *results,
+	     gboolean                 finished,
+	     PlumaSearchResultsPanel *panel)
+{
+	guint i;
+
+	for (i = 0; i < results->len; i++)
+		add_file_result (panel, g_ptr_array_index (results, i));
+
+	if (finished)
+	{
+		panel->priv->n_searched_files = _pluma_find_in_files_get_n_searched (search);
+		panel->priv->n_skipped_files = _pluma_find_in_files_get_n_skipped (search);
+
+		pluma_debug_message (DEBUG_SEARCH,
+				     "%d matches in %d of %u files",
+				     panel->priv->n_file_matches,
+				     panel->priv->n_files,
+				     panel->priv->n_searched_files);
+
+		_pluma_find_in_files_cancel (search);
+		panel->priv->files_search = NULL;
+	}
+
+	update_status (panel);
+}
+
+static void
+window_tab_removed (PlumaWindow             *window,
+		    PlumaTab                *tab,
+		    PlumaSearchResultsPanel *panel)
+{
+	g_hash_table_remove (panel->priv->documents,
+			     pluma_tab_get_document (tab));
+
+	update_status (panel);
+}
+
+static void
+jump_to_match (PlumaWindow   *window,
+	       PlumaDocument *doc,
+	       gint           line,
+	       gint           line_offset,
+	       gint           length)
+{
+	PlumaTab *tab;
+	PlumaView *view;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	tab = pluma_tab_get_from_document (doc);
+	g_return_if_fail (tab != NULL);
+
+	pluma_window_set_active_tab (window, tab);
+
+	/* the document may have been edited since it was searched */
+	gtk_text_buffer_get_iter_at_line (GTK_TEXT_BUFFER (doc), &start, line);
+
+	if (gtk_text_iter_get_line (&start) == line &&
+	    line_offset <= gtk_text_iter_get_chars_in_line (&start))
+		gtk_text_iter_set_line_offset (&start, line_offset);
+
+	end = start;
+	gtk_text_iter_forward_chars (&end, length);
+
+	gtk_text_buffer_select_range (GTK_TEXT_BUFFER (doc), &start, &end);
+
+	view = pluma_tab_get_view (tab);
+	pluma_view_scroll_to_cursor (view);
+	gtk_widget_grab_focus (GTK_WIDGET (view));
+}
+
+static void
+pending_match_free (PendingMatch *match,
+		    GClosure     *closure)
+{
+	g_slice_free (PendingMatch, match);
+}
+
+static void
+opened_document_loaded (PlumaDocument *doc,
+			const GError  *error,
+			PendingMatch  *match)
+{
+	PendingMatch copy = *match;
+
+	/* frees @match */
+	g_signal_handlers_disconnect_by_func (doc, opened_document_loaded, match);
+
+	if (error == NULL)
+		jump_to_match (copy.window, doc, copy.line, copy.line_offset, copy.length);
+}
+
+/* The files found by a folder search are opened when a match is
+ * activated, unless they already are */
+static void
+jump_to_file_match (PlumaSearchResultsPanel *panel,
+		    const gchar             *uri,
+		    gint                     line,
+		    gint                     line_offset,
+		    gint                     length)
+{
+	GFile *location;
+	PlumaTab *tab;
+
+	location = g_file_new_for_uri (uri);
+	tab = pluma_window_get_tab_from_location (panel->priv->window, location);
+	g_object_unref (location);
+
+	if (tab != NULL)
+	{
+		if (pluma_tab_get_state (tab) != PLUMA_TAB_STATE_LOADING &&
+		    pluma_tab_get_state (tab) != PLUMA_TAB_STATE_REVERTING)
+		{
+			jump_to_match (panel->priv->window,
+				       pluma_tab_get_document (tab),
+				       line,
+				       line_offset,
+				       length);
+			return;
+		}
+	}
+	else
+	{
+		tab = pluma_window_create_tab_from_uri (panel->priv->window,
+							uri,
+							NULL,
+							line + 1,
+							FALSE,
+							TRUE);
+
+		if (tab == NULL)
+			return;
+	}
+
+	{
+		PendingMatch *match;
+
+		match = g_slice_new (PendingMatch);
+		match->window = panel->priv->window;
+		match->line = line;
+		match->line_offset = line_offset;
+		match->length = length;
+
+		g_signal_connect_data (pluma_tab_get_document (tab),
+				       "loaded",
+				       G_CALLBACK (opened_document_loaded),
+				       match,
+				       (GClosureNotify) pending_match_free,
+				       G_CONNECT_AFTER);
+	}
+}
+
+static void
+treeview_row_activated (GtkTreeView             *treeview,
+			GtkTreePath             *path,
+			GtkTreeViewColumn       *column,
+			PlumaSearchResultsPanel *panel)
+{
+	GtkTreeIter iter;
+	PlumaDocument *doc;
+	gchar *uri;
+	gint line;
+	gint line_offset;
+	gint length;
+
+	/* the window is being destroyed */
+	if (panel->priv->window == NULL)
+		return;
+
+	if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (panel->priv->store), &iter, path))
+		return;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (panel->priv->store),
+			    &iter,
+			    DOCUMENT_COLUMN, &doc,
+			    LINE_COLUMN, &line,
+			    LINE_OFFSET_COLUMN, &line_offset,
+			    LENGTH_COLUMN, &length,
+			    URI_COLUMN, &uri,
+			    -1);
+
+	if (line >= 0 && doc != NULL)
+		jump_to_match (panel->priv->window, doc, line, line_offset, length);
+	else if (line >= 0 && uri != NULL)
+		jump_to_file_match (panel, uri, line, line_offset, length);
+	else if (gtk_tree_view_row_expanded (treeview, path))
+		gtk_tree_view_collapse_row (treeview, path);
+	else
+		gtk_tree_view_expand_row (treeview, path, FALSE);
+
+	if (doc != NULL)
+		g_object_unref (doc);
+
+	g_free (uri);
+}
+
+static void
+set_window (PlumaSearchResultsPanel *panel,
+	    PlumaWindow             *window)
+{
+	g_return_if_fail (panel->priv->window == NULL);
+	g_return_if_fail (PLUMA_IS_WINDOW (window));
+
+	panel->priv->window = window;
+	g_object_add_weak_pointer (G_OBJECT (window),
+				   (gpointer *) &panel->priv->window);
+
+	g_signal_connect (window,
+			  "tab_removed",
+			  G_CALLBACK (window_tab_removed),
+			  panel);
+}
+
+static void
+pluma_search_results_panel_set_property (GObject      *object,
+					 guint         prop_id,
+					 const GValue *value,
+					 GParamSpec   *pspec)
+{
+	PlumaSearchResultsPanel *panel = PLUMA_SEARCH_RESULTS_PANEL (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			set_window (panel, g_value_get_object (value));
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+pluma_search_results_panel_get_property (GObject    *object,
+					 guint       prop_id,
+					 GValue     *value,
+					 GParamSpec *pspec)
+{
+	PlumaSearchResultsPanel *panel = PLUMA_SEARCH_RESULTS_PANEL (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			g_value_set_object (value, panel->priv->window);
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+pluma_search_results_panel_dispose (GObject *object)
+{
+	PlumaSearchResultsPanel *panel = PLUMA_SEARCH_RESULTS_PANEL (object);
+
+	cancel_files_search (panel);
+
+	/* cancels the running jobs too */
+	if (panel->priv->documents != NULL)
+	{
+		g_hash_table_destroy (panel->priv->documents);
+		panel->priv->documents = NULL;
+	}
+
+	g_clear_object (&panel->priv->store);
+
+	if (panel->priv->regex != NULL)
+	{
+		g_regex_unref (panel->priv->regex);
+		panel->priv->regex = NULL;
+	}
+
+	if (panel->priv->window != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (panel->priv->window,
+						      window_tab_removed,
+						      panel);
+
+		g_object_remove_weak_pointer (G_OBJECT (panel->priv->window),
+					      (gpointer *) &panel->priv->window);
+		panel->priv->window = NULL;
+	}
+
+	G_OBJECT_CLASS (pluma_search_results_panel_parent_class)->dispose (object);
+}
+
+static void
+pluma_search_results_panel_class_init (PlumaSearchResultsPanelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = pluma_search_results_panel_dispose;
+	object_class->get_property = pluma_search_results_panel_get_property;
+	object_class->set_property = pluma_search_results_panel_set_property;
+
+	g_object_class_install_property (object_class,
+					 PROP_WINDOW,
+					 g_param_spec_object ("window",
+							      "Window",
+							      "The PlumaWindow this PlumaSearchResultsPanel is associated with",
+							      PLUMA_TYPE_WINDOW,
+							      G_PARAM_READWRITE |
+							      G_PARAM_CONSTRUCT_ONLY |
+							      G_PARAM_STATIC_STRINGS));
+}
+
+static void
+pluma_search_results_panel_init (PlumaSearchResultsPanel *panel)
+{
+	GtkWidget         *sw;
+	GtkTreeViewColumn *column;
+	GtkCellRenderer   *cell;
+
+	panel->priv = pluma_search_results_panel_get_instance_private (panel);
+
+	panel->priv->documents = g_hash_table_new_full (g_direct_hash,
+							g_direct_equal,
+							NULL,
+							(GDestroyNotify) document_state_free);
+
+	gtk_orientable_set_orientation (GTK_ORIENTABLE (panel),
+	                                GTK_ORIENTATION_VERTICAL);
+	gtk_box_set_spacing (GTK_BOX (panel), 6);
+
+	panel->priv->status_label = gtk_label_new (NULL);
+	gtk_label_set_xalign (GTK_LABEL (panel->priv->status_label), 0.0);
+	gtk_widget_show (panel->priv->status_label);
+	gtk_box_pack_start (GTK_BOX (panel), panel->priv->status_label, FALSE, FALSE, 0);
+
+	sw = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw),
+					GTK_POLICY_AUTOMATIC,
+					GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (sw),
+					     GTK_SHADOW_IN);
+	gtk_widget_show (sw);
+	gtk_box_pack_start (GTK_BOX (panel), sw, TRUE, TRUE, 0);
+
+	/* kept until dispose, the rows of the documents are removed then */
+	panel->priv->store = gtk_tree_store_new (N_COLUMNS,
+						 G_TYPE_STRING,
+						 PLUMA_TYPE_DOCUMENT,
+						 G_TYPE_INT,
+						 G_TYPE_INT,
+						 G_TYPE_INT,
+						 G_TYPE_STRING);
+
+	panel->priv->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (panel->priv->store));
+	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (panel->priv->treeview), FALSE);
+	gtk_tree_view_set_enable_search (GTK_TREE_VIEW (panel->priv->treeview), FALSE);
+	gtk_container_add (GTK_CONTAINER (sw), panel->priv->treeview);
+	gtk_widget_show (panel->priv->treeview);
+
+	column = gtk_tree_view_column_new ();
+	cell = gtk_cell_renderer_text_new ();
+	gtk_tree_view_column_pack_start (column, cell, TRUE);
+	gtk_tree_view_column_add_attribute (column, cell, "markup", MARKUP_COLUMN);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (panel->priv->treeview), column);
+
+	g_signal_connect (panel->priv->treeview,
+			  "row-activated",
+			  G_CALLBACK (treeview_row_activated),
+			  panel);
+}
+
+GtkWidget *
+pluma_search_results_panel_new (PlumaWindow *window)
+{
+	g_return_val_if_fail (PLUMA_IS_WINDOW (window), NULL);
+
+	return GTK_WIDGET (g_object_new (PLUMA_TYPE_SEARCH_RESULTS_PANEL,
+					 "window", window,
+					 NULL));
+}
+
+/* Plain text is searched as an escaped regex, like Replace All does.
+ * Sets *@literal to the string a file has to contain to match, when
+ * there is one. */
+static GRegex *
+compile_search_regex (const gchar  *search_text,
+		      guint         flags,
+		      gchar       **literal)
+{
+	GRegexCompileFlags compile_flags;
+	GRegex *regex;
+	gchar *text;
+
+	if (literal != NULL)
+		*literal = NULL;
+
+	text = pluma_utils_unescape_search_text (search_text);
+
+	if (*text == '\0')
+	{
+		g_free (text);
+		return NULL;
+	}
+
+	compile_flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+
+	if (!PLUMA_SEARCH_IS_CASE_SENSITIVE (flags))
+		compile_flags |= G_REGEX_CASELESS;
+
+	if (PLUMA_SEARCH_IS_MATCH_REGEX (flags))
+	{
+		regex = _pluma_utils_regex_cache_get (text, compile_flags);
+	}
+	else
+	{
+		gchar *pattern;
+
+		pattern = g_regex_escape_string (text, -1);
+		regex = _pluma_utils_regex_cache_get (pattern, compile_flags);
+		g_free (pattern);
+
+		if (literal != NULL && PLUMA_SEARCH_IS_CASE_SENSITIVE (flags))
+		{
+			*literal = text;
+			text = NULL;
+		}
+	}
+
+	g_free (text);
+
+	return regex;
+}
+
+/* Searches all the documents of the window for @search_text, an escaped
+ * string like the one taken by pluma_document_set_search_text(). The
+ * documents are searched again when they are edited, until the next
+ * search. Returns FALSE if @search_text is not a valid regular
+ * expression. */
+gboolean
+pluma_search_results_panel_search (PlumaSearchResultsPanel *panel,
+				   const gchar             *search_text,
+				   guint                    flags)
+{
+	GList *docs;
+	GList *l;
+
+	g_return_val_if_fail (PLUMA_IS_SEARCH_RESULTS_PANEL (panel), FALSE);
+	g_return_val_if_fail (search_text != NULL, FALSE);
+
+	clear_results (panel);
+
+	if (panel->priv->window == NULL)
+		return TRUE;
+
+	panel->priv->regex = compile_search_regex (search_text, flags, NULL);
+
+	if (panel->priv->regex == NULL)
+		return FALSE;
+
+	panel->priv->entire_word = PLUMA_SEARCH_IS_ENTIRE_WORD (flags);
+
+	docs = pluma_window_get_documents (panel->priv->window);
+
+	for (l = docs; l != NULL; l = l->next)
+		add_document (panel, PLUMA_DOCUMENT (l->data));
+
+	g_list_free (docs);
+
+	update_status (panel);
+
+	return TRUE;
+}
+
+/* Searches the files under the folder at @root_uri for @search_text,
+ * on the search threads: the results are listed as they come. Only
+ * local folders can be searched. Returns FALSE if the folder is not
+ * local or if @search_text is not a valid regular expression. */
+gboolean
+pluma_search_results_panel_search_files (PlumaSearchResultsPanel *panel,
+					 const gchar             *root_uri,
+					 const gchar             *search_text,
+					 guint                    flags)
+{
+	GFile *root;
+	gchar *literal;
+
+	g_return_val_if_fail (PLUMA_IS_SEARCH_RESULTS_PANEL (panel), FALSE);
+	g_return_val_if_fail (root_uri != NULL, FALSE);
+	g_return_val_if_fail (search_text != NULL, FALSE);
+
+	clear_results (panel);
+
+	root = g_file_new_for_uri (root_uri);
+	panel->priv->root = g_file_get_path (root);
+	g_object_unref (root);
+
+	if (panel->priv->root == NULL)
+		return FALSE;
+
+	panel->priv->regex = compile_search_regex (search_text, flags, &literal);
+
+	if (panel->priv->regex == NULL)
+	{
+		g_free (panel->priv->root);
+		panel->priv->root = NULL;
+
+		return FALSE;
+	}
+
+	panel->priv->entire_word = PLUMA_SEARCH_IS_ENTIRE_WORD (flags);
+
+	panel->priv->files_search = _pluma_find_in_files_new (panel->priv->root,
+							      panel->priv->regex,
+							      literal,
+							      panel->priv->entire_word,
+							      (PlumaFindInFilesFunc) files_found,
+							      panel);
+
+	g_free (literal);
+
+	update_status (panel);
+
+	return TRUE;
+}
+
+/* Replace All in each document of @docs which can be edited: the
+ * read-only ones are skipped, like the ones the search leaves alone.
+ * Returns the number of replacements. */
+gint
+_pluma_search_replace_all_in_documents (GList       *docs,
+					const gchar *search_text,
+					const gchar *replace_text,
+					guint        flags)
+{
+	GList *l;
+	gint count = 0;
+
+	g_return_val_if_fail (search_text != NULL, 0);
+	g_return_val_if_fail (replace_text != NULL, 0);
+
+	for (l = docs; l != NULL; l = l->next)
+	{
+		PlumaDocument *doc = PLUMA_DOCUMENT (l->data);
+
+		if (!can_search_document (doc) || pluma_document_get_readonly (doc))
+			continue;
+
+		count += pluma_document_replace_all (doc,
+						     search_text,
+						     replace_text,
+						     flags);
+	}
+
+	return count;
+}
@@ -0,0 +1,96 @@
+/*
+ * pluma-search-results-panel.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PLUMA_SEARCH_RESULTS_PANEL_H__
+#define __PLUMA_SEARCH_RESULTS_PANEL_H__
+
+#include <gtk/gtk.h>
+
+#include <pluma/pluma-window.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Type checking and casting macros
+ */
+#define PLUMA_TYPE_SEARCH_RESULTS_PANEL              (pluma_search_results_panel_get_type())
+#define PLUMA_SEARCH_RESULTS_PANEL(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), PLUMA_TYPE_SEARCH_RESULTS_PANEL, PlumaSearchResultsPanel))
+#define PLUMA_SEARCH_RESULTS_PANEL_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), PLUMA_TYPE_SEARCH_RESULTS_PANEL, PlumaSearchResultsPanelClass))
+#define PLUMA_IS_SEARCH_RESULTS_PANEL(obj)           (G_TYPE_CHECK_INSTANCE_TYPE((obj), PLUMA_TYPE_SEARCH_RESULTS_PANEL))
+#define PLUMA_IS_SEARCH_RESULTS_PANEL_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), PLUMA_TYPE_SEARCH_RESULTS_PANEL))
+#define PLUMA_SEARCH_RESULTS_PANEL_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS((obj), PLUMA_TYPE_SEARCH_RESULTS_PANEL, PlumaSearchResultsPanelClass))
+
+/* Private structure type */
+typedef struct _PlumaSearchResultsPanelPrivate PlumaSearchResultsPanelPrivate;
+
+/*
+ * Main object structure
+ */
+typedef struct _PlumaSearchResultsPanel PlumaSearchResultsPanel;
+
+struct _PlumaSearchResultsPanel
+{
+	GtkBox vbox;
+
+	/*< private > */
+	PlumaSearchResultsPanelPrivate *priv;
+};
+
+/*
+ * Class definition
+ */
+typedef struct _PlumaSearchResultsPanelClass PlumaSearchResultsPanelClass;
+
+struct _PlumaSearchResultsPanelClass
+{
+	GtkBoxClass parent_class;
+};
+
+/*
+ * Public methods
+ */
+GType 		 pluma_search_results_panel_get_type	(void) G_GNUC_CONST;
+
+GtkWidget	*pluma_search_results_panel_new 	(PlumaWindow             *window);
+
+gboolean	 pluma_search_results_panel_search	(PlumaSearchResultsPanel *panel,
+							 const gchar             *search_text,
+							 guint                    flags);
+
+gboolean	 pluma_search_results_panel_search_files
+							(PlumaSearchResultsPanel *panel,
+							 const gchar             *root_uri,
+							 const gchar             *search_text,
+							 guint                    flags);
+
+/*
+ * Non exported functions
+ */
+gint		 _pluma_search_replace_all_in_documents
+							(GList                   *docs,
+							 const gchar             *search_text,
+							 const gchar             *replace_text,
+							 guint                    flags);
+
+G_END_DECLS
+
+#endif  /* __PLUMA_SEARCH_RESULTS_PANEL_H__  */
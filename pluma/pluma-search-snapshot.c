@@ -0,0 +1,1362 @@
+/*
+ * pluma-search-snapshot.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* for memmem () */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
+#include "pluma-search-snapshot.h"
+#include "pluma-debug.h"
+
+/* The byte offset of one character every OFFSET_INDEX_STEP is stored */
+#define OFFSET_INDEX_STEP 1024
+
+/* Bytes before the cursor searched first going backward, doubled until
+ * something is found */
+#define BACKWARD_WINDOW_SIZE (16 * 1024)
+
+/* Bytes before a window searched again to check its first matches */
+#define BACKWARD_SYNC_SIZE (4 * 1024)
+
+#define SKIP_TABLE_SIZE 256
+
+typedef struct
+{
+    gint start;
+    gint end;
+} MatchPos;
+
+/* A run of visible text, copied from the character at @buffer on to the
+ * character at @copy on */
+typedef struct
+{
+    gint copy;
+    gint buffer;
+} Segment;
+
+/* A cluster of characters of the copy, a character and the marks
+ * combining with it, which is not folded one character for one, like a
+ * sharp s folded to "ss" or an accented letter decomposed to the letter
+ * and a combining accent. Between these the characters of the copy and
+ * of the folded copy go in step. */
+typedef struct
+{
+    gint copy;
+    gint copy_length;
+    gint folded;
+    gint folded_length;
+} FoldedRun;
+
+struct _PlumaSearchSnapshot
+{
+    gchar  *text;
+    gsize   length;
+    gint    n_chars;
+
+    /* where the runs of visible text come from, sorted and never empty */
+    GArray *segments;
+
+    /* byte offsets of characters 0, OFFSET_INDEX_STEP, 2 * OFFSET_INDEX_STEP... */
+    GArray *offsets;
+
+    /* case folded and decomposed copy for case insensitive searches,
+     * made on demand, with the clusters whose length changed */
+    gchar  *folded;
+    gsize   folded_length;
+    GArray *folded_offsets;
+    GArray *folded_runs;
+
+    /* last literal string searched, as given and folded if case
+     * insensitive, with the shifts of the Boyer-Moore-Horspool search */
+    gchar  *needle_text;
+    gchar  *needle;
+    gsize   needle_length;
+    gboolean needle_case_sensitive;
+    gsize   skip[SKIP_TABLE_SIZE];
+    gsize   backward_skip[SKIP_TABLE_SIZE];
+
+    /* matches found in the window searched by the last backward search,
+     * so that going back again from one of them does not search again:
+     * the ones from backward_start on have been checked */
+    GRegex *backward_regex;
+    gsize   backward_bound;
+    gsize   backward_scanned;
+    gsize   backward_start;
+    gsize   backward_end;
+    GArray *backward_matches;
+};
+
+static GArray *
+build_offset_index (const gchar *text,
+                    gsize        length,
+                    gint        *n_chars_ret)
+{
+    GArray *offsets;
+    const guchar *p;
+    const guchar *end;
+    guint n_chars = 0;
+
+    offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+    p = (const guchar *) text;
+    end = p + length;
+
+    for (; p < end; p++)
+    {
+        /* count the bytes starting a character */
+        if ((*p & 0xc0) == 0x80)
+            continue;
+
+        if (n_chars % OFFSET_INDEX_STEP == 0)
+        {
+            gsize offset = p - (const guchar *) text;
+
+            g_array_append_val (offsets, offset);
+        }
+
+        n_chars++;
+    }
+
+    if (n_chars_ret != NULL)
+        *n_chars_ret = n_chars;
+
+    return offsets;
+}
+
+PlumaSearchSnapshot *
+_pluma_search_snapshot_new (GtkTextBuffer *buffer)
+{
+    GtkTextIter start;
+    GtkTextIter end;
+
+    g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+    return _pluma_search_snapshot_new_for_range (buffer, &start, &end);
+}
+
+static void
+collect_invisible_tag (GtkTextTag *tag,
+                       GPtrArray  *tags)
+{
+    gboolean invisible;
+
+    g_object_get (tag, "invisible", &invisible, NULL);
+
+    if (invisible)
+        g_ptr_array_add (tags, tag);
+}
+
+static gint
+compare_ranges (const MatchPos *a,
+                const MatchPos *b)
+{
+    return a->start - b->start;
+}
+
+/* Returns the sorted ranges of text hidden by @tags between @start and
+ * @end, which may overlap */
+static GArray *
+get_hidden_ranges (GPtrArray         *tags,
+                   const GtkTextIter *start,
+                   const GtkTextIter *end)
+{
+    GArray *ranges;
+    gint end_offset;
+    guint i;
+
+    ranges = g_array_new (FALSE, FALSE, sizeof (MatchPos));
+    end_offset = gtk_text_iter_get_offset (end);
+
+    for (i = 0; i < tags->len; i++)
+    {
+        GtkTextTag *tag = g_ptr_array_index (tags, i);
+        GtkTextIter iter = *start;
+
+        while (gtk_text_iter_compare (&iter, end) < 0)
+        {
+            MatchPos range;
+
+            if (!gtk_text_iter_has_tag (&iter, tag))
+            {
+                if (!gtk_text_iter_forward_to_tag_toggle (&iter, tag))
+                    break;
+
+                continue;
+            }
+
+            range.start = gtk_text_iter_get_offset (&iter);
+            gtk_text_iter_forward_to_tag_toggle (&iter, tag);
+            range.end = MIN (gtk_text_iter_get_offset (&iter), end_offset);
+
+            g_array_append_val (ranges, range);
+        }
+    }
+
+    g_array_sort (ranges, (GCompareFunc) compare_ranges);
+
+    return ranges;
+}
+
+/* Copies the visible text between @start and @end, the searches of the
+ * document being visible only */
+static gchar *
+copy_visible_text (GtkTextBuffer     *buffer,
+                   const GtkTextIter *start,
+                   const GtkTextIter *end,
+                   GArray            *segments)
+{
+    GPtrArray *tags;
+    GArray *hidden;
+    GString *text;
+    Segment segment;
+    gint pos;
+    gint n_chars = 0;
+    guint i;
+
+    tags = g_ptr_array_new ();
+    gtk_text_tag_table_foreach (gtk_text_buffer_get_tag_table (buffer),
+                                (GtkTextTagTableForeach) collect_invisible_tag,
+                                tags);
+
+    segment.copy = 0;
+    segment.buffer = gtk_text_iter_get_offset (start);
+
+    /* nothing is hidden most of the time */
+    if (tags->len == 0)
+    {
+        g_ptr_array_free (tags, TRUE);
+        g_array_append_val (segments, segment);
+
+        /* a slice keeps a placeholder for pixbufs and child anchors */
+        return gtk_text_buffer_get_slice (buffer, start, end, TRUE);
+    }
+
+    hidden = get_hidden_ranges (tags, start, end);
+    g_ptr_array_free (tags, TRUE);
+
+    text = g_string_new (NULL);
+    pos = segment.buffer;
+
+    for (i = 0; i <= hidden->len; i++)
+    {
+        gint visible_end;
+
+        if (i < hidden->len)
+            visible_end = g_array_index (hidden, MatchPos, i).start;
+        else
+            visible_end = gtk_text_iter_get_offset (end);
+
+        if (visible_end > pos)
+        {
+            GtkTextIter run_start;
+            GtkTextIter run_end;
+            gchar *run;
+
+            gtk_text_buffer_get_iter_at_offset (buffer, &run_start, pos);
+            gtk_text_buffer_get_iter_at_offset (buffer, &run_end, visible_end);
+
+            segment.copy = n_chars;
+            segment.buffer = pos;
+            g_array_append_val (segments, segment);
+
+            run = gtk_text_buffer_get_slice (buffer, &run_start, &run_end, TRUE);
+            g_string_append (text, run);
+            g_free (run);
+
+            n_chars += visible_end - pos;
+        }
+
+        if (i < hidden->len)
+            pos = MAX (pos, g_array_index (hidden, MatchPos, i).end);
+    }
+
+    if (segments->len == 0)
+    {
+        segment.copy = 0;
+        segment.buffer = pos;
+        g_array_append_val (segments, segment);
+    }
+
+    g_array_free (hidden, TRUE);
+
+    return g_string_free (text, FALSE);
+}
+
+/* A copy of the text between @start and @end only, for searches which do
+ * not need to look outside of it. Iters passed to the searches are still
+ * in the buffer, but the offsets taken and returned by the getters are
+ * relative to @start. */
+PlumaSearchSnapshot *
+_pluma_search_snapshot_new_for_range (GtkTextBuffer     *buffer,
+                                      const GtkTextIter *start,
+                                      const GtkTextIter *end)
+{
+    PlumaSearchSnapshot *snapshot;
+
+    g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+    g_return_val_if_fail (start != NULL && end != NULL, NULL);
+
+    snapshot = g_slice_new0 (PlumaSearchSnapshot);
+
+    snapshot->segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+    snapshot->text = copy_visible_text (buffer, start, end, snapshot->segments);
+    snapshot->length = strlen (snapshot->text);
+    snapshot->offsets = build_offset_index (snapshot->text, snapshot->length, &snapshot->n_chars);
+    snapshot->backward_matches = g_array_new (FALSE, FALSE, sizeof (MatchPos));
+
+    pluma_debug_message (DEBUG_SEARCH,
+                         "snapshot of %" G_GSIZE_FORMAT " bytes",
+                         snapshot->length);
+
+    return snapshot;
+}
+
+void
+_pluma_search_snapshot_free (PlumaSearchSnapshot *snapshot)
+{
+    if (snapshot == NULL)
+        return;
+
+    g_free (snapshot->text);
+    g_array_free (snapshot->segments, TRUE);
+    g_array_free (snapshot->offsets, TRUE);
+    g_array_free (snapshot->backward_matches, TRUE);
+
+    g_free (snapshot->folded);
+    if (snapshot->folded_offsets != NULL)
+        g_array_free (snapshot->folded_offsets, TRUE);
+    if (snapshot->folded_runs != NULL)
+        g_array_free (snapshot->folded_runs, TRUE);
+
+    g_free (snapshot->needle_text);
+    g_free (snapshot->needle);
+
+    if (snapshot->backward_regex != NULL)
+        g_regex_unref (snapshot->backward_regex);
+
+    g_slice_free (PlumaSearchSnapshot, snapshot);
+}
+
+const gchar *
+_pluma_search_snapshot_get_text (PlumaSearchSnapshot *snapshot)
+{
+    g_return_val_if_fail (snapshot != NULL, NULL);
+
+    return snapshot->text;
+}
+
+gsize
+_pluma_search_snapshot_get_length (PlumaSearchSnapshot *snapshot)
+{
+    g_return_val_if_fail (snapshot != NULL, 0);
+
+    return snapshot->length;
+}
+
+static gsize
+get_byte_offset (const gchar *text,
+                 gsize        length,
+                 GArray      *offsets,
+                 gint         char_offset)
+{
+    const gchar *p;
+    const gchar *end;
+    guint i;
+    gint n;
+
+    if (char_offset <= 0)
+        return 0;
+
+    i = char_offset / OFFSET_INDEX_STEP;
+
+    if (i >= offsets->len)
+        return length;
+
+    p = text + g_array_index (offsets, gsize, i);
+    end = text + length;
+
+    for (n = char_offset % OFFSET_INDEX_STEP; n > 0 && p < end; n--)
+        p = g_utf8_next_char (p);
+
+    return MIN (p, end) - text;
+}
+
+static gint
+get_char_offset (const gchar *text,
+                 gsize        length,
+                 GArray      *offsets,
+                 gsize        byte_offset)
+{
+    guint lo, hi;
+
+    byte_offset = MIN (byte_offset, length);
+
+    if (offsets->len == 0)
+        return 0;
+
+    /* last indexed character starting at or before byte_offset */
+    lo = 0;
+    hi = offsets->len;
+
+    while (hi - lo > 1)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if (g_array_index (offsets, gsize, mid) <= byte_offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo * OFFSET_INDEX_STEP +
+           g_utf8_pointer_to_offset (text + g_array_index (offsets, gsize, lo),
+                                     text + byte_offset);
+}
+
+/* Returns the byte offset of the character at @char_offset, or the
+ * length of the text if it is past the end */
+gsize
+_pluma_search_snapshot_get_byte_offset (PlumaSearchSnapshot *snapshot,
+                                        gint                 char_offset)
+{
+    g_return_val_if_fail (snapshot != NULL, 0);
+
+    return get_byte_offset (snapshot->text,
+                            snapshot->length,
+                            snapshot->offsets,
+                            char_offset);
+}
+
+/* Returns the offset of the character starting at @byte_offset */
+gint
+_pluma_search_snapshot_get_char_offset (PlumaSearchSnapshot *snapshot,
+                                        gsize                byte_offset)
+{
+    g_return_val_if_fail (snapshot != NULL, 0);
+
+    return get_char_offset (snapshot->text,
+                            snapshot->length,
+                            snapshot->offsets,
+                            byte_offset);
+}
+
+/* Returns the index of the last segment whose copy starts before @copy,
+ * or at @copy too if @inclusive */
+static guint
+find_segment_by_copy (PlumaSearchSnapshot *snapshot,
+                      gint                 copy,
+                      gboolean             inclusive)
+{
+    GArray *segments = snapshot->segments;
+    guint lo = 0;
+    guint hi = segments->len;
+
+    while (hi - lo > 1)
+    {
+        guint mid = (lo + hi) / 2;
+        gint mid_copy = g_array_index (segments, Segment, mid).copy;
+
+        if (mid_copy < copy || (inclusive && mid_copy == copy))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Returns the character of the copy standing for the buffer offset
+ * @offset, the next visible one if it is hidden */
+static gint
+get_copy_offset (PlumaSearchSnapshot *snapshot,
+                 gint                 offset)
+{
+    GArray *segments = snapshot->segments;
+    const Segment *segment;
+    guint lo = 0;
+    guint hi = segments->len;
+    gint length;
+
+    while (hi - lo > 1)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if (g_array_index (segments, Segment, mid).buffer <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    segment = &g_array_index (segments, Segment, lo);
+
+    if (offset <= segment->buffer)
+        return segment->copy;
+
+    if (lo + 1 < segments->len)
+        length = g_array_index (segments, Segment, lo + 1).copy - segment->copy;
+    else
+        length = snapshot->n_chars - segment->copy;
+
+    return segment->copy + MIN (offset - segment->buffer, length);
+}
+
+/* The end of a match stays before the text hidden after it, its start
+ * goes after the text hidden before it */
+static gint
+get_buffer_offset (PlumaSearchSnapshot *snapshot,
+                   gint                 copy,
+                   gboolean             is_end)
+{
+    const Segment *segment;
+
+    segment = &g_array_index (snapshot->segments, Segment,
+                              find_segment_by_copy (snapshot, copy, !is_end));
+
+    return segment->buffer + copy - segment->copy;
+}
+
+/* Returns the offset in the buffer of the character starting at
+ * @byte_offset, @is_end telling whether it ends a match */
+gint
+_pluma_search_snapshot_get_buffer_offset (PlumaSearchSnapshot *snapshot,
+                                          gsize                byte_offset,
+                                          gboolean             is_end)
+{
+    g_return_val_if_fail (snapshot != NULL, 0);
+
+    return get_buffer_offset (snapshot,
+                              _pluma_search_snapshot_get_char_offset (snapshot, byte_offset),
+                              is_end);
+}
+
+static void
+get_match_iters (PlumaSearchSnapshot *snapshot,
+                 GtkTextBuffer       *buffer,
+                 gint                 start,
+                 gint                 end,
+                 GtkTextIter         *match_start,
+                 GtkTextIter         *match_end)
+{
+    if (match_start != NULL)
+        gtk_text_buffer_get_iter_at_offset (buffer,
+                                            match_start,
+                                            get_buffer_offset (snapshot, start, FALSE));
+
+    /* an empty match is not split around hidden text */
+    if (match_end != NULL)
+        gtk_text_buffer_get_iter_at_offset (buffer,
+                                            match_end,
+                                            get_buffer_offset (snapshot, end, end > start));
+}
+
+/* Returns the index of the first of @matches also found going forward
+ * from @from, or -1 if the two searches do not meet before @end */
+static gint
+find_common_match (PlumaSearchSnapshot *snapshot,
+                   GRegex              *regex,
+                   GArray              *matches,
+                   gsize                from,
+                   gsize                end)
+{
+    GMatchInfo *match_info;
+    guint i = 0;
+    gint common = -1;
+
+    g_regex_match_full (regex,
+                        snapshot->text,
+                        snapshot->length,
+                        from,
+                        0,
+                        &match_info,
+                        NULL);
+
+    while (g_match_info_matches (match_info))
+    {
+        MatchPos match;
+
+        g_match_info_fetch_pos (match_info, 0, &match.start, &match.end);
+
+        if ((gsize) match.start >= end)
+            break;
+
+        while (i < matches->len && g_array_index (matches, MatchPos, i).start < match.start)
+            i++;
+
+        if (i == matches->len)
+            break;
+
+        if (g_array_index (matches, MatchPos, i).start == match.start &&
+            g_array_index (matches, MatchPos, i).end == match.end)
+        {
+            common = i;
+            break;
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    return common;
+}
+
+/* Collects the matches of @regex found going forward from @start which
+ * end at or before @end. Going forward from @bound, a match could start
+ * before @start and go past it, and the ones after it would not be the
+ * same: unless @start is @bound, only the matches from the first one also
+ * found searching from a bit before @start are kept.
+ * In text repeating with the period of the matches, like "aaaa" and "aa",
+ * the searches from any two points can meet on matches the search from
+ * @bound never finds: one char further back they would meet on other
+ * ones, or not at all. The window is then scanned from @bound. */
+static void
+scan_window (PlumaSearchSnapshot *snapshot,
+             GRegex              *regex,
+             gsize                bound,
+             gsize                start,
+             gsize                end)
+{
+    GMatchInfo *match_info;
+
+    if (snapshot->backward_regex != regex)
+    {
+        if (snapshot->backward_regex != NULL)
+            g_regex_unref (snapshot->backward_regex);
+
+        snapshot->backward_regex = g_regex_ref (regex);
+    }
+
+    snapshot->backward_bound = bound;
+    snapshot->backward_scanned = start;
+    snapshot->backward_start = start;
+    snapshot->backward_end = end;
+    g_array_set_size (snapshot->backward_matches, 0);
+
+    /* the whole text is the subject, for the matches not to depend on
+     * where the window ends */
+    g_regex_match_full (regex,
+                        snapshot->text,
+                        snapshot->length,
+                        start,
+                        0,
+                        &match_info,
+                        NULL);
+
+    while (g_match_info_matches (match_info))
+    {
+        MatchPos match;
+
+        g_match_info_fetch_pos (match_info, 0, &match.start, &match.end);
+
+        /* an empty match at the cursor would be found again and again */
+        if ((gsize) match.start >= end)
+            break;
+
+        if ((gsize) match.end <= end)
+            g_array_append_val (snapshot->backward_matches, match);
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    if (start > bound)
+    {
+        gsize from;
+        gint common;
+
+        from = (start - bound > BACKWARD_SYNC_SIZE) ? start - BACKWARD_SYNC_SIZE : bound;
+
+        while (from > bound && (snapshot->text[from] & 0xc0) == 0x80)
+            from--;
+
+        common = find_common_match (snapshot, regex, snapshot->backward_matches, from, end);
+
+        if (common >= 0 && from > bound)
+        {
+            gsize before;
+            gint shifted;
+
+            before = from - 1;
+
+            while (before > bound && (snapshot->text[before] & 0xc0) == 0x80)
+                before--;
+
+            shifted = find_common_match (snapshot, regex, snapshot->backward_matches, before, end);
+
+            if (shifted < 0)
+            {
+                scan_window (snapshot, regex, bound, bound, end);
+                return;
+            }
+
+            common = MAX (common, shifted);
+        }
+
+        if (common < 0)
+        {
+            /* nothing is known about this window */
+            snapshot->backward_start = end;
+            g_array_set_size (snapshot->backward_matches, 0);
+        }
+        else
+        {
+            snapshot->backward_start = g_array_index (snapshot->backward_matches, MatchPos, common).start;
+            g_array_remove_range (snapshot->backward_matches, 0, common);
+        }
+    }
+}
+
+/* Looks for the last match of the last window ending at or before @end
+ * and starting at or after @start */
+static gboolean
+find_last_scanned (PlumaSearchSnapshot *snapshot,
+                   gsize                start,
+                   gsize                end,
+                   MatchPos            *match)
+{
+    GArray *matches = snapshot->backward_matches;
+    guint lo, hi;
+
+    /* the matches do not overlap, so their ends are sorted too */
+    lo = 0;
+    hi = matches->len;
+
+    while (lo < hi)
+    {
+        guint mid = (lo + hi) / 2;
+
+        if ((gsize) g_array_index (matches, MatchPos, mid).end <= end)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0 || (gsize) g_array_index (matches, MatchPos, lo - 1).start < start)
+        return FALSE;
+
+    *match = g_array_index (matches, MatchPos, lo - 1);
+
+    return TRUE;
+}
+
+/* Searching backward, the text is searched forward in windows ending at
+ * @pos which get twice as big until a match is found, so that the time
+ * spent is proportional to how far back the match is. */
+static gboolean
+backward_search (PlumaSearchSnapshot *snapshot,
+                 GRegex              *regex,
+                 gsize                bound,
+                 gsize                pos,
+                 MatchPos            *match)
+{
+    gsize window = BACKWARD_WINDOW_SIZE;
+
+    if (snapshot->backward_regex == regex &&
+        snapshot->backward_bound == bound &&
+        snapshot->backward_start <= pos &&
+        pos <= snapshot->backward_end)
+    {
+        if (find_last_scanned (snapshot, bound, pos, match))
+            return TRUE;
+
+        if (snapshot->backward_start <= bound)
+            return FALSE;
+
+        /* go on before the window already searched */
+        window = MAX (window, 2 * (snapshot->backward_end - snapshot->backward_scanned));
+    }
+
+    while (TRUE)
+    {
+        gsize start;
+
+        start = (pos - bound > window) ? pos - window : bound;
+
+        /* start on a character */
+        while (start > bound && (snapshot->text[start] & 0xc0) == 0x80)
+            start--;
+
+        scan_window (snapshot, regex, bound, start, pos);
+
+        if (find_last_scanned (snapshot, bound, pos, match))
+            return TRUE;
+
+        if (start <= bound)
+            return FALSE;
+
+        window *= 2;
+    }
+}
+
+/* Looks for @regex from @iter up to @limit, or to the end of the buffer
+ * (the start if @forward is FALSE). The text around the searched range
+ * is still seen by anchors and lookarounds, but going backward only the
+ * matches ending at or before @iter are found. On success the references in
+ * *@replace_text, if any, are expanded for the match. */
+gboolean
+_pluma_search_snapshot_regex_search (PlumaSearchSnapshot *snapshot,
+                                     GtkTextBuffer       *buffer,
+                                     GRegex              *regex,
+                                     const GtkTextIter   *iter,
+                                     const GtkTextIter   *limit,
+                                     gboolean             forward,
+                                     GtkTextIter         *match_start,
+                                     GtkTextIter         *match_end,
+                                     gchar              **replace_text)
+{
+    GMatchInfo *match_info = NULL;
+    gsize pos;
+    gsize bound;
+    gsize range_start;
+    gsize range_end;
+    gint start = -1;
+    gint end = -1;
+    gboolean found;
+
+    g_return_val_if_fail (snapshot != NULL, FALSE);
+    g_return_val_if_fail (regex != NULL, FALSE);
+    g_return_val_if_fail (iter != NULL, FALSE);
+
+    pos = _pluma_search_snapshot_get_byte_offset (snapshot,
+                                                  get_copy_offset (snapshot, gtk_text_iter_get_offset (iter)));
+
+    if (limit != NULL)
+        bound = _pluma_search_snapshot_get_byte_offset (snapshot,
+                                                        get_copy_offset (snapshot, gtk_text_iter_get_offset (limit)));
+    else
+        bound = forward ? snapshot->length : 0;
+
+    range_start = forward ? pos : bound;
+    range_end = forward ? bound : pos;
+
+    if (range_start > range_end)
+        return FALSE;
+
+    if (forward)
+    {
+        /* the subject ends at the end of the range, but starts at the
+         * start of the buffer: the match is looked for from range_start */
+        found = g_regex_match_full (regex,
+                                    snapshot->text,
+                                    range_end,
+                                    range_start,
+                                    0,
+                                    &match_info,
+                                    NULL);
+
+        if (found)
+            g_match_info_fetch_pos (match_info, 0, &start, &end);
+    }
+    else
+    {
+        MatchPos match;
+
+        found = backward_search (snapshot, regex, range_start, range_end, &match);
+
+        if (found)
+        {
+            start = match.start;
+            end = match.end;
+
+            /* match again at the start of the match to expand it */
+            if (replace_text != NULL && *replace_text != NULL)
+                g_regex_match_full (regex,
+                                    snapshot->text,
+                                    snapshot->length,
+                                    start,
+                                    0,
+                                    &match_info,
+                                    NULL);
+        }
+    }
+
+    if (found && replace_text != NULL && *replace_text != NULL)
+    {
+        gchar *expanded;
+
+        expanded = g_match_info_expand_references (match_info, *replace_text, NULL);
+
+        if (expanded != NULL)
+        {
+            g_free (*replace_text);
+            *replace_text = expanded;
+        }
+    }
+
+    if (match_info != NULL)
+        g_match_info_free (match_info);
+
+    if (!found)
+        return FALSE;
+
+    get_match_iters (snapshot, buffer,
+                     _pluma_search_snapshot_get_char_offset (snapshot, start),
+                     _pluma_search_snapshot_get_char_offset (snapshot, end),
+                     match_start, match_end);
+
+    return TRUE;
+}
+
+/* Appends the case folded and decomposed form of the @length bytes at
+ * @text, and returns its length in characters */
+static gint
+fold_cluster (GString     *folded,
+              const gchar *text,
+              gsize        length)
+{
+    gchar *casefolded;
+    gchar *normalized;
+    gint n_chars;
+
+    casefolded = g_utf8_casefold (text, length);
+
+    /* most characters do not decompose */
+    if (*g_utf8_next_char (casefolded) == '\0' &&
+        g_unichar_fully_decompose (g_utf8_get_char (casefolded), FALSE, NULL, 0) == 1)
+    {
+        g_string_append (folded, casefolded);
+        g_free (casefolded);
+
+        return 1;
+    }
+
+    normalized = g_utf8_normalize (casefolded, -1, G_NORMALIZE_NFD);
+    g_free (casefolded);
+
+    n_chars = g_utf8_strlen (normalized, -1);
+    g_string_append (folded, normalized);
+    g_free (normalized);
+
+    return n_chars;
+}
+
+/* Folds @text like gtk_text_iter_forward_search() does when it is case
+ * insensitive, so that "STRASSE" matches it written with a sharp s and
+ * a precomposed character matches its decomposed form. Each character
+ * is folded along with the marks combining with it, which is the same
+ * as normalizing the whole text, with an ASCII fast path. The clusters
+ * not folded one character for one are added to @runs if not NULL. */
+static gchar *
+fold_text (const gchar *text,
+           gsize        length,
+           gsize       *folded_length,
+           GArray      *runs)
+{
+    GString *folded;
+    const gchar *p;
+    const gchar *end;
+    gint n_chars = 0;
+    gint n_folded = 0;
+
+    folded = g_string_sized_new (length + 1);
+
+    p = text;
+    end = text + length;
+
+    while (p < end)
+    {
+        const gchar *next;
+        FoldedRun run;
+
+        next = g_utf8_next_char (p);
+
+        if ((guchar) *p < 0x80 && (next == end || (guchar) *next < 0x80))
+        {
+            g_string_append_c (folded, g_ascii_tolower (*p));
+
+            p = next;
+            n_chars++;
+            n_folded++;
+
+            continue;
+        }
+
+        run.copy = n_chars;
+        run.copy_length = 1;
+
+        while (next < end && g_unichar_combining_class (g_utf8_get_char (next)) != 0)
+        {
+            next = g_utf8_next_char (next);
+            run.copy_length++;
+        }
+
+        run.folded = n_folded;
+        run.folded_length = fold_cluster (folded, p, next - p);
+
+        if (runs != NULL && (run.copy_length != 1 || run.folded_length != 1))
+            g_array_append_val (runs, run);
+
+        p = next;
+        n_chars += run.copy_length;
+        n_folded += run.folded_length;
+    }
+
+    *folded_length = folded->len;
+
+    return g_string_free (folded, FALSE);
+}
+
+static void
+ensure_folded (PlumaSearchSnapshot *snapshot)
+{
+    if (snapshot->folded != NULL)
+        return;
+
+    snapshot->folded_runs = g_array_new (FALSE, FALSE, sizeof (FoldedRun));
+    snapshot->folded = fold_text (snapshot->text,
+                                  snapshot->length,
+                                  &snapshot->folded_length,
+                                  snapshot->folded_runs);
+    snapshot->folded_offsets = build_offset_index (snapshot->folded,
+                                                   snapshot->folded_length,
+                                                   NULL);
+}
+
+/* Returns the index of the last folded run starting at or before
+ * @offset, a character of the folded copy if @in_folded or else of the
+ * copy, or -1 */
+static gint
+find_folded_run (PlumaSearchSnapshot *snapshot,
+                 gint                 offset,
+                 gboolean             in_folded)
+{
+    GArray *runs = snapshot->folded_runs;
+    gint lo = -1;
+    gint hi = runs->len;
+
+    while (hi - lo > 1)
+    {
+        gint mid = (lo + hi) / 2;
+        const FoldedRun *run = &g_array_index (runs, FoldedRun, mid);
+
+        if ((in_folded ? run->folded : run->copy) <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Returns the character of the folded copy standing for the character
+ * @copy of the copy: the start of its cluster, or the end of it if
+ * @round_up and @copy is one of its marks */
+static gint
+get_folded_offset (PlumaSearchSnapshot *snapshot,
+                   gint                 copy,
+                   gboolean             round_up)
+{
+    const FoldedRun *run;
+    gint i;
+
+    i = find_folded_run (snapshot, copy, FALSE);
+
+    if (i < 0)
+        return copy;
+
+    run = &g_array_index (snapshot->folded_runs, FoldedRun, i);
+
+    if (copy == run->copy)
+        return run->folded;
+
+    if (copy < run->copy + run->copy_length)
+        return round_up ? run->folded + run->folded_length : run->folded;
+
+    return copy - run->copy - run->copy_length + run->folded + run->folded_length;
+}
+
+/* The other way round, returns FALSE if @folded is inside a folded
+ * cluster, like between a letter and its accent */
+static gboolean
+get_unfolded_offset (PlumaSearchSnapshot *snapshot,
+                     gint                 folded,
+                     gint                *copy)
+{
+    const FoldedRun *run;
+    gint i;
+
+    i = find_folded_run (snapshot, folded, TRUE);
+
+    if (i < 0)
+    {
+        *copy = folded;
+        return TRUE;
+    }
+
+    run = &g_array_index (snapshot->folded_runs, FoldedRun, i);
+
+    if (folded == run->folded)
+    {
+        *copy = run->copy;
+        return TRUE;
+    }
+
+    if (folded < run->folded + run->folded_length)
+        return FALSE;
+
+    *copy = folded - run->folded - run->folded_length + run->copy + run->copy_length;
+
+    return TRUE;
+}
+
+/* Returns the byte offset of @iter in the copy, or in the folded copy if
+ * @folded, see get_folded_offset() for @round_up */
+static gsize
+get_search_offset (PlumaSearchSnapshot *snapshot,
+                   const GtkTextIter   *iter,
+                   gboolean             folded,
+                   gboolean             round_up)
+{
+    gint copy;
+
+    copy = get_copy_offset (snapshot, gtk_text_iter_get_offset (iter));
+
+    if (!folded)
+        return get_byte_offset (snapshot->text, snapshot->length, snapshot->offsets, copy);
+
+    return get_byte_offset (snapshot->folded,
+                            snapshot->folded_length,
+                            snapshot->folded_offsets,
+                            get_folded_offset (snapshot, copy, round_up));
+}
+
+static void
+prepare_needle (PlumaSearchSnapshot *snapshot,
+                const gchar         *needle,
+                gboolean             case_sensitive)
+{
+    gsize len;
+    gsize i;
+
+    if (snapshot->needle_text != NULL &&
+        snapshot->needle_case_sensitive == case_sensitive &&
+        strcmp (snapshot->needle_text, needle) == 0)
+        return;
+
+    g_free (snapshot->needle_text);
+    g_free (snapshot->needle);
+
+    snapshot->needle_text = g_strdup (needle);
+
+    if (case_sensitive)
+    {
+        snapshot->needle = g_strdup (needle);
+        snapshot->needle_length = strlen (needle);
+    }
+    else
+    {
+        snapshot->needle = fold_text (needle, strlen (needle), &snapshot->needle_length, NULL);
+    }
+
+    snapshot->needle_case_sensitive = case_sensitive;
+    len = snapshot->needle_length;
+
+    /* how far the window can move when the byte under its last (first
+     * going backward) byte does not match */
+    for (i = 0; i < SKIP_TABLE_SIZE; i++)
+    {
+        snapshot->skip[i] = len;
+        snapshot->backward_skip[i] = len;
+    }
+
+    for (i = 0; i + 1 < len; i++)
+        snapshot->skip[(guchar) snapshot->needle[i]] = len - 1 - i;
+
+    for (i = len - 1; i > 0; i--)
+        snapshot->backward_skip[(guchar) snapshot->needle[i]] = i;
+}
+
+static const gchar *
+find_forward (PlumaSearchSnapshot *snapshot,
+              const gchar         *text,
+              gsize                length)
+{
+    const gchar *needle = snapshot->needle;
+    gsize len = snapshot->needle_length;
+
+    if (length < len)
+        return NULL;
+
+#ifdef HAVE_MEMMEM
+    /* the C library has a vectorized one */
+    return memmem (text, length, needle, len);
+#else
+    {
+        const gchar *p;
+        const gchar *last;
+
+        last = text + length - len;
+
+        for (p = text; p <= last; p += snapshot->skip[(guchar) p[len - 1]])
+        {
+            if (p[len - 1] == needle[len - 1] && memcmp (p, needle, len - 1) == 0)
+                return p;
+        }
+
+        return NULL;
+    }
+#endif
+}
+
+static const gchar *
+find_backward (PlumaSearchSnapshot *snapshot,
+               const gchar         *text,
+               gsize                length)
+{
+    const gchar *needle = snapshot->needle;
+    gsize len = snapshot->needle_length;
+    const gchar *p;
+
+    if (length < len)
+        return NULL;
+
+    p = text + length - len;
+
+    while (TRUE)
+    {
+        gsize shift;
+
+        if (p[0] == needle[0] && memcmp (p + 1, needle + 1, len - 1) == 0)
+            return p;
+
+        shift = snapshot->backward_skip[(guchar) p[0]];
+
+        if ((gsize) (p - text) < shift)
+            return NULL;
+
+        p -= shift;
+    }
+}
+
+/* Looks for the literal string @needle from @iter up to @limit, or to the
+ * end of the buffer (the start if @forward is FALSE). Going backward only
+ * the matches ending at or before @iter are found, like
+ * gtk_text_iter_backward_search() does. When @case_sensitive is FALSE,
+ * the folded copy is searched, and a match has to start and end on the
+ * clusters of the copy. */
+gboolean
+_pluma_search_snapshot_find (PlumaSearchSnapshot *snapshot,
+                             GtkTextBuffer       *buffer,
+                             const gchar         *needle,
+                             gboolean             case_sensitive,
+                             const GtkTextIter   *iter,
+                             const GtkTextIter   *limit,
+                             gboolean             forward,
+                             GtkTextIter         *match_start,
+                             GtkTextIter         *match_end)
+{
+    const gchar *text;
+    gsize length;
+    GArray *offsets;
+    gsize pos;
+    gsize bound;
+    gsize range_start;
+    gsize range_end;
+    const gchar *match;
+    gint start;
+    gint end;
+
+    g_return_val_if_fail (snapshot != NULL, FALSE);
+    g_return_val_if_fail (needle != NULL && *needle != '\0', FALSE);
+    g_return_val_if_fail (iter != NULL, FALSE);
+
+    if (case_sensitive)
+    {
+        text = snapshot->text;
+        length = snapshot->length;
+        offsets = snapshot->offsets;
+    }
+    else
+    {
+        ensure_folded (snapshot);
+
+        text = snapshot->folded;
+        length = snapshot->folded_length;
+        offsets = snapshot->folded_offsets;
+    }
+
+    prepare_needle (snapshot, needle, case_sensitive);
+
+    /* a match starts after @iter (ends before it going backward) and
+     * stays within @limit */
+    pos = get_search_offset (snapshot, iter, !case_sensitive, forward);
+
+    if (limit != NULL)
+        bound = get_search_offset (snapshot, limit, !case_sensitive, !forward);
+    else
+        bound = forward ? length : 0;
+
+    range_start = forward ? pos : bound;
+    range_end = forward ? bound : pos;
+
+    while (TRUE)
+    {
+        gint folded_start;
+        gint folded_end;
+
+        if (range_start > range_end)
+            return FALSE;
+
+        /* a valid UTF-8 needle can only match on whole characters */
+        if (forward)
+            match = find_forward (snapshot, text + range_start, range_end - range_start);
+        else
+            match = find_backward (snapshot, text + range_start, range_end - range_start);
+
+        if (match == NULL)
+            return FALSE;
+
+        start = get_char_offset (text, length, offsets, match - text);
+        end = start + g_utf8_strlen (snapshot->needle, snapshot->needle_length);
+
+        if (case_sensitive)
+            break;
+
+        folded_start = start;
+        folded_end = end;
+
+        if (get_unfolded_offset (snapshot, folded_start, &start) &&
+            get_unfolded_offset (snapshot, folded_end, &end))
+            break;
+
+        /* only a part of a cluster matched, like "e" in an accented e */
+        if (forward)
+            range_start = match - text + 1;
+        else
+            range_end = match - text + snapshot->needle_length - 1;
+    }
+
+    get_match_iters (snapshot, buffer, start, end, match_start, match_end);
+
+    return TRUE;
+}
@@ -0,0 +1,86 @@
+/*
+ * pluma-search-snapshot.h
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __PLUMA_SEARCH_SNAPSHOT_H__
+#define __PLUMA_SEARCH_SNAPSHOT_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* A flat UTF-8 copy of the visible text of a buffer for the regex and
+ * literal searches to run on. The runs of text hidden by invisible tags
+ * are left out and the offsets of the ones kept are recorded, and the
+ * byte offset of one character every few is indexed to map matches back
+ * to iters. The owner must drop the snapshot when the buffer changes or
+ * when a tag hides or shows text. */
+typedef struct _PlumaSearchSnapshot PlumaSearchSnapshot;
+
+PlumaSearchSnapshot *_pluma_search_snapshot_new            (GtkTextBuffer       *buffer);
+
+PlumaSearchSnapshot *_pluma_search_snapshot_new_for_range  (GtkTextBuffer       *buffer,
+                                                            const GtkTextIter   *start,
+                                                            const GtkTextIter   *end);
+
+void                 _pluma_search_snapshot_free           (PlumaSearchSnapshot *snapshot);
+
+const gchar         *_pluma_search_snapshot_get_text       (PlumaSearchSnapshot *snapshot);
+
+gsize                _pluma_search_snapshot_get_length     (PlumaSearchSnapshot *snapshot);
+
+gsize                _pluma_search_snapshot_get_byte_offset
+                                                           (PlumaSearchSnapshot *snapshot,
+                                                            gint                 char_offset);
+
+gint                 _pluma_search_snapshot_get_char_offset
+                                                           (PlumaSearchSnapshot *snapshot,
+                                                            gsize                byte_offset);
+
+gint                 _pluma_search_snapshot_get_buffer_offset
+                                                           (PlumaSearchSnapshot *snapshot,
+                                                            gsize                byte_offset,
+                                                            gboolean             is_end);
+
+gboolean             _pluma_search_snapshot_regex_search   (PlumaSearchSnapshot *snapshot,
+                                                            GtkTextBuffer       *buffer,
+                                                            GRegex              *regex,
+                                                            const GtkTextIter   *iter,
+                                                            const GtkTextIter   *limit,
+                                                            gboolean             forward,
+                                                            GtkTextIter         *match_start,
+                                                            GtkTextIter         *match_end,
+                                                            gchar              **replace_text);
+
+gboolean             _pluma_search_snapshot_find           (PlumaSearchSnapshot *snapshot,
+                                                            GtkTextBuffer       *buffer,
+                                                            const gchar         *needle,
+                                                            gboolean             case_sensitive,
+                                                            const GtkTextIter   *iter,
+                                                            const GtkTextIter   *limit,
+                                                            gboolean             forward,
+                                                            GtkTextIter         *match_start,
+                                                            GtkTextIter         *match_end);
+
+G_END_DECLS
+
+#endif /* __PLUMA_SEARCH_SNAPSHOT_H__ */
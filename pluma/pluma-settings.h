@@ -101,6 +101,7 @@ GSList *                pluma_settings_get_writable_vfs_schemes (GSettings *sett
 #define PLUMA_SETTINGS_EDITOR_FONT                  "editor-font"
 #define PLUMA_SETTINGS_COLOR_SCHEME                 "color-scheme"
 #define PLUMA_SETTINGS_CREATE_BACKUP_COPY           "create-backup-copy"
+#define PLUMA_SETTINGS_ATOMIC_SAVE                  "atomic-save"
 #define PLUMA_SETTINGS_AUTO_SAVE                    "auto-save"
 #define PLUMA_SETTINGS_AUTO_SAVE_INTERVAL           "auto-save-interval"
 #define PLUMA_SETTINGS_MAX_UNDO_ACTIONS             "max-undo-actions"
@@ -115,6 +116,9 @@ GSList *                pluma_settings_get_writable_vfs_schemes (GSettings *sett
 #define PLUMA_SETTINGS_RIGHT_MARGIN_POSITION        "right-margin-position"
 #define PLUMA_SETTINGS_WRITABLE_VFS_SCHEMES         "writable-vfs-schemes"
 #define PLUMA_SETTINGS_RESTORE_CURSOR_POSITION      "restore-cursor-position"
+#define PLUMA_SETTINGS_PROGRESSIVE_LOADING          "progressive-loading"
+#define PLUMA_SETTINGS_LARGE_FILE_VIEWER            "large-file-viewer"
+#define PLUMA_SETTINGS_LARGE_FILE_VIEWER_THRESHOLD  "large-file-viewer-threshold"
 #define PLUMA_SETTINGS_SYNTAX_HIGHLIGHTING          "syntax-highlighting"
 #define PLUMA_SETTINGS_SEARCH_HIGHLIGHTING          "search-highlighting"
 #define PLUMA_SETTINGS_TOOLBAR_VISIBLE              "toolbar-visible"
@@ -143,6 +147,7 @@ GSList *                pluma_settings_get_writable_vfs_schemes (GSettings *sett
 #define PLUMA_SETTINGS_DRAWER_NBSP                  "enable-space-drawer-nbsp"
 #define PLUMA_SETTINGS_DISPLAY_OVERVIEW_MAP         "display-overview-map"
 #define PLUMA_SETTINGS_BACKGROUND_PATTERN           "background-pattern"
+#define PLUMA_SETTINGS_IO_CHUNK_POLICY              "io-chunk-policy"
 
 /* White list of writable mate-vfs methods */
 #define PLUMA_SETTINGS_WRITABLE_VFS_SCHEMES         "writable-vfs-schemes"
@@ -25,15 +25,68 @@
 #include "pluma-debug.h"
 #include "pluma-document.h"
 
+#include <errno.h>
+#include <string.h>
 #include <gio/gio.h>
 #include <glib/gi18n.h>
 
+/* A byte order mark is a sure guess and valid UTF-8 with multibyte
+ * sequences almost one. Plain ASCII fits any ASCII compatible encoding. */
+#define CONFIDENCE_CERTAIN	1.0
+#define CONFIDENCE_UTF8		0.95
+#define CONFIDENCE_ASCII	0.5
+
+/* the confidence of encodings we can only tell by converting the text */
+#define CONFIDENCE_UNKNOWN	-1.0
+
+/* candidates scoring less than this below the best one are as good */
+#define CONFIDENCE_TIE		0.05
+
+/* how many stray characters a nul byte counts for */
+#define NUL_WEIGHT		8
+
+typedef enum
+{
+	BYTE_UNDEFINED,
+	BYTE_CONTROL,
+	BYTE_LETTER,
+	BYTE_OTHER
+} ByteClass;
+
+typedef enum
+{
+	BOM_NONE,
+	BOM_UTF8,
+	BOM_UTF16_BE,
+	BOM_UTF16_LE,
+	BOM_UTF32_BE,
+	BOM_UTF32_LE
+} ByteOrderMark;
+
+/* What a single scan of the text tells about it */
+typedef struct
+{
+	ByteOrderMark bom;
+
+	guint utf8_valid : 1;
+	guint utf8_multibyte : 1;
+
+	gsize length;
+	gsize counts[256];
+} TextStats;
+
+/* charset -> the class of each of its bytes, or NULL when the charset
+ * is not a single byte one */
+static GHashTable *byte_classes = NULL;
+G_LOCK_DEFINE_STATIC (byte_classes);
+
 struct _PlumaSmartCharsetConverterPrivate
 {
 	GCharsetConverter *charset_conv;
 
 	GSList *encodings;
 	GSList *current_encoding;
+	gdouble confidence;
 
 	guint is_utf8 : 1;
 	guint use_first : 1;
@@ -92,38 +145,13 @@ pluma_smart_charset_converter_init (PlumaSmartCharsetConverter *smart)
 	smart->priv->charset_conv = NULL;
 	smart->priv->encodings = NULL;
 	smart->priv->current_encoding = NULL;
+	smart->priv->confidence = 0;
 	smart->priv->is_utf8 = FALSE;
 	smart->priv->use_first = FALSE;
 
 	pluma_debug_message (DEBUG_UTILS, "initializing smart charset converter");
 }
 
-static const PlumaEncoding *
-get_encoding (PlumaSmartCharsetConverter *smart)
-{
-	if (smart->priv->current_encoding == NULL)
-	{
-		smart->priv->current_encoding = smart->priv->encodings;
-	}
-	else
-	{
-		smart->priv->current_encoding = g_slist_next (smart->priv->current_encoding);
-	}
-
-	if (smart->priv->current_encoding != NULL)
-		return (const PlumaEncoding *)smart->priv->current_encoding->data;
-
-#if 0
-	FIXME: uncomment this when using fallback
-	/* If we tried all encodings, we return the first encoding */
-	smart->priv->use_first = TRUE;
-	smart->priv->current_encoding = smart->priv->encodings;
-
-	return (const PlumaEncoding *)smart->priv->current_encoding->data;
-#endif
-	return NULL;
-}
-
 static gboolean
 try_convert (GCharsetConverter *converter,
              const void        *inbuf,
@@ -196,12 +224,319 @@ try_convert (GCharsetConverter *converter,
 	return ret;
 }
 
+static ByteOrderMark
+get_bom (const guchar *text,
+	 gsize         len)
+{
+	if (len >= 3 && text[0] == 0xef && text[1] == 0xbb && text[2] == 0xbf)
+		return BOM_UTF8;
+
+	if (len >= 4 && text[0] == 0x00 && text[1] == 0x00 && text[2] == 0xfe && text[3] == 0xff)
+		return BOM_UTF32_BE;
+
+	if (len >= 4 && text[0] == 0xff && text[1] == 0xfe && text[2] == 0x00 && text[3] == 0x00)
+		return BOM_UTF32_LE;
+
+	if (len >= 2 && text[0] == 0xfe && text[1] == 0xff)
+		return BOM_UTF16_BE;
+
+	if (len >= 2 && text[0] == 0xff && text[1] == 0xfe)
+		return BOM_UTF16_LE;
+
+	return BOM_NONE;
+}
+
+/* Validates the text as UTF-8 and counts its bytes in a single pass.
+ * A sequence cut by the end of the block is not an error. */
+static void
+scan_text (const guchar *text,
+	   gsize         len,
+	   TextStats    *stats)
+{
+	gsize i;
+	guint need = 0;
+	guchar lo = 0x80, hi = 0xbf;
+
+	memset (stats, 0, sizeof (TextStats));
+
+	stats->bom = get_bom (text, len);
+	stats->utf8_valid = TRUE;
+	stats->length = len;
+
+	for (i = 0; i < len; i++)
+	{
+		guchar c = text[i];
+
+		stats->counts[c]++;
+
+		if (!stats->utf8_valid)
+			continue;
+
+		if (need > 0)
+		{
+			if (c < lo || c > hi)
+			{
+				stats->utf8_valid = FALSE;
+				continue;
+			}
+
+			/* only the first continuation byte has a narrower range */
+			lo = 0x80;
+			hi = 0xbf;
+			need--;
+		}
+		else if (c < 0x80)
+		{
+			continue;
+		}
+		else if (c >= 0xc2 && c <= 0xdf)
+		{
+			need = 1;
+		}
+		else if (c >= 0xe0 && c <= 0xef)
+		{
+			need = 2;
+			lo = (c == 0xe0) ? 0xa0 : 0x80;
+			hi = (c == 0xed) ? 0x9f : 0xbf;
+		}
+		else if (c >= 0xf0 && c <= 0xf4)
+		{
+			need = 3;
+			lo = (c == 0xf0) ? 0x90 : 0x80;
+			hi = (c == 0xf4) ? 0x8f : 0xbf;
+		}
+		else
+		{
+			stats->utf8_valid = FALSE;
+		}
+
+		if (need > 0)
+			stats->utf8_multibyte = TRUE;
+	}
+}
+
+static ByteClass
+classify_char (gunichar ch)
+{
+	if (g_unichar_isalpha (ch))
+		return BYTE_LETTER;
+
+	if (g_unichar_iscntrl (ch) && !g_unichar_isspace (ch))
+		return BYTE_CONTROL;
+
+	return BYTE_OTHER;
+}
+
+/* Converts each byte on its own to find out what it stands for in
+ * @charset. Returns NULL if @charset is not a single byte encoding. */
+static guint8 *
+build_byte_classes (const gchar *charset)
+{
+	GIConv cd;
+	guint8 *classes;
+	guint i;
+
+	cd = g_iconv_open ("UTF-8", charset);
+	if (cd == (GIConv) -1)
+		return NULL;
+
+	classes = g_new (guint8, 256);
+
+	for (i = 0; i < 256; i++)
+	{
+		gchar in = (gchar) i;
+		gchar out[16];
+		gchar *inp = &in;
+		gchar *outp = out;
+		gsize inleft = 1;
+		gsize outleft = sizeof (out);
+		gunichar ch;
+
+		/* reset the conversion state */
+		g_iconv (cd, NULL, NULL, NULL, NULL);
+
+		if (g_iconv (cd, &inp, &inleft, &outp, &outleft) == (gsize) -1)
+		{
+			/* the byte starts a longer sequence */
+			if (errno == EINVAL)
+				break;
+
+			classes[i] = BYTE_UNDEFINED;
+			continue;
+		}
+
+		g_iconv (cd, NULL, NULL, &outp, &outleft);
+
+		/* more or less than one character */
+		if (outp == out ||
+		    (ch = g_utf8_get_char_validated (out, outp - out)) == (gunichar)-1 ||
+		    ch == (gunichar)-2 ||
+		    g_utf8_next_char (out) != outp)
+			break;
+
+		classes[i] = classify_char (ch);
+	}
+
+	g_iconv_close (cd);
+
+	if (i < 256)
+	{
+		g_free (classes);
+		return NULL;
+	}
+
+	return classes;
+}
+
+static const guint8 *
+get_byte_classes (const gchar *charset)
+{
+	guint8 *classes;
+
+	G_LOCK (byte_classes);
+
+	if (byte_classes == NULL)
+		byte_classes = g_hash_table_new (g_str_hash, g_str_equal);
+
+	if (!g_hash_table_lookup_extended (byte_classes, charset, NULL, (gpointer *) &classes))
+	{
+		classes = build_byte_classes (charset);
+		g_hash_table_insert (byte_classes, g_strdup (charset), classes);
+	}
+
+	G_UNLOCK (byte_classes);
+
+	return classes;
+}
+
+static gboolean
+bom_matches (ByteOrderMark  bom,
+	     const gchar   *charset)
+{
+	switch (bom)
+	{
+		case BOM_UTF16_BE:
+			return g_ascii_strcasecmp (charset, "UTF-16") == 0 ||
+			       g_ascii_strcasecmp (charset, "UTF-16BE") == 0;
+
+		case BOM_UTF16_LE:
+			return g_ascii_strcasecmp (charset, "UTF-16") == 0 ||
+			       g_ascii_strcasecmp (charset, "UTF-16LE") == 0;
+
+		case BOM_UTF32_BE:
+		case BOM_UTF32_LE:
+			return g_ascii_strcasecmp (charset, "UTF-32") == 0 ||
+			       g_ascii_strcasecmp (charset, "UCS-4") == 0;
+
+		default:
+			return FALSE;
+	}
+}
+
+/* Nul bytes are rare in text but a stray one does not rule out any
+ * encoding: they lower the confidence instead */
+static gdouble
+get_nul_factor (const TextStats *stats)
+{
+	gdouble nuls;
+
+	if (stats->counts[0] == 0)
+		return 1.0;
+
+	nuls = (gdouble) stats->counts[0] * NUL_WEIGHT / stats->length;
+
+	return 1.0 - MIN (nuls, 0.5);
+}
+
+/* Scores how well the text fits @enc from its byte frequencies, or
+ * returns CONFIDENCE_UNKNOWN if the scan cannot tell */
+static gdouble
+get_confidence (const PlumaEncoding *enc,
+		const TextStats     *stats)
+{
+	const gchar *charset;
+	const guint8 *classes;
+	gsize high = 0, letters = 0, controls = 0;
+	gdouble confidence;
+	guint i;
+
+	if (enc == pluma_encoding_get_utf8 ())
+	{
+		if (!stats->utf8_valid)
+			return 0;
+
+		if (stats->bom == BOM_UTF8)
+			return CONFIDENCE_CERTAIN;
+
+		return (stats->utf8_multibyte ? CONFIDENCE_UTF8 : CONFIDENCE_ASCII) *
+		       get_nul_factor (stats);
+	}
+
+	charset = pluma_encoding_get_charset (enc);
+
+	if (bom_matches (stats->bom, charset))
+		return CONFIDENCE_CERTAIN;
+
+	classes = get_byte_classes (charset);
+	if (classes == NULL)
+		return CONFIDENCE_UNKNOWN;
+
+	/* nul bytes are weighted on their own */
+	for (i = 1; i < 256; i++)
+	{
+		if (stats->counts[i] == 0)
+			continue;
+
+		if (classes[i] == BYTE_UNDEFINED)
+			return 0;
+
+		if (i < 0x80)
+			continue;
+
+		high += stats->counts[i];
+
+		if (classes[i] == BYTE_LETTER)
+			letters += stats->counts[i];
+		else if (classes[i] == BYTE_CONTROL)
+			controls += stats->counts[i];
+	}
+
+	if (high == 0)
+		return CONFIDENCE_ASCII * get_nul_factor (stats);
+
+	/* legacy text is mostly made of letters, stray control characters
+	 * usually mean the wrong encoding */
+	confidence = 0.1 + 0.8 * ((gdouble) letters - (gdouble) controls) / high;
+
+	return CLAMP (confidence, 0.05, 0.9) * get_nul_factor (stats);
+}
+
+/* Whether the candidate scored @confidence is as good as the best one:
+ * the scan cannot rank the encodings it does not score, they are tied
+ * with any guess which is not almost sure */
+static gboolean
+is_tied (gdouble confidence,
+	 gdouble best_confidence)
+{
+	if (confidence == CONFIDENCE_UNKNOWN)
+		return best_confidence < CONFIDENCE_UTF8;
+
+	return confidence > 0 && confidence > best_confidence - CONFIDENCE_TIE;
+}
+
 static GCharsetConverter *
 guess_encoding (PlumaSmartCharsetConverter *smart,
 		const void                 *inbuf,
 		gsize                       inbuf_size)
 {
 	GCharsetConverter *conv = NULL;
+	TextStats stats;
+	GSList *l;
+	GSList *best = NULL;
+	gdouble *confidences;
+	gdouble best_confidence = 0;
+	guint n_tied = 0;
+	guint i;
 
 	if (inbuf == NULL || inbuf_size == 0)
 	{
@@ -211,79 +546,108 @@ guess_encoding (PlumaSmartCharsetConverter *smart,
 
 	if (smart->priv->encodings != NULL &&
 	    smart->priv->encodings->next == NULL)
+	{
+		/* nothing to guess from, we use the only encoding */
 		smart->priv->use_first = TRUE;
-
-	/* We just check the first block */
-	while (TRUE)
+		best = smart->priv->encodings;
+	}
+	else
 	{
-		const PlumaEncoding *enc;
+		/* We just check the first block */
+		scan_text (inbuf, inbuf_size, &stats);
+
+		/* Rank the candidates */
+		confidences = g_new (gdouble, g_slist_length (smart->priv->encodings));
 
-		if (conv != NULL)
+		for (l = smart->priv->encodings, i = 0; l != NULL; l = g_slist_next (l), i++)
 		{
-			g_object_unref (conv);
-			conv = NULL;
-		}
+			confidences[i] = get_confidence (l->data, &stats);
 
-		/* We get an encoding from the list */
-		enc = get_encoding (smart);
+			pluma_debug_message (DEBUG_UTILS, "charset: %s, confidence: %.2f",
+					     pluma_encoding_get_charset (l->data),
+					     confidences[i]);
 
-		/* if it is NULL we didn't guess anything */
-		if (enc == NULL)
-		{
-			break;
+			if (confidences[i] > best_confidence)
+			{
+				best = l;
+				best_confidence = confidences[i];
+			}
 		}
 
-		pluma_debug_message (DEBUG_UTILS, "trying charset: %s",
-				     pluma_encoding_get_charset (smart->priv->current_encoding->data));
+		for (l = smart->priv->encodings, i = 0; l != NULL; l = g_slist_next (l), i++)
+		{
+			if (l != best && is_tied (confidences[i], best_confidence))
+				n_tied++;
+		}
 
-		if (enc == pluma_encoding_get_utf8 ())
+		/* Candidates tied with the best one are told apart by
+		   converting the text, in the order of the list */
+		for (l = smart->priv->encodings, i = 0; n_tied > 0 && l != NULL; l = g_slist_next (l), i++)
 		{
-			gsize remainder;
-			const gchar *end;
+			if (l != best && !is_tied (confidences[i], best_confidence))
+				continue;
+
+			pluma_debug_message (DEBUG_UTILS, "trying charset: %s",
+					     pluma_encoding_get_charset (l->data));
 
-			if (g_utf8_validate (inbuf, inbuf_size, &end) ||
-			    smart->priv->use_first)
+			/* UTF-8 is checked by the scan already */
+			if (l->data == pluma_encoding_get_utf8 ())
 			{
-				smart->priv->is_utf8 = TRUE;
+				if (!stats.utf8_valid)
+					continue;
+
+				best = l;
+				best_confidence = confidences[i];
 				break;
 			}
 
-			/* Check if the end is less than one char */
-			remainder = inbuf_size - (end - (gchar *)inbuf);
-			if (remainder < 6)
+			conv = g_charset_converter_new ("UTF-8",
+							pluma_encoding_get_charset (l->data),
+							NULL);
+
+			if (conv != NULL && try_convert (conv, inbuf, inbuf_size))
 			{
-				smart->priv->is_utf8 = TRUE;
+				best = l;
+				best_confidence = confidences[i];
 				break;
 			}
 
-			continue;
+			g_clear_object (&conv);
 		}
 
-		conv = g_charset_converter_new ("UTF-8",
-						pluma_encoding_get_charset (enc),
-						NULL);
+		g_free (confidences);
+	}
 
-		/* If we tried all encodings we use the first one */
-		if (smart->priv->use_first)
-		{
-			break;
-		}
+	/* if it is NULL we didn't guess anything */
+	if (best == NULL)
+		return NULL;
 
-		/* Try to convert */
-		if (try_convert (conv, inbuf, inbuf_size))
-		{
-			break;
-		}
+	smart->priv->current_encoding = best;
+	smart->priv->confidence = best_confidence;
+
+	pluma_debug_message (DEBUG_UTILS, "guessed charset: %s",
+			     pluma_encoding_get_charset (best->data));
+
+	if (best->data == pluma_encoding_get_utf8 ())
+	{
+		smart->priv->is_utf8 = TRUE;
+		return NULL;
 	}
 
-	if (conv != NULL)
+	if (conv == NULL)
+	{
+		conv = g_charset_converter_new ("UTF-8",
+						pluma_encoding_get_charset (best->data),
+						NULL);
+	}
+	else
 	{
 		g_converter_reset (G_CONVERTER (conv));
-
-		/* FIXME: uncomment this when we want to use the fallback
-		g_charset_converter_set_use_fallback (conv, TRUE);*/
 	}
 
+	/* FIXME: uncomment this when we want to use the fallback
+	g_charset_converter_set_use_fallback (conv, TRUE);*/
+
 	return conv;
 }
 
@@ -360,6 +724,7 @@ pluma_smart_charset_converter_reset (GConverter *converter)
 	PlumaSmartCharsetConverter *smart = PLUMA_SMART_CHARSET_CONVERTER (converter);
 
 	smart->priv->current_encoding = NULL;
+	smart->priv->confidence = 0;
 	smart->priv->is_utf8 = FALSE;
 
 	if (smart->priv->charset_conv != NULL)
@@ -418,3 +783,85 @@ pluma_smart_charset_converter_get_num_fallbacks (PlumaSmartCharsetConverter *sma
 	return g_charset_converter_get_num_fallbacks (smart->priv->charset_conv) != 0;
 }
 
+static gboolean
+is_ascii_compatible (const PlumaEncoding *enc)
+{
+	static const gchar ascii[] = "\t\n\r !\"#$%&'()*+,-./0123456789:;<=>?@"
+				     "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`"
+				     "abcdefghijklmnopqrstuvwxyz{|}~";
+	gchar *converted;
+	gboolean ret;
+
+	if (enc == pluma_encoding_get_utf8 ())
+		return TRUE;
+
+	converted = g_convert (ascii, -1,
+			       "UTF-8", pluma_encoding_get_charset (enc),
+			       NULL, NULL, NULL);
+
+	ret = (converted != NULL && strcmp (converted, ascii) == 0);
+
+	g_free (converted);
+
+	return ret;
+}
+
+/**
+ * pluma_smart_charset_converter_guess_again:
+ * @smart: a #PlumaSmartCharsetConverter
+ * @inbuf: the text the guessed encoding failed on
+ * @inbuf_size: the size of @inbuf
+ * @keep_ascii: whether the ASCII text decoded so far is kept
+ *
+ * Drops the guessed encoding once it turned out not to fit some text
+ * past the first block, and guesses again from @inbuf among the other
+ * candidates. If @keep_ascii is %TRUE only the encodings which read
+ * ASCII as it is are left. The converter then has to be fed the text
+ * again from where it was kept.
+ *
+ * Returns: %FALSE if there is no candidate left
+ */
+gboolean
+pluma_smart_charset_converter_guess_again (PlumaSmartCharsetConverter *smart,
+					   const void                 *inbuf,
+					   gsize                       inbuf_size,
+					   gboolean                    keep_ascii)
+{
+	GSList *l;
+
+	g_return_val_if_fail (PLUMA_IS_SMART_CHARSET_CONVERTER (smart), FALSE);
+	g_return_val_if_fail (inbuf_size > 0, FALSE);
+
+	if (smart->priv->current_encoding != NULL)
+	{
+		smart->priv->encodings = g_slist_delete_link (smart->priv->encodings,
+							      smart->priv->current_encoding);
+	}
+	else if (smart->priv->is_utf8)
+	{
+		smart->priv->encodings = g_slist_remove (smart->priv->encodings,
+							 pluma_encoding_get_utf8 ());
+	}
+
+	l = smart->priv->encodings;
+
+	while (keep_ascii && l != NULL)
+	{
+		GSList *next = g_slist_next (l);
+
+		if (!is_ascii_compatible (l->data))
+			smart->priv->encodings = g_slist_delete_link (smart->priv->encodings, l);
+
+		l = next;
+	}
+
+	pluma_smart_charset_converter_reset (G_CONVERTER (smart));
+	smart->priv->use_first = FALSE;
+
+	if (smart->priv->encodings == NULL)
+		return FALSE;
+
+	smart->priv->charset_conv = guess_encoding (smart, inbuf, inbuf_size);
+
+	return smart->priv->charset_conv != NULL || smart->priv->is_utf8;
+}
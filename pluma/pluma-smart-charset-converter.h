@@ -62,6 +62,11 @@ const PlumaEncoding		*pluma_smart_charset_converter_get_guessed	(PlumaSmartChars
 
 guint				 pluma_smart_charset_converter_get_num_fallbacks(PlumaSmartCharsetConverter *smart);
 
+gboolean			 pluma_smart_charset_converter_guess_again	(PlumaSmartCharsetConverter *smart,
+										 const void                 *inbuf,
+										 gsize                       inbuf_size,
+										 gboolean                    keep_ascii);
+
 G_END_DECLS
 
 #endif /* __PLUMA_SMART_CHARSET_CONVERTER_H__ */
@@ -61,6 +61,10 @@ struct _PlumaTabPrivate
 	GtkWidget	       *message_area;
 	GtkWidget	       *print_preview;
 
+	/* shown while the rest of a large file is loading */
+	GtkWidget	       *loading_indicator;
+	GtkWidget	       *loading_progress;
+
 	PlumaPrintJob          *print_job;
 
 	/* tmp data for saving */
@@ -84,6 +88,7 @@ struct _PlumaTabPrivate
 	gint                    ask_if_externally_modified : 1;
 
 	guint			idle_scroll;
+	guint			idle_page;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (PlumaTab, pluma_tab, GTK_TYPE_BOX)
@@ -98,6 +103,8 @@ enum
 };
 
 static gboolean pluma_tab_auto_save (PlumaTab *tab);
+static void large_file_scrolled (GtkAdjustment *adjustment,
+				 PlumaTab      *tab);
 
 static void
 install_auto_save_timeout (PlumaTab *tab)
@@ -243,6 +250,12 @@ pluma_tab_finalize (GObject *object)
 		tab->priv->idle_scroll = 0;
 	}
 
+	if (tab->priv->idle_page != 0)
+	{
+		g_source_remove (tab->priv->idle_page);
+		tab->priv->idle_page = 0;
+	}
+
 	/* settings must be cleared in finalize and not in dispose to prevent
 	a warning when trying to close pluma while print-preview is active */
 	g_clear_object (&tab->priv->editor_settings);
@@ -559,7 +572,8 @@ file_already_open_warning_message_area_response (GtkWidget   *message_area,
 
 	view = pluma_tab_get_view (tab);
 
-	if (response_id == GTK_RESPONSE_YES)
+	if (response_id == GTK_RESPONSE_YES &&
+	    !_pluma_document_is_large_file (pluma_tab_get_document (tab)))
 	{
 		tab->priv->not_editable = FALSE;
 
@@ -584,6 +598,69 @@ load_cancelled (GtkWidget        *area,
 	g_object_unref (tab);
 }
 
+static void
+loading_indicator_cancel_clicked (GtkButton *button,
+				  PlumaTab  *tab)
+{
+	g_object_ref (tab);
+	pluma_document_load_cancel (pluma_tab_get_document (tab));
+	g_object_unref (tab);
+}
+
+/* Once the region around the cursor is shown, the progress of the rest
+ * of the file is shown in a corner of the view instead of in a message
+ * area, so that the document can be read meanwhile */
+static void
+show_loading_indicator (PlumaTab *tab)
+{
+	GtkWidget *box;
+	GtkWidget *button;
+
+	if (tab->priv->loading_indicator != NULL)
+		return;
+
+	pluma_debug (DEBUG_TAB);
+
+	box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+	gtk_widget_set_halign (box, GTK_ALIGN_END);
+	gtk_widget_set_valign (box, GTK_ALIGN_END);
+	gtk_widget_set_margin_end (box, 12);
+	gtk_widget_set_margin_bottom (box, 12);
+	gtk_style_context_add_class (gtk_widget_get_style_context (box),
+				     GTK_STYLE_CLASS_OSD);
+
+	tab->priv->loading_progress = gtk_progress_bar_new ();
+	gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (tab->priv->loading_progress),
+					TRUE);
+	gtk_widget_set_valign (tab->priv->loading_progress, GTK_ALIGN_CENTER);
+	gtk_box_pack_start (GTK_BOX (box), tab->priv->loading_progress, FALSE, FALSE, 0);
+
+	button = gtk_button_new_from_icon_name ("process-stop", GTK_ICON_SIZE_MENU);
+	gtk_button_set_relief (GTK_BUTTON (button), GTK_RELIEF_NONE);
+	gtk_widget_set_tooltip_text (button, _("Stop loading"));
+	g_signal_connect (button,
+			  "clicked",
+			  G_CALLBACK (loading_indicator_cancel_clicked),
+			  tab);
+	gtk_box_pack_start (GTK_BOX (box), button, FALSE, FALSE, 0);
+
+	gtk_widget_show_all (box);
+	gtk_overlay_add_overlay (GTK_OVERLAY (tab->priv->overlay), box);
+
+	tab->priv->loading_indicator = box;
+}
+
+static void
+hide_loading_indicator (PlumaTab *tab)
+{
+	if (tab->priv->loading_indicator == NULL)
+		return;
+
+	gtk_widget_destroy (tab->priv->loading_indicator);
+	tab->priv->loading_indicator = NULL;
+	tab->priv->loading_progress = NULL;
+}
+
 static gboolean
 scroll_to_cursor (PlumaTab *tab)
 {
@@ -818,6 +895,21 @@ show_saving_message_area (PlumaTab *tab)
 	g_free (from_markup);
 }
 
+static void
+loading_indicator_set_progress (PlumaTab *tab,
+				goffset   size,
+				goffset   total_size)
+{
+	if (tab->priv->loading_progress == NULL)
+		return;
+
+	if (total_size == 0)
+		gtk_progress_bar_pulse (GTK_PROGRESS_BAR (tab->priv->loading_progress));
+	else
+		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (tab->priv->loading_progress),
+					       (gdouble)size / (gdouble)total_size);
+}
+
 static void
 message_area_set_progress (PlumaTab *tab,
 			   goffset   size,
@@ -872,6 +964,25 @@ document_loading (PlumaDocument *document,
 		tab->priv->timer = g_timer_new ();
 	}
 
+	/* the region around the cursor is in: let the user read it while
+	 * the rest of the file is loading */
+	if (_pluma_document_get_viewport_loaded (document))
+	{
+		if (tab->priv->loading_indicator == NULL)
+		{
+			set_message_area (tab, NULL);
+			show_loading_indicator (tab);
+
+			gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (tab->priv->view),
+							  TRUE);
+			pluma_view_scroll_to_cursor (PLUMA_VIEW (tab->priv->view));
+		}
+
+		loading_indicator_set_progress (tab, size, total_size);
+
+		return;
+	}
+
 	et = g_timer_elapsed (tab->priv->timer, NULL);
 
 	/* et : total_time = size : total_size */
@@ -913,6 +1024,7 @@ document_loaded (PlumaDocument *document,
 	tab->priv->times_called = 0;
 
 	set_message_area (tab, NULL);
+	hide_loading_indicator (tab);
 
 	location = pluma_document_get_location (document);
 	uri = pluma_document_get_uri (document);
@@ -987,6 +1099,9 @@ document_loaded (PlumaDocument *document,
 
 		g_return_if_fail (uri != NULL);
 
+		/* pages of a large file cannot be edited */
+		tab->priv->not_editable = _pluma_document_is_large_file (document);
+
 		mime = pluma_document_get_mime_type (document);
 		_pluma_recent_add (PLUMA_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (tab))),
 				   uri,
@@ -1561,6 +1676,12 @@ pluma_tab_init (PlumaTab *tab)
 					     GTK_SHADOW_IN);
 	gtk_widget_show (sw);
 
+	/* only does something for large files, see pluma-large-file.h */
+	g_signal_connect (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (sw)),
+			  "value-changed",
+			  G_CALLBACK (large_file_scrolled),
+			  tab);
+
 	/* Create the minimap overlay */
 	tab->priv->overlay = gtk_overlay_new ();
 	tab->priv->view_map_frame = gtk_frame_new (NULL);
@@ -1665,6 +1786,66 @@ _pluma_tab_new_from_uri (const gchar         *uri,
 	return GTK_WIDGET (tab);
 }
 
+/* Pages in the text around the first visible char, keeping it at the
+ * top of the view. It may be in the middle of a long wrapped line. */
+static gboolean
+large_file_page (PlumaTab *tab)
+{
+	PlumaDocument *doc;
+	GdkRectangle visible;
+	GtkTextIter iter;
+
+	tab->priv->idle_page = 0;
+
+	doc = pluma_tab_get_document (tab);
+
+	gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (tab->priv->view), &visible);
+	gtk_text_view_get_iter_at_location (GTK_TEXT_VIEW (tab->priv->view),
+					    &iter,
+					    visible.x,
+					    visible.y);
+
+	_pluma_document_large_file_show_iter (doc, &iter);
+
+	gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (tab->priv->view),
+				      gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)),
+				      0.0,
+				      TRUE,
+				      0.0,
+				      0.0);
+
+	return FALSE;
+}
+
+static void
+large_file_scrolled (GtkAdjustment *adjustment,
+		     PlumaTab      *tab)
+{
+	PlumaDocument *doc;
+	gdouble value;
+	gdouble page_size;
+	gboolean near_start;
+	gboolean near_end;
+
+	doc = pluma_tab_get_document (tab);
+
+	if (tab->priv->state != PLUMA_TAB_STATE_NORMAL ||
+	    tab->priv->idle_page != 0 ||
+	    !_pluma_document_is_large_file (doc))
+		return;
+
+	value = gtk_adjustment_get_value (adjustment);
+	page_size = gtk_adjustment_get_page_size (adjustment);
+
+	near_start = value < page_size &&
+		     !_pluma_document_large_file_at_start (doc);
+	near_end = value + 2 * page_size > gtk_adjustment_get_upper (adjustment) &&
+		   !_pluma_document_large_file_at_end (doc);
+
+	if (near_start || near_end)
+		tab->priv->idle_page = g_idle_add ((GSourceFunc) large_file_page, tab);
+}
+
 /**
  * pluma_tab_get_view:
  * @tab: a #PlumaTab
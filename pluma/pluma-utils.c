@@ -51,6 +51,7 @@
 #include "pluma-settings.h"
 #include "pluma-document.h"
 #include "pluma-debug.h"
+#include "pluma-search-snapshot.h"
 
 /* For the workspace/viewport stuff */
 #include <gdk/gdkx.h>
@@ -1559,6 +1560,146 @@ pluma_utils_decode_uri (const gchar  *uri,
 	return TRUE;
 }
 
+/* Compiled regexes are kept around, since searching again, highlighting
+ * the matches and replacing all of them run the same pattern many times */
+#define REGEX_CACHE_SIZE 8
+
+typedef struct
+{
+	gchar              *pattern;
+	GRegexCompileFlags  flags;
+	GRegex             *regex;
+} RegexCacheEntry;
+
+/* most recently used first */
+static GQueue regex_cache = G_QUEUE_INIT;
+G_LOCK_DEFINE_STATIC (regex_cache);
+
+static void
+regex_cache_entry_free (RegexCacheEntry *entry)
+{
+	g_free (entry->pattern);
+	g_regex_unref (entry->regex);
+
+	g_slice_free (RegexCacheEntry, entry);
+}
+
+/* Returns a new reference to @pattern compiled with @compile_flags, or
+ * NULL if it is not a valid regular expression */
+GRegex *
+_pluma_utils_regex_cache_get (const gchar        *pattern,
+			      GRegexCompileFlags  compile_flags)
+{
+	RegexCacheEntry *entry;
+	GRegex *regex;
+	GList *l;
+
+	g_return_val_if_fail (pattern != NULL, NULL);
+
+	G_LOCK (regex_cache);
+
+	for (l = regex_cache.head; l != NULL; l = l->next)
+	{
+		entry = l->data;
+
+		if (entry->flags == compile_flags &&
+		    strcmp (entry->pattern, pattern) == 0)
+		{
+			g_queue_unlink (&regex_cache, l);
+			g_queue_push_head_link (&regex_cache, l);
+
+			regex = g_regex_ref (entry->regex);
+
+			G_UNLOCK (regex_cache);
+
+			return regex;
+		}
+	}
+
+	G_UNLOCK (regex_cache);
+
+	regex = g_regex_new (pattern, compile_flags, 0, NULL);
+
+	if (regex == NULL)
+		return NULL;
+
+	entry = g_slice_new (RegexCacheEntry);
+	entry->pattern = g_strdup (pattern);
+	entry->flags = compile_flags;
+	entry->regex = g_regex_ref (regex);
+
+	G_LOCK (regex_cache);
+
+	g_queue_push_head (&regex_cache, entry);
+
+	if (regex_cache.length > REGEX_CACHE_SIZE)
+		regex_cache_entry_free (g_queue_pop_tail (&regex_cache));
+
+	G_UNLOCK (regex_cache);
+
+	return regex;
+}
+
+/* Drops @pattern, compiled with any flags, from the cache */
+void
+_pluma_utils_regex_cache_remove (const gchar *pattern)
+{
+	GList *l;
+
+	g_return_if_fail (pattern != NULL);
+
+	G_LOCK (regex_cache);
+
+	l = regex_cache.head;
+
+	while (l != NULL)
+	{
+		RegexCacheEntry *entry = l->data;
+		GList *next = l->next;
+
+		if (strcmp (entry->pattern, pattern) == 0)
+		{
+			g_queue_delete_link (&regex_cache, l);
+			regex_cache_entry_free (entry);
+		}
+
+		l = next;
+	}
+
+	G_UNLOCK (regex_cache);
+}
+
+/* Like gtk_text_buffer_get_iter_at_offset() but for documents with more
+ * chars than fit in a gint */
+void
+_pluma_utils_get_iter_at_offset64 (GtkTextBuffer *buffer,
+				   GtkTextIter   *iter,
+				   gint64         offset)
+{
+	g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+	g_return_if_fail (iter != NULL);
+
+	if (offset <= G_MAXINT)
+	{
+		gtk_text_buffer_get_iter_at_offset (buffer, iter, (gint) offset);
+		return;
+	}
+
+	gtk_text_buffer_get_iter_at_offset (buffer, iter, G_MAXINT);
+	offset -= G_MAXINT;
+
+	while (offset > 0 && !gtk_text_iter_is_end (iter))
+	{
+		gint step = (gint) MIN (offset, G_MAXINT);
+
+		gtk_text_iter_forward_chars (iter, step);
+		offset -= step;
+	}
+}
+
+/* Only the case sensitivity is taken from @flags. Text hidden by
+ * invisible tags is skipped, as if it was not in the buffer, see
+ * pluma-search-snapshot.h */
 gboolean
 pluma_gtk_text_iter_regex_search (const GtkTextIter *iter,
 				  const gchar       *str,
@@ -1569,103 +1710,52 @@ pluma_gtk_text_iter_regex_search (const GtkTextIter *iter,
 				  gboolean forward_search,
 				  gchar            **replace_text)
 {
+	GtkTextBuffer *buffer;
 	GRegex *regex;
 	GRegexCompileFlags compile_flags;
-	GMatchInfo *match_info;
-	gchar *text;
-	GtkTextIter *begin_iter;
-	GtkTextIter *end_iter;
-	gchar *match_string;
 	gboolean found;
 
-	match_string = "";
 	compile_flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
 
 	if ((flags & GTK_TEXT_SEARCH_CASE_INSENSITIVE) != 0)
 		compile_flags |= G_REGEX_CASELESS;
 
-	regex = g_regex_new (str,compile_flags,0,NULL);
+	regex = _pluma_utils_regex_cache_get (str, compile_flags);
 
 	if (regex == NULL)
 		return FALSE;
 
-	begin_iter = gtk_text_iter_copy (iter);
-
-	if (limit == NULL)
-	{
-		end_iter = gtk_text_iter_copy (begin_iter);
-		if (forward_search)
-		{
-			gtk_text_buffer_get_end_iter (gtk_text_iter_get_buffer(begin_iter),
-						      end_iter);
-		}
-		else
-		{
-			gtk_text_buffer_get_start_iter (gtk_text_iter_get_buffer (begin_iter),
-							end_iter);
-		}
-	}
-	else
-	{
-		end_iter = gtk_text_iter_copy (limit);
-	}
+	buffer = gtk_text_iter_get_buffer (iter);
 
-	if ((flags & GTK_TEXT_SEARCH_TEXT_ONLY) != 0)
+	if (PLUMA_IS_DOCUMENT (buffer))
 	{
-		if ((flags & GTK_TEXT_SEARCH_VISIBLE_ONLY) != 0)
-			text = gtk_text_iter_get_visible_text (begin_iter, end_iter);
-		else
-			text = gtk_text_iter_get_text (begin_iter, end_iter);
+		found = _pluma_document_regex_search (PLUMA_DOCUMENT (buffer),
+						      regex,
+						      iter,
+						      limit,
+						      forward_search,
+						      match_start,
+						      match_end,
+						      replace_text);
 	}
-	else if ((flags & GTK_TEXT_SEARCH_VISIBLE_ONLY) != 0)
-		text = gtk_text_iter_get_visible_slice (begin_iter, end_iter);
 	else
-		text = gtk_text_iter_get_slice (begin_iter, end_iter);
-
-	found = g_regex_match (regex, text, 0, &match_info);
-
-	if (!found)
-		goto free_resources;
-
-	if((replace_text != NULL) && (*replace_text != NULL))
 	{
-		*replace_text = g_match_info_expand_references (match_info,
-								*replace_text,
-								NULL);
+		PlumaSearchSnapshot *snapshot;
+
+		snapshot = _pluma_search_snapshot_new (buffer);
+		found = _pluma_search_snapshot_regex_search (snapshot,
+							     buffer,
+							     regex,
+							     iter,
+							     limit,
+							     forward_search,
+							     match_start,
+							     match_end,
+							     replace_text);
+		_pluma_search_snapshot_free (snapshot);
 	}
 
-	while (g_match_info_matches (match_info))
-	{
-		match_string = g_match_info_fetch (match_info, 0);
-
-		if (forward_search)
-			break;
-
-		g_match_info_next (match_info, NULL);
-	}
-
-
-	if (forward_search)
-	{
-		gtk_text_iter_forward_search (begin_iter,
-					      match_string,
-					      flags,
-					      match_start,
-					      match_end,
-					      limit);
-	} else {
-		gtk_text_iter_backward_search (begin_iter,
-					       match_string,
-					       flags,
-					       match_start,
-					       match_end,
-					       limit);
-	}
-
-free_resources:
-	gtk_text_iter_free (begin_iter);
-	gtk_text_iter_free (end_iter);
-	g_match_info_free (match_info);
 	g_regex_unref (regex);
+
 	return found;
 }
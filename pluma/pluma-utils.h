@@ -147,6 +147,15 @@ gboolean	 pluma_utils_decode_uri 		(const gchar *uri,
 /* Turns data from a drop into a list of well formatted uris */
 gchar 	       **pluma_utils_drop_get_uris		(GtkSelectionData *selection_data);
 
+GRegex		*_pluma_utils_regex_cache_get		(const gchar        *pattern,
+							 GRegexCompileFlags  compile_flags);
+
+void		 _pluma_utils_regex_cache_remove	(const gchar        *pattern);
+
+void		 _pluma_utils_get_iter_at_offset64	(GtkTextBuffer      *buffer,
+							 GtkTextIter        *iter,
+							 gint64              offset);
+
 /* Provides regexp forward search */
 gboolean
 pluma_gtk_text_iter_regex_search (const GtkTextIter *iter,
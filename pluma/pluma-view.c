@@ -95,6 +95,11 @@ struct _PlumaViewPrivate
 
     GtkWidget   *search_window;
     GtkWidget   *search_entry;
+    GtkWidget   *search_count_label;
+
+    /* document whose matches are counted while searching */
+    PlumaDocument *match_count_doc;
+    gulong       match_index_updated_id;
 
     guint        typeselect_flush_timeout;
     gulong       search_entry_changed_id;
@@ -164,6 +169,8 @@ static gboolean reset_searched_text          (PlumaView        *view);
 static void    hide_search_window            (PlumaView        *view,
                                               gboolean          cancel);
 
+static void    stop_match_count              (PlumaView        *view);
+
 static gboolean    pluma_view_draw           (GtkWidget        *widget,
                                               cairo_t          *cr);
 
@@ -623,11 +630,14 @@ pluma_view_dispose (GObject *object)
         view->priv->extensions = NULL;
     }
 
+    stop_match_count (view);
+
     if (view->priv->search_window != NULL)
     {
         gtk_widget_destroy (view->priv->search_window);
         view->priv->search_window = NULL;
         view->priv->search_entry = NULL;
+        view->priv->search_count_label = NULL;
 
         if (view->priv->typeselect_flush_timeout != 0)
         {
@@ -1082,6 +1092,154 @@ set_entry_state (GtkWidget             *entry,
     }
 }
 
+static void
+update_match_count (PlumaView *view)
+{
+    PlumaDocument *doc = view->priv->match_count_doc;
+    GtkTextIter    start;
+    GtkTextIter    end;
+    gboolean       complete;
+    gint           n_matches;
+    gint           number = -1;
+    gchar         *text;
+
+    if (doc == NULL)
+        return;
+
+    if (*gtk_entry_get_text (GTK_ENTRY (view->priv->search_entry)) == '\0')
+    {
+        gtk_label_set_text (GTK_LABEL (view->priv->search_count_label), "");
+        return;
+    }
+
+    n_matches = _pluma_document_get_n_matches (doc, &complete);
+
+    if (gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc), &start, &end))
+        number = _pluma_document_get_match_number (doc, &start);
+
+    if (number >= 0 && complete)
+        text = g_strdup_printf (_("%d of %d"), number + 1, n_matches);
+    else if (number >= 0)
+        text = g_strdup_printf (_("%d of at least %d"), number + 1, n_matches);
+    else if (complete)
+        text = g_strdup_printf (ngettext ("%d match", "%d matches", n_matches), n_matches);
+    else if (n_matches > 0)
+        text = g_strdup_printf (_("At least %d matches"), n_matches);
+    else
+        text = g_strdup (_("Counting matches\342\200\246"));
+
+    gtk_label_set_text (GTK_LABEL (view->priv->search_count_label), text);
+
+    g_free (text);
+}
+
+static void
+match_index_updated_cb (PlumaDocument *doc,
+                        PlumaView     *view)
+{
+    update_match_count (view);
+}
+
+/* The matches are counted in the background while the search window is
+ * shown, except in large files where only a part of the file is loaded */
+static void
+start_match_count (PlumaView *view)
+{
+    PlumaDocument *doc;
+
+    doc = PLUMA_DOCUMENT (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+
+    if (view->priv->match_count_doc != NULL || _pluma_document_is_large_file (doc))
+        return;
+
+    view->priv->match_count_doc = g_object_ref (doc);
+    view->priv->match_index_updated_id =
+        g_signal_connect (doc,
+                          "match-index-updated",
+                          G_CALLBACK (match_index_updated_cb),
+                          view);
+
+    _pluma_document_set_index_matches (doc, TRUE);
+
+    gtk_label_set_text (GTK_LABEL (view->priv->search_count_label), "");
+    gtk_widget_show (view->priv->search_count_label);
+}
+
+static void
+stop_match_count (PlumaView *view)
+{
+    if (view->priv->match_count_doc == NULL)
+        return;
+
+    g_signal_handler_disconnect (view->priv->match_count_doc,
+                                 view->priv->match_index_updated_id);
+    view->priv->match_index_updated_id = 0;
+
+    _pluma_document_set_index_matches (view->priv->match_count_doc, FALSE);
+
+    g_object_unref (view->priv->match_count_doc);
+    view->priv->match_count_doc = NULL;
+
+    if (view->priv->search_count_label != NULL)
+        gtk_widget_hide (view->priv->search_count_label);
+}
+
+/* Once all the matches are indexed, going to the next or previous one
+ * does not need to search the text */
+static gboolean
+jump_to_indexed_match (PlumaView *view,
+                       gboolean   search_backward,
+                       gboolean   wrap_around)
+{
+    PlumaDocument *doc = view->priv->match_count_doc;
+    GtkTextIter    sel_start;
+    GtkTextIter    sel_end;
+    GtkTextIter    match_start;
+    GtkTextIter    match_end;
+    gboolean       complete;
+    gint           n_matches;
+    gint           n;
+
+    if (doc == NULL)
+        return FALSE;
+
+    n_matches = _pluma_document_get_n_matches (doc, &complete);
+
+    if (!complete)
+        return FALSE;
+
+    gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc), &sel_start, &sel_end);
+
+    n = _pluma_document_find_match (doc,
+                                    search_backward ? &sel_start : &sel_end,
+                                    !search_backward);
+
+    if (n < 0 && wrap_around && n_matches > 0)
+        n = search_backward ? n_matches - 1 : 0;
+
+    if (_pluma_document_get_nth_match (doc, n, &match_start, &match_end))
+    {
+        gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &match_start);
+        gtk_text_buffer_move_mark_by_name (GTK_TEXT_BUFFER (doc),
+                                           "selection_bound",
+                                           &match_end);
+
+        pluma_view_scroll_to_cursor (view);
+
+        set_entry_state (view->priv->search_entry,
+                         PLUMA_SEARCH_ENTRY_NORMAL);
+    }
+    else
+    {
+        set_entry_state (view->priv->search_entry,
+                         PLUMA_SEARCH_ENTRY_NOT_FOUND);
+    }
+
+    update_match_count (view);
+
+    return TRUE;
+}
+
 static gboolean
 run_search (PlumaView        *view,
             const gchar      *entry_text,
@@ -1094,10 +1252,12 @@ run_search (PlumaView        *view,
     GtkTextIter    match_end;
     gboolean       found = FALSE;
     PlumaDocument *doc;
+    gint64         first_line;
 
     g_return_val_if_fail (view->priv->search_mode == SEARCH, FALSE);
 
     doc = PLUMA_DOCUMENT (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+    first_line = _pluma_document_get_first_line (doc);
 
     start_iter = view->priv->start_search_iter;
 
@@ -1158,6 +1318,12 @@ run_search (PlumaView        *view,
                                                         &match_start,
                                                         &match_end);
         }
+
+        /* searching a large file may have paged in another part of it */
+        if (_pluma_document_get_first_line (doc) != first_line)
+            gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
+                                              &view->priv->start_search_iter,
+                                              gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
     }
     else
     {
@@ -1196,6 +1362,8 @@ run_search (PlumaView        *view,
                          PLUMA_SEARCH_ENTRY_NOT_FOUND);
     }
 
+    update_match_count (view);
+
     return found;
 }
 
@@ -1244,6 +1412,8 @@ hide_search_window (PlumaView *view, gboolean cancel)
         view->priv->typeselect_flush_timeout = 0;
     }
 
+    stop_match_count (view);
+
     /* send focus-in event */
     send_focus_change (GTK_WIDGET (view->priv->search_entry), FALSE);
     gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (view), TRUE);
@@ -1334,6 +1504,10 @@ search_again (PlumaView *view,
 
     add_search_completion_entry (entry_text);
 
+    if (*entry_text != '\0' &&
+        jump_to_indexed_match (view, search_backward, view->priv->wrap_around))
+        return;
+
     run_search (view,
                 entry_text,
                 search_backward,
@@ -1816,6 +1990,15 @@ ensure_search_window (PlumaView *view)
     gtk_container_add (GTK_CONTAINER (vbox),
                        view->priv->search_entry);
 
+    /* "n of m" under the entry, shown while searching */
+    view->priv->search_count_label = gtk_label_new (NULL);
+    gtk_label_set_xalign (GTK_LABEL (view->priv->search_count_label), 1.0);
+    gtk_style_context_add_class (gtk_widget_get_style_context (view->priv->search_count_label),
+                                 GTK_STYLE_CLASS_DIM_LABEL);
+
+    gtk_container_add (GTK_CONTAINER (vbox),
+                       view->priv->search_count_label);
+
     if (search_completion_model == NULL)
     {
         /* Create a tree model and use it as the completion model */
@@ -1887,7 +2070,8 @@ init_search_entry (PlumaView *view)
         gint   line;
         gchar *line_str;
 
-        line = gtk_text_iter_get_line (&view->priv->start_search_iter);
+        line = gtk_text_iter_get_line (&view->priv->start_search_iter) +
+               _pluma_document_get_first_line (PLUMA_DOCUMENT (buffer));
 
         line_str = g_strdup_printf ("%d", line + 1);
 
@@ -1993,6 +2177,7 @@ search_init (GtkWidget *entry,
             gint line_offset = 0;
             gchar **split_text = NULL;
             const gchar *text;
+            gint64 first_line;
 
             split_text = g_strsplit (entry_text, ":", -1);
 
@@ -2005,9 +2190,12 @@ search_init (GtkWidget *entry,
                 text = entry_text;
             }
 
+            /* lines of large files are counted from the start of the file */
+            first_line = _pluma_document_get_first_line (doc);
+
             if (*text == '-')
             {
-                gint cur_line = gtk_text_iter_get_line (&view->priv->start_search_iter);
+                gint cur_line = gtk_text_iter_get_line (&view->priv->start_search_iter) + first_line;
 
                 if (*(text + 1) != '\0')
                     offset_line = MAX (atoi (text + 1), 0);
@@ -2016,7 +2204,7 @@ search_init (GtkWidget *entry,
             }
             else if (*entry_text == '+')
             {
-                gint cur_line = gtk_text_iter_get_line (&view->priv->start_search_iter);
+                gint cur_line = gtk_text_iter_get_line (&view->priv->start_search_iter) + first_line;
 
                 if (*(text + 1) != '\0')
                     offset_line = MAX (atoi (text + 1), 0);
@@ -2038,6 +2226,11 @@ search_init (GtkWidget *entry,
             moved = pluma_document_goto_line (doc, line);
             moved_offset = pluma_document_goto_line_offset (doc, line, line_offset);
 
+            if (_pluma_document_get_first_line (doc) != first_line)
+                gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
+                                                  &view->priv->start_search_iter,
+                                                  gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
+
             pluma_view_scroll_to_cursor (view);
 
             if (!moved || !moved_offset)
@@ -2073,6 +2266,9 @@ start_interactive_search_real (PlumaView *view)
 
     ensure_search_window (view);
 
+    if (view->priv->search_mode == SEARCH)
+        start_match_count (view);
+
     /* done, show it */
     update_search_window_position (view);
     gtk_widget_show (view->priv->search_window);
@@ -2153,7 +2153,9 @@ update_cursor_position_statusbar (GtkTextBuffer *buffer,
                                       &iter,
                                       gtk_text_buffer_get_insert (buffer));
 
-    row = gtk_text_iter_get_line (&iter);
+    /* only a page of large files is in the document */
+    row = gtk_text_iter_get_line (&iter) +
+          _pluma_document_get_first_line (PLUMA_DOCUMENT (buffer));
 
     col = gtk_source_view_get_visual_column (GTK_SOURCE_VIEW(view), &iter);
 
@@ -48,10 +48,17 @@ typedef struct _Subregion {
 	GtkTextMark *end;
 } Subregion;
 
+/* The subregions are kept sorted in an array so that the ones around an
+   iter are found with a binary search: they never overlap, so both their
+   starts and their ends are in order, even after the buffer changed.
+   Deleting text can leave empty ones behind, they are dropped before the
+   subregions are looked at again. */
 struct _PlumaTextRegion {
 	GtkTextBuffer *buffer;
-	GList         *subregions;
+	GPtrArray     *subregions;
 	guint32        time_stamp;
+	gulong         delete_range_id;
+	gboolean       may_have_empty;
 };
 
 typedef struct _PlumaTextRegionIteratorReal PlumaTextRegionIteratorReal;
@@ -60,60 +67,109 @@ struct _PlumaTextRegionIteratorReal {
 	PlumaTextRegion *region;
 	guint32        region_time_stamp;
 
-	GList         *subregions;
+	guint          index;
 };
 
+#define SUBREGION(region,i) ((Subregion *) g_ptr_array_index ((region)->subregions, (i)))
+
 
 /* ----------------------------------------------------------------------
    Private interface
    ---------------------------------------------------------------------- */
 
-/* Find and return a subregion node which contains the given text
-   iter.  If left_side is TRUE, return the subregion which contains
-   the text iter or which is the leftmost; else return the rightmost
-   subregion */
-static GList *
+static gint
+compare_to_mark (PlumaTextRegion   *region,
+		 const GtkTextIter *iter,
+		 GtkTextMark       *mark)
+{
+	GtkTextIter mark_iter;
+
+	gtk_text_buffer_get_iter_at_mark (region->buffer, &mark_iter, mark);
+
+	return gtk_text_iter_compare (iter, &mark_iter);
+}
+
+/* Find the index of the subregion which contains the given text iter.
+   If leftmost is TRUE, return the rightmost subregion starting before
+   iter, looking from begin on, or begin - 1 if there is none; else
+   return the leftmost subregion ending after iter, or the number of
+   subregions if there is none. */
+static gint
 find_nearest_subregion (PlumaTextRegion     *region,
 			const GtkTextIter *iter,
-			GList             *begin,
+			gint               begin,
 			gboolean           leftmost,
 			gboolean           include_edges)
 {
-	GList *l, *retval;
-
-	g_return_val_if_fail (region != NULL && iter != NULL, NULL);
+	gint lo, hi;
 
-	if (!begin)
-		begin = region->subregions;
+	g_return_val_if_fail (region != NULL && iter != NULL, -1);
 
-	if (begin)
-		retval = begin->prev;
-	else
-		retval = NULL;
+	/* first subregion for which the test fails */
+	lo = begin;
+	hi = region->subregions->len;
 
-	for (l = begin; l; l = l->next) {
-		GtkTextIter sr_iter;
-		Subregion *sr = l->data;
+	while (lo < hi) {
+		gint mid = (lo + hi) / 2;
+		Subregion *sr = SUBREGION (region, mid);
+		gboolean before;
 		gint cmp;
 
 		if (!leftmost) {
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_iter, sr->end);
-			cmp = gtk_text_iter_compare (iter, &sr_iter);
-			if (cmp < 0 || (cmp == 0 && include_edges)) {
-				retval = l;
-				break;
-			}
-
+			/* does sr end before iter? */
+			cmp = compare_to_mark (region, iter, sr->end);
+			before = cmp > 0 || (cmp == 0 && !include_edges);
 		} else {
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_iter, sr->start);
-			cmp = gtk_text_iter_compare (iter, &sr_iter);
-			if (cmp > 0 || (cmp == 0 && include_edges))
-				retval = l;
-			else
-				break;
+			/* does sr start before iter? */
+			cmp = compare_to_mark (region, iter, sr->start);
+			before = cmp > 0 || (cmp == 0 && include_edges);
 		}
+
+		if (before)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	return retval;
+
+	return leftmost ? lo - 1 : lo;
+}
+
+static void
+subregion_free (PlumaTextRegion *region,
+		Subregion       *sr,
+		gboolean         delete_marks)
+{
+	if (delete_marks) {
+		gtk_text_buffer_delete_mark (region->buffer, sr->start);
+		gtk_text_buffer_delete_mark (region->buffer, sr->end);
+	}
+
+	g_free (sr);
+}
+
+static void
+delete_range_cb (GtkTextBuffer   *buffer,
+		 GtkTextIter     *start,
+		 GtkTextIter     *end,
+		 PlumaTextRegion *region)
+{
+	region->may_have_empty = TRUE;
+}
+
+static void pluma_text_region_clear_zero_length_subregions (PlumaTextRegion *region,
+							   gint             first,
+							   gint             last);
+
+static void
+clear_empty_subregions (PlumaTextRegion *region)
+{
+	if (!region->may_have_empty)
+		return;
+
+	pluma_text_region_clear_zero_length_subregions (region,
+						       0,
+						       (gint) region->subregions->len - 1);
+	region->may_have_empty = FALSE;
 }
 
 /* ----------------------------------------------------------------------
@@ -129,8 +185,13 @@ pluma_text_region_new (GtkTextBuffer *buffer)
 
 	region = g_new (PlumaTextRegion, 1);
 	region->buffer = buffer;
-	region->subregions = NULL;
+	region->subregions = g_ptr_array_new ();
 	region->time_stamp = 0;
+	region->may_have_empty = FALSE;
+	region->delete_range_id = g_signal_connect (buffer,
+						    "delete-range",
+						    G_CALLBACK (delete_range_cb),
+						    region);
 
 	return region;
 }
@@ -138,18 +199,18 @@ pluma_text_region_new (GtkTextBuffer *buffer)
 void
 pluma_text_region_destroy (PlumaTextRegion *region, gboolean delete_marks)
 {
+	guint i;
+
 	g_return_if_fail (region != NULL);
 
-	while (region->subregions) {
-		Subregion *sr = region->subregions->data;
-		if (delete_marks) {
-			gtk_text_buffer_delete_mark (region->buffer, sr->start);
-			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-		}
-		g_free (sr);
-		region->subregions = g_list_delete_link (region->subregions,
-							 region->subregions);
-	}
+	for (i = 0; i < region->subregions->len; i++)
+		subregion_free (region, SUBREGION (region, i), delete_marks);
+
+	/* the handlers of a buffer being finalized are already gone */
+	if (delete_marks)
+		g_signal_handler_disconnect (region->buffer, region->delete_range_id);
+
+	g_ptr_array_free (region->subregions, TRUE);
 	region->buffer = NULL;
 	region->time_stamp = 0;
 
@@ -164,31 +225,30 @@ pluma_text_region_get_buffer (PlumaTextRegion *region)
 	return region->buffer;
 }
 
+/* Only the subregions between first and last are looked at: they are
+   the ones the caller has just changed. */
 static void
-pluma_text_region_clear_zero_length_subregions (PlumaTextRegion *region)
+pluma_text_region_clear_zero_length_subregions (PlumaTextRegion *region,
+					       gint             first,
+					       gint             last)
 {
 	GtkTextIter start, end;
-	GList *node;
+	gint i;
 
 	g_return_if_fail (region != NULL);
 
-	for (node = region->subregions; node; ) {
-		Subregion *sr = node->data;
+	first = MAX (first, 0);
+	last = MIN (last, (gint) region->subregions->len - 1);
+
+	for (i = last; i >= first; i--) {
+		Subregion *sr = SUBREGION (region, i);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &start, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &end, sr->end);
 		if (gtk_text_iter_equal (&start, &end)) {
-			gtk_text_buffer_delete_mark (region->buffer, sr->start);
-			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-			g_free (sr);
-			if (node == region->subregions)
-				region->subregions = node = g_list_delete_link (node, node);
-			else
-				node = g_list_delete_link (node, node);
+			subregion_free (region, sr, TRUE);
+			g_ptr_array_remove_index (region->subregions, i);
 
 			++region->time_stamp;
-
-		} else {
-			node = node->next;
 		}
 	}
 }
@@ -198,7 +258,7 @@ pluma_text_region_add (PlumaTextRegion     *region,
 		     const GtkTextIter *_start,
 		     const GtkTextIter *_end)
 {
-	GList *start_node, *end_node;
+	gint start_node, end_node;
 	GtkTextIter start, end;
 
 	g_return_if_fail (region != NULL && _start != NULL && _end != NULL);
@@ -219,50 +279,38 @@ pluma_text_region_add (PlumaTextRegion     *region,
 		return;
 
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, TRUE);
+	start_node = find_nearest_subregion (region, &start, 0, FALSE, TRUE);
 	end_node = find_nearest_subregion (region, &end, start_node, TRUE, TRUE);
 
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev) {
-		/* create the new subregion */
+	if (start_node == (gint) region->subregions->len || end_node < start_node) {
+		/* create the new subregion, after the ones ending before
+		   start and before the ones starting after end */
 		Subregion *sr = g_new0 (Subregion, 1);
 		sr->start = gtk_text_buffer_create_mark (region->buffer, NULL, &start, TRUE);
 		sr->end = gtk_text_buffer_create_mark (region->buffer, NULL, &end, FALSE);
 
-		if (start_node == NULL) {
-			/* append the new region */
-			region->subregions = g_list_append (region->subregions, sr);
-
-		} else if (end_node == NULL) {
-			/* prepend the new region */
-			region->subregions = g_list_prepend (region->subregions, sr);
-
-		} else {
-			/* we are in the middle of two subregions */
-			region->subregions = g_list_insert_before (region->subregions,
-								   start_node, sr);
-		}
+		g_ptr_array_insert (region->subregions, start_node, sr);
 	}
 	else {
 		GtkTextIter iter;
-		Subregion *sr = start_node->data;
+		Subregion *sr = SUBREGION (region, start_node);
 		if (start_node != end_node) {
 			/* we need to merge some subregions */
-			GList *l = start_node->next;
 			Subregion *q;
+			gint i;
 
 			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-			while (l != end_node) {
-				q = l->data;
-				gtk_text_buffer_delete_mark (region->buffer, q->start);
-				gtk_text_buffer_delete_mark (region->buffer, q->end);
-				g_free (q);
-				l = g_list_delete_link (l, l);
-			}
-			q = l->data;
+			for (i = start_node + 1; i < end_node; i++)
+				subregion_free (region, SUBREGION (region, i), TRUE);
+
+			q = SUBREGION (region, end_node);
 			gtk_text_buffer_delete_mark (region->buffer, q->start);
 			sr->end = q->end;
 			g_free (q);
-			l = g_list_delete_link (l, l);
+
+			g_ptr_array_remove_range (region->subregions,
+						  start_node + 1,
+						  end_node - start_node);
 		}
 		/* now move marks if that action expands the region */
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter, sr->start);
@@ -283,12 +331,13 @@ pluma_text_region_subtract (PlumaTextRegion     *region,
 			  const GtkTextIter *_start,
 			  const GtkTextIter *_end)
 {
-	GList *start_node, *end_node, *node;
+	gint start_node, end_node;
+	gint first, last;
 	GtkTextIter sr_start_iter, sr_end_iter;
-	gboolean done;
 	gboolean start_is_outside, end_is_outside;
 	Subregion *sr;
 	GtkTextIter start, end;
+	gint i;
 
 	g_return_if_fail (region != NULL && _start != NULL && _end != NULL);
 
@@ -304,17 +353,17 @@ pluma_text_region_subtract (PlumaTextRegion     *region,
 	gtk_text_iter_order (&start, &end);
 
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, FALSE);
+	start_node = find_nearest_subregion (region, &start, 0, FALSE, FALSE);
 	end_node = find_nearest_subregion (region, &end, start_node, TRUE, FALSE);
 
 	/* easy case first */
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev)
+	if (start_node == (gint) region->subregions->len || end_node < start_node)
 		return;
 
 	/* deal with the start point */
 	start_is_outside = end_is_outside = FALSE;
 
-	sr = start_node->data;
+	sr = SUBREGION (region, start_node);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 
@@ -329,11 +378,13 @@ pluma_text_region_subtract (PlumaTextRegion     *region,
 			new_sr->end = sr->end;
 			new_sr->start = gtk_text_buffer_create_mark (region->buffer,
 								     NULL, &end, TRUE);
-			start_node = g_list_insert_before (start_node, start_node->next, new_sr);
+			g_ptr_array_insert (region->subregions, start_node + 1, new_sr);
 
 			sr->end = gtk_text_buffer_create_mark (region->buffer,
 							       NULL, &start, FALSE);
 
+			++region->time_stamp;
+
 			/* no further processing needed */
 			DEBUG (g_message ("subregion splitted"));
 
@@ -353,7 +404,7 @@ pluma_text_region_subtract (PlumaTextRegion     *region,
 
 	/* deal with the end point */
 	if (start_node != end_node) {
-		sr = end_node->data;
+		sr = SUBREGION (region, end_node);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 	}
@@ -368,37 +419,25 @@ pluma_text_region_subtract (PlumaTextRegion     *region,
 
 	}
 
-	/* finally remove any intermediate subregions */
-	done = FALSE;
-	node = start_node;
+	/* finally remove any intermediate subregions, skipping the
+	   starting and ending ones if they were only cut */
+	first = start_is_outside ? start_node : start_node + 1;
+	last = end_is_outside ? end_node : end_node - 1;
 
-	while (!done) {
-		if (node == end_node)
-			/* we are done, exit in the next iteration */
-			done = TRUE;
+	for (i = first; i <= last; i++)
+		subregion_free (region, SUBREGION (region, i), TRUE);
 
-		if ((node == start_node && !start_is_outside) ||
-		    (node == end_node && !end_is_outside)) {
-			/* skip starting or ending node */
-			node = node->next;
-		} else {
-			GList *l = node->next;
-			sr = node->data;
-			gtk_text_buffer_delete_mark (region->buffer, sr->start);
-			gtk_text_buffer_delete_mark (region->buffer, sr->end);
-			g_free (sr);
-			region->subregions = g_list_delete_link (region->subregions,
-								 node);
-			node = l;
-		}
-	}
+	if (last >= first)
+		g_ptr_array_remove_range (region->subregions, first, last - first + 1);
 
 	++region->time_stamp;
 
 	DEBUG (pluma_text_region_debug_print (region));
 
 	/* now get rid of empty subregions */
-	pluma_text_region_clear_zero_length_subregions (region);
+	pluma_text_region_clear_zero_length_subregions (region,
+						       start_node - 1,
+						       start_node + 1);
 
 	DEBUG (pluma_text_region_debug_print (region));
 }
@@ -408,7 +447,9 @@ pluma_text_region_subregions (PlumaTextRegion *region)
 {
 	g_return_val_if_fail (region != NULL, 0);
 
-	return g_list_length (region->subregions);
+	clear_empty_subregions (region);
+
+	return region->subregions->len;
 }
 
 gboolean
@@ -421,10 +462,13 @@ pluma_text_region_nth_subregion (PlumaTextRegion *region,
 
 	g_return_val_if_fail (region != NULL, FALSE);
 
-	sr = g_list_nth_data (region->subregions, subregion);
-	if (sr == NULL)
+	clear_empty_subregions (region);
+
+	if (subregion >= region->subregions->len)
 		return FALSE;
 
+	sr = SUBREGION (region, subregion);
+
 	if (start)
 		gtk_text_buffer_get_iter_at_mark (region->buffer, start, sr->start);
 	if (end)
@@ -433,105 +477,67 @@ pluma_text_region_nth_subregion (PlumaTextRegion *region,
 	return TRUE;
 }
 
+static void
+append_subregion (PlumaTextRegion   *region,
+		  const GtkTextIter *start,
+		  const GtkTextIter *end)
+{
+	Subregion *sr = g_new0 (Subregion, 1);
+
+	sr->start = gtk_text_buffer_create_mark (region->buffer, NULL, start, TRUE);
+	sr->end = gtk_text_buffer_create_mark (region->buffer, NULL, end, FALSE);
+
+	g_ptr_array_add (region->subregions, sr);
+}
+
 PlumaTextRegion *
 pluma_text_region_intersect (PlumaTextRegion     *region,
 			   const GtkTextIter *_start,
 			   const GtkTextIter *_end)
 {
-	GList *start_node, *end_node, *node;
+	gint start_node, end_node, node;
 	GtkTextIter sr_start_iter, sr_end_iter;
-	Subregion *sr, *new_sr;
-	gboolean done;
+	Subregion *sr;
 	PlumaTextRegion *new_region;
 	GtkTextIter start, end;
 
 	g_return_val_if_fail (region != NULL && _start != NULL && _end != NULL, NULL);
 
+	clear_empty_subregions (region);
+
 	start = *_start;
 	end = *_end;
 
 	gtk_text_iter_order (&start, &end);
 
 	/* find bounding subregions */
-	start_node = find_nearest_subregion (region, &start, NULL, FALSE, FALSE);
+	start_node = find_nearest_subregion (region, &start, 0, FALSE, FALSE);
 	end_node = find_nearest_subregion (region, &end, start_node, TRUE, FALSE);
 
 	/* easy case first */
-	if (start_node == NULL || end_node == NULL || end_node == start_node->prev)
+	if (start_node == (gint) region->subregions->len || end_node < start_node)
 		return NULL;
 
 	new_region = pluma_text_region_new (region->buffer);
-	done = FALSE;
-
-	sr = start_node->data;
-	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
-	gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 
-	/* starting node */
-	if (gtk_text_iter_in_range (&start, &sr_start_iter, &sr_end_iter)) {
-		new_sr = g_new0 (Subregion, 1);
-		new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
-
-		new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-							     &start, TRUE);
-		if (start_node == end_node) {
-			/* things will finish shortly */
-			done = TRUE;
-			if (gtk_text_iter_in_range (&end, &sr_start_iter, &sr_end_iter))
-				new_sr->end = gtk_text_buffer_create_mark (new_region->buffer,
-									   NULL, &end, FALSE);
-			else
-				new_sr->end = gtk_text_buffer_create_mark (new_region->buffer,
-									   NULL, &sr_end_iter,
-									   FALSE);
-		} else {
-			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-								   &sr_end_iter, FALSE);
-		}
-		node = start_node->next;
-	} else {
-		/* start should be the same as the subregion, so copy it in the loop */
-		node = start_node;
-	}
-
-	if (!done) {
-		while (node != end_node) {
-			/* copy intermediate subregions verbatim */
-			sr = node->data;
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter,
-							  sr->start);
-			gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
-
-			new_sr = g_new0 (Subregion, 1);
-			new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
-			new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-								     &sr_start_iter, TRUE);
-			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-								   &sr_end_iter, FALSE);
-			/* next node */
-			node = node->next;
-		}
-
-		/* ending node */
-		sr = node->data;
+	for (node = start_node; node <= end_node; node++) {
+		sr = SUBREGION (region, node);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_start_iter, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &sr_end_iter, sr->end);
 
-		new_sr = g_new0 (Subregion, 1);
-		new_region->subregions = g_list_prepend (new_region->subregions, new_sr);
+		/* clip the starting and ending nodes, copy the
+		   intermediate ones verbatim */
+		if (node == start_node &&
+		    gtk_text_iter_in_range (&start, &sr_start_iter, &sr_end_iter))
+			sr_start_iter = start;
 
-		new_sr->start = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-							     &sr_start_iter, TRUE);
+		if (node == end_node &&
+		    gtk_text_iter_in_range (&end, &sr_start_iter, &sr_end_iter))
+			sr_end_iter = end;
 
-		if (gtk_text_iter_in_range (&end, &sr_start_iter, &sr_end_iter))
-			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-								   &end, FALSE);
-		else
-			new_sr->end = gtk_text_buffer_create_mark (new_region->buffer, NULL,
-								   &sr_end_iter, FALSE);
+		append_subregion (new_region, &sr_start_iter, &sr_end_iter);
 	}
 
-	new_region->subregions = g_list_reverse (new_region->subregions);
 	return new_region;
 }
 
@@ -564,10 +570,12 @@ pluma_text_region_get_iterator (PlumaTextRegion         *region,
 
 	real = (PlumaTextRegionIteratorReal *)iter;
 
-	/* region->subregions may be NULL, -> end iter */
+	clear_empty_subregions (region);
+
+	/* start may be past the last subregion, -> end iter */
 
 	real->region = region;
-	real->subregions = g_list_nth (region->subregions, start);
+	real->index = MIN (start, region->subregions->len);
 	real->region_time_stamp = region->time_stamp;
 }
 
@@ -581,7 +589,7 @@ pluma_text_region_iterator_is_end (PlumaTextRegionIterator *iter)
 	real = (PlumaTextRegionIteratorReal *)iter;
 	g_return_val_if_fail (check_iterator (real), FALSE);
 
-	return (real->subregions == NULL);
+	return (real->index >= real->region->subregions->len);
 }
 
 gboolean
@@ -594,8 +602,8 @@ pluma_text_region_iterator_next (PlumaTextRegionIterator *iter)
 	real = (PlumaTextRegionIteratorReal *)iter;
 	g_return_val_if_fail (check_iterator (real), FALSE);
 
-	if (real->subregions != NULL) {
-		real->subregions = g_list_next (real->subregions);
+	if (real->index < real->region->subregions->len) {
+		real->index++;
 		return TRUE;
 	}
 	else
@@ -614,9 +622,9 @@ pluma_text_region_iterator_get_subregion (PlumaTextRegionIterator *iter,
 
 	real = (PlumaTextRegionIteratorReal *)iter;
 	g_return_if_fail (check_iterator (real));
-	g_return_if_fail (real->subregions != NULL);
+	g_return_if_fail (real->index < real->region->subregions->len);
 
-	sr = (Subregion*)real->subregions->data;
+	sr = SUBREGION (real->region, real->index);
 	g_return_if_fail (sr != NULL);
 
 	if (start)
@@ -628,20 +636,18 @@ pluma_text_region_iterator_get_subregion (PlumaTextRegionIterator *iter,
 void
 pluma_text_region_debug_print (PlumaTextRegion *region)
 {
-	GList *l;
+	guint i;
 
 	g_return_if_fail (region != NULL);
 
 	g_print ("Subregions: ");
-	l = region->subregions;
-	while (l) {
-		Subregion *sr = l->data;
+	for (i = 0; i < region->subregions->len; i++) {
+		Subregion *sr = SUBREGION (region, i);
 		GtkTextIter iter1, iter2;
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter1, sr->start);
 		gtk_text_buffer_get_iter_at_mark (region->buffer, &iter2, sr->end);
 		g_print ("%d-%d ", gtk_text_iter_get_offset (&iter1),
 			 gtk_text_iter_get_offset (&iter2));
-		l = l->next;
 	}
 	g_print ("\n");
 }
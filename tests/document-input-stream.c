@@ -45,7 +45,7 @@ test_consecutive_read (const gchar *inbuf,
 	buf = gtk_text_buffer_new (NULL);
 	gtk_text_buffer_set_text (buf, inbuf, -1);
 
-	b = g_malloc (200);
+	b = g_malloc (MAX (200, strlen (outbuf) + read_chunk_len + 1));
 	in = pluma_document_input_stream_new (buf, type);
 
 	outlen = strlen (outbuf);
@@ -138,6 +138,180 @@ test_consecutive_multibyte_big_read ()
 	test_consecutive_read ("hello\nhello\xe6\x96\x87\nworld\n", "hello\nhello\xe6\x96\x87\nworld\n\n", PLUMA_DOCUMENT_NEWLINE_TYPE_LF, 200);
 }
 
+static void
+test_consecutive_small_read ()
+{
+	/* less than a char or a line ending fits */
+	test_consecutive_read ("hello\nhello\xe6\x96\x87\nworld\n", "hello\r\nhello\xe6\x96\x87\r\nworld\r\n\r\n", PLUMA_DOCUMENT_NEWLINE_TYPE_CR_LF, 1);
+	test_consecutive_read ("hello\nhello\xe6\x96\x87\nworld", "hello\nhello\xe6\x96\x87\nworld\n", PLUMA_DOCUMENT_NEWLINE_TYPE_LF, 2);
+}
+
+static void
+test_tell ()
+{
+	GtkTextBuffer *buf;
+	GInputStream *in;
+	gchar b[200];
+	gssize r;
+
+	buf = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_set_text (buf, "h\xc3\xa9llo\r\nw\xe6\x96\x87rld", -1);
+
+	in = pluma_document_input_stream_new (buf, PLUMA_DOCUMENT_NEWLINE_TYPE_LF);
+
+	r = g_input_stream_read (in, b, 6, NULL, NULL);
+	g_assert_cmpint (r, ==, 6);
+	g_assert_cmpint (pluma_document_input_stream_tell (PLUMA_DOCUMENT_INPUT_STREAM (in)), ==, 5);
+
+	while (g_input_stream_read (in, b, sizeof (b), NULL, NULL) > 0)
+		;
+
+	g_assert_cmpint (pluma_document_input_stream_tell (PLUMA_DOCUMENT_INPUT_STREAM (in)), ==,
+			 gtk_text_buffer_get_char_count (buf));
+
+	g_input_stream_close (in, NULL, NULL);
+	g_object_unref (in);
+	g_object_unref (buf);
+}
+
+static void
+test_crlf_across_runs ()
+{
+	GString *inbuf;
+	GString *outbuf;
+
+	/* the \r\n lands on the boundary between two runs of text */
+	inbuf = g_string_new (NULL);
+	outbuf = g_string_new (NULL);
+
+	while (inbuf->len < 64 * 1024 - 1)
+	{
+		g_string_append_c (inbuf, 'a');
+		g_string_append_c (outbuf, 'a');
+	}
+
+	g_string_append (inbuf, "\r\nb");
+	g_string_append (outbuf, "\nb\n");
+
+	test_consecutive_read (inbuf->str, outbuf->str, PLUMA_DOCUMENT_NEWLINE_TYPE_LF, 4096);
+	test_consecutive_read (inbuf->str, outbuf->str, PLUMA_DOCUMENT_NEWLINE_TYPE_LF, 7);
+
+	g_string_free (inbuf, TRUE);
+	g_string_free (outbuf, TRUE);
+}
+
+#define BENCHMARK_LINES 200000
+
+static GtkTextBuffer *
+create_benchmark_buffer (void)
+{
+	GtkTextBuffer *buf;
+	GString *text;
+	gint i;
+
+	text = g_string_new (NULL);
+
+	for (i = 0; i < BENCHMARK_LINES; i++)
+		g_string_append_printf (text, "%d: the quick brown fox jumps over the lazy dog\n", i);
+
+	buf = gtk_text_buffer_new (NULL);
+	gtk_text_buffer_set_text (buf, text->str, text->len);
+
+	g_string_free (text, TRUE);
+
+	return buf;
+}
+
+/* What reading used to cost: a slice, a byte count and a mark move for
+ * every line */
+static gsize
+read_per_line (GtkTextBuffer *buf)
+{
+	GtkTextMark *pos;
+	GtkTextIter start, end;
+	gsize total = 0;
+
+	gtk_text_buffer_get_start_iter (buf, &start);
+	pos = gtk_text_buffer_create_mark (buf, NULL, &start, FALSE);
+
+	while (!gtk_text_iter_is_end (&start))
+	{
+		gchar *line;
+
+		end = start;
+		if (!gtk_text_iter_ends_line (&end))
+			gtk_text_iter_forward_to_line_end (&end);
+
+		line = gtk_text_iter_get_slice (&start, &end);
+		total += gtk_text_iter_get_bytes_in_line (&start);
+		g_free (line);
+
+		gtk_text_iter_forward_line (&start);
+		gtk_text_buffer_move_mark (buf, pos, &start);
+		gtk_text_buffer_get_iter_at_mark (buf, &start, pos);
+	}
+
+	gtk_text_buffer_delete_mark (buf, pos);
+
+	return total;
+}
+
+static gsize
+read_stream (GtkTextBuffer            *buf,
+	     PlumaDocumentNewlineType  type)
+{
+	GInputStream *in;
+	gchar *b;
+	gssize r;
+	gsize total = 0;
+	GError *err = NULL;
+
+	b = g_malloc (64 * 1024);
+	in = pluma_document_input_stream_new (buf, type);
+
+	while ((r = g_input_stream_read (in, b, 64 * 1024, NULL, &err)) > 0)
+		total += r;
+
+	g_assert_no_error (err);
+
+	g_input_stream_close (in, NULL, NULL);
+	g_object_unref (in);
+	g_free (b);
+
+	return total;
+}
+
+static void
+test_read_benchmark ()
+{
+	GtkTextBuffer *buf;
+	GTimer *timer;
+	gsize bytes;
+	gdouble elapsed;
+
+	buf = create_benchmark_buffer ();
+	timer = g_timer_new ();
+
+	bytes = read_per_line (buf);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_message ("per line: %.1f MB/s", bytes / elapsed / (1024 * 1024));
+
+	g_timer_start (timer);
+	bytes = read_stream (buf, PLUMA_DOCUMENT_NEWLINE_TYPE_LF);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_minimized_result (elapsed, "stream, same newlines: %.1f MB/s",
+				 bytes / elapsed / (1024 * 1024));
+
+	g_timer_start (timer);
+	bytes = read_stream (buf, PLUMA_DOCUMENT_NEWLINE_TYPE_CR_LF);
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_minimized_result (elapsed, "stream, rewritten newlines: %.1f MB/s",
+				 bytes / elapsed / (1024 * 1024));
+
+	g_timer_destroy (timer);
+	g_object_unref (buf);
+}
+
 int main (int   argc,
           char *argv[])
 {
@@ -152,5 +326,13 @@ int main (int   argc,
 	g_test_add_func ("/document-input-stream/consecutive_multibyte_cut", test_consecutive_multibyte_cut);
 	g_test_add_func ("/document-input-stream/consecutive_multibyte_big_read", test_consecutive_multibyte_big_read);
 
+	g_test_add_func ("/document-input-stream/consecutive_small_read", test_consecutive_small_read);
+
+	g_test_add_func ("/document-input-stream/crlf_across_runs", test_crlf_across_runs);
+	g_test_add_func ("/document-input-stream/tell", test_tell);
+
+	if (g_test_perf ())
+		g_test_add_func ("/document-input-stream/read_benchmark", test_read_benchmark);
+
 	return g_test_run ();
 }
@@ -96,10 +96,11 @@ on_document_loaded (PlumaDocument  *document,
 }
 
 static void
-test_loader (const gchar *filename,
-             const gchar *contents,
-             const gchar *in_buffer,
-             gint         newline_type)
+test_loader_with_encoding (const gchar         *filename,
+                           const gchar         *contents,
+                           const gchar         *in_buffer,
+                           gint                 newline_type,
+                           const PlumaEncoding *encoding)
 {
 	GFile *file;
 	gchar *uri;
@@ -123,7 +124,7 @@ test_loader (const gchar *filename,
 
 	uri = g_file_get_uri (file);
 
-	pluma_document_load (document, uri, pluma_encoding_get_utf8 (), 0, FALSE);
+	pluma_document_load (document, uri, encoding, 0, FALSE);
 
 	g_free (uri);
 
@@ -137,6 +138,19 @@ test_loader (const gchar *filename,
 	g_object_unref (document);
 }
 
+static void
+test_loader (const gchar *filename,
+             const gchar *contents,
+             const gchar *in_buffer,
+             gint         newline_type)
+{
+	test_loader_with_encoding (filename,
+	                           contents,
+	                           in_buffer,
+	                           newline_type,
+	                           pluma_encoding_get_utf8 ());
+}
+
 static void
 test_end_line_stripping ()
 {
@@ -234,6 +248,192 @@ test_begin_new_line_detection ()
 	             PLUMA_DOCUMENT_NEWLINE_TYPE_CR);
 }
 
+static void
+test_large_file ()
+{
+	GString *contents;
+	gchar *in_buffer;
+	gint i;
+
+	/* big enough to be loaded in several spans */
+	contents = g_string_new (NULL);
+
+	for (i = 0; i < 200000; i++)
+	{
+		g_string_append_printf (contents, "line %d: \303\250 hello world\n", i);
+	}
+
+	in_buffer = g_strndup (contents->str, contents->len - 1);
+
+	test_loader ("document-loader.txt",
+	             contents->str,
+	             in_buffer,
+	             PLUMA_DOCUMENT_NEWLINE_TYPE_LF);
+
+	g_free (in_buffer);
+	g_string_free (contents, TRUE);
+}
+
+static void
+test_large_file_conversion ()
+{
+	GString *contents;
+	GString *in_buffer;
+	gint i;
+
+	contents = g_string_new (NULL);
+	in_buffer = g_string_new (NULL);
+
+	for (i = 0; i < 200000; i++)
+	{
+		g_string_append_printf (contents, "line %d: \350 hello world\r\n", i);
+		g_string_append_printf (in_buffer, "line %d: \303\250 hello world\r\n", i);
+	}
+
+	g_string_truncate (in_buffer, in_buffer->len - 2);
+
+	test_loader_with_encoding ("document-loader.txt",
+	                           contents->str,
+	                           in_buffer->str,
+	                           PLUMA_DOCUMENT_NEWLINE_TYPE_CR_LF,
+	                           pluma_encoding_get_from_charset ("ISO-8859-15"));
+
+	g_string_free (in_buffer, TRUE);
+	g_string_free (contents, TRUE);
+}
+
+static void
+test_late_encoding_change ()
+{
+	GString *contents;
+	GString *in_buffer;
+	gint i;
+
+	contents = g_string_new (NULL);
+	in_buffer = g_string_new (NULL);
+
+	/* plain ASCII for a few spans, then Latin-1 */
+	for (i = 0; i < 100000; i++)
+	{
+		g_string_append_printf (contents, "line %d: hello world\n", i);
+		g_string_append_printf (in_buffer, "line %d: hello world\n", i);
+	}
+
+	for (i = 0; i < 1000; i++)
+	{
+		g_string_append_printf (contents, "line %d: \350 hello world\n", i);
+		g_string_append_printf (in_buffer, "line %d: \303\250 hello world\n", i);
+	}
+
+	g_string_truncate (in_buffer, in_buffer->len - 1);
+
+	test_loader_with_encoding ("document-loader.txt",
+	                           contents->str,
+	                           in_buffer->str,
+	                           PLUMA_DOCUMENT_NEWLINE_TYPE_LF,
+	                           NULL);
+
+	g_string_free (in_buffer, TRUE);
+	g_string_free (contents, TRUE);
+}
+
+#define VIEWPORT_LINE 300000
+
+static gboolean viewport_loaded;
+
+static void
+on_viewport_loading (PlumaDocumentLoader *loader,
+                     gboolean             completed,
+                     const GError        *error,
+                     LoaderTestData      *data)
+{
+	PlumaDocument *document;
+	GtkTextIter start, end, cursor;
+	gchar *text;
+
+	g_assert_no_error (error);
+
+	if (!completed)
+	{
+		viewport_loaded |= pluma_document_loader_get_viewport_loaded (loader);
+		return;
+	}
+
+	g_assert (viewport_loaded);
+
+	document = pluma_document_loader_get_document (loader);
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (document), &start, &end);
+	text = gtk_text_iter_get_slice (&start, &end);
+
+	g_assert_cmpstr (text, ==, data->in_buffer);
+
+	g_free (text);
+
+	/* the text loaded before the viewport did not move the cursor away */
+	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (document),
+	                                  &cursor,
+	                                  gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (document)));
+
+	g_assert_cmpint (gtk_text_iter_get_line (&cursor), ==, VIEWPORT_LINE);
+
+	delete_document (data->file);
+}
+
+static void
+test_viewport_first ()
+{
+	GString *contents;
+	gchar *in_buffer;
+	gchar *uri;
+	PlumaDocument *document;
+	PlumaDocumentLoader *loader;
+	LoaderTestData data;
+	gint i;
+
+	/* big enough to be loaded starting from the viewport */
+	contents = g_string_new (NULL);
+
+	for (i = 0; i < 400000; i++)
+	{
+		g_string_append_printf (contents, "line %d: \303\250 hello world\n", i);
+	}
+
+	in_buffer = g_strndup (contents->str, contents->len - 1);
+
+	data.in_buffer = in_buffer;
+	data.newline_type = -1;
+	data.file = create_document ("document-loader.txt", contents->str);
+
+	test_completed = FALSE;
+	viewport_loaded = FALSE;
+
+	document = pluma_document_new ();
+	uri = g_file_get_uri (data.file);
+
+	loader = pluma_document_loader_new (document, uri, pluma_encoding_get_utf8 ());
+	pluma_document_loader_set_viewport_hint (loader, VIEWPORT_LINE, -1);
+
+	g_signal_connect (loader,
+	                  "loading",
+	                  G_CALLBACK (on_viewport_loading),
+	                  &data);
+
+	pluma_document_loader_load (loader);
+
+	while (!test_completed)
+	{
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_object_unref (loader);
+	g_object_unref (document);
+	g_object_unref (data.file);
+	g_free (uri);
+	g_free (in_buffer);
+	g_string_free (contents, TRUE);
+}
+
 int main (int   argc,
           char *argv[])
 {
@@ -242,6 +442,10 @@ int main (int   argc,
 	g_test_add_func ("/document-loader/end-line-stripping", test_end_line_stripping);
 	g_test_add_func ("/document-loader/end-new-line-detection", test_end_new_line_detection);
 	g_test_add_func ("/document-loader/begin-new-line-detection", test_begin_new_line_detection);
+	g_test_add_func ("/document-loader/large-file", test_large_file);
+	g_test_add_func ("/document-loader/large-file-conversion", test_large_file_conversion);
+	g_test_add_func ("/document-loader/late-encoding-change", test_late_encoding_change);
+	g_test_add_func ("/document-loader/viewport-first", test_viewport_first);
 
 	return g_test_run ();
 }
@@ -120,6 +120,51 @@ test_big_char ()
 				PLUMA_DOCUMENT_NEWLINE_TYPE_LF);
 }
 
+static void
+test_invalid_write (const gchar *inbuf,
+		    gsize        inlen,
+		    gsize        write_chunk_len)
+{
+	PlumaDocument *doc;
+	GOutputStream *out;
+	gsize n;
+	gssize w;
+	GError *err = NULL;
+
+	doc = pluma_document_new ();
+	out = pluma_document_output_stream_new (doc);
+
+	n = 0;
+
+	do
+	{
+		w = g_output_stream_write (out, inbuf + n, MIN (write_chunk_len, inlen - n), NULL, &err);
+		if (w > 0)
+			n += w;
+	} while (w > 0);
+
+	g_assert_cmpint (w, ==, -1);
+	g_assert_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+
+	g_error_free (err);
+	g_object_unref (doc);
+	g_object_unref (out);
+}
+
+static void
+test_invalid ()
+{
+	const gchar ascii_then_invalid[] = "the quick brown fox jumps\nover\377 the lazy dog";
+	const gchar cut_then_invalid[] = "hello \343\203abc";
+	const gchar nul[] = "hello, here is a nul\0 byte";
+
+	test_invalid_write (ascii_then_invalid, sizeof (ascii_then_invalid) - 1, 100);
+	test_invalid_write (ascii_then_invalid, sizeof (ascii_then_invalid) - 1, 7);
+	test_invalid_write (cut_then_invalid, sizeof (cut_then_invalid) - 1, 100);
+	test_invalid_write (cut_then_invalid, sizeof (cut_then_invalid) - 1, 7);
+	test_invalid_write (nul, sizeof (nul) - 1, 100);
+}
+
 int main (int   argc,
           char *argv[])
 {
@@ -130,6 +175,7 @@ int main (int   argc,
 	g_test_add_func ("/document-output-stream/consecutive", test_consecutive);
 	g_test_add_func ("/document-output-stream/consecutive_tnewline", test_consecutive_tnewline);
 	g_test_add_func ("/document-output-stream/big-char", test_big_char);
+	g_test_add_func ("/document-output-stream/invalid", test_invalid);
 
 	return g_test_run ();
 }
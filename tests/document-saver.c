@@ -26,6 +26,7 @@
 #include <gtk/gtk.h>
 #include <glib.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
@@ -38,6 +39,7 @@
 #define DEFAULT_REMOTE_URI "sftp://localhost/tmp/pluma-document-saver-test.txt"
 #define DEFAULT_CONTENT "hello world!"
 #define DEFAULT_CONTENT_RESULT "hello world!\n"
+#define DEFAULT_LOCAL_LINK "/tmp/pluma-document-saver-test-link.txt"
 
 #define UNOWNED_LOCAL_DIRECTORY "/tmp/pluma-document-saver-unowned"
 #define UNOWNED_LOCAL_URI "/tmp/pluma-document-saver-unowned/pluma-document-saver-test.txt"
@@ -332,6 +334,81 @@ test_local ()
 	            saver_test_data_new (DEFAULT_LOCAL_URI, "hello world\n\n", NULL));
 }
 
+static void
+test_local_encoding ()
+{
+	GFile *file;
+	gchar *uri;
+	PlumaDocument *document;
+
+	document = create_document ("gr\xc3\xbc\xc3\x9f" "e \xe2\x82\xac");
+
+	g_signal_connect (document, "saved", G_CALLBACK (complete_test_error), NULL);
+	g_signal_connect_after (document, "saved", G_CALLBACK (complete_test), NULL);
+
+	test_completed = FALSE;
+
+	file = g_file_new_for_commandline_arg (DEFAULT_LOCAL_URI);
+	uri = g_file_get_uri (file);
+
+	pluma_document_save_as (document,
+	                        uri,
+	                        pluma_encoding_get_from_charset ("ISO-8859-15"),
+	                        0);
+
+	while (!test_completed)
+	{
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	g_assert_cmpstr (read_file (DEFAULT_LOCAL_URI), ==, "gr\xfc\xdf" "e \xa4\n");
+
+	g_file_delete (file, NULL, NULL);
+
+	g_free (uri);
+	g_object_unref (file);
+	g_object_unref (document);
+}
+
+static void
+test_local_symlink ()
+{
+	GError *error = NULL;
+	GFile *symlink_file;
+	GFileInfo *info;
+
+	g_file_set_contents (DEFAULT_LOCAL_URI, "old contents\n", -1, &error);
+	g_assert_no_error (error);
+
+	symlink_file = g_file_new_for_path (DEFAULT_LOCAL_LINK);
+	g_file_delete (symlink_file, NULL, NULL);
+	g_file_make_symbolic_link (symlink_file, DEFAULT_LOCAL_URI, NULL, &error);
+	g_assert_no_error (error);
+
+	/* saving through the link must not replace it with a regular file */
+	test_saver (DEFAULT_LOCAL_LINK,
+	            DEFAULT_CONTENT,
+	            PLUMA_DOCUMENT_NEWLINE_TYPE_LF,
+	            0,
+	            NULL,
+	            saver_test_data_new (DEFAULT_LOCAL_URI, DEFAULT_CONTENT_RESULT, NULL));
+
+	info = g_file_query_info (symlink_file,
+	                          G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK,
+	                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+	                          NULL,
+	                          &error);
+	g_assert_no_error (error);
+	g_assert (g_file_info_get_is_symlink (info));
+
+	g_object_unref (info);
+
+	g_file_delete (symlink_file, NULL, NULL);
+	g_unlink (DEFAULT_LOCAL_URI);
+
+	g_object_unref (symlink_file);
+}
+
 static void
 test_remote_newline ()
 {
@@ -695,6 +772,8 @@ int main (int   argc,
 
 	g_test_add_func ("/document-saver/local", test_local);
 	g_test_add_func ("/document-saver/local-new-line", test_local_newline);
+	g_test_add_func ("/document-saver/local-encoding", test_local_encoding);
+	g_test_add_func ("/document-saver/local-symlink", test_local_symlink);
 
 	if (have_unowned)
 	{
@@ -0,0 +1,541 @@
+/*
+ * document-search.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-document.h"
+#include "pluma-search-snapshot.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <string.h>
+
+static PlumaDocument *
+create_document (const gchar *contents)
+{
+	PlumaDocument *doc = pluma_document_new ();
+
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), contents, -1);
+	return doc;
+}
+
+static void
+check_match (PlumaDocument *doc,
+	     gboolean       forward,
+	     gint           from,
+	     gint           start,
+	     gint           end)
+{
+	GtkTextIter iter;
+	GtkTextIter m_start;
+	GtkTextIter m_end;
+	gboolean found;
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, from);
+
+	if (forward)
+		found = pluma_document_search_forward (doc, &iter, NULL, &m_start, &m_end);
+	else
+		found = pluma_document_search_backward (doc, NULL, &iter, &m_start, &m_end);
+
+	if (start < 0)
+	{
+		g_assert (!found);
+		return;
+	}
+
+	g_assert (found);
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, start);
+	g_assert_cmpint (gtk_text_iter_get_offset (&m_end), ==, end);
+}
+
+static void
+test_snapshot_offsets ()
+{
+	PlumaDocument *doc;
+	PlumaSearchSnapshot *snapshot;
+	GString *text;
+	gint i;
+
+	/* enough multibyte characters to go through the offset index */
+	text = g_string_new (NULL);
+
+	for (i = 0; i < 3000; i++)
+		g_string_append (text, i % 2 == 0 ? "a" : "\xc3\xa9");
+
+	doc = create_document (text->str);
+	snapshot = _pluma_search_snapshot_new (GTK_TEXT_BUFFER (doc));
+
+	g_assert_cmpuint (_pluma_search_snapshot_get_length (snapshot), ==, text->len);
+
+	for (i = 0; i <= 3000; i += 7)
+	{
+		gsize byte_offset = i + i / 2;
+
+		g_assert_cmpuint (_pluma_search_snapshot_get_byte_offset (snapshot, i), ==, byte_offset);
+		g_assert_cmpint (_pluma_search_snapshot_get_char_offset (snapshot, byte_offset), ==, i);
+	}
+
+	g_assert_cmpuint (_pluma_search_snapshot_get_byte_offset (snapshot, 5000), ==, text->len);
+
+	_pluma_search_snapshot_free (snapshot);
+	g_string_free (text, TRUE);
+	g_object_unref (doc);
+}
+
+static void
+test_regex ()
+{
+	PlumaDocument *doc;
+
+	doc = create_document ("h\xc3\xa9llo bc\nbd b\n");
+	pluma_document_set_search_text (doc, "b(?=[cd])", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 6, 7);
+	check_match (doc, TRUE, 7, 9, 10);
+	check_match (doc, TRUE, 10, -1, -1);
+	check_match (doc, FALSE, 14, 9, 10);
+	check_match (doc, FALSE, 9, 6, 7);
+	check_match (doc, FALSE, 6, -1, -1);
+
+	/* anchors see the whole line, not only the searched range */
+	pluma_document_set_search_text (doc, "^b", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 9, 10);
+	check_match (doc, TRUE, 11, -1, -1);
+
+	/* the snapshot follows the changes */
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), "a\nb", -1);
+	check_match (doc, TRUE, 0, 2, 3);
+
+	g_object_unref (doc);
+}
+
+static void
+test_literal ()
+{
+	PlumaDocument *doc;
+	gchar *as;
+	gchar *text;
+
+	doc = create_document ("h\xc3\xa9llo H\xc3\x89LLO hello\nabab ab");
+
+	pluma_document_set_search_text (doc, "h\xc3\xa9llo", 0);
+
+	check_match (doc, TRUE, 0, 0, 5);
+	check_match (doc, TRUE, 1, 6, 11);
+	check_match (doc, TRUE, 7, -1, -1);
+	check_match (doc, FALSE, 25, 6, 11);
+	check_match (doc, FALSE, 10, 0, 5);
+	check_match (doc, FALSE, 4, -1, -1);
+
+	pluma_document_set_search_text (doc, "h\xc3\xa9llo", PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 1, -1, -1);
+	check_match (doc, FALSE, 25, 0, 5);
+
+	pluma_document_set_search_text (doc, "o\nab", PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 16, 20);
+
+	pluma_document_set_search_text (doc, "ab", PLUMA_SEARCH_CASE_SENSITIVE | PLUMA_SEARCH_ENTIRE_WORD);
+
+	check_match (doc, TRUE, 0, 23, 25);
+	check_match (doc, FALSE, 25, 23, 25);
+	check_match (doc, FALSE, 23, -1, -1);
+
+	/* the search windows shift through a long run of near matches */
+	as = g_strnfill (10000, 'a');
+	text = g_strconcat (as, "b", NULL);
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+
+	pluma_document_set_search_text (doc, "AAB", 0);
+
+	check_match (doc, TRUE, 0, 9998, 10001);
+	check_match (doc, FALSE, 10001, 9998, 10001);
+	check_match (doc, FALSE, 10000, -1, -1);
+
+	g_free (as);
+	g_free (text);
+	g_object_unref (doc);
+}
+
+static void
+test_literal_folding ()
+{
+	PlumaDocument *doc;
+
+	/* a sharp s folds to "ss" */
+	doc = create_document ("Stra\xc3\x9f" "e STRASSE strasse");
+
+	pluma_document_set_search_text (doc, "strasse", 0);
+
+	check_match (doc, TRUE, 0, 0, 6);
+	check_match (doc, TRUE, 1, 7, 14);
+	check_match (doc, FALSE, 22, 15, 22);
+	check_match (doc, FALSE, 7, 0, 6);
+
+	pluma_document_set_search_text (doc, "STRA\xc3\x9f" "E", 0);
+
+	check_match (doc, TRUE, 0, 0, 6);
+	check_match (doc, TRUE, 1, 7, 14);
+
+	/* not half of the sharp s */
+	pluma_document_set_search_text (doc, "stras", 0);
+
+	check_match (doc, TRUE, 0, 7, 12);
+	check_match (doc, FALSE, 6, -1, -1);
+
+	/* a capital and a final sigma both fold to a small sigma */
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc),
+				  "\xce\x9f\xce\x94\xce\x9f\xce\xa3 \xce\xbf\xce\xb4\xce\xbf\xcf\x82", -1);
+
+	pluma_document_set_search_text (doc, "\xce\xbf\xce\xb4\xce\xbf\xcf\x83", 0);
+
+	check_match (doc, TRUE, 0, 0, 4);
+	check_match (doc, TRUE, 1, 5, 9);
+	check_match (doc, FALSE, 9, 5, 9);
+
+	/* precomposed and decomposed accents match each other */
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), "caf\xc3\xa9 cafe\xcc\x81 cafe", -1);
+
+	pluma_document_set_search_text (doc, "CAF\xc3\x89", 0);
+
+	check_match (doc, TRUE, 0, 0, 4);
+	check_match (doc, TRUE, 1, 5, 10);
+	check_match (doc, TRUE, 6, -1, -1);
+	check_match (doc, FALSE, 15, 5, 10);
+
+	pluma_document_set_search_text (doc, "cafe\xcc\x81", 0);
+
+	check_match (doc, TRUE, 0, 0, 4);
+	check_match (doc, FALSE, 15, 5, 10);
+
+	/* but a letter does not match the start of an accented one */
+	pluma_document_set_search_text (doc, "cafe", 0);
+
+	check_match (doc, TRUE, 0, 11, 15);
+	check_match (doc, FALSE, 10, -1, -1);
+
+	g_object_unref (doc);
+}
+
+static void
+test_hidden_text ()
+{
+	PlumaDocument *doc;
+	GtkTextTag *tag;
+	GtkTextIter start;
+	GtkTextIter end;
+
+	doc = create_document ("abXXcd XX ab");
+	tag = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (doc), NULL, "invisible", TRUE, NULL);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &start, 2);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &end, 4);
+	gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (doc), tag, &start, &end);
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &start, 7);
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &end, 9);
+	gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (doc), tag, &start, &end);
+
+	/* the searches are visible only */
+	pluma_document_set_search_text (doc, "XX", PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, -1, -1);
+	check_match (doc, FALSE, 12, -1, -1);
+
+	pluma_document_set_search_text (doc, "bc", PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 1, 5);
+	check_match (doc, FALSE, 12, 1, 5);
+
+	pluma_document_set_search_text (doc, "d +a", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 5, 11);
+	check_match (doc, FALSE, 12, 5, 11);
+
+	/* the text shown again is found */
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (doc), tag, &start, &end);
+
+	pluma_document_set_search_text (doc, "XX", PLUMA_SEARCH_CASE_SENSITIVE);
+
+	check_match (doc, TRUE, 0, 2, 4);
+	check_match (doc, TRUE, 3, 7, 9);
+
+	g_object_unref (doc);
+}
+
+static void
+test_regex_backward_steps ()
+{
+	PlumaDocument *doc;
+	GString *text;
+	GtkTextIter iter;
+	gint line_len;
+	gint i;
+
+	/* far more text than the first backward window */
+	text = g_string_new (NULL);
+
+	for (i = 0; i < 20000; i++)
+		g_string_append_printf (text, "line %05d\n", i);
+
+	line_len = strlen ("line 00000\n");
+
+	doc = create_document (text->str);
+	pluma_document_set_search_text (doc, "e [0-9]*7\\b", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &iter);
+
+	/* each step goes back to the previous line ending with a 7 */
+	for (i = 19997; i >= 0; i -= 10)
+	{
+		GtkTextIter m_start;
+		GtkTextIter m_end;
+
+		g_assert (pluma_document_search_backward (doc, NULL, &iter, &m_start, &m_end));
+		g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, i * line_len + 3);
+		g_assert_cmpint (gtk_text_iter_get_offset (&m_end), ==, i * line_len + 10);
+
+		iter = m_start;
+	}
+
+	g_assert (!pluma_document_search_backward (doc, NULL, &iter, NULL, NULL));
+
+	g_string_free (text, TRUE);
+	g_object_unref (doc);
+}
+
+static void
+test_regex_backward_boundary ()
+{
+	PlumaDocument *doc;
+	gchar *as;
+	gchar *text;
+
+	/* the match starts well before the first backward window */
+	as = g_strnfill (20000, 'a');
+	text = g_strconcat ("x", as, "y", NULL);
+	doc = create_document (text);
+
+	pluma_document_set_search_text (doc, "a*y", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+	check_match (doc, FALSE, 20002, 1, 20002);
+
+	/* going forward from the start, the window starts in a match */
+	g_free (text);
+	text = g_strconcat ("a", as, NULL);
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), text, -1);
+
+	pluma_document_set_search_text (doc, "aa", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+	check_match (doc, FALSE, 20001, 19998, 20000);
+
+	g_free (as);
+	g_free (text);
+	g_object_unref (doc);
+}
+
+static void
+test_regex_backward_periodic ()
+{
+	PlumaDocument *doc;
+	GtkTextIter iter;
+	gchar *text;
+	gint i;
+
+	/* the windows start an odd number of chars after the start, where
+	 * the search from there and the one from a bit before agree */
+	text = g_strnfill (100001, 'a');
+	doc = create_document (text);
+
+	pluma_document_set_search_text (doc, "aa", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	/* going forward the matches start on even offsets */
+	check_match (doc, FALSE, 100001, 99998, 100000);
+	check_match (doc, FALSE, 50001, 49998, 50000);
+	check_match (doc, FALSE, 20001, 19998, 20000);
+
+	gtk_text_buffer_get_end_iter (GTK_TEXT_BUFFER (doc), &iter);
+
+	for (i = 99998; i >= 90000; i -= 2)
+	{
+		GtkTextIter m_start;
+		GtkTextIter m_end;
+
+		g_assert (pluma_document_search_backward (doc, NULL, &iter, &m_start, &m_end));
+		g_assert_cmpint (gtk_text_iter_get_offset (&m_start), ==, i);
+		g_assert_cmpint (gtk_text_iter_get_offset (&m_end), ==, i + 2);
+
+		iter = m_start;
+	}
+
+	g_free (text);
+	g_object_unref (doc);
+}
+
+static void
+test_regex_replace ()
+{
+	PlumaDocument *doc;
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+	gint n;
+
+	doc = create_document ("x=1, y=22, z=333");
+
+	n = pluma_document_replace_all (doc,
+					"([a-z])=([0-9]+)",
+					"\\2=\\1",
+					PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+
+	g_assert_cmpint (n, ==, 3);
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+	g_assert_cmpstr (text, ==, "1=x, 22=y, 333=z");
+
+	g_free (text);
+	g_object_unref (doc);
+}
+
+static void
+check_replace_all (const gchar *text,
+		   const gchar *find,
+		   const gchar *replace,
+		   guint        flags,
+		   gint         count,
+		   const gchar *result)
+{
+	PlumaDocument *doc;
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *replaced;
+
+	doc = create_document (text);
+
+	g_assert_cmpint (pluma_document_replace_all (doc, find, replace, flags), ==, count);
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	replaced = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+	g_assert_cmpstr (replaced, ==, result);
+
+	g_free (replaced);
+	g_object_unref (doc);
+}
+
+static void
+test_replace_all ()
+{
+	gchar *spaces;
+	gchar *text;
+	gchar *result;
+
+	check_replace_all ("foo bar foobar foo", "foo", "x", PLUMA_SEARCH_ENTIRE_WORD, 2, "x bar foobar x");
+	check_replace_all ("Foo foo FOO", "foo", "x", 0, 3, "x x x");
+	check_replace_all ("Foo foo FOO", "foo", "x", PLUMA_SEARCH_CASE_SENSITIVE, 1, "Foo x FOO");
+	check_replace_all ("a.b.c", ".", "\\n", PLUMA_SEARCH_CASE_SENSITIVE, 2, "a\nb\nc");
+	check_replace_all ("abc", "x", "y", 0, 0, "abc");
+
+	/* matches too far apart to be replaced in the same edit */
+	spaces = g_strnfill (10000, ' ');
+	text = g_strconcat ("a", spaces, "a", spaces, "a", NULL);
+	result = g_strconcat ("bb", spaces, "bb", spaces, "bb", NULL);
+
+	check_replace_all (text, "a", "bb", PLUMA_SEARCH_CASE_SENSITIVE, 3, result);
+
+	g_free (spaces);
+	g_free (text);
+	g_free (result);
+}
+
+static void
+test_index_lookbehind ()
+{
+	PlumaDocument *doc;
+	GString *text;
+	gboolean complete;
+	gint n;
+	gint i;
+
+	/* more lines than a chunk of the index */
+	text = g_string_new (NULL);
+
+	for (i = 0; i < 5000; i++)
+		g_string_append (text, "a\n");
+
+	doc = create_document (text->str);
+	pluma_document_set_search_text (doc, "(?<=a\\n)^a", PLUMA_SEARCH_MATCH_REGEX | PLUMA_SEARCH_CASE_SENSITIVE);
+	_pluma_document_set_index_matches (doc, TRUE);
+
+	while (n = _pluma_document_get_n_matches (doc, &complete), !complete)
+		g_main_context_iteration (NULL, TRUE);
+
+	/* the lines starting a chunk see the one before */
+	g_assert_cmpint (n, ==, 4999);
+
+	_pluma_document_set_index_matches (doc, FALSE);
+
+	g_string_free (text, TRUE);
+	g_object_unref (doc);
+}
+
+static void
+test_replace_all_marks ()
+{
+	PlumaDocument *doc;
+	GtkTextIter iter;
+	GtkTextMark *mark;
+
+	doc = create_document ("a b a aa");
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, 2);
+	mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc), NULL, &iter, TRUE);
+
+	g_assert_cmpint (pluma_document_replace_all (doc, "a", "xy", PLUMA_SEARCH_CASE_SENSITIVE), ==, 4);
+
+	/* the text between the matches is left alone */
+	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc), &iter, mark);
+	g_assert_cmpint (gtk_text_iter_get_offset (&iter), ==, 3);
+	g_assert_cmpint (gtk_text_iter_get_char (&iter), ==, 'b');
+
+	g_object_unref (doc);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/document-search/snapshot-offsets", test_snapshot_offsets);
+	g_test_add_func ("/document-search/regex", test_regex);
+	g_test_add_func ("/document-search/literal", test_literal);
+	g_test_add_func ("/document-search/literal-folding", test_literal_folding);
+	g_test_add_func ("/document-search/hidden-text", test_hidden_text);
+	g_test_add_func ("/document-search/regex-backward-steps", test_regex_backward_steps);
+	g_test_add_func ("/document-search/regex-backward-boundary", test_regex_backward_boundary);
+	g_test_add_func ("/document-search/regex-backward-periodic", test_regex_backward_periodic);
+	g_test_add_func ("/document-search/regex-replace", test_regex_replace);
+	g_test_add_func ("/document-search/replace-all", test_replace_all);
+	g_test_add_func ("/document-search/replace-all-marks", test_replace_all_marks);
+	g_test_add_func ("/document-search/index-lookbehind", test_index_lookbehind);
+
+	return g_test_run ();
+}
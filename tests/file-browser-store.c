@@ -0,0 +1,384 @@
+/*
+ * file-browser-store.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-file-browser-store.h"
+#include "pluma-file-browser-enum-types.h"
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+
+/* The store is a dynamic type of the plugin, register it in a module of
+ * our own */
+typedef GTypeModule TestModule;
+typedef GTypeModuleClass TestModuleClass;
+
+G_DEFINE_TYPE (TestModule, test_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+test_module_load (GTypeModule *module)
+{
+	pluma_file_browser_enum_and_flag_register_type (module);
+	_pluma_file_browser_store_register_type (module);
+
+	return TRUE;
+}
+
+static void
+test_module_unload (GTypeModule *module)
+{
+}
+
+static void
+test_module_class_init (TestModuleClass *klass)
+{
+	klass->load = test_module_load;
+	klass->unload = test_module_unload;
+}
+
+static void
+test_module_init (TestModule *module)
+{
+}
+
+static void
+write_file (const gchar *root,
+	    const gchar *relative_path)
+{
+	gchar *path;
+	gchar *dir;
+
+	path = g_build_filename (root, relative_path, NULL);
+	dir = g_path_get_dirname (path);
+
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+	g_assert_true (g_file_set_contents (path, "text\n", -1, NULL));
+
+	g_free (dir);
+	g_free (path);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir != NULL)
+	{
+		while ((name = g_dir_read_name (dir)) != NULL)
+		{
+			gchar *child = g_build_filename (path, name, NULL);
+
+			remove_tree (child);
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+static void
+end_loading (PlumaFileBrowserStore *store,
+	     GtkTreeIter           *iter,
+	     GMainLoop             *loop)
+{
+	g_main_loop_quit (loop);
+}
+
+static PlumaFileBrowserStore *
+load_store (const gchar *root,
+	    GCallback    row_inserted_cb)
+{
+	PlumaFileBrowserStore *store;
+	GMainLoop *loop;
+	gchar *uri;
+
+	loop = g_main_loop_new (NULL, FALSE);
+	store = g_object_new (PLUMA_TYPE_FILE_BROWSER_STORE, NULL);
+
+	g_signal_connect (store, "end-loading", G_CALLBACK (end_loading), loop);
+
+	if (row_inserted_cb != NULL)
+		g_signal_connect (store, "row-inserted", row_inserted_cb, NULL);
+
+	uri = g_filename_to_uri (root, NULL, NULL);
+	pluma_file_browser_store_set_root (store, uri);
+	g_free (uri);
+
+	g_main_loop_run (loop);
+
+	g_signal_handlers_disconnect_by_func (store, end_loading, loop);
+	g_main_loop_unref (loop);
+
+	return store;
+}
+
+static gchar *
+get_name (GtkTreeModel *model,
+	  GtkTreeIter  *iter)
+{
+	gchar *name;
+
+	gtk_tree_model_get (model, iter, PLUMA_FILE_BROWSER_STORE_COLUMN_NAME, &name, -1);
+
+	return name;
+}
+
+/* Every row is found again from its path */
+static void
+check_paths (GtkTreeModel *model)
+{
+	GtkTreeIter iter;
+	GtkTreeIter found;
+	gint n_children;
+	gint i;
+
+	n_children = gtk_tree_model_iter_n_children (model, NULL);
+
+	for (i = 0; i < n_children; i++)
+	{
+		GtkTreePath *path;
+
+		g_assert_true (gtk_tree_model_iter_nth_child (model, &iter, NULL, i));
+
+		path = gtk_tree_model_get_path (model, &iter);
+		g_assert_cmpint (gtk_tree_path_get_depth (path), ==, 1);
+		g_assert_cmpint (gtk_tree_path_get_indices (path)[0], ==, i);
+
+		g_assert_true (gtk_tree_model_get_iter (model, &found, path));
+		g_assert_true (found.user_data == iter.user_data);
+
+		gtk_tree_path_free (path);
+
+		g_assert_true (gtk_tree_model_iter_next (model, &found) == (i < n_children - 1));
+	}
+
+	g_assert_false (gtk_tree_model_iter_nth_child (model, &iter, NULL, n_children));
+}
+
+static void
+test_rows (void)
+{
+	PlumaFileBrowserStore *store;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *root;
+	gchar *name;
+
+	root = g_dir_make_tmp ("pluma-file-browser-store-XXXXXX", NULL);
+	g_assert_nonnull (root);
+
+	write_file (root, "b.txt");
+	write_file (root, "a.txt");
+	write_file (root, ".hidden.txt");
+	write_file (root, "sub/c.txt");
+
+	store = load_store (root, NULL);
+	model = GTK_TREE_MODEL (store);
+
+	pluma_file_browser_store_set_filter_mode (store, PLUMA_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, 3);
+
+	/* the folders come first */
+	g_assert_true (gtk_tree_model_iter_nth_child (model, &iter, NULL, 0));
+	name = get_name (model, &iter);
+	g_assert_cmpstr (name, ==, "sub");
+	g_free (name);
+
+	g_assert_true (gtk_tree_model_iter_nth_child (model, &iter, NULL, 2));
+	name = get_name (model, &iter);
+	g_assert_cmpstr (name, ==, "b.txt");
+	g_free (name);
+
+	check_paths (model);
+
+	/* the hidden file is inserted among the rows */
+	pluma_file_browser_store_set_filter_mode (store, PLUMA_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, 4);
+	check_paths (model);
+
+	pluma_file_browser_store_set_filter_mode (store, PLUMA_FILE_BROWSER_STORE_FILTER_MODE_HIDE_HIDDEN);
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, 3);
+	check_paths (model);
+
+	g_object_unref (store);
+
+	remove_tree (root);
+	g_free (root);
+}
+
+static gboolean
+quit_loop (GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+
+	return FALSE;
+}
+
+/* Waits for the store to apply the monitor events */
+static void
+wait_for_n_children (GtkTreeModel *model,
+		     gint          n_children)
+{
+	GMainLoop *loop;
+	gint64 end_time;
+
+	loop = g_main_loop_new (NULL, FALSE);
+	end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+	while (gtk_tree_model_iter_n_children (model, NULL) != n_children &&
+	       g_get_monotonic_time () < end_time)
+	{
+		g_timeout_add (50, (GSourceFunc) quit_loop, loop);
+		g_main_loop_run (loop);
+	}
+
+	g_main_loop_unref (loop);
+
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, n_children);
+}
+
+static void
+test_monitor (void)
+{
+	PlumaFileBrowserStore *store;
+	GtkTreeModel *model;
+	gchar *root;
+	gchar *path;
+	gint i;
+
+	root = g_dir_make_tmp ("pluma-file-browser-store-XXXXXX", NULL);
+	g_assert_nonnull (root);
+
+	for (i = 0; i < 10; i++)
+	{
+		gchar *name = g_strdup_printf ("old-%d.txt", i);
+
+		write_file (root, name);
+		g_free (name);
+	}
+
+	store = load_store (root, NULL);
+	model = GTK_TREE_MODEL (store);
+
+	pluma_file_browser_store_set_filter_mode (store, PLUMA_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+	g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, 10);
+
+	for (i = 0; i < 5; i++)
+	{
+		gchar *name = g_strdup_printf ("old-%d.txt", i);
+
+		path = g_build_filename (root, name, NULL);
+		g_remove (path);
+		g_free (path);
+		g_free (name);
+	}
+
+	/* created and deleted before the events are applied */
+	write_file (root, "new-0.txt");
+	write_file (root, "new-1.txt");
+	write_file (root, "gone.txt");
+	path = g_build_filename (root, "gone.txt", NULL);
+	g_remove (path);
+	g_free (path);
+
+	wait_for_n_children (model, 7);
+	check_paths (model);
+
+	g_object_unref (store);
+
+	remove_tree (root);
+	g_free (root);
+}
+
+static void
+row_inserted (GtkTreeModel *model,
+	      GtkTreePath  *path,
+	      GtkTreeIter  *iter,
+	      gpointer      user_data)
+{
+	GtkTreePath *row_path;
+
+	/* like the views do */
+	row_path = gtk_tree_model_get_path (model, iter);
+	gtk_tree_path_free (row_path);
+}
+
+static void
+test_large_folder (void)
+{
+	PlumaFileBrowserStore *store;
+	gchar *root;
+	gdouble elapsed;
+	gint n_files = 100000;
+	gint i;
+
+	if (!g_test_perf ())
+		return;
+
+	root = g_dir_make_tmp ("pluma-file-browser-store-XXXXXX", NULL);
+	g_assert_nonnull (root);
+
+	for (i = 0; i < n_files; i++)
+	{
+		gchar *name = g_strdup_printf ("file-%d.txt", i);
+
+		write_file (root, name);
+		g_free (name);
+	}
+
+	g_test_timer_start ();
+	store = load_store (root, G_CALLBACK (row_inserted));
+	elapsed = g_test_timer_elapsed ();
+
+	g_assert_cmpint (gtk_tree_model_iter_n_children (GTK_TREE_MODEL (store), NULL), ==, n_files);
+	g_test_minimized_result (elapsed, "loaded %d files in %6.3f seconds", n_files, elapsed);
+
+	g_object_unref (store);
+
+	remove_tree (root);
+	g_free (root);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	GTypeModule *module;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* the icons are looked up in the theme of the screen */
+	if (!gtk_init_check (&argc, &argv))
+		return g_test_run ();
+
+	module = g_object_new (test_module_get_type (), NULL);
+	g_type_module_use (module);
+
+	g_test_add_func ("/file-browser-store/rows", test_rows);
+	g_test_add_func ("/file-browser-store/monitor", test_monitor);
+	g_test_add_func ("/file-browser-store/large-folder", test_large_folder);
+
+	return g_test_run ();
+}
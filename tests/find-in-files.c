@@ -0,0 +1,295 @@
+/*
+ * find-in-files.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-find-in-files.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct
+{
+	GMainLoop  *loop;
+	GHashTable *files;
+} SearchData;
+
+static void
+test_scan_text (void)
+{
+	const gchar *text = "foo bar\n  food, foo_ foo\n\xc3\xa9foo";
+	GRegex *regex;
+	GArray *matches;
+	PlumaSearchMatch *match;
+	gint n_matches;
+
+	regex = g_regex_new ("foo", G_REGEX_MULTILINE, 0, NULL);
+
+	matches = _pluma_search_matches_new ();
+	n_matches = _pluma_search_scan_text (text, strlen (text), regex, FALSE, 10, NULL, matches);
+	g_assert_cmpint (n_matches, ==, 5);
+	g_assert_cmpuint (matches->len, ==, 5);
+
+	/* the columns are in characters */
+	match = &g_array_index (matches, PlumaSearchMatch, 4);
+	g_assert_cmpint (match->line, ==, 2);
+	g_assert_cmpint (match->line_offset, ==, 1);
+	g_assert_cmpint (match->length, ==, 3);
+	_pluma_search_matches_free (matches);
+
+	/* only the first ones are listed */
+	matches = _pluma_search_matches_new ();
+	n_matches = _pluma_search_scan_text (text, strlen (text), regex, FALSE, 2, NULL, matches);
+	g_assert_cmpint (n_matches, ==, 5);
+	g_assert_cmpuint (matches->len, ==, 2);
+	_pluma_search_matches_free (matches);
+
+	matches = _pluma_search_matches_new ();
+	n_matches = _pluma_search_scan_text (text, strlen (text), regex, TRUE, 10, NULL, matches);
+	g_assert_cmpint (n_matches, ==, 2);
+
+	match = &g_array_index (matches, PlumaSearchMatch, 1);
+	g_assert_cmpint (match->line, ==, 1);
+	g_assert_cmpint (match->line_offset, ==, 13);
+	g_assert_cmpstr (match->markup, ==, "2: food, foo_ <b>foo</b>");
+	_pluma_search_matches_free (matches);
+
+	g_regex_unref (regex);
+}
+
+static void
+test_scan_line_breaks (void)
+{
+	/* the line breaks of GtkTextBuffer */
+	const gchar *text = "a foo\rfoo\r\n  foo\xe2\x80\xa9" "foo";
+	const gint lines[] = { 0, 1, 2, 3 };
+	const gint columns[] = { 2, 0, 2, 0 };
+	GRegex *regex;
+	GArray *matches;
+	PlumaSearchMatch *match;
+	guint i;
+
+	regex = g_regex_new ("foo", G_REGEX_MULTILINE, 0, NULL);
+
+	matches = _pluma_search_matches_new ();
+	_pluma_search_scan_text (text, strlen (text), regex, FALSE, 10, NULL, matches);
+	g_assert_cmpuint (matches->len, ==, 4);
+
+	for (i = 0; i < matches->len; i++)
+	{
+		match = &g_array_index (matches, PlumaSearchMatch, i);
+		g_assert_cmpint (match->line, ==, lines[i]);
+		g_assert_cmpint (match->line_offset, ==, columns[i]);
+	}
+
+	/* the previews stop at the line break */
+	match = &g_array_index (matches, PlumaSearchMatch, 1);
+	g_assert_cmpstr (match->markup, ==, "2: <b>foo</b>");
+	match = &g_array_index (matches, PlumaSearchMatch, 2);
+	g_assert_cmpstr (match->markup, ==, "3: <b>foo</b>");
+
+	_pluma_search_matches_free (matches);
+	g_regex_unref (regex);
+}
+
+static void
+write_file (const gchar *root,
+	    const gchar *relative_path,
+	    const gchar *contents,
+	    gssize       length)
+{
+	gchar *path;
+	gchar *dir;
+
+	path = g_build_filename (root, relative_path, NULL);
+	dir = g_path_get_dirname (path);
+
+	g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+	g_assert_true (g_file_set_contents (path, contents, length, NULL));
+
+	g_free (dir);
+	g_free (path);
+}
+
+static void
+files_found (PlumaFindInFiles *search,
+	     GPtrArray        *results,
+	     gboolean          finished,
+	     SearchData       *data)
+{
+	guint i;
+
+	for (i = 0; i < results->len; i++)
+	{
+		PlumaFindInFilesResult *result = g_ptr_array_index (results, i);
+
+		g_hash_table_insert (data->files,
+				     g_strdup (result->relative_path),
+				     GINT_TO_POINTER (result->n_matches));
+	}
+
+	if (finished)
+		g_main_loop_quit (data->loop);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir != NULL)
+	{
+		while ((name = g_dir_read_name (dir)) != NULL)
+		{
+			gchar *child = g_build_filename (path, name, NULL);
+
+			remove_tree (child);
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+static void
+test_walk (void)
+{
+	PlumaFindInFiles *search;
+	SearchData data;
+	GRegex *regex;
+	gchar *root;
+
+	root = g_dir_make_tmp ("pluma-find-in-files-XXXXXX", NULL);
+	g_assert_nonnull (root);
+
+	write_file (root, "a.txt", "needle\nneedle\n", -1);
+	write_file (root, "sub/b.txt", "a needle\n", -1);
+	write_file (root, "sub/c.log", "needle\n", -1);
+	write_file (root, "sub/keep.log", "needle\n", -1);
+	write_file (root, "sub/.gitignore", "*.log\n!keep.log\n", -1);
+	write_file (root, "build/d.txt", "needle\n", -1);
+	write_file (root, "binary.bin", "needle\0\1\2", 9);
+	write_file (root, "latin1.txt", "needle \xe9\n", -1);
+	write_file (root, "none.txt", "nothing\n", -1);
+	write_file (root, ".git/e.txt", "needle\n", -1);
+	write_file (root, ".gitignore", "/build/\n", -1);
+
+	regex = g_regex_new ("needle", G_REGEX_MULTILINE, 0, NULL);
+
+	data.loop = g_main_loop_new (NULL, FALSE);
+	data.files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	search = _pluma_find_in_files_new (root,
+					   regex,
+					   "needle",
+					   FALSE,
+					   (PlumaFindInFilesFunc) files_found,
+					   &data);
+
+	g_main_loop_run (data.loop);
+
+	g_assert_cmpuint (g_hash_table_size (data.files), ==, 4);
+	g_assert_cmpint (GPOINTER_TO_INT (g_hash_table_lookup (data.files, "a.txt")), ==, 2);
+	g_assert_cmpint (GPOINTER_TO_INT (g_hash_table_lookup (data.files, "sub/b.txt")), ==, 1);
+	g_assert_cmpint (GPOINTER_TO_INT (g_hash_table_lookup (data.files, "sub/keep.log")), ==, 1);
+
+	/* read with the candidate encodings */
+	g_assert_cmpint (GPOINTER_TO_INT (g_hash_table_lookup (data.files, "latin1.txt")), ==, 1);
+	g_assert_cmpuint (_pluma_find_in_files_get_n_skipped (search), ==, 0);
+
+	/* the ones without matches and the .gitignore files are read too */
+	g_assert_cmpuint (_pluma_find_in_files_get_n_searched (search), ==, 8);
+
+	_pluma_find_in_files_cancel (search);
+
+	g_hash_table_destroy (data.files);
+	g_main_loop_unref (data.loop);
+	g_regex_unref (regex);
+
+	remove_tree (root);
+	g_free (root);
+}
+
+static void
+test_walk_many_files (void)
+{
+	PlumaFindInFiles *search;
+	SearchData data;
+	GRegex *regex;
+	gchar *root;
+	gint i;
+
+	root = g_dir_make_tmp ("pluma-find-in-files-XXXXXX", NULL);
+	g_assert_nonnull (root);
+
+	/* more than are queued at once */
+	for (i = 0; i < 1000; i++)
+	{
+		gchar *name = g_strdup_printf ("dir%d/%d.txt", i % 3, i);
+
+		write_file (root, name, "caf\xe9\n", -1);
+		g_free (name);
+	}
+
+	/* the literal is looked for once converted */
+	regex = g_regex_new ("caf\xc3\xa9", G_REGEX_MULTILINE, 0, NULL);
+
+	data.loop = g_main_loop_new (NULL, FALSE);
+	data.files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	search = _pluma_find_in_files_new (root,
+					   regex,
+					   "caf\xc3\xa9",
+					   FALSE,
+					   (PlumaFindInFilesFunc) files_found,
+					   &data);
+
+	g_main_loop_run (data.loop);
+
+	g_assert_cmpuint (g_hash_table_size (data.files), ==, 1000);
+	g_assert_cmpuint (_pluma_find_in_files_get_n_searched (search), ==, 1000);
+
+	_pluma_find_in_files_cancel (search);
+
+	g_hash_table_destroy (data.files);
+	g_main_loop_unref (data.loop);
+	g_regex_unref (regex);
+
+	remove_tree (root);
+	g_free (root);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/find-in-files/scan-text", test_scan_text);
+	g_test_add_func ("/find-in-files/scan-line-breaks", test_scan_line_breaks);
+	g_test_add_func ("/find-in-files/walk", test_walk);
+	g_test_add_func ("/find-in-files/walk-many-files", test_walk_many_files);
+
+	return g_test_run ();
+}
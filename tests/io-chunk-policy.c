@@ -0,0 +1,162 @@
+/*
+ * io-chunk-policy.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-io-chunk-policy.h"
+#include <glib.h>
+
+/* Reports a chunk of @transferred bytes that took @io_time us to come
+ * in and then kept the main loop busy for @busy us, by moving the
+ * timestamps back, and returns the size asked for the next one */
+static gsize
+feed_chunk (PlumaIOChunkPolicy *policy,
+	    gsize               transferred,
+	    gint64              io_time,
+	    gint64              busy)
+{
+	policy->started = g_get_monotonic_time () - io_time;
+	_pluma_io_chunk_policy_done (policy, transferred);
+	policy->finished -= busy;
+
+	return _pluma_io_chunk_policy_begin (policy);
+}
+
+static void
+test_grow ()
+{
+	PlumaIOChunkPolicy policy;
+	gsize size;
+	gint64 io_time = 1000;
+
+	_pluma_io_chunk_policy_init (&policy, PLUMA_IO_CHUNK_POLICY_ADAPTIVE, PLUMA_IO_CHUNK_MIN_SIZE);
+	size = _pluma_io_chunk_policy_begin (&policy);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MIN_SIZE);
+
+	/* each chunk twice as big takes less than twice as long */
+	while (size < PLUMA_IO_CHUNK_MAX_SIZE)
+	{
+		gsize next;
+
+		next = feed_chunk (&policy, size, io_time, 0);
+		g_assert_cmpuint (next, ==, size * 2);
+
+		size = next;
+		io_time = io_time * 3 / 2;
+	}
+
+	/* never past the maximum */
+	size = feed_chunk (&policy, size, io_time, 0);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MAX_SIZE);
+	g_assert_cmpuint (_pluma_io_chunk_policy_get_max_size (&policy), ==, PLUMA_IO_CHUNK_MAX_SIZE);
+
+	g_assert_cmpuint (_pluma_io_chunk_policy_get_throughput (&policy), >, 0);
+}
+
+static void
+test_stop_growing ()
+{
+	PlumaIOChunkPolicy policy;
+	gsize size;
+
+	_pluma_io_chunk_policy_init (&policy, PLUMA_IO_CHUNK_POLICY_ADAPTIVE, PLUMA_IO_CHUNK_MIN_SIZE);
+	size = _pluma_io_chunk_policy_begin (&policy);
+
+	size = feed_chunk (&policy, size, 1000, 0);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MIN_SIZE * 2);
+
+	/* twice the bytes in four times the time: the rate dropped */
+	size = feed_chunk (&policy, size, 4000, 0);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MIN_SIZE * 2);
+
+	/* a short read says nothing about a bigger chunk */
+	size = feed_chunk (&policy, size / 2, 500, 0);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MIN_SIZE * 2);
+}
+
+static void
+test_shrink ()
+{
+	PlumaIOChunkPolicy policy;
+	gsize size;
+
+	_pluma_io_chunk_policy_init (&policy, PLUMA_IO_CHUNK_POLICY_ADAPTIVE, PLUMA_IO_CHUNK_MAX_SIZE);
+	size = _pluma_io_chunk_policy_begin (&policy);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MAX_SIZE);
+
+	/* within the 16ms budget nothing changes */
+	size = feed_chunk (&policy, size, 1000, 10 * 1000);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MAX_SIZE);
+
+	/* past it the chunk is halved, down to the minimum */
+	while (size > PLUMA_IO_CHUNK_MIN_SIZE)
+	{
+		gsize next;
+
+		next = feed_chunk (&policy, size, 1000, 20 * 1000);
+		g_assert_cmpuint (next, ==, size / 2);
+
+		size = next;
+	}
+
+	size = feed_chunk (&policy, size, 1000, 20 * 1000);
+	g_assert_cmpuint (size, ==, PLUMA_IO_CHUNK_MIN_SIZE);
+}
+
+static void
+test_fixed ()
+{
+	PlumaIOChunkPolicy policy;
+	gsize size;
+	gint i;
+
+	_pluma_io_chunk_policy_init (&policy, PLUMA_IO_CHUNK_POLICY_FIXED, 64 * 1024);
+	g_assert_cmpuint (_pluma_io_chunk_policy_get_max_size (&policy), ==, 64 * 1024);
+
+	size = _pluma_io_chunk_policy_begin (&policy);
+	g_assert_cmpuint (size, ==, 64 * 1024);
+
+	/* neither a fast read nor a busy main loop moves it */
+	for (i = 0; i < 10; i++)
+	{
+		size = feed_chunk (&policy, size, 10, 0);
+		g_assert_cmpuint (size, ==, 64 * 1024);
+
+		size = feed_chunk (&policy, size, 1000, 100 * 1000);
+		g_assert_cmpuint (size, ==, 64 * 1024);
+	}
+
+	/* the stats are still kept */
+	g_assert_cmpuint (policy.n_chunks, ==, 20);
+	g_assert_cmpuint (policy.transferred, ==, 20 * 64 * 1024);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/io-chunk-policy/grow", test_grow);
+	g_test_add_func ("/io-chunk-policy/stop-growing", test_stop_growing);
+	g_test_add_func ("/io-chunk-policy/shrink", test_shrink);
+	g_test_add_func ("/io-chunk-policy/fixed", test_fixed);
+
+	return g_test_run ();
+}
@@ -0,0 +1,270 @@
+/*
+ * large-file.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-large-file.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define N_LINES 5000
+
+static gchar *
+create_file (void)
+{
+	GString *contents;
+	gchar *path;
+	GError *error = NULL;
+	gint fd;
+	gint i;
+
+	fd = g_file_open_tmp ("pluma-large-file-XXXXXX", &path, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+
+	contents = g_string_new (NULL);
+
+	for (i = 0; i < N_LINES; i++)
+		g_string_append_printf (contents, "line %d\n", i);
+
+	g_file_set_contents (path, contents->str, contents->len, &error);
+	g_assert_no_error (error);
+
+	g_string_free (contents, TRUE);
+
+	return path;
+}
+
+static void
+test_line_index ()
+{
+	PlumaLargeFile *file;
+	const gchar *contents;
+	gchar *path;
+	gint64 line;
+	gsize offset;
+	GError *error = NULL;
+
+	path = create_file ();
+	file = _pluma_large_file_new (path, &error);
+	g_assert_no_error (error);
+
+	contents = _pluma_large_file_get_contents (file);
+
+	/* not indexed yet */
+	g_assert_cmpint (_pluma_large_file_get_n_lines (file), ==, -1);
+
+	line = 3001;
+	offset = _pluma_large_file_get_line_offset (file, &line);
+	g_assert_cmpint (line, ==, 3001);
+	g_assert (strncmp (contents + offset, "line 3001\n", 10) == 0);
+	g_assert_cmpint (_pluma_large_file_get_line_at_offset (file, offset + 3), ==, 3001);
+
+	while (_pluma_large_file_build_index (file, 1024))
+		;
+
+	g_assert_cmpint (_pluma_large_file_get_n_lines (file), ==, N_LINES);
+
+	/* past the end is clamped to the last line */
+	line = N_LINES + 10;
+	offset = _pluma_large_file_get_line_offset (file, &line);
+	g_assert_cmpint (line, ==, N_LINES - 1);
+	g_assert (strncmp (contents + offset, "line 4999\n", 10) == 0);
+
+	_pluma_large_file_free (file);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_find ()
+{
+	PlumaLargeFile *file;
+	const gchar *contents;
+	gchar *path;
+	gsize length;
+	gsize match;
+	gsize match_end;
+	GError *error = NULL;
+
+	path = create_file ();
+	file = _pluma_large_file_new (path, &error);
+	g_assert_no_error (error);
+
+	contents = _pluma_large_file_get_contents (file);
+	length = _pluma_large_file_get_length (file);
+
+	g_assert (_pluma_large_file_find (file, "line 4321\n", 0, length, TRUE, FALSE, &match, &match_end));
+	g_assert_cmpint (_pluma_large_file_get_line_at_offset (file, match), ==, 4321);
+	g_assert_cmpint (match_end - match, ==, 10);
+
+	g_assert (_pluma_large_file_find (file, "LINE 12\n", 0, length, FALSE, TRUE, &match, &match_end));
+	g_assert (strncmp (contents + match, "line 12\n", 8) == 0);
+
+	g_assert (!_pluma_large_file_find (file, "LINE 12\n", 0, length, TRUE, FALSE, &match, &match_end));
+	g_assert (!_pluma_large_file_find (file, "line 4321", 0, match, TRUE, FALSE, &match, &match_end));
+
+	/* the last one */
+	g_assert (_pluma_large_file_find (file, "line 4", 0, length, TRUE, TRUE, &match, &match_end));
+	g_assert (strncmp (contents + match, "line 4999\n", 10) == 0);
+
+	g_assert (_pluma_large_file_find (file, "line 4", 0, match + 5, TRUE, TRUE, &match, &match_end));
+	g_assert (strncmp (contents + match, "line 4998\n", 10) == 0);
+
+	_pluma_large_file_free (file);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_find_non_ascii ()
+{
+	PlumaLargeFile *file;
+	const gchar *contents;
+	gchar *path;
+	gsize match;
+	gsize match_end;
+	gint fd;
+	GError *error = NULL;
+
+	fd = g_file_open_tmp ("pluma-large-file-XXXXXX", &path, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+
+	g_file_set_contents (path, "Straße\n\xff ÉTÉ\nété\n", -1, &error);
+	g_assert_no_error (error);
+
+	file = _pluma_large_file_new (path, &error);
+	g_assert_no_error (error);
+
+	contents = _pluma_large_file_get_contents (file);
+
+	/* found after the invalid byte */
+	g_assert (_pluma_large_file_find (file, "été", 0, _pluma_large_file_get_length (file), FALSE, FALSE, &match, &match_end));
+	g_assert_cmpint (match_end - match, ==, strlen ("ÉTÉ"));
+	g_assert (strncmp (contents + match, "ÉTÉ", match_end - match) == 0);
+
+	g_assert (_pluma_large_file_find (file, "ÉTÉ", 0, _pluma_large_file_get_length (file), FALSE, TRUE, &match, &match_end));
+	g_assert (strncmp (contents + match, "été\n", 4) == 0);
+
+	g_assert (_pluma_large_file_find (file, "sTRAßE", 0, _pluma_large_file_get_length (file), FALSE, FALSE, &match, &match_end));
+	g_assert_cmpint (match, ==, 0);
+
+	_pluma_large_file_free (file);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_find_regex ()
+{
+	PlumaLargeFile *file;
+	const gchar *contents;
+	GRegex *regex;
+	gchar *path;
+	gsize length;
+	gsize match;
+	gsize match_end;
+	GError *error = NULL;
+
+	path = create_file ();
+	file = _pluma_large_file_new (path, &error);
+	g_assert_no_error (error);
+
+	contents = _pluma_large_file_get_contents (file);
+	length = _pluma_large_file_get_length (file);
+
+	regex = g_regex_new ("^line 43\\d1$", G_REGEX_MULTILINE, 0, NULL);
+
+	g_assert (_pluma_large_file_find_regex (file, regex, 0, length, FALSE, &match, &match_end));
+	g_assert (strncmp (contents + match, "line 4301\n", 10) == 0);
+	g_assert_cmpint (match_end - match, ==, 9);
+
+	g_assert (_pluma_large_file_find_regex (file, regex, 0, length, TRUE, &match, &match_end));
+	g_assert (strncmp (contents + match, "line 4391\n", 10) == 0);
+
+	/* not at the start of a line */
+	g_assert (!_pluma_large_file_find_regex (file, regex, match + 1, length, FALSE, &match, &match_end));
+
+	g_regex_unref (regex);
+
+	_pluma_large_file_free (file);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_truncated ()
+{
+	PlumaLargeFile *file;
+	const gchar *contents;
+	gchar *path;
+	gint64 line;
+	gsize offset;
+	gsize match;
+	gsize match_end;
+	GError *error = NULL;
+
+	path = create_file ();
+	file = _pluma_large_file_new (path, &error);
+	g_assert_no_error (error);
+
+	contents = _pluma_large_file_get_contents (file);
+
+	line = 3001;
+	_pluma_large_file_get_line_offset (file, &line);
+	g_assert_cmpint (line, ==, 3001);
+
+	/* like logrotate's copytruncate does, in the middle of line 13 */
+	g_assert_cmpint (truncate (path, 100), ==, 0);
+
+	/* the pages past the end read as zeros */
+	g_assert_cmpint (contents[40000], ==, 0);
+
+	g_assert_cmpuint (_pluma_large_file_get_length (file), ==, 100);
+
+	line = 3001;
+	offset = _pluma_large_file_get_line_offset (file, &line);
+	g_assert_cmpint (line, ==, 13);
+	g_assert_cmpuint (offset, ==, 94);
+	g_assert_cmpint (_pluma_large_file_get_n_lines (file), ==, 14);
+
+	g_assert (!_pluma_large_file_find (file, "line 4321", 0, G_MAXSIZE, TRUE, FALSE, &match, &match_end));
+
+	_pluma_large_file_free (file);
+	g_unlink (path);
+	g_free (path);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/large-file/line-index", test_line_index);
+	g_test_add_func ("/large-file/find", test_find);
+	g_test_add_func ("/large-file/find-non-ascii", test_find_non_ascii);
+	g_test_add_func ("/large-file/find-regex", test_find_regex);
+	g_test_add_func ("/large-file/truncated", test_truncated);
+
+	return g_test_run ();
+}
@@ -0,0 +1,165 @@
+/*
+ * mapping-guard.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-mapping-guard.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILE_SIZE (64 * 1024)
+
+static GMappedFile *
+map_file (gchar **path)
+{
+	GMappedFile *mapped_file;
+	gchar *contents;
+	GError *error = NULL;
+	gint fd;
+
+	fd = g_file_open_tmp ("pluma-mapping-guard-XXXXXX", path, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+
+	contents = g_malloc (FILE_SIZE);
+	memset (contents, 'a', FILE_SIZE);
+
+	g_file_set_contents (*path, contents, FILE_SIZE, &error);
+	g_assert_no_error (error);
+	g_free (contents);
+
+	mapped_file = g_mapped_file_new (*path, FALSE, &error);
+	g_assert_no_error (error);
+
+	return mapped_file;
+}
+
+/* Adds up the bytes so that the reads are not optimized away */
+static guint
+sum_bytes (const gchar *contents,
+	   gsize        len)
+{
+	guint sum = 0;
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		sum += (guchar) contents[i];
+
+	return sum;
+}
+
+static void
+test_intact ()
+{
+	PlumaMappingGuard guard;
+	GMappedFile *mapped_file;
+	const gchar *contents;
+	gchar *path;
+	guint sum = 0;
+	gboolean faulted = FALSE;
+
+	mapped_file = map_file (&path);
+	contents = g_mapped_file_get_contents (mapped_file);
+
+	_pluma_mapping_guard_push (&guard, contents, FILE_SIZE);
+
+	if (sigsetjmp (guard.env, 1) == 0)
+	{
+		sum = sum_bytes (contents, FILE_SIZE);
+		_pluma_mapping_guard_pop (&guard);
+	}
+	else
+	{
+		faulted = TRUE;
+	}
+
+	g_assert_false (faulted);
+	g_assert_cmpuint (sum, ==, 'a' * FILE_SIZE);
+
+	g_mapped_file_unref (mapped_file);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_truncated ()
+{
+	PlumaMappingGuard outer;
+	PlumaMappingGuard guard;
+	GMappedFile *mapped_file;
+	const gchar *contents;
+	gchar *path;
+	volatile gboolean faulted = FALSE;
+
+	mapped_file = map_file (&path);
+	contents = g_mapped_file_get_contents (mapped_file);
+
+	/* like logrotate's copytruncate does */
+	g_assert_cmpint (truncate (path, 100), ==, 0);
+
+	/* the fault goes to the innermost guard covering the address */
+	_pluma_mapping_guard_push (&outer, contents, FILE_SIZE);
+	_pluma_mapping_guard_push (&guard, "", 1);
+
+	if (sigsetjmp (outer.env, 1) == 0)
+	{
+		sum_bytes (contents, FILE_SIZE);
+		g_assert_not_reached ();
+	}
+	else
+	{
+		faulted = TRUE;
+	}
+
+	g_assert_true (faulted);
+
+	/* both guards are gone, a new one works */
+	faulted = FALSE;
+	_pluma_mapping_guard_push (&guard, contents, FILE_SIZE);
+
+	if (sigsetjmp (guard.env, 1) == 0)
+	{
+		sum_bytes (contents + FILE_SIZE / 2, FILE_SIZE / 2);
+		g_assert_not_reached ();
+	}
+	else
+	{
+		faulted = TRUE;
+	}
+
+	g_assert_true (faulted);
+
+	g_mapped_file_unref (mapped_file);
+	g_unlink (path);
+	g_free (path);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/mapping-guard/intact", test_intact);
+	g_test_add_func ("/mapping-guard/truncated", test_truncated);
+
+	return g_test_run ();
+}
@@ -0,0 +1,159 @@
+/*
+ * match-index.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-match-index.h"
+#include <glib.h>
+
+/* matches of 2 characters at 0, 10, 20... */
+static PlumaMatchIndex *
+create_index (gint n_matches)
+{
+	PlumaMatchIndex *index;
+	gint i;
+
+	index = _pluma_match_index_new ();
+
+	/* out of order on purpose */
+	for (i = n_matches - 1; i >= 0; i--)
+		_pluma_match_index_add (index, i * 10, i * 10 + 2);
+
+	return index;
+}
+
+static void
+check_match (PlumaMatchIndex *index,
+	     gint             n,
+	     gint             expected_start,
+	     gint             expected_end)
+{
+	gint start, end;
+
+	g_assert_true (_pluma_match_index_get_nth (index, n, &start, &end));
+	g_assert_cmpint (start, ==, expected_start);
+	g_assert_cmpint (end, ==, expected_end);
+}
+
+static void
+test_lookup (void)
+{
+	PlumaMatchIndex *index = create_index (5);
+
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 5);
+	check_match (index, 0, 0, 2);
+	check_match (index, 4, 40, 42);
+	g_assert_false (_pluma_match_index_get_nth (index, 5, NULL, NULL));
+	g_assert_false (_pluma_match_index_get_nth (index, -1, NULL, NULL));
+
+	g_assert_cmpint (_pluma_match_index_lookup (index, 20), ==, 2);
+	g_assert_cmpint (_pluma_match_index_lookup (index, 21), ==, -1);
+
+	g_assert_cmpint (_pluma_match_index_find (index, 20, TRUE), ==, 2);
+	g_assert_cmpint (_pluma_match_index_find (index, 21, TRUE), ==, 3);
+	g_assert_cmpint (_pluma_match_index_find (index, 41, TRUE), ==, -1);
+	g_assert_cmpint (_pluma_match_index_find (index, 20, FALSE), ==, 1);
+	g_assert_cmpint (_pluma_match_index_find (index, 21, FALSE), ==, 2);
+	g_assert_cmpint (_pluma_match_index_find (index, 0, FALSE), ==, -1);
+
+	_pluma_match_index_remove (index, 10, 30);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 3);
+	check_match (index, 1, 30, 32);
+
+	_pluma_match_index_clear (index);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 0);
+	g_assert_cmpint (_pluma_match_index_find (index, 0, TRUE), ==, -1);
+
+	_pluma_match_index_free (index);
+}
+
+static void
+test_text_changes (void)
+{
+	PlumaMatchIndex *index = create_index (5);
+
+	/* before a match: it is moved */
+	_pluma_match_index_text_inserted (index, 10, 3);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 5);
+	check_match (index, 0, 0, 2);
+	check_match (index, 1, 13, 15);
+	check_match (index, 4, 43, 45);
+
+	/* inside a match: it is dropped */
+	_pluma_match_index_text_inserted (index, 14, 1);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 4);
+	check_match (index, 1, 24, 26);
+
+	/* right after a match: it is kept in place */
+	_pluma_match_index_text_inserted (index, 2, 1);
+	check_match (index, 0, 0, 2);
+	check_match (index, 1, 25, 27);
+
+	/* over a match: it is dropped, the others are moved back */
+	_pluma_match_index_text_deleted (index, 20, 10);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 3);
+	check_match (index, 0, 0, 2);
+	check_match (index, 1, 25, 27);
+	check_match (index, 2, 35, 37);
+
+	/* up to the start of a match: it is kept */
+	_pluma_match_index_text_deleted (index, 2, 23);
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, 3);
+	check_match (index, 1, 2, 4);
+	check_match (index, 2, 12, 14);
+
+	_pluma_match_index_free (index);
+}
+
+static void
+test_scattered_changes (void)
+{
+	PlumaMatchIndex *index = create_index (10);
+	gint expected[] = { 0, 10, 21, 31, 41, 51, 55, 66, 76, 84, 94 };
+	guint i;
+
+	/* the matches are moved lazily, going back and forth */
+	_pluma_match_index_text_inserted (index, 55, 5);
+	_pluma_match_index_text_inserted (index, 15, 1);
+	_pluma_match_index_add (index, 55, 57);
+	_pluma_match_index_text_deleted (index, 80, 2);
+
+	g_assert_cmpint (_pluma_match_index_get_n_matches (index), ==, G_N_ELEMENTS (expected));
+
+	for (i = 0; i < G_N_ELEMENTS (expected); i++)
+		check_match (index, i, expected[i], expected[i] + 2);
+
+	g_assert_cmpint (_pluma_match_index_lookup (index, 66), ==, 7);
+	g_assert_cmpint (_pluma_match_index_find (index, 80, TRUE), ==, 9);
+
+	_pluma_match_index_free (index);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/match-index/lookup", test_lookup);
+	g_test_add_func ("/match-index/text-changes", test_text_changes);
+	g_test_add_func ("/match-index/scattered-changes", test_scattered_changes);
+
+	return g_test_run ();
+}
@@ -0,0 +1,99 @@
+/*
+ * search-results-panel.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "pluma-document.h"
+#include "pluma-search-results-panel.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <string.h>
+
+static PlumaDocument *
+create_document (const gchar *contents)
+{
+	PlumaDocument *doc = pluma_document_new ();
+
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (doc), contents, -1);
+	return doc;
+}
+
+static void
+check_text (PlumaDocument *doc,
+	    const gchar   *expected)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+	text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+	g_assert_cmpstr (text, ==, expected);
+	g_free (text);
+}
+
+static void
+test_replace_all_documents (void)
+{
+	PlumaDocument *docs[3];
+	GList *list = NULL;
+	gint count;
+	gint i;
+
+	docs[0] = create_document ("foo bar foo");
+	docs[1] = create_document ("Foo\nfoo");
+	docs[2] = create_document ("foo");
+
+	/* the read-only documents are not changed */
+	_pluma_document_set_readonly (docs[2], TRUE);
+
+	for (i = 2; i >= 0; i--)
+		list = g_list_prepend (list, docs[i]);
+
+	count = _pluma_search_replace_all_in_documents (list,
+							"foo",
+							"baz",
+							PLUMA_SEARCH_CASE_SENSITIVE);
+	g_assert_cmpint (count, ==, 3);
+
+	check_text (docs[0], "baz bar baz");
+	check_text (docs[1], "Foo\nbaz");
+	check_text (docs[2], "foo");
+
+	/* the documents are searched like the document search does */
+	count = _pluma_search_replace_all_in_documents (list, "BAZ", "qux", 0);
+	g_assert_cmpint (count, ==, 3);
+	check_text (docs[1], "Foo\nqux");
+
+	g_list_free (list);
+
+	for (i = 0; i < 3; i++)
+		g_object_unref (docs[i]);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/search-results-panel/replace-all-documents", test_replace_all_documents);
+
+	return g_test_run ();
+}
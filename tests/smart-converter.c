@@ -345,6 +345,63 @@ test_guessed ()
 	g_free (aux2);
 }
 
+static void
+test_ranked ()
+{
+	GSList *encs = NULL;
+	gchar *out;
+	const PlumaEncoding *guessed;
+
+	/* valid UTF-8 with accents beats a legacy encoding listed first */
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_from_charset ("ISO-8859-15"));
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_utf8 ());
+
+	out = do_test ("caf\xc3\xa9 cr\xc3\xa8me", NULL, encs, 12, &guessed);
+	g_assert (guessed == pluma_encoding_get_utf8 ());
+	g_free (out);
+
+	/* plain ASCII fits both, the first one wins */
+	out = do_test ("plain text", NULL, encs, 10, &guessed);
+	g_assert (guessed == pluma_encoding_get_from_charset ("ISO-8859-15"));
+	g_free (out);
+
+	g_slist_free (encs);
+	encs = NULL;
+
+	/* 0x81 is not defined in WINDOWS-1252 */
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_utf8 ());
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_from_charset ("WINDOWS-1252"));
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_from_charset ("ISO-8859-15"));
+
+	out = do_test ("caf\xe9 \x81", NULL, encs, 6, &guessed);
+	g_assert (guessed == pluma_encoding_get_from_charset ("ISO-8859-15"));
+	g_free (out);
+
+	out = do_test ("caf\xe9 cr\xe8me", NULL, encs, 10, &guessed);
+	g_assert (guessed == pluma_encoding_get_from_charset ("WINDOWS-1252"));
+	g_free (out);
+
+	g_slist_free (encs);
+}
+
+static void
+test_stray_nul ()
+{
+	GSList *encs = NULL;
+	gchar *out;
+	const PlumaEncoding *guessed;
+
+	/* a nul byte lowers the confidence but does not rule the text out */
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_utf8 ());
+	encs = g_slist_append (encs, (gpointer)pluma_encoding_get_from_charset ("WINDOWS-1252"));
+
+	out = do_test ("caf\xe9\0 cr\xe8me", NULL, encs, 11, &guessed);
+	g_assert (guessed == pluma_encoding_get_from_charset ("WINDOWS-1252"));
+	g_free (out);
+
+	g_slist_free (encs);
+}
+
 int main (int   argc,
           char *argv[])
 {
@@ -354,6 +411,8 @@ int main (int   argc,
 	//g_test_add_func ("/smart-converter/xxx-xxx", test_xxx_xxx);
 	g_test_add_func ("/smart-converter/guessed", test_guessed);
 	g_test_add_func ("/smart-converter/empty", test_empty);
+	g_test_add_func ("/smart-converter/ranked", test_ranked);
+	g_test_add_func ("/smart-converter/stray-nul", test_stray_nul);
 
 	return g_test_run ();
 }
@@ -0,0 +1,356 @@
+/*
+ * text-region.c
+ * This file is part of pluma
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * pluma is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * pluma is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with pluma; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "plumatextregion.h"
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <string.h>
+
+/* Number of subregions of the benchmark, when running the perf tests */
+#define BENCHMARK_SUBREGIONS 100000
+
+static GtkTextBuffer *
+create_buffer (gint length)
+{
+	GtkTextBuffer *buffer;
+	gchar *text;
+
+	buffer = gtk_text_buffer_new (NULL);
+	text = g_strnfill (length, 'x');
+
+	gtk_text_buffer_set_text (buffer, text, -1);
+
+	g_free (text);
+	return buffer;
+}
+
+static void
+region_add (PlumaTextRegion *region,
+	    gint             start,
+	    gint             end)
+{
+	GtkTextBuffer *buffer = pluma_text_region_get_buffer (region);
+	GtkTextIter s, e;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &s, start);
+	gtk_text_buffer_get_iter_at_offset (buffer, &e, end);
+
+	pluma_text_region_add (region, &s, &e);
+}
+
+static void
+region_subtract (PlumaTextRegion *region,
+		 gint             start,
+		 gint             end)
+{
+	GtkTextBuffer *buffer = pluma_text_region_get_buffer (region);
+	GtkTextIter s, e;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &s, start);
+	gtk_text_buffer_get_iter_at_offset (buffer, &e, end);
+
+	pluma_text_region_subtract (region, &s, &e);
+}
+
+static PlumaTextRegion *
+region_intersect (PlumaTextRegion *region,
+		  gint             start,
+		  gint             end)
+{
+	GtkTextBuffer *buffer = pluma_text_region_get_buffer (region);
+	GtkTextIter s, e;
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &s, start);
+	gtk_text_buffer_get_iter_at_offset (buffer, &e, end);
+
+	return pluma_text_region_intersect (region, &s, &e);
+}
+
+/* Checks the subregions against "start-end start-end..." */
+static void
+check_region (PlumaTextRegion *region,
+	      const gchar     *expected)
+{
+	GString *str;
+	gint i;
+
+	str = g_string_new (NULL);
+
+	for (i = 0; i < pluma_text_region_subregions (region); i++)
+	{
+		GtkTextIter start, end;
+
+		g_assert (pluma_text_region_nth_subregion (region, i, &start, &end));
+
+		g_string_append_printf (str,
+					"%s%d-%d",
+					i > 0 ? " " : "",
+					gtk_text_iter_get_offset (&start),
+					gtk_text_iter_get_offset (&end));
+	}
+
+	g_assert_cmpstr (str->str, ==, expected);
+
+	g_string_free (str, TRUE);
+}
+
+static void
+test_add ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+
+	buffer = create_buffer (100);
+	region = pluma_text_region_new (buffer);
+
+	region_add (region, 30, 40);
+	region_add (region, 10, 20);
+	region_add (region, 60, 70);
+	region_add (region, 5, 5);
+	check_region (region, "10-20 30-40 60-70");
+
+	/* overlapping and touching subregions are merged */
+	region_add (region, 15, 35);
+	check_region (region, "10-40 60-70");
+
+	region_add (region, 40, 60);
+	check_region (region, "10-70");
+
+	region_add (region, 0, 100);
+	check_region (region, "0-100");
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_subtract ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+
+	buffer = create_buffer (100);
+	region = pluma_text_region_new (buffer);
+
+	region_add (region, 10, 60);
+	region_subtract (region, 20, 30);
+	check_region (region, "10-20 30-60");
+
+	region_subtract (region, 0, 5);
+	check_region (region, "10-20 30-60");
+
+	region_subtract (region, 15, 40);
+	check_region (region, "10-15 40-60");
+
+	region_subtract (region, 40, 60);
+	check_region (region, "10-15");
+
+	region_add (region, 20, 30);
+	region_add (region, 40, 50);
+	region_subtract (region, 0, 100);
+	check_region (region, "");
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_intersect ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+	PlumaTextRegion *intersection;
+
+	buffer = create_buffer (100);
+	region = pluma_text_region_new (buffer);
+
+	region_add (region, 10, 20);
+	region_add (region, 30, 40);
+	region_add (region, 50, 60);
+
+	intersection = region_intersect (region, 15, 55);
+	check_region (intersection, "15-20 30-40 50-55");
+	pluma_text_region_destroy (intersection, TRUE);
+
+	intersection = region_intersect (region, 32, 38);
+	check_region (intersection, "32-38");
+	pluma_text_region_destroy (intersection, TRUE);
+
+	intersection = region_intersect (region, 0, 10);
+	g_assert (intersection == NULL);
+
+	intersection = region_intersect (region, 20, 30);
+	g_assert (intersection == NULL);
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_iterator ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+	PlumaTextRegionIterator iter;
+	gint n = 0;
+
+	buffer = create_buffer (100);
+	region = pluma_text_region_new (buffer);
+
+	region_add (region, 10, 20);
+	region_add (region, 30, 40);
+
+	pluma_text_region_get_iterator (region, &iter, 0);
+
+	while (!pluma_text_region_iterator_is_end (&iter))
+	{
+		GtkTextIter start, end;
+
+		pluma_text_region_iterator_get_subregion (&iter, &start, &end);
+		g_assert_cmpint (gtk_text_iter_get_offset (&start), ==, 10 + 20 * n);
+		g_assert_cmpint (gtk_text_iter_get_offset (&end), ==, 20 + 20 * n);
+
+		pluma_text_region_iterator_next (&iter);
+		n++;
+	}
+
+	g_assert_cmpint (n, ==, 2);
+
+	pluma_text_region_get_iterator (region, &iter, 5);
+	g_assert (pluma_text_region_iterator_is_end (&iter));
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_buffer_changes ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+	GtkTextIter start, end;
+
+	buffer = create_buffer (100);
+	region = pluma_text_region_new (buffer);
+
+	region_add (region, 10, 20);
+	region_add (region, 30, 40);
+
+	/* the subregions follow the text */
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, 0);
+	gtk_text_buffer_insert (buffer, &start, "12345", -1);
+	check_region (region, "15-25 35-45");
+
+	/* the subregion whose text is deleted is gone */
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, 12);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, 28);
+	gtk_text_buffer_delete (buffer, &start, &end);
+	check_region (region, "19-29");
+
+	region_subtract (region, 0, 14);
+	check_region (region, "19-29");
+
+	region_add (region, 0, 19);
+	check_region (region, "0-29");
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+static void
+test_benchmark ()
+{
+	GtkTextBuffer *buffer;
+	PlumaTextRegion *region;
+	gint n_subregions;
+	gint length;
+	gdouble elapsed;
+	gint i;
+
+	n_subregions = g_test_perf () ? BENCHMARK_SUBREGIONS : 1000;
+	length = n_subregions * 4;
+
+	buffer = create_buffer (length);
+	region = pluma_text_region_new (buffer);
+
+	/* a scattered region, like the one left by many edits */
+	g_test_timer_start ();
+
+	for (i = 0; i < n_subregions; i++)
+		region_add (region, (i * 7919 % n_subregions) * 4, (i * 7919 % n_subregions) * 4 + 2);
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "add %d subregions: %f s", n_subregions, elapsed);
+
+	g_assert_cmpint (pluma_text_region_subregions (region), ==, n_subregions);
+
+	g_test_timer_start ();
+
+	for (i = 0; i < n_subregions; i++)
+	{
+		PlumaTextRegion *intersection;
+		gint offset;
+
+		offset = g_test_rand_int_range (0, length - 8);
+		intersection = region_intersect (region, offset, offset + 8);
+
+		g_assert (intersection != NULL);
+		pluma_text_region_destroy (intersection, TRUE);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "%d intersections: %f s", n_subregions, elapsed);
+
+	g_test_timer_start ();
+
+	/* take every other subregion out, in no particular order */
+	for (i = 0; i < n_subregions; i += 2)
+	{
+		gint offset = (i * 7919 % n_subregions) * 4;
+
+		region_subtract (region, offset, offset + 1);
+		region_subtract (region, offset + 1, offset + 2);
+	}
+
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "%d subtractions: %f s", n_subregions, elapsed);
+
+	g_assert_cmpint (pluma_text_region_subregions (region), ==, n_subregions / 2);
+
+	pluma_text_region_destroy (region, TRUE);
+	g_object_unref (buffer);
+}
+
+int main (int   argc,
+          char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/text-region/add", test_add);
+	g_test_add_func ("/text-region/subtract", test_subtract);
+	g_test_add_func ("/text-region/intersect", test_intersect);
+	g_test_add_func ("/text-region/iterator", test_iterator);
+	g_test_add_func ("/text-region/buffer-changes", test_buffer_changes);
+	g_test_add_func ("/text-region/benchmark", test_benchmark);
+
+	return g_test_run ();
+}